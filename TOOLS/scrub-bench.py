@@ -0,0 +1,247 @@
+#!/usr/bin/env python3
+"""
+Simulate dragging the seek bar over a file served by a local HTTP server, and
+measure the time from the end of the drag (the final exact seek) to the first
+frame being shown. Each run is done with plain keyframe seeks during the drag
+(like the OSC did before the "scrub" seek flag existed) and with scrub seeks.
+
+Example:
+
+    TOOLS/scrub-bench.py --mpv build/mpv --latency 50 --runs 5 video.mkv
+
+Requires POSIX (uses a Unix domain socket for the JSON IPC).
+"""
+
+import argparse
+import http.server
+import json
+import os
+import queue
+import re
+import socket
+import statistics
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+
+RANGE = re.compile(r"bytes=(\d+)-(\d*)")
+
+
+def make_handler(path, latency, stats):
+    size = os.path.getsize(path)
+
+    class Handler(http.server.BaseHTTPRequestHandler):
+        protocol_version = "HTTP/1.1"
+
+        def log_message(self, *args):
+            pass
+
+        def do_HEAD(self):
+            self.do_GET(body=False)
+
+        def do_GET(self, body=True):
+            stats["requests"] += 1
+            time.sleep(latency)
+            start, end = 0, size - 1
+            m = RANGE.match(self.headers.get("Range", ""))
+            if m:
+                start = int(m.group(1))
+                if m.group(2):
+                    end = min(int(m.group(2)), size - 1)
+            if start >= size:
+                self.send_response(416)
+                self.send_header("Content-Range", f"bytes */{size}")
+                self.send_header("Content-Length", "0")
+                self.end_headers()
+                return
+            self.send_response(206 if m else 200)
+            self.send_header("Accept-Ranges", "bytes")
+            self.send_header("Content-Length", str(end - start + 1))
+            if m:
+                self.send_header("Content-Range", f"bytes {start}-{end}/{size}")
+            self.end_headers()
+            if not body:
+                return
+            try:
+                with open(path, "rb") as f:
+                    f.seek(start)
+                    left = end - start + 1
+                    while left > 0:
+                        data = f.read(min(left, 65536))
+                        if not data:
+                            break
+                        self.wfile.write(data)
+                        left -= len(data)
+            except (BrokenPipeError, ConnectionResetError):
+                pass
+
+    return Handler
+
+
+class IPC:
+    def __init__(self, path, timeout):
+        deadline = time.monotonic() + timeout
+        while True:
+            try:
+                self.sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+                self.sock.connect(path)
+                break
+            except OSError:
+                self.sock.close()
+                if time.monotonic() > deadline:
+                    raise
+                time.sleep(0.05)
+        self.replies = queue.Queue()
+        self.events = queue.Queue()
+        self.request_id = 0
+        self.thread = threading.Thread(target=self._reader, daemon=True)
+        self.thread.start()
+
+    def _reader(self):
+        for line in self.sock.makefile("r"):
+            msg = json.loads(line)
+            if "event" in msg:
+                self.events.put((time.monotonic(), msg["event"]))
+            else:
+                self.replies.put(msg)
+        self.replies.put(None)
+
+    def command(self, *args, wait=True):
+        self.request_id += 1
+        msg = {"command": list(args), "request_id": self.request_id}
+        self.sock.sendall((json.dumps(msg) + "\n").encode())
+        while wait:
+            reply = self.replies.get()
+            if reply is None:
+                raise EOFError("mpv closed the IPC connection")
+            if reply.get("request_id") == self.request_id:
+                return reply.get("data") if reply["error"] == "success" else None
+
+    def wait_event(self, name, timeout):
+        deadline = time.monotonic() + timeout
+        while True:
+            left = deadline - time.monotonic()
+            if left <= 0:
+                raise TimeoutError(f"no {name} event")
+            t, event = self.events.get(timeout=left)
+            if event == name:
+                return t
+
+    def drain_events(self):
+        while not self.events.empty():
+            self.events.get()
+
+    def close(self):
+        self.sock.close()
+
+
+def drag(ipc, args, flags):
+    """Returns the time from the final seek to the first frame, and the
+    number of frames shown during the drag."""
+    ipc.command("seek", args.start, "absolute-percent+exact")
+    ipc.wait_event("playback-restart", args.timeout)
+    time.sleep(0.5)
+    ipc.drain_events()
+
+    steps = max(int(args.drag_time * args.rate), 1)
+    for n in range(1, steps + 1):
+        pos = args.start + (args.end - args.start) * n / steps
+        ipc.command("seek", pos, flags, wait=False)
+        time.sleep(1 / args.rate)
+    restarts = 0
+    while not ipc.events.empty():
+        restarts += ipc.events.get()[1] == "playback-restart"
+
+    t0 = time.monotonic()
+    ipc.command("seek", args.end, "absolute-percent+exact", wait=False)
+    t1 = ipc.wait_event("playback-restart", args.timeout)
+    # A restart from a drag seek may still have been pending.
+    while True:
+        try:
+            t1 = ipc.wait_event("playback-restart", 0.3)
+        except (TimeoutError, queue.Empty):
+            break
+    return t1 - t0, restarts
+
+
+def run(args, url, flags, tmpdir):
+    sock = os.path.join(tmpdir, "ipc")
+    cmd = [
+        args.mpv, "--no-config", "--really-quiet", "--idle=no",
+        "--keep-open=yes", "--pause", "--ao=null", f"--vo={args.vo}",
+        f"--input-ipc-server={sock}", url,
+    ] + args.extra
+    proc = subprocess.Popen(cmd, stdin=subprocess.DEVNULL)
+    try:
+        ipc = IPC(sock, args.timeout)
+        ipc.wait_event("file-loaded", args.timeout)
+        res = drag(ipc, args, flags)
+        ipc.command("quit", wait=False)
+        ipc.close()
+        proc.wait(args.timeout)
+    finally:
+        if proc.poll() is None:
+            proc.kill()
+            proc.wait()
+    return res
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().split("\n")[0])
+    parser.add_argument("--mpv", default="mpv", help="mpv binary")
+    parser.add_argument("--vo", default="null")
+    parser.add_argument("--latency", type=float, default=50,
+                        help="added delay per HTTP request in ms")
+    parser.add_argument("--start", type=float, default=10,
+                        help="drag start position in percent")
+    parser.add_argument("--end", type=float, default=60,
+                        help="drag end position in percent")
+    parser.add_argument("--drag-time", type=float, default=2,
+                        help="duration of the drag in seconds")
+    parser.add_argument("--rate", type=float, default=60,
+                        help="seek commands per second during the drag")
+    parser.add_argument("--runs", type=int, default=3)
+    parser.add_argument("--timeout", type=float, default=30,
+                        help="real time limit per step in seconds")
+    parser.add_argument("file", help="file to serve")
+    parser.add_argument("extra", nargs="*", help="additional mpv options")
+    args = parser.parse_args()
+
+    stats = {"requests": 0}
+    handler = make_handler(args.file, args.latency / 1000, stats)
+    server = http.server.ThreadingHTTPServer(("127.0.0.1", 0), handler)
+    threading.Thread(target=server.serve_forever, daemon=True).start()
+    url = (f"http://127.0.0.1:{server.server_address[1]}/" +
+           os.path.basename(args.file))
+
+    print(f"{'mode':>10} {'time-to-frame (ms)':>20} {'drag frames':>12} "
+          f"{'requests':>9}")
+    failed = False
+    for mode, flags in [("keyframes", "absolute-percent+keyframes"),
+                        ("scrub", "absolute-percent+scrub")]:
+        times, frames = [], []
+        stats["requests"] = 0
+        for _ in range(args.runs):
+            with tempfile.TemporaryDirectory() as tmpdir:
+                try:
+                    t, f = run(args, url, flags, tmpdir)
+                except (OSError, EOFError, TimeoutError, queue.Empty,
+                        subprocess.TimeoutExpired) as e:
+                    print(f"{mode:>10} error: {e}")
+                    failed = True
+                    continue
+            times.append(t * 1000)
+            frames.append(f)
+        if times:
+            print(f"{mode:>10} {statistics.median(times):>20.1f} "
+                  f"{statistics.median(frames):>12} "
+                  f"{stats['requests'] // args.runs:>9}")
+
+    server.shutdown()
+    sys.exit(1 if failed else 0)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,182 @@
+#!/usr/bin/env python3
+"""
+Run mpv with the simulated display (--vo=sim) for a matrix of content frame
+rates and display refresh rates, and report the frame scheduling statistics.
+With limits given, exits with status 1 if any run exceeds them, so it can be
+used to catch regressions in CI.
+
+Example:
+
+    TOOLS/vsync-bench.py --mpv build/mpv --video-sync display-resample \\
+        --content-fps 23.976,25,30,60 --display-fps 50,60,144 \\
+        --jitter 0.5 --max-mistimed 0 --max-drops 0
+
+Requires POSIX (uses a Unix domain socket for the JSON IPC).
+"""
+
+import argparse
+import json
+import os
+import re
+import socket
+import subprocess
+import sys
+import tempfile
+import time
+
+PROPERTIES = [
+    "frame-drop-count",
+    "decoder-frame-drop-count",
+    "vo-delayed-frame-count",
+    "mistimed-frame-count",
+    "total-avsync-change",
+    "avsync",
+    "vsync-jitter",
+]
+
+SIM_STATS = re.compile(r"Simulated (\d+) vsyncs: (\d+) frames, (\d+) repeats, "
+                       r"(\d+) vsyncs without flip, (\d+) missed vsyncs")
+
+
+class IPC:
+    def __init__(self, path, timeout):
+        deadline = time.monotonic() + timeout
+        while True:
+            try:
+                self.sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+                self.sock.connect(path)
+                break
+            except OSError:
+                self.sock.close()
+                if time.monotonic() > deadline:
+                    raise
+                time.sleep(0.05)
+        self.file = self.sock.makefile("r")
+        self.request_id = 0
+
+    def command(self, *args):
+        self.request_id += 1
+        msg = {"command": list(args), "request_id": self.request_id}
+        self.sock.sendall((json.dumps(msg) + "\n").encode())
+        for line in self.file:
+            reply = json.loads(line)
+            if reply.get("request_id") == self.request_id:
+                return reply.get("data") if reply["error"] == "success" else None
+        raise EOFError("mpv closed the IPC connection")
+
+    def close(self):
+        self.file.close()
+        self.sock.close()
+
+
+def run(args, content_fps, display_fps, tmpdir):
+    sock = os.path.join(tmpdir, "ipc")
+    log = os.path.join(tmpdir, "log")
+    cmd = [
+        args.mpv, "--no-config", "--really-quiet", "--idle=no",
+        "--keep-open=yes", "--ao=null", "--vo=sim",
+        f"--vo-sim-fps={display_fps}",
+        f"--vo-sim-speed={args.speed}",
+        f"--vo-sim-jitter={args.jitter}",
+        f"--vo-sim-missed-vsyncs={args.missed_vsyncs}",
+        f"--vo-sim-render-time={args.render_time}",
+        f"--vo-sim-render-time-stddev={args.render_time_stddev}",
+        f"--video-sync={args.video_sync}",
+        f"--length={args.length}",
+        f"--input-ipc-server={sock}",
+        f"--log-file={log}",
+        "--audio-file=av://lavfi:sine=frequency=440",
+        f"av://lavfi:testsrc2=rate={content_fps}:size=320x240",
+    ] + args.extra
+    proc = subprocess.Popen(cmd, stdin=subprocess.DEVNULL)
+    res = {}
+    try:
+        ipc = IPC(sock, args.timeout)
+        deadline = time.monotonic() + args.timeout
+        while not ipc.command("get_property", "eof-reached"):
+            if time.monotonic() > deadline:
+                raise TimeoutError("playback did not finish")
+            time.sleep(0.1)
+        for prop in PROPERTIES:
+            res[prop] = ipc.command("get_property", prop)
+        ipc.command("quit")
+        ipc.close()
+        proc.wait(args.timeout)
+    finally:
+        if proc.poll() is None:
+            proc.kill()
+            proc.wait()
+
+    with open(log, encoding="utf-8", errors="replace") as f:
+        m = SIM_STATS.search(f.read())
+    if m:
+        res["vsyncs"], res["frames"], res["repeats"] = map(int, m.groups()[:3])
+    return res
+
+
+def fmt(v, spec):
+    return "-" if v is None else format(v, spec)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().split("\n")[0])
+    parser.add_argument("--mpv", default="mpv", help="mpv binary")
+    parser.add_argument("--content-fps", default="23.976,24,25,29.97,30,50,60")
+    parser.add_argument("--display-fps", default="50,59.94,60,75,120,144")
+    parser.add_argument("--video-sync", default="display-resample")
+    parser.add_argument("--length", type=float, default=30,
+                        help="seconds of playback per run")
+    parser.add_argument("--speed", type=float, default=8,
+                        help="player clock speed (--vo-sim-speed)")
+    parser.add_argument("--jitter", type=float, default=0)
+    parser.add_argument("--missed-vsyncs", type=float, default=0)
+    parser.add_argument("--render-time", type=float, default=0)
+    parser.add_argument("--render-time-stddev", type=float, default=0)
+    parser.add_argument("--timeout", type=float, default=120,
+                        help="real time limit per run in seconds")
+    parser.add_argument("--max-drops", type=int)
+    parser.add_argument("--max-delayed", type=int)
+    parser.add_argument("--max-mistimed", type=int)
+    parser.add_argument("--max-desync", type=float,
+                        help="limit for the absolute total A/V sync change")
+    parser.add_argument("extra", nargs="*", help="additional mpv options")
+    args = parser.parse_args()
+
+    limits = [
+        ("frame-drop-count", args.max_drops),
+        ("vo-delayed-frame-count", args.max_delayed),
+        ("mistimed-frame-count", args.max_mistimed),
+        ("total-avsync-change", args.max_desync),
+    ]
+
+    print(f"{'content':>8} {'display':>8} {'frames':>7} {'repeats':>7} "
+          f"{'drops':>6} {'delayed':>7} {'mistimed':>8} {'desync':>8} "
+          f"{'jitter':>7}")
+    failed = False
+    for content_fps in args.content_fps.split(","):
+        for display_fps in args.display_fps.split(","):
+            with tempfile.TemporaryDirectory() as tmpdir:
+                try:
+                    r = run(args, content_fps, display_fps, tmpdir)
+                except (OSError, EOFError, TimeoutError,
+                        subprocess.TimeoutExpired) as e:
+                    print(f"{content_fps:>8} {display_fps:>8} error: {e}")
+                    failed = True
+                    continue
+            print(f"{content_fps:>8} {display_fps:>8} "
+                  f"{fmt(r.get('frames'), '7d')} {fmt(r.get('repeats'), '7d')} "
+                  f"{fmt(r.get('frame-drop-count'), '6d')} "
+                  f"{fmt(r.get('vo-delayed-frame-count'), '7d')} "
+                  f"{fmt(r.get('mistimed-frame-count'), '8d')} "
+                  f"{fmt(r.get('total-avsync-change'), '8.4f')} "
+                  f"{fmt(r.get('vsync-jitter'), '7.4f')}")
+            for prop, limit in limits:
+                if limit is not None and abs(r.get(prop) or 0) > limit:
+                    print(f"  {prop} exceeds limit {limit}")
+                    failed = True
+
+    sys.exit(1 if failed else 0)
+
+
+if __name__ == "__main__":
+    main()
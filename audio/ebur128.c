@@ -0,0 +1,205 @@
+/*
+ * This file is part of mpv.
+ *
+ * mpv is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * mpv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <math.h>
+
+#include "mpv_talloc.h"
+
+#include "common/common.h"
+#include "chmap.h"
+#include "ebur128.h"
+
+// 400 ms gating blocks with 75% overlap => a new block every 100 ms.
+#define STEPS_PER_BLOCK 4
+
+struct biquad {
+    double b[3], a[3];
+};
+
+struct channel {
+    double weight;
+    double z[2][2];         // transposed direct form II state per stage
+    double steps[STEPS_PER_BLOCK]; // sum of squares of recent steps
+};
+
+struct mp_ebur128 {
+    int num_channels;
+    struct channel *channels;
+    struct biquad stage[2];
+    int step_len;           // samples per step
+    int step_pos;           // samples in current step
+    int num_steps;          // completed steps (saturates)
+    int cur_step;           // ring buffer index into channel.steps
+    double peak;
+    uint32_t hist[MP_EBUR128_HIST_BINS];
+};
+
+// K-weighting filter (BS.1770 pre-filter + RLB high-pass), with the
+// coefficients derived for the actual sample rate.
+static void init_filters(struct mp_ebur128 *m, int rate)
+{
+    double f0 = 1681.974450955533;
+    double G  = 3.999843853973347;
+    double Q  = 0.7071752369554196;
+    double K  = tan(M_PI * f0 / rate);
+    double Vh = pow(10.0, G / 20.0);
+    double Vb = pow(Vh, 0.4996667741545416);
+    double a0 = 1.0 + K / Q + K * K;
+    m->stage[0] = (struct biquad){
+        .b = {(Vh + Vb * K / Q + K * K) / a0,
+              2.0 * (K * K - Vh) / a0,
+              (Vh - Vb * K / Q + K * K) / a0},
+        .a = {1.0, 2.0 * (K * K - 1.0) / a0, (1.0 - K / Q + K * K) / a0},
+    };
+
+    f0 = 38.13547087602444;
+    Q  = 0.5003270373238773;
+    K  = tan(M_PI * f0 / rate);
+    a0 = 1.0 + K / Q + K * K;
+    m->stage[1] = (struct biquad){
+        .b = {1.0, -2.0, 1.0},
+        .a = {1.0, 2.0 * (K * K - 1.0) / a0, (1.0 - K / Q + K * K) / a0},
+    };
+}
+
+static double channel_weight(int speaker)
+{
+    switch (speaker) {
+    case MP_SPEAKER_ID_LFE:
+    case MP_SPEAKER_ID_LFE2:
+        return 0;
+    case MP_SPEAKER_ID_BL:
+    case MP_SPEAKER_ID_BR:
+    case MP_SPEAKER_ID_SL:
+    case MP_SPEAKER_ID_SR:
+        return 1.41; // +1.5 dB for surround channels
+    default:
+        return 1.0;
+    }
+}
+
+struct mp_ebur128 *mp_ebur128_create(void *ta_parent, int rate,
+                                     struct mp_chmap *chmap)
+{
+    struct mp_ebur128 *m = talloc_zero(ta_parent, struct mp_ebur128);
+    m->num_channels = chmap->num;
+    m->channels = talloc_zero_array(m, struct channel, chmap->num);
+    for (int n = 0; n < chmap->num; n++)
+        m->channels[n].weight = channel_weight(chmap->speaker[n]);
+    init_filters(m, rate);
+    m->step_len = MPMAX(rate / 10, 1);
+    return m;
+}
+
+static inline double filter(const struct biquad *f, double z[2], double x)
+{
+    double y = f->b[0] * x + z[0];
+    z[0] = f->b[1] * x - f->a[1] * y + z[1];
+    z[1] = f->b[2] * x - f->a[2] * y;
+    return y;
+}
+
+static void add_block(struct mp_ebur128 *m)
+{
+    double sum = 0;
+    for (int c = 0; c < m->num_channels; c++) {
+        struct channel *ch = &m->channels[c];
+        double ms = 0;
+        for (int n = 0; n < STEPS_PER_BLOCK; n++)
+            ms += ch->steps[n];
+        sum += ch->weight * ms / (STEPS_PER_BLOCK * (double)m->step_len);
+    }
+    double l = -0.691 + 10 * log10(sum);
+    if (!(l >= MP_EBUR128_HIST_MIN))
+        return; // absolute gate (also catches log10(0))
+    int bin = (l - MP_EBUR128_HIST_MIN) * 10;
+    m->hist[MPMIN(bin, MP_EBUR128_HIST_BINS - 1)]++;
+}
+
+void mp_ebur128_add_planar(struct mp_ebur128 *m, float **planes, int samples)
+{
+    int pos = 0;
+    while (pos < samples) {
+        int len = MPMIN(samples - pos, m->step_len - m->step_pos);
+        for (int c = 0; c < m->num_channels; c++) {
+            struct channel *ch = &m->channels[c];
+            float *src = planes[c] + pos;
+            double sum = 0, peak = m->peak;
+            for (int n = 0; n < len; n++) {
+                double x = src[n];
+                peak = MPMAX(peak, fabs(x));
+                double y = filter(&m->stage[0], ch->z[0], x);
+                y = filter(&m->stage[1], ch->z[1], y);
+                sum += y * y;
+            }
+            ch->steps[m->cur_step] += sum;
+            m->peak = peak;
+        }
+        pos += len;
+        m->step_pos += len;
+        if (m->step_pos == m->step_len) {
+            m->step_pos = 0;
+            m->num_steps = MPMIN(m->num_steps + 1, STEPS_PER_BLOCK);
+            if (m->num_steps == STEPS_PER_BLOCK)
+                add_block(m);
+            m->cur_step = (m->cur_step + 1) % STEPS_PER_BLOCK;
+            for (int c = 0; c < m->num_channels; c++)
+                m->channels[c].steps[m->cur_step] = 0;
+        }
+    }
+}
+
+double mp_ebur128_get_peak(struct mp_ebur128 *m)
+{
+    return m->peak;
+}
+
+const uint32_t *mp_ebur128_get_histogram(struct mp_ebur128 *m)
+{
+    return m->hist;
+}
+
+static double bin_energy(int bin)
+{
+    double l = MP_EBUR128_HIST_MIN + (bin + 0.5) / 10.0;
+    return pow(10.0, (l + 0.691) / 10.0);
+}
+
+static double gated_mean(const uint32_t *const *hists, int num_hists,
+                         int first_bin)
+{
+    double sum = 0;
+    uint64_t count = 0;
+    for (int bin = first_bin; bin < MP_EBUR128_HIST_BINS; bin++) {
+        uint64_t c = 0;
+        for (int n = 0; n < num_hists; n++)
+            c += hists[n][bin];
+        sum += c * bin_energy(bin);
+        count += c;
+    }
+    return count ? -0.691 + 10 * log10(sum / count) : -INFINITY;
+}
+
+double mp_ebur128_loudness(const uint32_t *const *hists, int num_hists)
+{
+    double l = gated_mean(hists, num_hists, 0);
+    if (!isfinite(l))
+        return l;
+    // Relative gate: drop blocks 10 LU below the absolute-gated loudness.
+    int bin = ceil((l - 10 - MP_EBUR128_HIST_MIN) * 10 - 0.5);
+    return gated_mean(hists, num_hists, MPCLAMP(bin, 0, MP_EBUR128_HIST_BINS - 1));
+}
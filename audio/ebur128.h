@@ -0,0 +1,51 @@
+/*
+ * This file is part of mpv.
+ *
+ * mpv is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * mpv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+struct mp_chmap;
+
+// Integrated loudness meter as specified by ITU-R BS.1770-4 / EBU R128.
+// Gating blocks are not stored individually, but collected in a histogram
+// with 0.1 LU resolution, which makes memory usage independent of the input
+// length and allows combining the results of multiple tracks (album gain).
+
+// Histogram range: -70 LUFS (absolute gate) to +5 LUFS.
+#define MP_EBUR128_HIST_MIN -70
+#define MP_EBUR128_HIST_BINS 750
+
+struct mp_ebur128;
+
+// chmap is used for channel weighting; LFE channels are ignored.
+struct mp_ebur128 *mp_ebur128_create(void *ta_parent, int rate,
+                                     struct mp_chmap *chmap);
+
+// Feed planar float samples (one plane per channel of the chmap).
+void mp_ebur128_add_planar(struct mp_ebur128 *m, float **planes, int samples);
+
+// Maximum absolute sample value seen (linear, 1.0 = full scale).
+double mp_ebur128_get_peak(struct mp_ebur128 *m);
+
+// Gating block histogram. Has MP_EBUR128_HIST_BINS entries; bin n counts the
+// blocks with loudness in [MIN + n / 10, MIN + (n + 1) / 10).
+const uint32_t *mp_ebur128_get_histogram(struct mp_ebur128 *m);
+
+// Gated integrated loudness in LUFS over all blocks of the given histograms.
+// Returns -INFINITY if there were no blocks above the absolute gate.
+double mp_ebur128_loudness(const uint32_t *const *hists, int num_hists);
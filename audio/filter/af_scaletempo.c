@@ -37,14 +37,24 @@
 #include <assert.h>
 #include <math.h>
 
+#include <libavutil/cpu.h>
+
 #include "audio/aframe.h"
 #include "audio/format.h"
 #include "common/common.h"
 #include "filters/f_autoconvert.h"
 #include "filters/filter_internal.h"
 #include "filters/user_filters.h"
+#include "misc/thread_pool.h"
 #include "options/m_option.h"
 
+// Step size of the coarse overlap search.
+#define SEARCH_STEP 3
+
+// With threads=auto, use multiple threads for the overlap search only with at
+// least this many channels.
+#define MIN_THREADED_CHANNELS 8
+
 struct f_opts {
     float scale_nominal;
     float ms_stride;
@@ -53,6 +63,7 @@ struct f_opts {
 #define SCALE_TEMPO 1
 #define SCALE_PITCH 2
     int speed_opt;
+    int threads;
 };
 
 struct priv {
@@ -89,6 +100,11 @@ struct priv {
     int frames_search;
     int num_channels;
     int (*best_overlap_offset)(struct priv *s);
+    // coarse search distances, computed by search_groups in parallel
+    void *search_distances;
+    void (*search_group)(void *ctx, int group);
+    int num_search_groups;
+    struct mp_thread_pool *thread_pool;
 };
 
 static bool reinit(struct mp_filter *f);
@@ -176,21 +192,50 @@ static void quadratic_interpolation_s16(
     }
 }
 
-static int best_overlap_offset_float(struct priv *s)
+// Divide the coarse search offsets between the search groups.
+static void get_search_range(struct priv *s, int group, int *start, int *end)
 {
-    int num_channels = s->num_channels, frames_search = s->frames_search;
+    int num = (s->frames_search + SEARCH_STEP - 1) / SEARCH_STEP;
+    *start = group * num / s->num_search_groups;
+    *end = (group + 1) * num / s->num_search_groups;
+}
+
+static float overlap_distance_float(struct priv *s, int offset)
+{
+    int num_channels = s->num_channels;
     float *source = (float *)s->buf_queue + num_channels;
     float *target = (float *)s->buf_overlap + num_channels;
     int num_samples = s->samples_overlap - num_channels;
-    int step_size = 3;
+    float distance = 0;
+    for (int i = 0; i < num_samples; i++)
+        distance += fabsf(target[i] - source[offset * num_channels + i]);
+    return distance;
+}
+
+static void search_group_float(void *ctx, int group)
+{
+    struct priv *s = ctx;
+    float *distances = s->search_distances;
+    int start, end;
+    get_search_range(s, group, &start, &end);
+    for (int n = start; n < end; n++)
+        distances[n] = overlap_distance_float(s, n * SEARCH_STEP);
+}
+
+static int best_overlap_offset_float(struct priv *s)
+{
+    int num_channels = s->num_channels, frames_search = s->frames_search;
+    int step_size = SEARCH_STEP;
     float history[3] = {0};
 
+    mp_thread_pool_run_all(s->thread_pool, s->num_search_groups,
+                           s->search_group, s);
+    float *distances = s->search_distances;
+
     float best_distance = FLT_MAX;
     int best_offset_approx = 0;
     for (int offset = 0; offset < frames_search; offset += step_size) {
-        float distance = 0;
-        for (int i = 0; i < num_samples; i++)
-            distance += fabsf(target[i] - source[offset * num_channels + i]);
+        float distance = distances[offset / step_size];
 
         int offset_approx = offset;
         history[0] = history[1];
@@ -213,9 +258,7 @@ static int best_overlap_offset_float(struct priv *s)
     int min_offset = MPMAX(0, best_offset_approx - step_size + 1);
     int max_offset = MPMIN(frames_search, best_offset_approx + step_size);
     for (int offset = min_offset; offset < max_offset; offset++) {
-        float distance = 0;
-        for (int i = 0; i < num_samples; i++)
-            distance += fabsf(target[i] - source[offset * num_channels + i]);
+        float distance = overlap_distance_float(s, offset);
         if (distance < best_distance) {
             best_distance = distance;
             best_offset  = offset;
@@ -225,21 +268,42 @@ static int best_overlap_offset_float(struct priv *s)
     return best_offset * 4 * num_channels;
 }
 
-static int best_overlap_offset_s16(struct priv *s)
+static int32_t overlap_distance_s16(struct priv *s, int offset)
 {
-    int num_channels = s->num_channels, frames_search = s->frames_search;
+    int num_channels = s->num_channels;
     int16_t *source = (int16_t *)s->buf_queue + num_channels;
     int16_t *target = (int16_t *)s->buf_overlap + num_channels;
     int num_samples = s->samples_overlap - num_channels;
-    int step_size = 3;
+    int32_t distance = 0;
+    for (int i = 0; i < num_samples; i++)
+        distance += abs((int32_t)target[i] - source[offset * num_channels + i]);
+    return distance;
+}
+
+static void search_group_s16(void *ctx, int group)
+{
+    struct priv *s = ctx;
+    int32_t *distances = s->search_distances;
+    int start, end;
+    get_search_range(s, group, &start, &end);
+    for (int n = start; n < end; n++)
+        distances[n] = overlap_distance_s16(s, n * SEARCH_STEP);
+}
+
+static int best_overlap_offset_s16(struct priv *s)
+{
+    int frames_search = s->frames_search;
+    int step_size = SEARCH_STEP;
     int32_t history[3] = {0};
 
+    mp_thread_pool_run_all(s->thread_pool, s->num_search_groups,
+                           s->search_group, s);
+    int32_t *distances = s->search_distances;
+
     int32_t best_distance = INT32_MAX;
     int best_offset_approx = 0;
     for (int offset = 0; offset < frames_search; offset += step_size) {
-        int32_t distance = 0;
-        for (int i = 0; i < num_samples; i++)
-            distance += abs((int32_t)target[i] - source[offset * num_channels + i]);
+        int32_t distance = distances[offset / step_size];
 
         int offset_approx = offset;
         history[0] = history[1];
@@ -262,9 +326,7 @@ static int best_overlap_offset_s16(struct priv *s)
     int min_offset = MPMAX(0, best_offset_approx - step_size + 1);
     int max_offset = MPMIN(frames_search, best_offset_approx + step_size);
     for (int offset = min_offset; offset < max_offset; offset++) {
-        int32_t distance = 0;
-        for (int i = 0; i < num_samples; i++)
-            distance += abs((int32_t)target[i] - source[offset * num_channels + i]);
+        int32_t distance = overlap_distance_s16(s, offset);
         if (distance < best_distance) {
             best_distance = distance;
             best_offset  = offset;
@@ -521,8 +583,35 @@ static bool reinit(struct mp_filter *f)
     else {
         if (use_int) {
             s->best_overlap_offset = best_overlap_offset_s16;
+            s->search_group = search_group_s16;
         } else {
             s->best_overlap_offset = best_overlap_offset_float;
+            s->search_group = search_group_float;
+        }
+        int num = (s->frames_search + SEARCH_STEP - 1) / SEARCH_STEP;
+        size_t size = use_int ? sizeof(int32_t) : sizeof(float);
+        void *distances = realloc(s->search_distances, num * size);
+        if (!distances) {
+            MP_FATAL(f, "Out of memory\n");
+            return false;
+        }
+        s->search_distances = distances;
+        // The coarse search is split into groups of offsets, which are
+        // computed in parallel. The result doesn't depend on the grouping.
+        int groups = s->opts->threads;
+        if (groups < 1) {
+            groups = nch >= MIN_THREADED_CHANNELS ?
+                     MPMIN(av_cpu_count(), nch / 4) : 1;
+        }
+        groups = MPCLAMP(groups, 1, num);
+        if (groups != s->num_search_groups) {
+            TA_FREEP(&s->thread_pool);
+            if (groups > 1) {
+                MP_VERBOSE(f, "using %d threads for overlap search\n", groups);
+                s->thread_pool = mp_thread_pool_create(NULL, groups - 1,
+                                                       groups - 1, groups - 1);
+            }
+            s->num_search_groups = s->thread_pool ? groups : 1;
         }
     }
 
@@ -594,6 +683,8 @@ static void af_scaletempo_destroy(struct mp_filter *f)
     free(s->buf_queue);
     free(s->buf_overlap);
     free(s->table_blend);
+    free(s->search_distances);
+    TA_FREEP(&s->thread_pool);
     TA_FREEP(&s->in);
     mp_filter_free_children(f);
 }
@@ -662,6 +753,7 @@ const struct mp_user_filter_entry af_scaletempo = {
                 {"tempo", SCALE_TEMPO},
                 {"none", 0},
                 {"both", SCALE_TEMPO | SCALE_PITCH})},
+            {"threads", OPT_CHOICE(threads, {"auto", 0}), M_RANGE(1, 64)},
             {0}
         },
     },
@@ -248,6 +248,7 @@ const struct mp_user_filter_entry af_scaletempo2 = {
                 OPT_FLOAT(min_playback_rate), M_RANGE(0, FLT_MAX)},
             {"max-speed",
                 OPT_FLOAT(max_playback_rate), M_RANGE(0, FLT_MAX)},
+            {"threads", OPT_CHOICE(threads, {"auto", 0}), M_RANGE(1, 64)},
             {0}
         }
     },
@@ -1,8 +1,11 @@
 #include <float.h>
 #include <math.h>
 
+#include <libavutil/cpu.h>
+
 #include "audio/chmap.h"
 #include "audio/filter/af_scaletempo2_internals.h"
+#include "misc/thread_pool.h"
 
 #include "config.h"
 
@@ -31,6 +34,18 @@
 //
 // 6) Update:write
 
+// This is a compromise between complexity reduction and search accuracy. I
+// don't have a proof that down sample of order 5 is optimal.
+// One can compute a decimation factor that minimizes complexity given
+// the size of |search_block| and |target_block|. However, my experiments
+// show the rate of missing the optimal index is significant.
+// This value is chosen heuristically based on experiments.
+#define SEARCH_DECIMATION 5
+
+// With "auto" threads, use one thread per this many channels, if there are at
+// least 2 groups.
+#define CHANNELS_PER_GROUP 4
+
 struct interval {
     int lo;
     int hi;
@@ -59,45 +74,53 @@ static void zero_2d_partial(float **a, int x, int y)
     }
 }
 
-// Energies of sliding windows of channels are interleaved.
+// Energies of sliding windows of channels are stored per channel, i.e. the
+// energy of window |n| of channel |k| is at |energy|[k * num_windows + n].
+// (Not interleaved, so that channel groups processed on different threads
+// don't write to the same cache lines.)
 // The number windows is |input_frames| - (|frames_per_window| - 1), hence,
 // the method assumes |energy| must be, at least, of size
 // (|input_frames| - (|frames_per_window| - 1)) * |channels|.
+// Only the channels [|ch_start|, |ch_end|) are computed.
 static void multi_channel_moving_block_energies(
-    float **input, int input_frames, int channels,
+    float **input, int input_frames, int ch_start, int ch_end,
     int frames_per_block, float *energy)
 {
     int num_blocks = input_frames - (frames_per_block - 1);
 
-    for (int k = 0; k < channels; ++k) {
+    for (int k = ch_start; k < ch_end; ++k) {
         const float* input_channel = input[k];
+        float *energy_channel = energy + k * num_blocks;
 
-        energy[k] = 0;
+        energy_channel[0] = 0;
 
         // First block of channel |k|.
         for (int m = 0; m < frames_per_block; ++m) {
-            energy[k] += input_channel[m] * input_channel[m];
+            energy_channel[0] += input_channel[m] * input_channel[m];
         }
 
         const float* slide_out = input_channel;
         const float* slide_in = input_channel + frames_per_block;
         for (int n = 1; n < num_blocks; ++n, ++slide_in, ++slide_out) {
-            energy[k + n * channels] = energy[k + (n - 1) * channels]
+            energy_channel[n] = energy_channel[n - 1]
                 - *slide_out * *slide_out + *slide_in * *slide_in;
         }
     }
 }
 
+// |energy_candidate| is the energy of the candidate block in channel 0, the
+// other channels follow with |energy_stride|.
 static float multi_channel_similarity_measure(
     const float* dot_prod,
     const float* energy_target, const float* energy_candidate,
-    int channels)
+    int energy_stride, int channels)
 {
     const float epsilon = 1e-12f;
     float similarity_measure = 0.0f;
     for (int n = 0; n < channels; ++n) {
         similarity_measure += dot_prod[n] * energy_target[n]
-            / sqrtf(energy_target[n] * energy_candidate[n] + epsilon);
+            / sqrtf(energy_target[n] * energy_candidate[n * energy_stride]
+                    + epsilon);
     }
     return similarity_measure;
 }
@@ -216,27 +239,21 @@ static void quadratic_interpolation(
 // Search a subset of all candid blocks. The search is performed every
 // |decimation| frames. This reduces complexity by a factor of about
 // 1 / |decimation|. A cubic interpolation is used to have a better estimate of
-// the best match.
+// the best match. |dot_decimated| contains the dot products of the target
+// block with the candidate blocks at the decimated positions.
 static int decimated_search(
     int decimation, struct interval exclude_interval,
-    float **target_block, int target_block_frames,
-    float **search_segment, int search_segment_frames,
+    int num_candidate_blocks,
     int channels,
+    const float *dot_decimated,
     const float *energy_target_block, const float *energy_candidate_blocks)
 {
-    int num_candidate_blocks = search_segment_frames - (target_block_frames - 1);
-    float dot_prod [MP_NUM_CHANNELS];
     float similarity[3];  // Three elements for cubic interpolation.
 
     int n = 0;
-    multi_channel_dot_product(
-        target_block, 0,
-        search_segment, n,
-        channels,
-        target_block_frames, dot_prod);
     similarity[0] = multi_channel_similarity_measure(
-        dot_prod, energy_target_block,
-        &energy_candidate_blocks[n * channels], channels);
+        &dot_decimated[(n / decimation) * channels], energy_target_block,
+        &energy_candidate_blocks[n], num_candidate_blocks, channels);
 
     // Set the starting point as optimal point.
     float best_similarity = similarity[0];
@@ -247,14 +264,9 @@ static int decimated_search(
         return 0;
     }
 
-    multi_channel_dot_product(
-        target_block, 0,
-        search_segment, n,
-        channels,
-        target_block_frames, dot_prod);
     similarity[1] = multi_channel_similarity_measure(
-        dot_prod, energy_target_block,
-        &energy_candidate_blocks[n * channels], channels);
+        &dot_decimated[(n / decimation) * channels], energy_target_block,
+        &energy_candidate_blocks[n], num_candidate_blocks, channels);
 
     n += decimation;
     if (n >= num_candidate_blocks) {
@@ -264,15 +276,9 @@ static int decimated_search(
     }
 
     for (; n < num_candidate_blocks; n += decimation) {
-        multi_channel_dot_product(
-            target_block, 0,
-            search_segment, n,
-            channels,
-            target_block_frames, dot_prod);
-
         similarity[2] = multi_channel_similarity_measure(
-            dot_prod, energy_target_block,
-            &energy_candidate_blocks[n * channels], channels);
+            &dot_decimated[(n / decimation) * channels], energy_target_block,
+            &energy_candidate_blocks[n], num_candidate_blocks, channels);
 
         if ((similarity[1] > similarity[0] && similarity[1] >= similarity[2]) ||
             (similarity[1] >= similarity[0] && similarity[1] > similarity[2]))
@@ -320,6 +326,7 @@ static int full_search(
 {
     // int block_size = target_block->frames;
     float dot_prod [sizeof(float) * MP_NUM_CHANNELS];
+    int num_candidate_blocks = search_block_frames - (target_block_frames - 1);
 
     float best_similarity = -FLT_MAX;//FLT_MIN;
     int optimal_index = 0;
@@ -333,7 +340,7 @@ static int full_search(
 
         float similarity = multi_channel_similarity_measure(
             dot_prod, energy_target_block,
-            &energy_candidate_blocks[n * channels], channels);
+            &energy_candidate_blocks[n], num_candidate_blocks, channels);
 
         if (similarity > best_similarity) {
             best_similarity = similarity;
@@ -347,59 +354,29 @@ static int full_search(
 // Find the index of the block, within |search_block|, that is most similar
 // to |target_block|. Obviously, the returned index is w.r.t. |search_block|.
 // |exclude_interval| is an interval that is excluded from the search.
-static int compute_optimal_index(
-    float **search_block, int search_block_frames,
-    float **target_block, int target_block_frames,
-    float *energy_candidate_blocks,
-    int channels,
-    struct interval exclude_interval)
+// prepare_search() must have been run for all channel groups.
+static int compute_optimal_index(struct mp_scaletempo2 *p,
+                                 struct interval exclude_interval)
 {
-    int num_candidate_blocks = search_block_frames - (target_block_frames - 1);
-
-    // This is a compromise between complexity reduction and search accuracy. I
-    // don't have a proof that down sample of order 5 is optimal.
-    // One can compute a decimation factor that minimizes complexity given
-    // the size of |search_block| and |target_block|. However, my experiments
-    // show the rate of missing the optimal index is significant.
-    // This value is chosen heuristically based on experiments.
-    const int search_decimation = 5;
-
-    float energy_target_block [MP_NUM_CHANNELS];
-    // energy_candidate_blocks must have at least size
-    // sizeof(float) * channels * num_candidate_blocks
-
-    // Energy of all candid frames.
-    multi_channel_moving_block_energies(
-        search_block,
-        search_block_frames,
-        channels,
-        target_block_frames,
-        energy_candidate_blocks);
-
-    // Energy of target frame.
-    multi_channel_dot_product(
-        target_block, 0,
-        target_block, 0,
-        channels,
-        target_block_frames, energy_target_block);
+    int num_candidate_blocks = p->search_block_size - (p->ola_window_size - 1);
 
     int optimal_index = decimated_search(
-        search_decimation, exclude_interval,
-        target_block, target_block_frames,
-        search_block, search_block_frames,
-        channels,
-        energy_target_block,
-        energy_candidate_blocks);
-
-    int lim_low = MPMAX(0, optimal_index - search_decimation);
+        SEARCH_DECIMATION, exclude_interval,
+        num_candidate_blocks,
+        p->channels,
+        p->dot_decimated,
+        p->energy_target_block,
+        p->energy_candidate_blocks);
+
+    int lim_low = MPMAX(0, optimal_index - SEARCH_DECIMATION);
     int lim_high = MPMIN(num_candidate_blocks - 1,
-                            optimal_index + search_decimation);
+                            optimal_index + SEARCH_DECIMATION);
     return full_search(
         lim_low, lim_high, exclude_interval,
-        target_block, target_block_frames,
-        search_block, search_block_frames,
-        channels,
-        energy_target_block, energy_candidate_blocks);
+        p->target_block, p->ola_window_size,
+        p->search_block, p->search_block_size,
+        p->channels,
+        p->energy_target_block, p->energy_candidate_blocks);
 }
 
 static void peek_buffer(struct mp_scaletempo2 *p,
@@ -530,8 +507,10 @@ static bool target_is_within_search_region(struct mp_scaletempo2 *p)
 }
 
 
-static void peek_audio_with_zero_prepend(struct mp_scaletempo2 *p,
-    int read_offset_frames, float **dest, int dest_frames)
+// Like peek_audio_with_zero_prepend(), for the channels [ch_start, ch_end).
+static void peek_channels_with_zero_prepend(struct mp_scaletempo2 *p,
+    int ch_start, int ch_end, int read_offset_frames, float **dest,
+    int dest_frames)
 {
     mp_assert(read_offset_frames + dest_frames <= p->input_buffer_frames);
 
@@ -543,9 +522,63 @@ static void peek_audio_with_zero_prepend(struct mp_scaletempo2 *p,
         read_offset_frames = 0;
         num_frames_to_read -= num_zero_frames_appended;
         write_offset = num_zero_frames_appended;
-        zero_2d_partial(dest, p->channels, num_zero_frames_appended);
+        zero_2d_partial(dest + ch_start, ch_end - ch_start,
+                        num_zero_frames_appended);
+    }
+    for (int i = ch_start; i < ch_end; ++i) {
+        memcpy(dest[i] + write_offset,
+            p->input_buffer[i] + read_offset_frames,
+            num_frames_to_read * sizeof(float));
+    }
+}
+
+static void peek_audio_with_zero_prepend(struct mp_scaletempo2 *p,
+    int read_offset_frames, float **dest, int dest_frames)
+{
+    peek_channels_with_zero_prepend(p, 0, p->channels,
+        read_offset_frames, dest, dest_frames);
+}
+
+// Extract the target and search blocks, and compute everything the search
+// needs per channel, for the channels of one channel group. The groups are
+// independent of each other and can run in parallel.
+static void prepare_search(void *ctx, int group)
+{
+    struct mp_scaletempo2 *p = ctx;
+    int ch_start = group * p->channels / p->num_channel_groups;
+    int ch_end = (group + 1) * p->channels / p->num_channel_groups;
+    int num_ch = ch_end - ch_start;
+    int num_candidate_blocks = p->search_block_size - (p->ola_window_size - 1);
+
+    peek_channels_with_zero_prepend(p, ch_start, ch_end,
+        p->target_block_index, p->target_block, p->ola_window_size);
+    peek_channels_with_zero_prepend(p, ch_start, ch_end,
+        p->search_block_index, p->search_block, p->search_block_size);
+
+    // Energy of all candid frames.
+    multi_channel_moving_block_energies(
+        p->search_block,
+        p->search_block_size,
+        ch_start, ch_end,
+        p->ola_window_size,
+        p->energy_candidate_blocks);
+
+    // Energy of target frame.
+    multi_channel_dot_product(
+        p->target_block + ch_start, 0,
+        p->target_block + ch_start, 0,
+        num_ch,
+        p->ola_window_size, p->energy_target_block + ch_start);
+
+    // Similarity of the decimated candidates (see decimated_search()).
+    for (int n = 0; n < num_candidate_blocks; n += SEARCH_DECIMATION) {
+        multi_channel_dot_product(
+            p->target_block + ch_start, 0,
+            p->search_block + ch_start, n,
+            num_ch,
+            p->ola_window_size,
+            &p->dot_decimated[(n / SEARCH_DECIMATION) * p->channels + ch_start]);
     }
-    peek_buffer(p, num_frames_to_read, read_offset_frames, write_offset, dest);
 }
 
 static void get_optimal_block(struct mp_scaletempo2 *p)
@@ -561,10 +594,10 @@ static void get_optimal_block(struct mp_scaletempo2 *p)
         peek_audio_with_zero_prepend(p,
             optimal_index, p->optimal_block, p->ola_window_size);
     } else {
-        peek_audio_with_zero_prepend(p,
-            p->target_block_index, p->target_block, p->ola_window_size);
-        peek_audio_with_zero_prepend(p,
-            p->search_block_index, p->search_block, p->search_block_size);
+        // This is the bulk of the work, and is split across threads for
+        // high channel counts.
+        mp_thread_pool_run_all(p->thread_pool, p->num_channel_groups,
+                               prepare_search, p);
         int last_optimal = p->target_block_index
             - p->ola_hop_size - p->search_block_index;
         struct interval exclude_iterval = {
@@ -574,12 +607,7 @@ static void get_optimal_block(struct mp_scaletempo2 *p)
 
         // |optimal_index| is in frames and it is relative to the beginning of the
         // |search_block|.
-        optimal_index = compute_optimal_index(
-            p->search_block, p->search_block_size,
-            p->target_block, p->ola_window_size,
-            p->energy_candidate_blocks,
-            p->channels,
-            exclude_iterval);
+        optimal_index = compute_optimal_index(p, exclude_iterval);
 
         // Translate |index| w.r.t. the beginning of |audio_buffer| and extract the
         // optimal block.
@@ -841,4 +869,21 @@ void mp_scaletempo2_init(struct mp_scaletempo2 *p, int channels, int rate)
 
     MP_RESIZE_ARRAY(p, p->energy_candidate_blocks,
         p->channels * p->num_candidate_blocks);
+    MP_RESIZE_ARRAY(p, p->dot_decimated,
+        p->channels * (p->num_candidate_blocks / SEARCH_DECIMATION + 1));
+
+    int groups = p->opts->threads;
+    if (groups < 1) {
+        groups = p->channels / CHANNELS_PER_GROUP;
+        groups = groups >= 2 ? MPMIN(groups, av_cpu_count()) : 1;
+    }
+    groups = MPCLAMP(groups, 1, p->channels);
+    if (groups != p->num_channel_groups) {
+        TA_FREEP(&p->thread_pool);
+        if (groups > 1) {
+            p->thread_pool = mp_thread_pool_create(p, groups - 1, groups - 1,
+                                                   groups - 1);
+        }
+        p->num_channel_groups = p->thread_pool ? groups : 1;
+    }
 }
@@ -29,6 +29,7 @@
 // (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 // OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
+#include "audio/chmap.h"
 #include "common/common.h"
 
 struct mp_scaletempo2_opts {
@@ -43,6 +44,8 @@ struct mp_scaletempo2_opts {
     // [-delta delta] around |output_index| * |playback_rate|. So the search
     // interval is 2 * delta.
     float wsola_search_interval_ms;
+    // Number of threads for the similarity search (0 = auto).
+    int threads;
 };
 
 struct mp_scaletempo2 {
@@ -119,6 +122,15 @@ struct mp_scaletempo2 {
     // for padding after the final packet.
     int input_buffer_added_silence;
     float *energy_candidate_blocks;
+    // Per-channel dot products of |target_block| with every decimated
+    // candidate block, indexed as [block / decimation * channels + channel].
+    float *dot_decimated;
+    // Energy of |target_block| per channel.
+    float energy_target_block[MP_NUM_CHANNELS];
+    // Channels are split into |num_channel_groups| groups, which prepare the
+    // search in parallel on |thread_pool|.
+    int num_channel_groups;
+    struct mp_thread_pool *thread_pool;
 };
 
 void mp_scaletempo2_destroy(struct mp_scaletempo2 *p);
@@ -27,10 +27,10 @@
 #include "ao.h"
 #include "internal.h"
 #include "audio/format.h"
+#include "audio/sample_conv.h"
 
 #include "options/options.h"
 #include "options/m_config_frontend.h"
-#include "osdep/endian.h"
 #include "common/msg.h"
 #include "common/common.h"
 #include "common/global.h"
@@ -151,6 +151,8 @@ const struct m_sub_options ao_conf = {
             .flags = UPDATE_AUDIO, M_RANGE(0, 10)},
         {"audio-set-media-role", OPT_BOOL(audio_set_media_role),
             .flags = UPDATE_AUDIO},
+        {"audio-timing-report", OPT_STRING(audio_timing_report),
+            .flags = M_OPT_FILE},
         {0}
     },
     .size = sizeof(OPT_BASE_STRUCT),
@@ -186,7 +188,8 @@ static struct ao *ao_alloc(bool probing, struct mpv_global *global,
         .log = mp_log_new(ao, log, name),
         .def_buffer = opts->audio_buffer,
         .client_name = talloc_strdup(ao, opts->audio_client_name),
-        .set_media_role = opts->audio_set_media_role
+        .set_media_role = opts->audio_set_media_role,
+        .timing_report = talloc_strdup(ao, opts->audio_timing_report),
     };
     talloc_free(opts);
     ao->priv = m_config_group_from_desc(ao, ao->log, global, &desc, name);
@@ -685,32 +688,15 @@ bool ao_need_conversion(struct ao_convert_fmt *fmt)
     return get_conv_type(fmt) != 0;
 }
 
-// The LSB is always ignored.
-#if BYTE_ORDER == BIG_ENDIAN
-#define SHIFT24(x) ((3-(x))*8)
-#else
-#define SHIFT24(x) (((x)+1)*8)
-#endif
-
 static void convert_plane(int type, void *data, int num_samples)
 {
     switch (type) {
     case 0:
         break;
     case 1: /* fall through */
-    case 2: {
-        int bytes = type == 1 ? 3 : 4;
-        for (int s = 0; s < num_samples; s++) {
-            uint32_t val = *((uint32_t *)data + s);
-            uint8_t *ptr = (uint8_t *)data + s * bytes;
-            ptr[0] = val >> SHIFT24(0);
-            ptr[1] = val >> SHIFT24(1);
-            ptr[2] = val >> SHIFT24(2);
-            if (type == 2)
-                ptr[3] = 0;
-        }
+    case 2:
+        mp_sconv_pack_s24(data, num_samples, type == 2);
         break;
-    }
     default:
         MP_ASSERT_UNREACHABLE();
     }
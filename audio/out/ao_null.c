@@ -40,6 +40,7 @@ struct priv {
     bool paused;
     double last_time;
     float buffered;     // samples
+    double consumed;    // samples played, but not yet in a complete period
     int buffersize;     // samples
     bool playing;
 
@@ -51,6 +52,10 @@ struct priv {
     bool broken_eof;
     bool broken_delay;
 
+    // Simulated device period. The device consumes audio in units of this
+    // many samples, so the reported delay jumps at period boundaries.
+    int period;         // samples
+
     // Minimal unit of audio samples that can be written at once. If play() is
     // called with sizes not aligned to this, a rounded size will be returned.
     // (This is not needed by the AO API, but many AOs behave this way.)
@@ -74,9 +79,16 @@ static void drain(struct ao *ao)
 
     double now = mp_time_sec();
     if (priv->buffered > 0) {
-        priv->buffered -= (now - priv->last_time) * ao->samplerate * priv->speed;
-        if (priv->buffered < 0)
+        priv->consumed += (now - priv->last_time) * ao->samplerate * priv->speed;
+        double played = priv->consumed;
+        if (priv->period > 1)
+            played = floor(played / priv->period) * priv->period;
+        priv->consumed -= played;
+        priv->buffered -= played;
+        if (priv->buffered <= 0) {
             priv->buffered = 0;
+            priv->consumed = 0;
+        }
     }
     priv->last_time = now;
 }
@@ -122,6 +134,7 @@ static void reset(struct ao *ao)
     struct priv *priv = ao->priv;
     priv->paused = false;
     priv->buffered = 0;
+    priv->consumed = 0;
     priv->playing = false;
 }
 
@@ -223,6 +236,7 @@ const struct ao_driver audio_out_null = {
         {"latency", OPT_FLOAT(latency_sec), M_RANGE(0, 100)},
         {"broken-eof", OPT_BOOL(broken_eof)},
         {"broken-delay", OPT_BOOL(broken_delay)},
+        {"period", OPT_INT(period), M_RANGE(0, 100000)},
         {"channel-layouts", OPT_CHANNELS(channel_layouts)},
         {"format", OPT_AUDIOFORMAT(format)},
         {0}
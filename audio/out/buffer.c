@@ -20,6 +20,9 @@
 #include <math.h>
 #include <errno.h>
 #include <assert.h>
+#include <stdio.h>
+
+#include <mpv/client.h>
 
 #include "ao.h"
 #include "internal.h"
@@ -28,6 +31,9 @@
 
 #include "common/msg.h"
 #include "common/common.h"
+#include "misc/json.h"
+#include "misc/node.h"
+#include "options/path.h"
 
 #include "filters/f_async_queue.h"
 #include "filters/filter_internal.h"
@@ -35,6 +41,26 @@
 #include "osdep/timer.h"
 #include "osdep/threads.h"
 
+struct ao_latency_stat {
+    int64_t count;
+    int64_t sum_ns;
+    int64_t max_ns;
+};
+
+// Scheduling statistics collected since the AO was created.
+struct ao_timing_stats {
+    struct ao_latency_stat wakeup;  // ao thread wakeup vs. requested time
+    struct ao_latency_stat restart; // ao_reset() during playback to new audio
+    struct ao_latency_stat resume;  // unpause to new audio
+    struct ao_latency_stat pause;   // time needed to pause the device
+    int64_t underruns;              // device ran dry before EOF
+    // Deviation of the delay reported by the driver from the delay expected
+    // from the previous report (push AOs only). Includes device clock drift.
+    int64_t delay_checks;
+    double delay_error_sum;         // seconds
+    double delay_error_max;         // seconds
+};
+
 struct buffer_state {
     // Buffer and AO
     mp_mutex lock;
@@ -75,9 +101,19 @@ struct buffer_state {
     bool thread_valid;          // thread is running
     struct mp_aframe *temp_buf;
 
+    // Scheduling statistics (see get_timing_stats()).
+    struct ao_timing_stats stats;
+    bool played;                // real audio was passed to the device
+    bool eof_seen;              // EOF was read since the last start/reset
+    int64_t restart_ns;         // time of the last reset, 0 if restarted
+    int64_t unpause_ns;         // time of the last unpause, 0 if resumed
+    int64_t last_delay_ns;      // time of the last delay estimate, or 0
+    double last_delay;          // expected delay at last_delay_ns
+
     // --- protected by pt_lock
     bool need_wakeup;
     bool terminate;             // exit thread
+    int64_t wakeup_req_ns;      // time of first ao_wakeup() since last wait
 };
 
 static MP_THREAD_VOID ao_thread(void *arg);
@@ -86,11 +122,75 @@ void ao_wakeup(struct ao *ao)
 {
     struct buffer_state *p = ao->buffer_state;
     mp_mutex_lock(&p->pt_lock);
+    if (!p->need_wakeup)
+        p->wakeup_req_ns = mp_time_ns();
     p->need_wakeup = true;
     mp_cond_broadcast(&p->pt_wakeup);
     mp_mutex_unlock(&p->pt_lock);
 }
 
+// called locked
+static void add_latency(struct ao_latency_stat *st, int64_t ns)
+{
+    st->count++;
+    st->sum_ns += ns;
+    st->max_ns = MPMAX(st->max_ns, ns);
+}
+
+// called locked; real audio (not silence padding) was passed to the device
+static void note_audio_output(struct buffer_state *p)
+{
+    p->played = true;
+    if (!p->restart_ns && !p->unpause_ns)
+        return;
+    int64_t now = mp_time_ns();
+    if (p->restart_ns)
+        add_latency(&p->stats.restart, now - p->restart_ns);
+    if (p->unpause_ns)
+        add_latency(&p->stats.resume, now - p->unpause_ns);
+    p->restart_ns = p->unpause_ns = 0;
+}
+
+// called locked
+// Compare the driver's delay estimate with the previous estimate, advanced by
+// the elapsed system time and the audio written since. The difference is the
+// estimate error, plus device clock drift against the system clock.
+static void check_delay_estimate(struct ao *ao, struct mp_pcm_state *state)
+{
+    struct buffer_state *p = ao->buffer_state;
+
+    if (!p->streaming || !state->playing || p->paused || state->delay < 0) {
+        p->last_delay_ns = 0;
+        return;
+    }
+
+    int64_t now = mp_time_ns();
+    if (p->last_delay_ns) {
+        double expected = p->last_delay - MP_TIME_NS_TO_S(now - p->last_delay_ns);
+        // If this goes negative, the device underran; that's accounted elsewhere.
+        if (expected > 0) {
+            double err = fabs(state->delay - expected);
+            p->stats.delay_checks++;
+            p->stats.delay_error_sum += err;
+            p->stats.delay_error_max = MPMAX(p->stats.delay_error_max, err);
+        }
+    }
+    p->last_delay_ns = now;
+    p->last_delay = state->delay;
+}
+
+// Returns false if the AO never played any audio.
+static bool get_timing_stats(struct ao *ao, struct ao_timing_stats *stats)
+{
+    struct buffer_state *p = ao->buffer_state;
+
+    mp_mutex_lock(&p->lock);
+    *stats = p->stats;
+    bool played = p->played;
+    mp_mutex_unlock(&p->lock);
+    return played;
+}
+
 // called locked
 static void get_dev_state(struct ao *ao, struct mp_pcm_state *state)
 {
@@ -130,8 +230,10 @@ static int read_buffer(struct ao *ao, void **data, int samples, bool *eof,
             if (!frame.type)
                 break; // we can't/don't want to block
             if (frame.type != MP_FRAME_AUDIO) {
-                if (frame.type == MP_FRAME_EOF)
+                if (frame.type == MP_FRAME_EOF) {
                     *eof = true;
+                    p->eof_seen = true;
+                }
                 mp_frame_unref(&frame);
                 continue;
             }
@@ -156,12 +258,16 @@ static int read_buffer(struct ao *ao, void **data, int samples, bool *eof,
     if (!data) {
         if (!p->pending)
             return 0;
+        note_audio_output(p);
         void **pd = (void *)mp_aframe_get_data_rw(p->pending);
         if (pd)
             ao_post_process_data(ao, pd, mp_aframe_get_size(p->pending));
         return 1;
     }
 
+    if (pos > 0)
+        note_audio_output(p);
+
     // pad with silence (underflow/paused/eof)
     if (pad_silence) {
         for (int n = 0; n < ao->num_planes; n++) {
@@ -187,6 +293,8 @@ static int ao_read_data_locked(struct ao *ao, void **data, int samples,
         p->end_time_ns = out_time_ns;
 
     if (pos < samples && p->playing && !p->paused) {
+        if (!p->eof_seen)
+            p->stats.underruns++;
         p->playing = false;
         ao->wakeup_cb(ao->wakeup_ctx);
         // For ao_drain().
@@ -342,6 +450,12 @@ void ao_reset(struct ao *ao)
         p->streaming = false;
     }
     wakeup = p->playing;
+    // Only measure restarts that interrupt playback (seeks etc.), not the
+    // final reset after draining.
+    p->restart_ns = p->playing ? mp_time_ns() : 0;
+    p->unpause_ns = 0;
+    p->eof_seen = false;
+    p->last_delay_ns = 0;
     p->playing = false;
     p->recover_pause = false;
     p->hw_paused = false;
@@ -368,6 +482,7 @@ void ao_start(struct ao *ao)
     mp_mutex_lock(&p->lock);
 
     p->playing = true;
+    p->eof_seen = false;
 
     if (!ao->driver->write && !p->paused && !p->streaming) {
         p->streaming = true;
@@ -389,6 +504,7 @@ void ao_set_paused(struct ao *ao, bool paused, bool eof)
     bool wakeup = false;
     bool do_change_state = false;
     bool is_hw_paused;
+    int64_t pause_start_ns = 0;
 
     // If we are going to pause on eof and ao is still playing,
     // be sure to drain the ao first for gapless.
@@ -398,6 +514,7 @@ void ao_set_paused(struct ao *ao, bool paused, bool eof)
     mp_mutex_lock(&p->lock);
 
     if ((p->playing || !ao->driver->write) && !p->paused && paused) {
+        pause_start_ns = mp_time_ns();
         if (p->streaming && !ao->stream_silence) {
             if (ao->driver->write) {
                 if (!p->recover_pause)
@@ -418,6 +535,7 @@ void ao_set_paused(struct ao *ao, bool paused, bool eof)
         }
         wakeup = true;
     } else if (p->playing && p->paused && !paused) {
+        p->unpause_ns = mp_time_ns();
         if (ao->driver->write) {
             if (p->hw_paused)
                 ao->driver->set_pause(ao, false);
@@ -452,6 +570,12 @@ void ao_set_paused(struct ao *ao, bool paused, bool eof)
         }
     }
 
+    if (pause_start_ns) {
+        mp_mutex_lock(&p->lock);
+        add_latency(&p->stats.pause, mp_time_ns() - pause_start_ns);
+        mp_mutex_unlock(&p->lock);
+    }
+
     if (wakeup)
         ao_wakeup(ao);
 }
@@ -502,6 +626,60 @@ void ao_drain(struct ao *ao)
     ao_reset(ao);
 }
 
+static void add_latency_node(struct mpv_node *dst, const char *name,
+                             struct ao_latency_stat *st)
+{
+    struct mpv_node *n = node_map_add(dst, name, MPV_FORMAT_NODE_MAP);
+    node_map_add_int64(n, "count", st->count);
+    node_map_add_double(n, "avg", st->count ?
+                        MP_TIME_NS_TO_S(st->sum_ns) / st->count : 0);
+    node_map_add_double(n, "max", MP_TIME_NS_TO_S(st->max_ns));
+}
+
+// Append the timing statistics as a single JSON line to ao->timing_report.
+static void write_timing_report(struct ao *ao)
+{
+    struct ao_timing_stats stats;
+    if (!get_timing_stats(ao, &stats))
+        return;
+    struct ao_timing_stats *st = &stats;
+
+    char *path = mp_get_user_path(NULL, ao->global, ao->timing_report);
+    FILE *f = path ? fopen(path, "ab") : NULL;
+    if (!f) {
+        MP_ERR(ao, "Could not open timing report '%s'.\n", ao->timing_report);
+        talloc_free(path);
+        return;
+    }
+
+    struct mpv_node root;
+    node_init(&root, MPV_FORMAT_NODE_MAP, NULL);
+    node_map_add_string(&root, "ao", ao->driver->name);
+    node_map_add_int64(&root, "samplerate", ao->samplerate);
+    node_map_add_string(&root, "format", af_fmt_to_str(ao->format));
+    node_map_add_string(&root, "channels", mp_chmap_to_str(&ao->channels));
+    node_map_add_int64(&root, "device-buffer", ao->device_buffer);
+    node_map_add_flag(&root, "untimed", ao->untimed);
+    node_map_add_int64(&root, "underruns", st->underruns);
+    add_latency_node(&root, "wakeup", &st->wakeup);
+    add_latency_node(&root, "restart", &st->restart);
+    add_latency_node(&root, "resume", &st->resume);
+    add_latency_node(&root, "pause", &st->pause);
+    struct mpv_node *d = node_map_add(&root, "delay-error", MPV_FORMAT_NODE_MAP);
+    node_map_add_int64(d, "count", st->delay_checks);
+    node_map_add_double(d, "avg", st->delay_checks ?
+                        st->delay_error_sum / st->delay_checks : 0);
+    node_map_add_double(d, "max", st->delay_error_max);
+
+    char *s = talloc_strdup(root.u.list, "");
+    json_write(&s, &root);
+    fprintf(f, "%s\n", s);
+    fclose(f);
+
+    talloc_free(root.u.list);
+    talloc_free(path);
+}
+
 static void wakeup_filters(void *ctx)
 {
     struct ao *ao = ctx;
@@ -522,6 +700,9 @@ void ao_uninit(struct ao *ao)
         p->thread_valid = false;
     }
 
+    if (p && ao->timing_report && ao->timing_report[0])
+        write_timing_report(ao);
+
     if (ao->driver_initialized)
         ao->driver->uninit(ao);
 
@@ -631,9 +812,13 @@ static bool ao_play_data(struct ao *ao)
 
     struct mp_pcm_state state;
     get_dev_state(ao, &state);
+    check_delay_estimate(ao, &state);
 
-    if (p->streaming && !state.playing && !ao->untimed)
+    if (p->streaming && !state.playing && !ao->untimed) {
+        if (!p->eof_seen && !ao->stream_silence)
+            p->stats.underruns++;
         goto eof;
+    }
 
     void **planes = NULL;
     int space = state.free_samples;
@@ -674,6 +859,9 @@ static bool ao_play_data(struct ao *ao)
             MP_ERR(ao, "Error writing audio to device.\n");
         MP_STATS(ao, "end ao fill");
 
+        if (p->last_delay_ns)
+            p->last_delay += samples / (double)ao->samplerate;
+
         if (!p->streaming) {
             MP_VERBOSE(ao, "starting AO\n");
             ao->driver->start(ao);
@@ -708,9 +896,14 @@ static MP_THREAD_VOID ao_thread(void *arg)
     struct ao *ao = arg;
     struct buffer_state *p = ao->buffer_state;
     mp_thread_set_name("ao");
+    int64_t wakeup_latency = -1;
     while (1) {
         mp_mutex_lock(&p->lock);
 
+        if (wakeup_latency >= 0)
+            add_latency(&p->stats.wakeup, wakeup_latency);
+        wakeup_latency = -1;
+
         bool retry = ao_play_data(ao);
 
         // Wait until the device wants us to write more data to it.
@@ -730,11 +923,19 @@ static MP_THREAD_VOID ao_thread(void *arg)
             mp_mutex_unlock(&p->pt_lock);
             break;
         }
+        int64_t deadline = 0;
         if (!p->need_wakeup && !retry) {
+            if (timeout != INT64_MAX)
+                deadline = mp_time_ns() + timeout;
             MP_STATS(ao, "start audio wait");
             mp_cond_timedwait(&p->pt_wakeup, &p->pt_lock, timeout);
             MP_STATS(ao, "end audio wait");
         }
+        // Time from the wakeup request (or the timeout expiring) until the
+        // thread actually got to run.
+        int64_t ref = p->need_wakeup ? p->wakeup_req_ns : deadline;
+        if (ref)
+            wakeup_latency = MPMAX(mp_time_ns() - ref, 0);
         p->need_wakeup = false;
         mp_mutex_unlock(&p->pt_lock);
     }
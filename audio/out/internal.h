@@ -70,6 +70,9 @@ struct ao {
     int buffer;
     double def_buffer;
     struct buffer_state *buffer_state;
+
+    // If set, append timing statistics to this file on uninit.
+    char *timing_report;
 };
 
 void init_buffer_pre(struct ao *ao);
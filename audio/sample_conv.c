@@ -0,0 +1,238 @@
+/*
+ * This file is part of mpv.
+ *
+ * mpv is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * mpv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <math.h>
+
+#include "config.h"
+
+#include "common/common.h"
+#include "osdep/endian.h"
+#include "format.h"
+#include "sample_conv.h"
+
+// Interleaved data is processed in blocks of this many samples per channel, so
+// that the source and destination of a block stay in the cache while walking
+// through the channels.
+#define BLOCK_SAMPLES 512
+
+// Convert num samples. The strides are in samples.
+typedef void (*conv_fn)(void *dst, int dst_stride, const void *src,
+                        int src_stride, int num);
+
+// The conversions match libswresample's.
+
+static inline int16_t float_sample_to_s16(float x)
+{
+    float v = x * 32768.0f;
+    v = v > 32767.0f ? 32767.0f : v;
+    v = v < -32768.0f ? -32768.0f : v;
+    return lrintf(v);
+}
+
+static inline int32_t float_sample_to_s32(float x)
+{
+    float v = x * 2147483648.0f;
+    if (v >= 2147483648.0f)
+        return INT32_MAX;
+    if (v <= -2147483648.0f)
+        return INT32_MIN;
+    return lrintf(v);
+}
+
+#define DEF_CONV(name, dst_t, src_t, expr)                                  \
+    static void name(void *dstp, int dst_stride, const void *srcp,          \
+                     int src_stride, int num)                               \
+    {                                                                       \
+        dst_t *restrict dst = dstp;                                         \
+        const src_t *restrict src = srcp;                                   \
+        if (dst_stride == 1 && src_stride == 1) {                           \
+            for (int n = 0; n < num; n++) {                                 \
+                src_t x = src[n];                                           \
+                dst[n] = (expr);                                            \
+            }                                                               \
+        } else {                                                            \
+            for (int n = 0; n < num; n++) {                                 \
+                src_t x = src[n * src_stride];                              \
+                dst[n * dst_stride] = (expr);                               \
+            }                                                               \
+        }                                                                   \
+    }
+
+DEF_CONV(copy_8,  uint8_t,  uint8_t,  x)
+DEF_CONV(copy_16, uint16_t, uint16_t, x)
+DEF_CONV(copy_32, uint32_t, uint32_t, x)
+DEF_CONV(copy_64, uint64_t, uint64_t, x)
+DEF_CONV(s16_to_s32,   int32_t, int16_t, (int32_t)((uint32_t)x << 16))
+DEF_CONV(s16_to_float, float,   int16_t, x * (1.0f / (1 << 15)))
+DEF_CONV(s32_to_s16,   int16_t, int32_t, x >> 16)
+DEF_CONV(s32_to_float, float,   int32_t, x * (1.0f / (1U << 31)))
+DEF_CONV(float_to_s32_generic, int32_t, float, float_sample_to_s32(x))
+DEF_CONV(float_to_s16_generic, int16_t, float, float_sample_to_s16(x))
+
+#if HAVE_VECTOR
+
+typedef float v8sf __attribute__ ((vector_size (32), aligned (1)));
+typedef int32_t v8si __attribute__ ((vector_size (32), aligned (1)));
+
+#define V8(x) {x, x, x, x, x, x, x, x}
+
+// Same as float_sample_to_s16(), 8 samples at a time. Adding 1.5 * 2^23 rounds
+// to nearest-even like lrintf(), and leaves the integer in the mantissa bits.
+static void float_to_s16(void *dstp, int dst_stride, const void *srcp,
+                         int src_stride, int num)
+{
+    if (dst_stride != 1 || src_stride != 1) {
+        float_to_s16_generic(dstp, dst_stride, srcp, src_stride, num);
+        return;
+    }
+
+    int16_t *dst = dstp;
+    const float *src = srcp;
+    const v8sf scale = V8(32768.0f), max = V8(32767.0f), min = V8(-32768.0f);
+    const v8sf magic = V8(12582912.0f);
+    const v8si magic_bits = V8(0x4B400000);
+
+    int n = 0;
+    for (; n + 8 <= num; n += 8) {
+        v8sf v = *(const v8sf *)(src + n) * scale;
+        v8si hi = v > max, lo = v < min;
+        v8si i = ((v8si)v & ~hi) | ((v8si)max & hi);
+        i = (i & ~lo) | ((v8si)min & lo);
+        i = (v8si)((v8sf)i + magic) - magic_bits;
+        for (int k = 0; k < 8; k++)
+            dst[n + k] = i[k];
+    }
+    float_to_s16_generic(dst + n, 1, src + n, 1, num - n);
+}
+
+#else
+
+#define float_to_s16 float_to_s16_generic
+
+#endif // HAVE_VECTOR
+
+static conv_fn get_conv(int dst_fmt, int src_fmt)
+{
+    if (!af_fmt_is_pcm(dst_fmt) || !af_fmt_is_pcm(src_fmt))
+        return NULL;
+    dst_fmt = af_fmt_from_planar(dst_fmt);
+    src_fmt = af_fmt_from_planar(src_fmt);
+
+    if (dst_fmt == src_fmt) {
+        switch (af_fmt_to_bytes(dst_fmt)) {
+        case 1: return copy_8;
+        case 2: return copy_16;
+        case 4: return copy_32;
+        case 8: return copy_64;
+        }
+        return NULL;
+    }
+
+    switch (src_fmt) {
+    case AF_FORMAT_S16:
+        switch (dst_fmt) {
+        case AF_FORMAT_S32:     return s16_to_s32;
+        case AF_FORMAT_FLOAT:   return s16_to_float;
+        }
+        break;
+    case AF_FORMAT_S32:
+        switch (dst_fmt) {
+        case AF_FORMAT_S16:     return s32_to_s16;
+        case AF_FORMAT_FLOAT:   return s32_to_float;
+        }
+        break;
+    case AF_FORMAT_FLOAT:
+        switch (dst_fmt) {
+        case AF_FORMAT_S16:     return float_to_s16;
+        case AF_FORMAT_S32:     return float_to_s32_generic;
+        }
+        break;
+    }
+    return NULL;
+}
+
+bool mp_sconv_can_convert(int dst_fmt, int src_fmt)
+{
+    return !!get_conv(dst_fmt, src_fmt);
+}
+
+static void fill_silence(uint8_t *dst, int stride, int bytes, int num, int fmt)
+{
+    if (stride == 1) {
+        af_fill_silence(dst, num * (size_t)bytes, fmt);
+        return;
+    }
+    for (int n = 0; n < num; n++)
+        af_fill_silence(dst + n * (size_t)stride * bytes, bytes, fmt);
+}
+
+void mp_sconv_convert(uint8_t **dst, int dst_fmt, uint8_t **src, int src_fmt,
+                      const int *reorder, int channels, int samples)
+{
+    conv_fn conv = get_conv(dst_fmt, src_fmt);
+    mp_assert(conv);
+
+    bool dst_planar = af_fmt_is_planar(dst_fmt) || channels == 1;
+    bool src_planar = af_fmt_is_planar(src_fmt) || channels == 1;
+    int dst_bytes = af_fmt_to_bytes(dst_fmt);
+    int src_bytes = af_fmt_to_bytes(src_fmt);
+    int dst_stride = dst_planar ? 1 : channels;
+    int src_stride = src_planar ? 1 : channels;
+
+    // Planar to planar needs no blocking.
+    int block = dst_planar && src_planar ? samples : BLOCK_SAMPLES;
+
+    for (int pos = 0; pos < samples; pos += block) {
+        int num = MPMIN(block, samples - pos);
+        for (int c = 0; c < channels; c++) {
+            uint8_t *d = dst_planar
+                ? dst[c] + pos * (size_t)dst_bytes
+                : dst[0] + (pos * (size_t)channels + c) * dst_bytes;
+            int s = reorder ? reorder[c] : c;
+            if (s < 0) {
+                fill_silence(d, dst_stride, dst_bytes, num, dst_fmt);
+                continue;
+            }
+            mp_assert(s < channels);
+            const uint8_t *sp = src_planar
+                ? src[s] + pos * (size_t)src_bytes
+                : src[0] + (pos * (size_t)channels + s) * src_bytes;
+            conv(d, dst_stride, sp, src_stride, num);
+        }
+    }
+}
+
+// The LSB is always ignored.
+#if BYTE_ORDER == BIG_ENDIAN
+#define SHIFT24(x) ((3-(x))*8)
+#else
+#define SHIFT24(x) (((x)+1)*8)
+#endif
+
+void mp_sconv_pack_s24(void *data, size_t num, bool pad_msb)
+{
+    int bytes = pad_msb ? 4 : 3;
+    for (size_t s = 0; s < num; s++) {
+        uint32_t val = *((uint32_t *)data + s);
+        uint8_t *ptr = (uint8_t *)data + s * bytes;
+        ptr[0] = val >> SHIFT24(0);
+        ptr[1] = val >> SHIFT24(1);
+        ptr[2] = val >> SHIFT24(2);
+        if (pad_msb)
+            ptr[3] = 0;
+    }
+}
@@ -0,0 +1,46 @@
+/*
+ * This file is part of mpv.
+ *
+ * mpv is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * mpv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MP_AUDIO_SAMPLE_CONV_H
+#define MP_AUDIO_SAMPLE_CONV_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Simple PCM conversions that don't need libswresample: (de)interleaving and
+// channel reordering for any PCM format, and sample format conversion between
+// s16, s32 and float. Results are the same as with libswresample (without
+// dithering).
+
+// Whether mp_sconv_convert() supports converting src_fmt to dst_fmt.
+bool mp_sconv_can_convert(int dst_fmt, int src_fmt);
+
+// Convert samples per channel from src to dst. The planes arrays are as used
+// by mp_aframe (one plane per channel for planar formats, else a single plane).
+// If reorder is not NULL, destination channel n is taken from source channel
+// reorder[n], or is set to silence if reorder[n] is -1. (See
+// mp_chmap_get_reorder().) src and dst must not overlap.
+void mp_sconv_convert(uint8_t **dst, int dst_fmt, uint8_t **src, int src_fmt,
+                      const int *reorder, int channels, int samples);
+
+// Convert num s32 samples in place to packed 24 bit samples (3 bytes per
+// sample), or with pad_msb set, to 24 bit samples in the LSBs of 4 bytes. The
+// LSB of the source is dropped.
+void mp_sconv_pack_s24(void *data, size_t num, bool pad_msb);
+
+#endif
@@ -29,6 +29,7 @@
 #include "common/global.h"
 #include "misc/bstr.h"
 #include "misc/codepoint_width.h"
+#include "misc/record_ring.h"
 #include "options/options.h"
 #include "options/path.h"
 #include "osdep/io.h"
@@ -53,6 +54,23 @@
 // overwritten, then the first (virtual) log line indicates how many were lost.
 #define EARLY_FILE_BUF 5000
 
+// size of the message ring used with --msg-async (bytes, power of 2)
+#define LOG_RING_SIZE (1 << 20)
+
+// Record in the message ring. The formatted message follows the header.
+struct log_record {
+    int8_t level;
+    int8_t terminal_level;  // mp_log.terminal_level at the time of the call
+    uint8_t flags;          // LOG_RECORD_*
+    uint32_t prefix_len;
+    uint32_t verbose_prefix_len;
+    uint32_t text_len;
+    int64_t time_ns;
+    // followed by: prefix, verbose_prefix, text, each \0-terminated
+};
+
+#define LOG_RECORD_NO_PREFIX 1      // mp_log.prefix is NULL
+
 struct mp_log_root {
     struct mpv_global *global;
     mp_mutex lock;
@@ -81,6 +99,11 @@ struct mp_log_root {
     bstr status_line;
     struct mp_log *status_log;
     bstr term_status_msg;
+    int64_t msg_time;   // time of the message being written
+    struct mp_log *ring_status_log; // copy of the log of last queued status
+    // --- must be accessed atomically
+    atomic_bool async;  // use ring (can be set while log_drain_thread runs)
+    atomic_bool drain_pending;
     // --- must be accessed atomically
     /* This is incremented every time the msglevels must be reloaded.
      * (This is perhaps better than maintaining a globally accessible and
@@ -96,6 +119,14 @@ struct mp_log_root {
     // --- protected by log_file_lock
     bool log_file_thread_active; // also termination signal for the thread
     int module_indent;
+    // --- owner thread only; ring is not freed until mp_msg_uninit()
+    // The consumer side of the ring is protected by lock.
+    struct mp_record_ring *ring;
+    mp_thread drain_thread;
+    // --- protected by drain_lock
+    mp_mutex drain_lock;
+    mp_cond drain_wakeup;
+    bool drain_active;  // also termination signal for the thread
 };
 
 struct mp_log {
@@ -107,6 +138,7 @@ struct mp_log {
     int terminal_level;         // minimum log level for terminal output
     atomic_ulong reload_counter;
     bstr partial[MSGL_MAX + 1];
+    atomic_uint partial_levels; // bit per level if partial[] is not empty
 };
 
 struct mp_log_buffer {
@@ -125,6 +157,8 @@ struct mp_log_buffer {
     int level;
 };
 
+static void drain_ring(struct mp_log_root *root);
+
 static const struct mp_log null_log = {0};
 struct mp_log *const mp_null_log = (struct mp_log *)&null_log;
 
@@ -292,6 +326,7 @@ void mp_msg_flush_status_line(struct mp_log *log, bool clear)
         return;
 
     mp_mutex_lock(&log->root->lock);
+    drain_ring(log->root);
     msg_flush_status_line(log->root, clear);
     mp_mutex_unlock(&log->root->lock);
 }
@@ -301,6 +336,7 @@ void mp_msg_set_term_title(struct mp_log *log, const char *title)
     if (log->root && title) {
         // Lock because printf to terminal is not necessarily atomic.
         mp_mutex_lock(&log->root->lock);
+        drain_ring(log->root);
         fprintf(term_msg_fp(log->root, MSGL_STATUS), "\033]0;%s\007", title);
         mp_mutex_unlock(&log->root->lock);
     }
@@ -310,6 +346,7 @@ bool mp_msg_has_status_line(struct mpv_global *global)
 {
     struct mp_log_root *root = global->log->root;
     mp_mutex_lock(&root->lock);
+    drain_ring(root);
     bool r = root->status_lines > 0;
     mp_mutex_unlock(&root->lock);
     return r;
@@ -382,7 +419,8 @@ static void append_terminal_line(struct mp_log *log, int lev,
     size_t start = term_msg->len;
 
     if (root->show_time)
-        bstr_xappend_asprintf(root, term_msg, "[%10.6f] ", mp_time_sec());
+        bstr_xappend_asprintf(root, term_msg, "[%10.6f] ",
+                              MP_TIME_NS_TO_S(root->msg_time));
 
     const char *log_prefix = (lev >= MSGL_V) || root->verbose || root->module
                                 ? log->verbose_prefix : log->prefix;
@@ -499,7 +537,7 @@ static void dump_stats(struct mp_log *log, int lev, bstr text)
 {
     struct mp_log_root *root = log->root;
     if (lev == MSGL_STATS && root->stats_file)
-        fprintf(root->stats_file, "%"PRId64" %.*s\n", mp_time_ns(), BSTR_P(text));
+        fprintf(root->stats_file, "%"PRId64" %.*s\n", root->msg_time, BSTR_P(text));
 }
 
 static void write_term_msg(struct mp_log *log, int lev, bstr text, bstr *out)
@@ -548,6 +586,7 @@ static void write_term_msg(struct mp_log *log, int lev, bstr text, bstr *out)
                                   : (line_w + term_w - 1) / term_w;
     } else if (str.len) {
         bstr_xappend(NULL, &log->partial[lev], str);
+        atomic_fetch_or(&log->partial_levels, 1u << lev);
     }
 
     if (print_term && (root->term_msg_tmp.len || lev == MSGL_STATUS)) {
@@ -627,44 +666,27 @@ void mp_msg_sanitize(bstr *text, bool allow_sgr)
     }
 }
 
-void mp_msg_va(struct mp_log *log, int lev, const char *format, va_list va)
+// Write a formatted message to all outputs. root->lock must be held.
+static void write_msg(struct mp_log *log, int lev, bstr text)
 {
-    if (!mp_msg_test(log, lev))
-        return; // do not display
-
     struct mp_log_root *root = log->root;
 
-    mp_mutex_lock(&root->lock);
-
-    root->buffer.len = 0;
-
-    if (log->partial[lev].len)
-        bstr_xappend(root, &root->buffer, log->partial[lev]);
-    log->partial[lev].len = 0;
-
-    if (bstr_xappend_vasprintf(root, &root->buffer, format, va) < 0) {
-        bstr_xappend(root, &root->buffer, bstr0("format error: "));
-        bstr_xappend(root, &root->buffer, bstr0(format));
-    }
-
-    mp_msg_sanitize(&root->buffer, true);
-
     // Remember last status message and restore it to ensure that it is
     // always displayed
     if (lev == MSGL_STATUS) {
         root->status_log = log;
         root->status_line.len = 0;
         // Use bstr_xappend instead bstrdup to reuse allocated memory
-        if (root->buffer.len)
-            bstr_xappend(root, &root->status_line, root->buffer);
+        if (text.len)
+            bstr_xappend(root, &root->status_line, text);
     }
 
     if (lev == MSGL_STATS) {
-        dump_stats(log, lev, root->buffer);
+        dump_stats(log, lev, text);
     } else if (lev == MSGL_STATUS && !test_terminal_level(log, lev)) {
         /* discard */
     } else {
-        write_term_msg(log, lev, root->buffer, &root->term_msg);
+        write_term_msg(log, lev, text, &root->term_msg);
 
         FILE *stream = term_msg_fp(root, lev);
         if (root->term_msg.len) {
@@ -681,6 +703,185 @@ void mp_msg_va(struct mp_log *log, int lev, const char *format, va_list va)
             fflush(stream);
         }
     }
+}
+
+static void write_ring_record(void *ctx, void *record)
+{
+    struct mp_log_root *root = ctx;
+    struct log_record *rec = record;
+    const char *prefix = (char *)(rec + 1);
+    const char *verbose_prefix = prefix + rec->prefix_len + 1;
+    bstr text = {(unsigned char *)verbose_prefix + rec->verbose_prefix_len + 1,
+                 rec->text_len};
+
+    // The mp_log the message was sent to might be gone, so use a stand-in.
+    // Messages in the ring never leave partial lines.
+    struct mp_log log = {
+        .root = root,
+        .prefix = rec->flags & LOG_RECORD_NO_PREFIX ? NULL : prefix,
+        .verbose_prefix = verbose_prefix,
+        .terminal_level = rec->terminal_level,
+    };
+    struct mp_log *plog = &log;
+
+    if (rec->level == MSGL_STATUS) {
+        // root->status_log must stay valid after this call.
+        plog = root->ring_status_log;
+        if (!plog)
+            plog = root->ring_status_log = talloc_zero(root, struct mp_log);
+        talloc_free((char *)plog->prefix);
+        talloc_free((char *)plog->verbose_prefix);
+        *plog = log;
+        plog->prefix = talloc_strdup(root, log.prefix);
+        plog->verbose_prefix = talloc_strdup(root, log.verbose_prefix);
+    }
+
+    root->msg_time = rec->time_ns;
+    write_msg(plog, rec->level, text);
+}
+
+// Output all committed messages in the ring. root->lock must be held.
+static void drain_ring(struct mp_log_root *root)
+{
+    if (!root->ring)
+        return;
+
+    mp_record_ring_drain(root->ring, write_ring_record, root);
+
+    uint64_t dropped = mp_record_ring_take_dropped(root->ring);
+    if (dropped) {
+        struct mp_log log = {
+            .root = root,
+            .verbose_prefix = "overflow",
+            .terminal_level = MSGL_MAX,
+        };
+        root->msg_time = mp_time_ns();
+        write_msg(&log, MSGL_WARN, bstr0(mp_tprintf(80,
+            "log message ring overflow: %"PRIu64" messages dropped\n", dropped)));
+    }
+}
+
+// Append the message to the ring. Returns false if it does not fit.
+static bool push_ring(struct mp_log_root *root, struct mp_log *log, int lev,
+                      bstr text)
+{
+    const char *prefix = log->prefix ? log->prefix : "";
+    size_t prefix_len = strlen(prefix);
+    size_t verbose_prefix_len = strlen(log->verbose_prefix);
+    size_t size = sizeof(struct log_record) + prefix_len + 1 +
+                  verbose_prefix_len + 1 + text.len + 1;
+    if (size > mp_record_ring_max_size(root->ring))
+        return false;
+
+    struct log_record *rec = mp_record_ring_reserve(root->ring, size);
+    if (!rec)
+        return true; // dropped; reported by drain_ring()
+
+    rec->level = lev;
+    rec->terminal_level = log->terminal_level;
+    rec->flags = log->prefix ? 0 : LOG_RECORD_NO_PREFIX;
+    rec->prefix_len = prefix_len;
+    rec->verbose_prefix_len = verbose_prefix_len;
+    rec->text_len = text.len;
+    rec->time_ns = mp_time_ns();
+    char *dst = (char *)(rec + 1);
+    memcpy(dst, prefix, prefix_len + 1);
+    dst += prefix_len + 1;
+    memcpy(dst, log->verbose_prefix, verbose_prefix_len + 1);
+    dst += verbose_prefix_len + 1;
+    memcpy(dst, text.start, text.len);
+    mp_record_ring_commit(root->ring, rec);
+
+    // Only the first message after the drain thread woke up needs the lock.
+    if (!atomic_exchange(&root->drain_pending, true)) {
+        mp_mutex_lock(&root->drain_lock);
+        mp_cond_signal(&root->drain_wakeup);
+        mp_mutex_unlock(&root->drain_lock);
+    }
+    return true;
+}
+
+static void msg_va_async(struct mp_log *log, int lev, const char *format,
+                         va_list va)
+{
+    struct mp_log_root *root = log->root;
+
+    char buf[1024];
+    va_list copy;
+    va_copy(copy, va);
+    bstr text = {(unsigned char *)buf, 0};
+    int len = vsnprintf(buf, sizeof(buf), format, va);
+    void *tmp = NULL;
+    if (len >= (int)sizeof(buf)) {
+        tmp = talloc_vasprintf(NULL, format, copy);
+        text = bstr0(tmp);
+    } else if (len >= 0) {
+        text.len = len;
+    } else {
+        tmp = talloc_asprintf(NULL, "format error: %s", format);
+        text = bstr0(tmp);
+    }
+    va_end(copy);
+
+    mp_msg_sanitize(&text, true);
+
+    // Partial lines need the mp_log, which the ring does not keep. These are
+    // rare, so handle them like without --msg-async.
+    bool partial = lev != MSGL_STATUS && lev != MSGL_STATS &&
+        (!bstr_endswith0(text, "\n") ||
+         (atomic_load_explicit(&log->partial_levels, memory_order_relaxed) &
+          (1u << lev)));
+
+    if (partial || !push_ring(root, log, lev, text)) {
+        mp_mutex_lock(&root->lock);
+        drain_ring(root);
+        root->buffer.len = 0;
+        if (log->partial[lev].len)
+            bstr_xappend(root, &root->buffer, log->partial[lev]);
+        log->partial[lev].len = 0;
+        atomic_fetch_and(&log->partial_levels, ~(1u << lev));
+        bstr_xappend(root, &root->buffer, text);
+        root->msg_time = mp_time_ns();
+        write_msg(log, lev, root->buffer);
+        mp_mutex_unlock(&root->lock);
+    }
+
+    talloc_free(tmp);
+}
+
+void mp_msg_va(struct mp_log *log, int lev, const char *format, va_list va)
+{
+    if (!mp_msg_test(log, lev))
+        return; // do not display
+
+    struct mp_log_root *root = log->root;
+
+    if (atomic_load_explicit(&root->async, memory_order_relaxed)) {
+        msg_va_async(log, lev, format, va);
+        return;
+    }
+
+    mp_mutex_lock(&root->lock);
+
+    // Messages queued while --msg-async was still enabled go first.
+    drain_ring(root);
+
+    root->buffer.len = 0;
+
+    if (log->partial[lev].len)
+        bstr_xappend(root, &root->buffer, log->partial[lev]);
+    log->partial[lev].len = 0;
+    atomic_fetch_and(&log->partial_levels, ~(1u << lev));
+
+    if (bstr_xappend_vasprintf(root, &root->buffer, format, va) < 0) {
+        bstr_xappend(root, &root->buffer, bstr0("format error: "));
+        bstr_xappend(root, &root->buffer, bstr0(format));
+    }
+
+    mp_msg_sanitize(&root->buffer, true);
+
+    root->msg_time = mp_time_ns();
+    write_msg(log, lev, root->buffer);
 
     mp_mutex_unlock(&root->lock);
 }
@@ -751,6 +952,8 @@ void mp_msg_init(struct mpv_global *global)
     mp_mutex_init(&root->lock);
     mp_mutex_init(&root->log_file_lock);
     mp_cond_init(&root->log_file_wakeup);
+    mp_mutex_init(&root->drain_lock);
+    mp_cond_init(&root->drain_wakeup);
 
     struct mp_log dummy = { .root = root };
     struct mp_log *log = mp_log_new(root, &dummy, "");
@@ -822,6 +1025,61 @@ static void terminate_log_file_thread(struct mp_log_root *root)
     root->log_file = NULL;
 }
 
+static MP_THREAD_VOID log_drain_thread(void *p)
+{
+    struct mp_log_root *root = p;
+
+    mp_thread_set_name("log-drain");
+
+    mp_mutex_lock(&root->drain_lock);
+
+    while (root->drain_active) {
+        if (atomic_exchange(&root->drain_pending, false)) {
+            mp_mutex_unlock(&root->drain_lock);
+            mp_mutex_lock(&root->lock);
+            drain_ring(root);
+            mp_mutex_unlock(&root->lock);
+            mp_mutex_lock(&root->drain_lock);
+        } else {
+            mp_cond_wait(&root->drain_wakeup, &root->drain_lock);
+        }
+    }
+
+    mp_mutex_unlock(&root->drain_lock);
+
+    MP_THREAD_RETURN();
+}
+
+// Only to be called from the main thread.
+static void set_async(struct mp_log_root *root, bool enable)
+{
+    if (enable == atomic_load(&root->async))
+        return;
+
+    if (enable) {
+        if (!root->ring)
+            root->ring = mp_record_ring_create(root, LOG_RING_SIZE);
+        root->drain_active = true;
+        if (mp_thread_create(&root->drain_thread, log_drain_thread, root)) {
+            root->drain_active = false;
+            return;
+        }
+        atomic_store(&root->async, true);
+    } else {
+        atomic_store(&root->async, false);
+        mp_mutex_lock(&root->drain_lock);
+        root->drain_active = false;
+        mp_cond_signal(&root->drain_wakeup);
+        mp_mutex_unlock(&root->drain_lock);
+        mp_thread_join(root->drain_thread);
+        // Anything that is still queued is written by the next message, or
+        // by mp_msg_uninit().
+        mp_mutex_lock(&root->lock);
+        drain_ring(root);
+        mp_mutex_unlock(&root->lock);
+    }
+}
+
 // If opt is different from *current_path, update *current_path and return true.
 // No lock must be held; passed values must be accessible without.
 static bool check_new_path(struct mpv_global *global, char *opt,
@@ -874,6 +1132,8 @@ void mp_msg_update_msglevels(struct mpv_global *global, struct MPOpts *opts)
     atomic_fetch_add(&root->reload_counter, 1);
     mp_mutex_unlock(&root->lock);
 
+    set_async(root, opts->msg_async);
+
     if (check_new_path(global, opts->log_file, &root->log_path)) {
         terminate_log_file_thread(root);
         if (root->log_path) {
@@ -946,6 +1206,7 @@ void mp_msg_force_stderr(struct mpv_global *global, bool force_stderr)
     struct mp_log_root *root = global->log->root;
 
     mp_mutex_lock(&root->lock);
+    drain_ring(root);
     root->force_stderr = force_stderr;
     mp_mutex_unlock(&root->lock);
 }
@@ -961,6 +1222,7 @@ bool mp_msg_has_log_file(struct mpv_global *global)
 void mp_msg_uninit(struct mpv_global *global)
 {
     struct mp_log_root *root = global->log->root;
+    set_async(root, false);
     mp_msg_flush_status_line(global->log, true);
     if (root->really_quiet && root->isatty[term_msg_fileno(root, MSGL_STATUS)])
         fprintf(term_msg_fp(root, MSGL_STATUS), TERM_ESC_RESTORE_CURSOR);
@@ -976,6 +1238,8 @@ void mp_msg_uninit(struct mpv_global *global)
     mp_mutex_destroy(&root->lock);
     mp_mutex_destroy(&root->log_file_lock);
     mp_cond_destroy(&root->log_file_wakeup);
+    mp_mutex_destroy(&root->drain_lock);
+    mp_cond_destroy(&root->drain_wakeup);
     talloc_free(root);
     global->log = NULL;
 }
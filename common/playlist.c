@@ -61,6 +61,45 @@ void playlist_set_params(struct playlist *pl, struct playlist_param *params,
     }
 }
 
+// Maximum number of unconsumed changes before they're collapsed into a reset.
+#define MAX_CHANGES 256
+
+static void record_change(struct playlist *pl, struct playlist_change ch)
+{
+    if (!pl->track_changes)
+        return;
+
+    struct playlist_change *last =
+        pl->num_changes ? &pl->changes[pl->num_changes - 1] : NULL;
+    if (last && last->type == PLAYLIST_CHANGE_RESET)
+        return;
+
+    if (last && last->type == ch.type && ch.type == PLAYLIST_CHANGE_INSERT &&
+        ch.index == last->index + last->count && ch.id == last->id + last->count)
+    {
+        last->count += ch.count;
+        return;
+    }
+
+    if (last && last->type == ch.type && ch.type == PLAYLIST_CHANGE_REMOVE) {
+        if (ch.index == last->index) {
+            last->count += ch.count;
+            return;
+        }
+        if (ch.index + ch.count == last->index) {
+            last->index = ch.index;
+            last->count += ch.count;
+            return;
+        }
+    }
+
+    if (pl->num_changes >= MAX_CHANGES) {
+        pl->num_changes = 0;
+        ch = (struct playlist_change){.type = PLAYLIST_CHANGE_RESET};
+    }
+    MP_TARRAY_APPEND(pl, pl->changes, pl->num_changes, ch);
+}
+
 static void playlist_update_indexes(struct playlist *pl, int start, int end)
 {
     start = MPMAX(start, 0);
@@ -87,6 +126,13 @@ void playlist_insert_at(struct playlist *pl, struct playlist_entry *add,
 
     playlist_update_indexes(pl, index, pl->num_entries);
 
+    record_change(pl, (struct playlist_change){
+        .type = PLAYLIST_CHANGE_INSERT,
+        .index = index,
+        .count = 1,
+        .id = add->id,
+    });
+
     talloc_steal(pl, add);
 }
 
@@ -108,6 +154,12 @@ void playlist_remove(struct playlist *pl, struct playlist_entry *entry)
         pl->current_was_replaced = true;
     }
 
+    record_change(pl, (struct playlist_change){
+        .type = PLAYLIST_CHANGE_REMOVE,
+        .index = entry->pl_index,
+        .count = 1,
+    });
+
     MP_TARRAY_REMOVE_AT(pl->entries, pl->num_entries, entry->pl_index);
     playlist_update_indexes(pl, entry->pl_index, -1);
 
@@ -160,6 +212,16 @@ void playlist_move(struct playlist *pl, struct playlist_entry *entry,
 
     playlist_update_indexes(pl, MPMIN(index - 1, old_index - 1),
                                 MPMAX(index + 1, old_index + 1));
+
+    int from = old_index > index ? old_index - 1 : old_index;
+    if (from != entry->pl_index) {
+        record_change(pl, (struct playlist_change){
+            .type = PLAYLIST_CHANGE_MOVE,
+            .index = from,
+            .to_index = entry->pl_index,
+            .id = entry->id,
+        });
+    }
 }
 
 void playlist_append_file(struct playlist *pl, const char *filename)
@@ -186,6 +248,7 @@ void playlist_shuffle(struct playlist *pl)
         MPSWAP(struct playlist_entry *, pl->entries[n], pl->entries[j]);
     }
     playlist_update_indexes(pl, 0, -1);
+    record_change(pl, (struct playlist_change){.type = PLAYLIST_CHANGE_RESET});
 }
 
 #define CMP_INT(a, b) ((a) == (b) ? 0 : ((a) > (b) ? 1 : -1))
@@ -205,6 +268,7 @@ void playlist_unshuffle(struct playlist *pl)
     if (pl->num_entries)
         qsort(pl->entries, pl->num_entries, sizeof(pl->entries[0]), cmp_unshuffle);
     playlist_update_indexes(pl, 0, -1);
+    record_change(pl, (struct playlist_change){.type = PLAYLIST_CHANGE_RESET});
 }
 
 // (Explicitly ignores current_was_replaced.)
@@ -342,6 +406,15 @@ int64_t playlist_transfer_entries_to(struct playlist *pl, int dst_index,
     playlist_update_indexes(pl, dst_index + count, -1);
     source_pl->num_entries = 0;
 
+    if (count) {
+        record_change(pl, (struct playlist_change){
+            .type = PLAYLIST_CHANGE_INSERT,
+            .index = dst_index,
+            .count = count,
+            .id = first->id,
+        });
+    }
+
     pl->playlist_completed = source_pl->playlist_completed;
     pl->playlist_started = source_pl->playlist_started;
 
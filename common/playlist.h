@@ -64,6 +64,23 @@ struct playlist_entry {
     int stream_flags;
 };
 
+enum playlist_change_type {
+    PLAYLIST_CHANGE_INSERT,
+    PLAYLIST_CHANGE_REMOVE,
+    PLAYLIST_CHANGE_MOVE,
+    // Too many or complex changes (like shuffling); the whole list changed.
+    PLAYLIST_CHANGE_RESET,
+};
+
+struct playlist_change {
+    enum playlist_change_type type;
+    int index;      // first inserted/removed entry, or old index of moved entry
+    int count;      // number of inserted/removed entries
+    int to_index;   // new index of moved entry
+    uint64_t id;    // ID of the first inserted entry, or of the moved entry
+                    // (inserted entries have consecutive IDs)
+};
+
 struct playlist {
     struct playlist_entry **entries;
     int num_entries;
@@ -78,6 +95,14 @@ struct playlist {
     char *playlist_dir;
 
     uint64_t id_alloc;
+
+    // If set, changes to the entry list are appended to changes[] (the user
+    // is responsible for consuming and resetting num_changes). Adjacent
+    // inserts or removes are merged, and if too many changes accumulate, they
+    // are replaced by a single PLAYLIST_CHANGE_RESET.
+    bool track_changes;
+    struct playlist_change *changes;
+    int num_changes;
 };
 
 void playlist_entry_add_param(struct playlist_entry *e, bstr name, bstr value);
@@ -0,0 +1,240 @@
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdio.h>
+
+#include <mpv/client.h>
+
+#include "common.h"
+#include "global.h"
+#include "misc/json.h"
+#include "misc/node.h"
+#include "msg.h"
+#include "osdep/getpid.h"
+#include "osdep/threads.h"
+#include "osdep/timer.h"
+#include "trace.h"
+
+// Startup should not produce more events than this. If it does, something is
+// probably calling the trace functions in a loop; drop the excess.
+#define MAX_EVENTS 2000
+
+struct trace_event {
+    char *name;
+    char type;      // 'B' (begin), 'E' (end) or 'i' (instant), as in Chrome
+    int thread;     // index into trace_base.threads
+    int64_t time_ns; // relative to trace_base.start_ns
+};
+
+struct trace_base {
+    atomic_bool finished;
+
+    mp_mutex lock;
+
+    int64_t start_ns;
+
+    mp_thread_id *threads;
+    int num_threads;
+
+    struct trace_event *events;
+    int num_events;
+};
+
+struct trace_span {
+    struct trace_event *begin, *end;
+};
+
+static void trace_destroy(void *p)
+{
+    struct trace_base *trace = p;
+    mp_mutex_destroy(&trace->lock);
+}
+
+void trace_global_init(struct mpv_global *global)
+{
+    mp_assert(!global->trace);
+    struct trace_base *trace = talloc_zero(global, struct trace_base);
+    ta_set_destructor(trace, trace_destroy);
+    mp_mutex_init(&trace->lock);
+    trace->start_ns = mp_time_ns();
+
+    global->trace = trace;
+}
+
+static int get_thread_index(struct trace_base *trace)
+{
+    mp_thread_id id = mp_thread_current_id();
+    for (int n = 0; n < trace->num_threads; n++) {
+        if (mp_thread_id_equal(trace->threads[n], id))
+            return n;
+    }
+    MP_TARRAY_APPEND(trace, trace->threads, trace->num_threads, id);
+    return trace->num_threads - 1;
+}
+
+static void add_event(struct mpv_global *global, const char *name, char type)
+{
+    struct trace_base *trace = global->trace;
+    if (!trace || atomic_load_explicit(&trace->finished, memory_order_relaxed))
+        return;
+
+    mp_mutex_lock(&trace->lock);
+    if (!atomic_load(&trace->finished) && trace->num_events < MAX_EVENTS) {
+        struct trace_event ev = {
+            .name = talloc_strdup(trace, name),
+            .type = type,
+            .thread = get_thread_index(trace),
+            .time_ns = mp_time_ns() - trace->start_ns,
+        };
+        MP_TARRAY_APPEND(trace, trace->events, trace->num_events, ev);
+    }
+    mp_mutex_unlock(&trace->lock);
+}
+
+void trace_begin(struct mpv_global *global, const char *name)
+{
+    add_event(global, name, 'B');
+}
+
+void trace_end(struct mpv_global *global, const char *name)
+{
+    add_event(global, name, 'E');
+}
+
+void trace_instant(struct mpv_global *global, const char *name)
+{
+    add_event(global, name, 'i');
+}
+
+bool trace_finish(struct mpv_global *global)
+{
+    struct trace_base *trace = global->trace;
+    mp_mutex_lock(&trace->lock);
+    bool was_finished = atomic_exchange(&trace->finished, true);
+    mp_mutex_unlock(&trace->lock);
+    return !was_finished;
+}
+
+// Pair begin and end events. Events are appended under the lock with
+// monotonic timestamps, so the result is sorted by start time.
+// Must be called with trace->lock held.
+static int get_spans(struct trace_base *trace, void *ta_parent,
+                     struct trace_span **out)
+{
+    struct trace_span *spans = NULL;
+    int num_spans = 0;
+    for (int n = 0; n < trace->num_events; n++) {
+        struct trace_event *ev = &trace->events[n];
+        if (ev->type == 'E')
+            continue;
+        struct trace_span span = {ev, ev->type == 'i' ? ev : NULL};
+        for (int i = n + 1; ev->type == 'B' && i < trace->num_events; i++) {
+            struct trace_event *end = &trace->events[i];
+            if (end->thread == ev->thread && strcmp(end->name, ev->name) == 0) {
+                if (end->type == 'E')
+                    span.end = end;
+                if (end->type != 'i')
+                    break;
+            }
+        }
+        MP_TARRAY_APPEND(ta_parent, spans, num_spans, span);
+    }
+    *out = spans;
+    return num_spans;
+}
+
+void trace_query(struct mpv_global *global, struct mpv_node *out)
+{
+    struct trace_base *trace = global->trace;
+    void *tmp = talloc_new(NULL);
+
+    node_init(out, MPV_FORMAT_NODE_ARRAY, NULL);
+
+    mp_mutex_lock(&trace->lock);
+    struct trace_span *spans;
+    int num_spans = get_spans(trace, tmp, &spans);
+    for (int n = 0; n < num_spans; n++) {
+        struct trace_span *s = &spans[n];
+        struct mpv_node *ne = node_array_add(out, MPV_FORMAT_NODE_MAP);
+        node_map_add_string(ne, "name", s->begin->name);
+        node_map_add_int64(ne, "thread", s->begin->thread);
+        node_map_add_double(ne, "start", MP_TIME_NS_TO_S(s->begin->time_ns));
+        if (s->end) {
+            node_map_add_double(ne, "duration",
+                MP_TIME_NS_TO_S(s->end->time_ns - s->begin->time_ns));
+        }
+    }
+    mp_mutex_unlock(&trace->lock);
+
+    talloc_free(tmp);
+}
+
+bool trace_write_chrome_json(struct mpv_global *global, struct mp_log *log,
+                             const char *path)
+{
+    struct trace_base *trace = global->trace;
+    void *tmp = talloc_new(NULL);
+    struct mpv_node root;
+    node_init(&root, MPV_FORMAT_NODE_MAP, NULL);
+    talloc_steal(tmp, root.u.list);
+    struct mpv_node *list = node_map_add(&root, "traceEvents",
+                                         MPV_FORMAT_NODE_ARRAY);
+    node_map_add_string(&root, "displayTimeUnit", "ms");
+
+    int64_t pid = mp_getpid();
+
+    mp_mutex_lock(&trace->lock);
+    for (int n = 0; n < trace->num_events; n++) {
+        struct trace_event *ev = &trace->events[n];
+        struct mpv_node *ne = node_array_add(list, MPV_FORMAT_NODE_MAP);
+        node_map_add_string(ne, "name", ev->name);
+        node_map_add_string(ne, "ph", (char[2]){ev->type, '\0'});
+        node_map_add_double(ne, "ts", MP_TIME_NS_TO_US(ev->time_ns));
+        node_map_add_int64(ne, "pid", pid);
+        node_map_add_int64(ne, "tid", ev->thread);
+        if (ev->type == 'i')
+            node_map_add_string(ne, "s", "t");
+    }
+    mp_mutex_unlock(&trace->lock);
+
+    char *s = talloc_strdup(tmp, "");
+    bool ok = json_write(&s, &root) >= 0;
+
+    FILE *f = ok ? fopen(path, "wb") : NULL;
+    if (f) {
+        ok = fwrite(s, strlen(s), 1, f) == 1;
+        ok &= fclose(f) == 0;
+    } else {
+        ok = false;
+    }
+    if (!ok)
+        mp_err(log, "Failed to write trace to '%s': %s\n", path, mp_strerror(errno));
+
+    talloc_free(tmp);
+    return ok;
+}
+
+void trace_log_summary(struct mpv_global *global, struct mp_log *log, int lev)
+{
+    struct trace_base *trace = global->trace;
+    if (!mp_msg_test(log, lev))
+        return;
+
+    void *tmp = talloc_new(NULL);
+
+    mp_mutex_lock(&trace->lock);
+    struct trace_span *spans;
+    int num_spans = get_spans(trace, tmp, &spans);
+    mp_msg(log, lev, "Startup trace (start/duration in ms):\n");
+    for (int n = 0; n < num_spans; n++) {
+        struct trace_span *s = &spans[n];
+        char *dur = s->end ? mp_tprintf(20, "%10.3f",
+                MP_TIME_NS_TO_MS(s->end->time_ns - s->begin->time_ns))
+                           : "         -";
+        mp_msg(log, lev, "  %10.3f %s  [%d] %s\n",
+               MP_TIME_NS_TO_MS(s->begin->time_ns), dur, s->begin->thread,
+               s->begin->name);
+    }
+    mp_mutex_unlock(&trace->lock);
+
+    talloc_free(tmp);
+}
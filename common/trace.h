@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stdbool.h>
+
+struct mp_log;
+struct mpv_global;
+struct mpv_node;
+
+// Startup trace: records named spans from player creation until the first
+// playback restart (or until trace_finish() is called). Recording is cheap,
+// but not free, so it should be used only for coarse, one-time events. After
+// the trace is finished, all recording functions are no-ops.
+
+void trace_global_init(struct mpv_global *global);
+
+// Begin/end a span on the calling thread. Spans with the same name can't be
+// nested on the same thread. The name is copied.
+void trace_begin(struct mpv_global *global, const char *name);
+void trace_end(struct mpv_global *global, const char *name);
+
+// Record an event without duration.
+void trace_instant(struct mpv_global *global, const char *name);
+
+// Stop recording. Returns false if the trace was already finished.
+bool trace_finish(struct mpv_global *global);
+
+// Set *out to a list of maps with the keys "name", "thread", "start" and
+// "duration" (in seconds), sorted by start time. Instant events have a
+// duration of 0, spans that were not ended have no "duration" key.
+void trace_query(struct mpv_global *global, struct mpv_node *out);
+
+// Write the trace in the Chrome trace event JSON format (viewable in
+// chrome://tracing or Perfetto). Returns success.
+bool trace_write_chrome_json(struct mpv_global *global, struct mp_log *log,
+                             const char *path);
+
+// Print a summary table of all spans.
+void trace_log_summary(struct mpv_global *global, struct mp_log *log, int lev);
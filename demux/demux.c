@@ -37,6 +37,7 @@
 #include "common/global.h"
 #include "common/recorder.h"
 #include "common/stats.h"
+#include "common/trace.h"
 #include "misc/charset_conv.h"
 #include "misc/thread_tools.h"
 #include "osdep/timer.h"
@@ -3609,18 +3610,22 @@ struct demuxer *demux_open_url(const char *url,
         mp_cancel_set_parent(priv_cancel, cancel);
     struct stream *s = params->external_stream;
     if (!s) {
+        trace_begin(global, "stream-open");
         s = stream_create(url, STREAM_READ | params->stream_flags,
                           priv_cancel, global);
         if (s && params->init_fragment.len) {
             s = create_webshit_concat_stream(global, priv_cancel,
                                              params->init_fragment, s);
         }
+        trace_end(global, "stream-open");
     }
     if (!s) {
         talloc_free(priv_cancel);
         return NULL;
     }
+    trace_begin(global, "demux-open");
     struct demuxer *d = demux_open(s, priv_cancel, params, global);
+    trace_end(global, "demux-open");
     if (d) {
         talloc_steal(d->in, priv_cancel);
         mp_assert(d->cancel);
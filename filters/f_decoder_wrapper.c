@@ -24,6 +24,7 @@
 
 #include <libavutil/buffer.h>
 #include <libavutil/common.h>
+#include <libavutil/cpu.h>
 #include <libavutil/rational.h>
 
 #include "options/options.h"
@@ -39,7 +40,9 @@
 #include "common/codecs.h"
 #include "common/global.h"
 #include "common/recorder.h"
+#include "common/trace.h"
 #include "misc/dispatch.h"
+#include "misc/thread_pool.h"
 
 #include "audio/aframe.h"
 #include "video/out/vo.h"
@@ -106,6 +109,7 @@ struct dec_wrapper_opts {
     struct dec_queue_opts *adec_queue_opts;
     int64_t video_reverse_size;
     int64_t audio_reverse_size;
+    int video_reverse_threads;
 };
 
 static int decoder_list_help(struct mp_log *log, const m_option_t *opt,
@@ -137,6 +141,8 @@ const struct m_sub_options dec_wrapper_conf = {
             M_RANGE(0, M_MAX_MEM_BYTES)},
         {"audio-reversal-buffer", OPT_BYTE_SIZE(audio_reverse_size),
             M_RANGE(0, M_MAX_MEM_BYTES)},
+        {"video-reversal-threads", OPT_CHOICE(video_reverse_threads,
+            {"no", 0}, {"auto", -1}), M_RANGE(1, 64)},
         {0}
     },
     .size = sizeof(struct dec_wrapper_opts),
@@ -149,6 +155,34 @@ const struct m_sub_options dec_wrapper_conf = {
     },
 };
 
+// A range of packets decoded in one go for backward playback (normally a GOP),
+// decoded on a worker thread with a separate decoder instance.
+struct back_job {
+    struct priv *p;
+    struct mp_codec_params *codec;  // private copy of orig_codec
+    struct mp_codec_params *orig_codec;
+    char *decoder;
+    struct demux_packet **packets;
+    int num_packets;
+    double start, end;              // segment range, as in priv
+    bool preroll;                   // starts with back_preroll packets
+    bool eof;                       // start of the stream is reached after it
+    int64_t max_bytes;              // reversal buffer size
+    bool overflow;
+
+    // Decoded frames in decoding order. Set by the worker.
+    struct mp_frame *frames;
+    int num_frames;
+    int64_t frames_bytes;
+
+    atomic_bool abandoned;          // result not needed anymore
+    bool done;                      // protected by priv.back_lock
+
+    mp_mutex wakeup_lock;
+    mp_cond wakeup;
+    bool woken;
+};
+
 struct priv {
     struct mp_log *log;
     struct sh_stream *header;
@@ -214,6 +248,15 @@ struct priv {
 
     int play_dir;
 
+    // Parallel backward decoding (--video-reversal-threads).
+    int back_threads;               // -1: undecided, 0: not used
+    struct mp_thread_pool *back_pool;
+    int back_pool_threads;
+    struct back_job *back_fill;     // job currently receiving packets
+    struct back_job **back_jobs;    // submitted jobs, in demuxer order
+    int num_back_jobs;
+    bool back_eof;                  // demuxer EOF was added to a job
+
     // --- The following fields can be accessed only from the mp_decoder_wrapper
     //     user thread.
     struct mp_decoder_wrapper public;
@@ -225,6 +268,7 @@ struct priv {
     mp_thread dec_thread;
     bool dec_thread_valid;
     mp_mutex cache_lock;
+    mp_mutex back_lock; // for back_job.done and back_job.abandoned
 
     // --- Protected by cache_lock.
     char *cur_hwdec;
@@ -331,6 +375,40 @@ static void reset_decoder(struct priv *p)
         mp_filter_reset(p->decoder->f);
 }
 
+static void free_back_job(struct back_job *job)
+{
+    for (int n = 0; n < job->num_packets; n++)
+        talloc_free(job->packets[n]);
+    for (int n = 0; n < job->num_frames; n++)
+        mp_frame_unref(&job->frames[n]);
+    mp_mutex_destroy(&job->wakeup_lock);
+    mp_cond_destroy(&job->wakeup);
+    talloc_free(job);
+}
+
+// Drop all backward decoding jobs. Jobs still running on a worker are freed
+// by the worker once it notices.
+static void reset_back_jobs(struct priv *p)
+{
+    if (p->back_fill)
+        free_back_job(p->back_fill);
+    p->back_fill = NULL;
+
+    mp_mutex_lock(&p->back_lock);
+    for (int n = 0; n < p->num_back_jobs; n++) {
+        struct back_job *job = p->back_jobs[n];
+        if (job->done) {
+            free_back_job(job);
+        } else {
+            atomic_store(&job->abandoned, true);
+        }
+    }
+    mp_mutex_unlock(&p->back_lock);
+    p->num_back_jobs = 0;
+    p->back_eof = false;
+    p->back_threads = -1;
+}
+
 static void decf_reset(struct mp_filter *f)
 {
     struct priv *p = f->priv;
@@ -353,6 +431,7 @@ static void decf_reset(struct mp_filter *f)
     p->reverse_queue_byte_size = 0;
     p->reverse_queue_complete = false;
 
+    reset_back_jobs(p);
     reset_decoder(p);
 }
 
@@ -403,6 +482,10 @@ static void decf_destroy(struct mp_filter *f)
 
     decf_reset(f);
     mp_frame_unref(&p->decoded_coverart);
+
+    // Wait until the workers are done with abandoned jobs.
+    talloc_free(p->back_pool);
+    p->back_pool = NULL;
 }
 
 struct mp_decoder_list *video_decoder_list(void)
@@ -473,6 +556,10 @@ static bool reinit_decoder(struct priv *p)
 
     mp_print_decoders(p->log, MSGL_V, "Codec list:", list);
 
+    char *trace_name = mp_tprintf(80, "decoder-init/%s",
+                                  stream_type_name(p->codec->type));
+    trace_begin(p->decf->global, trace_name);
+
     for (int n = 0; n < list->num_entries; n++) {
         struct mp_decoder_entry *sel = &list->entries[n];
         MP_VERBOSE(p, "Opening decoder %s\n", sel->decoder);
@@ -491,6 +578,8 @@ static bool reinit_decoder(struct priv *p)
         MP_WARN(p, "Decoder init failed for %s\n", sel->decoder);
     }
 
+    trace_end(p->decf->global, trace_name);
+
     if (!p->decoder) {
         MP_ERR(p, "Failed to initialize a decoder for codec '%s'.\n",
                p->codec->codec ? p->codec->codec : "<?>");
@@ -608,6 +697,8 @@ void mp_decoder_wrapper_set_play_dir(struct mp_decoder_wrapper *d, int dir)
         return;
     }
     thread_lock(p);
+    if (p->play_dir != dir)
+        p->back_threads = -1;
     p->play_dir = dir;
     thread_unlock(p);
 }
@@ -996,6 +1087,11 @@ static void feed_packet(struct priv *p)
             framedrop_type = 2;
 
         p->decoder->control(p->decoder->f, VDCTRL_SET_FRAMEDROP, &framedrop_type);
+
+        if (p->queue) {
+            int queued = mp_async_queue_get_frames(p->queue);
+            p->decoder->control(p->decoder->f, VDCTRL_SET_QUEUED_FRAMES, &queued);
+        }
     }
 
     if (!p->dec_dispatch && p->public.recorder_sink)
@@ -1055,6 +1151,284 @@ static void enqueue_backward_frame(struct priv *p, struct mp_frame frame)
     p->reverse_queue_complete = eof;
 }
 
+static void wakeup_back_job(void *ptr)
+{
+    struct back_job *job = ptr;
+
+    mp_mutex_lock(&job->wakeup_lock);
+    job->woken = true;
+    mp_cond_signal(&job->wakeup);
+    mp_mutex_unlock(&job->wakeup_lock);
+}
+
+// Runs on a worker thread: decode all packets of the job with a new decoder.
+// Hardware decoding is not used, because there could be many decoders at once.
+static void run_back_job(void *ptr)
+{
+    struct back_job *job = ptr;
+    struct priv *p = job->p;
+
+    struct mp_stream_info sinfo = {.force_swdec = true};
+    struct mp_filter *root = mp_filter_create_root(p->decf->global);
+    root->stream_info = &sinfo;
+    mp_filter_graph_set_wakeup_cb(root, wakeup_back_job, job);
+
+    struct mp_decoder *dec = NULL;
+    if (job->num_packets) {
+        dec = job->decoder ? vd_lavc.create(root, job->codec, job->decoder)
+                           : NULL;
+        if (!dec)
+            MP_ERR(p, "Failed to create decoder for backward decoding.\n");
+    }
+
+    int next_packet = 0;
+    bool eof_sent = false;
+    while (dec && !atomic_load(&job->abandoned)) {
+        struct mp_pin *in = dec->f->pins[0];
+        if (!eof_sent && mp_pin_in_needs_data(in)) {
+            if (next_packet < job->num_packets) {
+                struct demux_packet *pkt = job->packets[next_packet];
+                job->packets[next_packet++] = NULL;
+                mp_pin_in_write(in, MAKE_FRAME(MP_FRAME_PACKET, pkt));
+            } else {
+                mp_pin_in_write(in, MP_EOF_FRAME);
+                eof_sent = true;
+            }
+            continue;
+        }
+
+        struct mp_frame frame = mp_pin_out_read(dec->f->pins[1]);
+        if (frame.type == MP_FRAME_EOF) {
+            break;
+        } else if (frame.type == MP_FRAME_VIDEO) {
+            if (job->frames_bytes >= job->max_bytes) {
+                job->overflow = true;
+                mp_frame_unref(&frame);
+            } else {
+                job->frames_bytes += mp_frame_approx_size(frame);
+                MP_TARRAY_APPEND(job, job->frames, job->num_frames, frame);
+            }
+        } else if (frame.type) {
+            mp_frame_unref(&frame);
+        } else if (mp_filter_has_failed(dec->f)) {
+            break;
+        } else if (!mp_filter_graph_run(root)) {
+            mp_mutex_lock(&job->wakeup_lock);
+            if (!job->woken)
+                mp_cond_timedwait(&job->wakeup, &job->wakeup_lock,
+                                  MP_TIME_MS_TO_NS(50));
+            job->woken = false;
+            mp_mutex_unlock(&job->wakeup_lock);
+        }
+    }
+
+    talloc_free(root);
+
+    mp_mutex_lock(&p->back_lock);
+    bool abandoned = atomic_load(&job->abandoned);
+    if (!abandoned) {
+        job->done = true;
+        mp_filter_wakeup(p->decf);
+    }
+    mp_mutex_unlock(&p->back_lock);
+
+    if (abandoned)
+        free_back_job(job);
+}
+
+// Return the number of worker threads for parallel backward decoding, or 0 if
+// it should not be used.
+static int get_back_threads(struct priv *p)
+{
+    int threads = p->opts->video_reverse_threads;
+    if (p->play_dir > 0 || !threads || p->header->type != STREAM_VIDEO ||
+        !p->decoder || p->decoded_coverart.type)
+        return 0;
+
+    mp_mutex_lock(&p->cache_lock);
+    bool unsupported = p->attached_picture || p->cur_hwdec;
+    mp_mutex_unlock(&p->cache_lock);
+    if (unsupported) {
+        MP_DBG(p, "Not using parallel backward decoding with hwdec or "
+               "cover art.\n");
+        return 0;
+    }
+
+    if (threads < 0)
+        threads = MPMAX(av_cpu_count(), 1);
+    if (!p->back_pool || p->back_pool_threads != threads) {
+        talloc_free(p->back_pool);
+        p->back_pool = mp_thread_pool_create(p, 0, 0, threads);
+        p->back_pool_threads = threads;
+        MP_VERBOSE(p, "Using %d threads for backward decoding.\n", threads);
+    }
+    return threads;
+}
+
+// Pick the decoder for a segment with a different codec (timeline only).
+static char *select_back_decoder(struct priv *p, struct mp_codec_params *codec)
+{
+    if (codec == p->codec && codec->decoder)
+        return talloc_strdup(NULL, codec->decoder);
+
+    struct mp_decoder_list *full = talloc_zero(NULL, struct mp_decoder_list);
+    vd_lavc.add_decoders(full);
+    struct mp_decoder_list *list =
+        mp_select_decoders(p->log, full, codec->codec, p->opts->video_decoders);
+    const char *name = list->num_entries ? list->entries[0].decoder : NULL;
+    char *res = talloc_strdup(NULL, name);
+    talloc_free(list);
+    talloc_free(full);
+    return res;
+}
+
+// pkt is the first packet of the job, or NULL if there is none.
+static struct back_job *new_back_job(struct priv *p, struct demux_packet *pkt)
+{
+    struct back_job *job = talloc_zero(NULL, struct back_job);
+    job->p = p;
+    mp_mutex_init(&job->wakeup_lock);
+    mp_cond_init(&job->wakeup);
+
+    bool segmented = pkt && pkt->segmented;
+    job->orig_codec = segmented ? pkt->codec : p->codec;
+    job->codec = talloc_dup(job, job->orig_codec);
+    job->decoder = talloc_steal(job, select_back_decoder(p, job->orig_codec));
+    job->start = segmented ? pkt->start : MP_NOPTS_VALUE;
+    job->end = segmented ? pkt->end : MP_NOPTS_VALUE;
+    // The reversal buffer is split between all jobs that can be in flight,
+    // and the reversal queue, which holds the frames of the job being output.
+    job->max_bytes = p->opts->video_reverse_size / (p->back_threads + 1);
+    return job;
+}
+
+static void submit_back_job(struct priv *p)
+{
+    struct back_job *job = p->back_fill;
+    p->back_fill = NULL;
+
+    // The pool starts jobs in the order they were queued, so the oldest job,
+    // which read_back_job() waits for, is never behind newer ones.
+    MP_TARRAY_APPEND(p, p->back_jobs, p->num_back_jobs, job);
+    if (!mp_thread_pool_queue(p->back_pool, run_back_job, job))
+        run_back_job(job);
+}
+
+// Read packets from the demuxer and split them into jobs. Each backward
+// restart (or segment change) starts a new job, so a job is complete as soon
+// as the first packet of the next one is read.
+static void feed_back_jobs(struct priv *p)
+{
+    while (!p->back_eof && p->num_back_jobs < p->back_threads) {
+        if (!p->packet.type) {
+            p->packet = mp_pin_out_read(p->demux);
+            if (!p->packet.type)
+                return;
+        }
+
+        if (p->packet.type == MP_FRAME_EOF) {
+            p->packet = MP_NO_FRAME;
+            p->back_eof = true;
+        } else if (p->packet.type != MP_FRAME_PACKET) {
+            MP_ERR(p, "invalid frame type from demuxer\n");
+            mp_frame_unref(&p->packet);
+            mp_filter_internal_mark_failed(p->decf);
+            return;
+        }
+
+        struct demux_packet *pkt = p->packet.data;
+
+        if (p->back_fill && pkt && p->back_fill->num_packets &&
+            (pkt->back_restart || (pkt->segmented &&
+             (pkt->start != p->back_fill->start ||
+              pkt->end != p->back_fill->end ||
+              pkt->codec != p->back_fill->orig_codec))))
+        {
+            submit_back_job(p);
+            continue;
+        }
+
+        if (!p->back_fill)
+            p->back_fill = new_back_job(p, pkt);
+        struct back_job *job = p->back_fill;
+
+        if (pkt) {
+            if (pkt->dts == MP_NOPTS_VALUE && !job->codec->avi_dts)
+                pkt->dts = pkt->pts;
+            if (pkt->back_preroll) {
+                job->preroll = true;
+                pkt->pts = pkt->dts = MP_NOPTS_VALUE;
+            }
+            MP_TARRAY_APPEND(job, job->packets, job->num_packets, pkt);
+            p->packet = MP_NO_FRAME;
+        } else {
+            job->eof = true;
+            submit_back_job(p);
+        }
+    }
+}
+
+// Move the frames of the oldest finished job to the reversal queue, and
+// output them (in reverse) like with normal backward decoding.
+static void read_back_job(struct priv *p)
+{
+    struct mp_pin *pin = p->decf->ppins[0];
+    if (!mp_pin_in_needs_data(pin))
+        return;
+
+    if (p->reverse_queue_complete && p->num_reverse_queue) {
+        struct mp_frame frame = p->reverse_queue[p->num_reverse_queue - 1];
+        p->num_reverse_queue -= 1;
+        process_output_frame(p, frame);
+        mp_pin_in_write(pin, frame);
+        return;
+    }
+    p->reverse_queue_complete = false;
+
+    if (!p->num_back_jobs)
+        return;
+    struct back_job *job = p->back_jobs[0];
+    mp_mutex_lock(&p->back_lock);
+    bool done = job->done;
+    mp_mutex_unlock(&p->back_lock);
+    if (!done)
+        return;
+    MP_TARRAY_REMOVE_AT(p->back_jobs, p->num_back_jobs, 0);
+
+    if (job->overflow)
+        MP_ERR(p, "Reversal queue overflow, discarding frames.\n");
+
+    // Each job is a separate decoding run, as with a segment change.
+    p->codec_pts = p->codec_dts = MP_NOPTS_VALUE;
+    p->num_codec_pts_problems = p->num_codec_dts_problems = 0;
+    p->has_broken_decoded_pts = 0;
+    p->start = job->start;
+    p->end = job->end;
+    p->preroll_discard = job->preroll;
+    p->reverse_queue_byte_size = 0;
+
+    for (int n = 0; n < job->num_frames; n++) {
+        struct mp_frame frame = job->frames[n];
+        job->frames[n] = MP_NO_FRAME;
+        if (p->preroll_discard) {
+            if (mp_frame_get_pts(frame) == MP_NOPTS_VALUE) {
+                mp_frame_unref(&frame);
+                continue;
+            }
+            p->preroll_discard = false;
+        }
+        process_decoded_frame(p, &frame);
+        if (frame.type)
+            enqueue_backward_frame(p, frame);
+    }
+    if (job->eof)
+        enqueue_backward_frame(p, MP_EOF_FRAME);
+    p->reverse_queue_complete = true;
+
+    free_back_job(job);
+    mp_filter_internal_mark_progress(p->decf);
+}
+
 static void read_frame(struct priv *p)
 {
     struct mp_pin *pin = p->decf->ppins[0];
@@ -1183,6 +1557,15 @@ static void decf_process(struct mp_filter *f)
     if (m_config_cache_update(p->opt_cache))
         update_queue_config(p);
 
+    if (p->back_threads < 0)
+        p->back_threads = get_back_threads(p);
+
+    if (p->back_threads > 0) {
+        feed_back_jobs(p);
+        read_back_job(p);
+        return;
+    }
+
     feed_packet(p);
     read_frame(p);
 }
@@ -1242,6 +1625,7 @@ static void public_f_destroy(struct mp_filter *f)
     talloc_free(p->dec_root_filter);
     talloc_free(p->queue);
     mp_mutex_destroy(&p->cache_lock);
+    mp_mutex_destroy(&p->back_lock);
 }
 
 static const struct mp_filter_info decf_filter = {
@@ -1358,6 +1742,7 @@ struct mp_decoder_wrapper *mp_decoder_wrapper_create(struct mp_filter *parent,
     p->public.f = public_f;
 
     mp_mutex_init(&p->cache_lock);
+    mp_mutex_init(&p->back_lock);
     p->opt_cache = m_config_cache_alloc(p, public_f->global, &dec_wrapper_conf);
     p->opts = p->opt_cache->opts;
     p->header = src;
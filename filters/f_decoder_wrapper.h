@@ -81,6 +81,8 @@ enum dec_ctrl {
     // int*: extra hw surfaces retained
     VDCTRL_SET_EXTRA_HW_FRAMES,
     VDCTRL_CHECK_FORCED_EOF,
+    // int*: decoded frames waiting in the decoder thread's output queue
+    VDCTRL_SET_QUEUED_FRAMES,
 };
 
 int mp_decoder_wrapper_control(struct mp_decoder_wrapper *d,
@@ -1,3 +1,5 @@
+#include <float.h>
+
 #include "audio/aframe.h"
 #include "audio/out/ao.h"
 #include "common/global.h"
@@ -13,9 +15,76 @@
 #include "f_enhancement_pair.h"
 #include "f_lavfi.h"
 #include "f_output_chain.h"
+#include "f_thread_graph.h"
 #include "f_utils.h"
 #include "user_filters.h"
 
+struct filter_queue_opts {
+    bool use_thread;
+    int64_t max_bytes;
+    int64_t max_samples;
+    double max_duration;
+};
+
+#define OPT_BASE_STRUCT struct filter_queue_opts
+
+static const struct m_sub_options af_queue_conf = {
+    .opts = (const struct m_option[]){
+        {"enable", OPT_BOOL(use_thread)},
+        {"max-secs", OPT_DOUBLE(max_duration), M_RANGE(0, DBL_MAX)},
+        {"max-bytes", OPT_BYTE_SIZE(max_bytes), M_RANGE(0, M_MAX_MEM_BYTES)},
+        {"max-samples", OPT_INT64(max_samples), M_RANGE(0, DBL_MAX)},
+        {0}
+    },
+    .size = sizeof(struct filter_queue_opts),
+    .defaults = &(const struct filter_queue_opts){
+        .max_bytes = 1 * 1024 * 1024,
+        .max_samples = 4096,
+        .max_duration = 0.1,
+    },
+};
+
+static const struct m_sub_options vf_queue_conf = {
+    .opts = (const struct m_option[]){
+        {"enable", OPT_BOOL(use_thread)},
+        {"max-secs", OPT_DOUBLE(max_duration), M_RANGE(0, DBL_MAX)},
+        {"max-bytes", OPT_BYTE_SIZE(max_bytes), M_RANGE(0, M_MAX_MEM_BYTES)},
+        {"max-samples", OPT_INT64(max_samples), M_RANGE(0, DBL_MAX)},
+        {0}
+    },
+    .size = sizeof(struct filter_queue_opts),
+    .defaults = &(const struct filter_queue_opts){
+        .max_bytes = 64 * 1024 * 1024,
+        .max_samples = 3,
+    },
+};
+
+#undef OPT_BASE_STRUCT
+#define OPT_BASE_STRUCT struct output_chain_opts
+
+struct output_chain_opts {
+    struct filter_queue_opts *af_queue_opts;
+    struct filter_queue_opts *vf_queue_opts;
+};
+
+const struct m_sub_options output_chain_conf = {
+    .opts = (const struct m_option[]){
+        {"af-queue", OPT_SUBSTRUCT(af_queue_opts, af_queue_conf)},
+        {"vf-queue", OPT_SUBSTRUCT(vf_queue_opts, vf_queue_conf)},
+        {0}
+    },
+    .size = sizeof(struct output_chain_opts),
+};
+
+#undef OPT_BASE_STRUCT
+
+// A part of the user filter list that runs on a separate thread. The sub-graph
+// is represented by wrapper in the main filter list.
+struct filter_stage {
+    struct mp_thread_graph *thread;
+    struct mp_user_filter *wrapper;
+};
+
 struct chain {
     struct mp_filter *f;
     struct mp_log *log;
@@ -52,6 +121,15 @@ struct chain {
     struct vo *vo;
     struct ao *ao;
 
+    struct m_config_cache *opt_cache;
+    struct filter_queue_opts *queue_opts;
+
+    // Threads the user filters run on, in filter list order. User filters
+    // before the first stage run on the chain's own thread.
+    struct filter_stage **stages;
+    int num_stages;
+    bool stages_locked;
+
     struct mp_output_chain public;
 };
 
@@ -79,6 +157,9 @@ struct mp_user_filter {
     bool failed;
     bool error_eof_sent;
     bool in_eof;
+
+    struct filter_stage *stage; // user filter on this thread, or NULL
+    bool on_thread; // part of a stage, must not touch chain state
 };
 
 static void update_output_caps(struct chain *p)
@@ -128,7 +209,8 @@ static void check_in_format_change(struct mp_user_filter *u,
                 if (strcmp(u->name, "convert") == 0)
                     update_output_caps(p);
 
-                p->public.reconfig_happened = true;
+                if (!u->on_thread)
+                    p->public.reconfig_happened = true;
             }
             u->last_in_vformat = img->params;
         }
@@ -148,7 +230,8 @@ static void check_in_format_change(struct mp_user_filter *u,
                 mp_aframe_config_copy(p->public.output_aformat, aframe);
             }
 
-            p->public.reconfig_happened = true;
+            if (!u->on_thread)
+                p->public.reconfig_happened = true;
         }
     }
 }
@@ -254,14 +337,17 @@ static const struct mp_filter_info user_wrapper_filter = {
     .destroy = user_wrapper_destroy,
 };
 
-static struct mp_user_filter *create_wrapper_filter(struct chain *p)
+// parent is p->f, or the root of a stage thread for filters running on it.
+static struct mp_user_filter *create_wrapper_filter(struct chain *p,
+                                                    struct mp_filter *parent)
 {
-    struct mp_filter *f = mp_filter_create(p->f, &user_wrapper_filter);
+    struct mp_filter *f = mp_filter_create(parent, &user_wrapper_filter);
     if (!f)
         abort();
     struct mp_user_filter *wrapper = f->priv;
     wrapper->wrapper = f;
     wrapper->p = p;
+    wrapper->on_thread = parent != p->f;
     wrapper->last_in_aformat = talloc_steal(wrapper, mp_aframe_create());
     wrapper->last_is_active = true;
     mp_filter_add_pin(f, MP_PIN_IN, "in");
@@ -269,13 +355,108 @@ static struct mp_user_filter *create_wrapper_filter(struct chain *p)
     return wrapper;
 }
 
+// Lock/unlock the threads the user filters run on, if any.
+static void thread_lock(struct chain *p)
+{
+    mp_assert(!p->stages_locked);
+    for (int n = 0; n < p->num_stages; n++)
+        mp_thread_graph_lock(p->stages[n]->thread);
+    p->stages_locked = true;
+}
+
+static void thread_unlock(struct chain *p)
+{
+    mp_assert(p->stages_locked);
+    for (int n = p->num_stages - 1; n >= 0; n--)
+        mp_thread_graph_unlock(p->stages[n]->thread);
+    p->stages_locked = false;
+}
+
+static struct mp_async_queue_config get_queue_config(struct chain *p)
+{
+    return (struct mp_async_queue_config){
+        .max_bytes = p->queue_opts->max_bytes,
+        .sample_unit = p->type == MP_OUTPUT_CHAIN_AUDIO ? AQUEUE_UNIT_SAMPLES
+                                                        : AQUEUE_UNIT_FRAME,
+        .max_samples = p->queue_opts->max_samples,
+        .max_duration = p->queue_opts->max_duration,
+    };
+}
+
+// Return the n-th stage, creating it and the stages before it if needed.
+// Must be called with thread_lock() held.
+static struct filter_stage *get_stage(struct chain *p, int n)
+{
+    while (p->num_stages <= n) {
+        int index = p->num_stages;
+        const char *type = p->type == MP_OUTPUT_CHAIN_AUDIO ? "audio" : "video";
+        struct filter_stage *stage = talloc_zero(p, struct filter_stage);
+        // The wrapper measures the delay of the thread including its queues,
+        // so mp_output_get_measured_total_delay() accounts for it.
+        stage->wrapper = create_wrapper_filter(p, p->f);
+        stage->wrapper->name = talloc_asprintf(stage->wrapper, "%s-thread%d",
+                                               type, index + 1);
+        char *name = index ? mp_tprintf(16, "filter/%s%d", type, index + 1)
+                           : mp_tprintf(16, "filter/%s", type);
+        stage->thread = mp_thread_graph_create(stage->wrapper->wrapper, name,
+                                               get_queue_config(p));
+        if (!stage->thread)
+            abort();
+        stage->wrapper->f = stage->thread->f;
+        mp_thread_graph_lock(stage->thread);
+        MP_TARRAY_APPEND(p, p->stages, p->num_stages, stage);
+    }
+    return p->stages[n];
+}
+
+// Destroy the stages from index n on. Their user filters must have been freed.
+// Must be called with thread_lock() held.
+static void remove_stages(struct chain *p, int n)
+{
+    while (p->num_stages > n) {
+        struct filter_stage *stage = p->stages[p->num_stages - 1];
+        p->num_stages--;
+        mp_thread_graph_unlock(stage->thread);
+        talloc_free(stage->wrapper->wrapper);
+        talloc_free(stage);
+    }
+}
+
 // Rebuild p->all_filters and relink the filters. Non-destructive if no change.
+// If the user filters run on a thread, the caller must hold thread_lock().
 static void relink_filter_list(struct chain *p)
 {
     struct mp_user_filter **all_filters[3] =
         {p->pre_filters, p->user_filters, p->post_filters};
     int all_filters_num[3] =
         {p->num_pre_filters, p->num_user_filters, p->num_post_filters};
+
+    // Filters on the chain's thread come first, then one entry per stage,
+    // which contains the rest of the filters.
+    struct mp_user_filter **user = NULL;
+    int num_user = 0;
+    for (int n = 0; n < p->num_user_filters; n++) {
+        if (!p->user_filters[n]->stage)
+            MP_TARRAY_APPEND(p, user, num_user, p->user_filters[n]);
+    }
+    for (int i = 0; i < p->num_stages; i++) {
+        struct filter_stage *stage = p->stages[i];
+        struct mp_filter **filters = NULL;
+        int num_filters = 0;
+        for (int n = 0; n < p->num_user_filters; n++) {
+            if (p->user_filters[n]->stage == stage) {
+                MP_TARRAY_APPEND(NULL, filters, num_filters,
+                                 p->user_filters[n]->wrapper);
+            }
+        }
+        mp_chain_filters(stage->thread->in, stage->thread->out, filters,
+                         num_filters);
+        talloc_free(filters);
+        MP_TARRAY_APPEND(p, user, num_user, stage->wrapper);
+    }
+    all_filters[1] = user;
+    all_filters_num[1] = num_user;
+
     p->num_all_filters = 0;
     for (int n = 0; n < 3; n++) {
         struct mp_user_filter **filters = all_filters[n];
@@ -284,6 +465,8 @@ static void relink_filter_list(struct chain *p)
             MP_TARRAY_APPEND(p, p->all_filters, p->num_all_filters, filters[i]);
     }
 
+    talloc_free(user);
+
     mp_assert(p->num_all_filters > 0);
 
     p->filters_in = NULL;
@@ -302,6 +485,11 @@ static void output_chain_process(struct mp_filter *f)
 {
     struct chain *p = f->priv;
 
+    if (m_config_cache_update(p->opt_cache)) {
+        for (int n = 0; n < p->num_stages; n++)
+            mp_thread_graph_set_config(p->stages[n]->thread, get_queue_config(p));
+    }
+
     if (mp_pin_can_transfer_data(p->filters_in, f->ppins[0])) {
         struct mp_frame frame = mp_pin_out_read(f->ppins[0]);
 
@@ -336,6 +524,13 @@ static void output_chain_reset(struct mp_filter *f)
     p->public.got_output_eof = false;
 }
 
+static void reset_filter_state(struct mp_user_filter *u)
+{
+    u->failed = false;
+    u->last_in_vformat = (struct mp_image_params){0};
+    mp_aframe_reset(u->last_in_aformat);
+}
+
 void mp_output_chain_reset_harder(struct mp_output_chain *c)
 {
     struct chain *p = c->f->priv;
@@ -343,13 +538,13 @@ void mp_output_chain_reset_harder(struct mp_output_chain *c)
     mp_filter_reset(p->f);
 
     p->public.failed_output_conversion = false;
-    for (int n = 0; n < p->num_all_filters; n++) {
-        struct mp_user_filter *u = p->all_filters[n];
+    for (int n = 0; n < p->num_all_filters; n++)
+        reset_filter_state(p->all_filters[n]);
 
-        u->failed = false;
-        u->last_in_vformat = (struct mp_image_params){0};
-        mp_aframe_reset(u->last_in_aformat);
-    }
+    thread_lock(p);
+    for (int n = 0; n < p->num_user_filters; n++)
+        reset_filter_state(p->user_filters[n]);
+    thread_unlock(p);
 
     if (p->type == MP_OUTPUT_CHAIN_AUDIO) {
         p->ao = NULL;
@@ -422,7 +617,7 @@ void mp_output_chain_set_el_stream(struct mp_output_chain *c,
     }
 
     if (el_sh) {
-        struct mp_user_filter *u = create_wrapper_filter(p);
+        struct mp_user_filter *u = create_wrapper_filter(p, p->f);
         u->name = "el_pair";
         u->f = mp_enhancement_pair_create(u->wrapper, el_sh);
         if (!u->f) {
@@ -435,7 +630,9 @@ void mp_output_chain_set_el_stream(struct mp_output_chain *c,
         }
     }
 
+    thread_lock(p);
     relink_filter_list(p);
+    thread_unlock(p);
 }
 
 void mp_output_chain_set_ao(struct mp_output_chain *c, struct ao *ao)
@@ -507,8 +704,10 @@ bool mp_output_chain_command(struct mp_output_chain *c, const char *target,
 
     if (strcmp(target, "all") == 0 && cmd->type == MP_FILTER_COMMAND_TEXT) {
         // (Following old semantics.)
+        thread_lock(p);
         for (int n = 0; n < p->num_user_filters; n++)
             mp_filter_command(p->user_filters[n]->f, cmd);
+        thread_unlock(p);
         return true;
     }
 
@@ -516,7 +715,10 @@ bool mp_output_chain_command(struct mp_output_chain *c, const char *target,
     if (!f)
         return false;
 
-    return mp_filter_command(f->f, cmd);
+    thread_lock(p);
+    bool res = mp_filter_command(f->f, cmd);
+    thread_unlock(p);
+    return res;
 }
 
 // Set the speed on the last filter in the chain that supports it. If a filter
@@ -547,12 +749,14 @@ void mp_output_chain_set_audio_speed(struct mp_output_chain *c,
 
     // If users have filters like "scaletempo" insert anywhere, use that,
     // otherwise use the builtin ones.
+    thread_lock(p);
     set_speed_any(p->user_filters, p->num_user_filters,
                   MP_FILTER_COMMAND_SET_SPEED, &speed);
-    set_speed_any(p->post_filters, p->num_post_filters,
-                  MP_FILTER_COMMAND_SET_SPEED, &speed);
     set_speed_any(p->user_filters, p->num_user_filters,
                   MP_FILTER_COMMAND_SET_SPEED_DROP, &drop);
+    thread_unlock(p);
+    set_speed_any(p->post_filters, p->num_post_filters,
+                  MP_FILTER_COMMAND_SET_SPEED, &speed);
     set_speed_any(p->post_filters, p->num_post_filters,
                   MP_FILTER_COMMAND_SET_SPEED_DROP, &drop);
 }
@@ -598,16 +802,36 @@ bool mp_output_chain_update_filters(struct mp_output_chain *c,
     int num_res = 0;
     bool *used = talloc_zero_array(NULL, bool, p->num_user_filters);
 
+    thread_lock(p);
+
+    // Index of the stage the next filters run on, -1 for the chain's thread.
+    int stage_index = p->queue_opts->use_thread ? 0 : -1;
+    int num_stages = 0;
+
     for (int n = 0; list && list[n].name; n++) {
         struct m_obj_settings *entry = &list[n];
 
         if (!entry->enabled)
             continue;
 
+        if (strcmp(entry->name, MP_USER_FILTER_THREAD) == 0) {
+            // Don't create empty stages.
+            if (stage_index < 0 || num_stages > stage_index)
+                stage_index++;
+            continue;
+        }
+
+        struct filter_stage *stage = NULL;
+        if (stage_index >= 0) {
+            stage = get_stage(p, stage_index);
+            num_stages = stage_index + 1;
+        }
+
         struct mp_user_filter *u = NULL;
 
         for (int i = 0; i < p->num_user_filters; i++) {
-            if (!used[i] && m_obj_settings_equal(entry, p->user_filters[i]->args))
+            if (!used[i] && p->user_filters[i]->stage == stage &&
+                m_obj_settings_equal(entry, p->user_filters[i]->args))
             {
                 u = p->user_filters[i];
                 used[i] = true;
@@ -616,7 +840,8 @@ bool mp_output_chain_update_filters(struct mp_output_chain *c,
         }
 
         if (!u) {
-            u = create_wrapper_filter(p);
+            u = create_wrapper_filter(p, stage ? stage->thread->root : p->f);
+            u->stage = stage;
             u->name = talloc_strdup(u, entry->name);
             u->label = talloc_strdup(u, entry->label);
             u->f = mp_create_user_filter(u->wrapper, p->type, entry->name,
@@ -648,8 +873,12 @@ bool mp_output_chain_update_filters(struct mp_output_chain *c,
     p->user_filters = res;
     p->num_user_filters = num_res;
 
+    remove_stages(p, num_stages);
+
     relink_filter_list(p);
 
+    thread_unlock(p);
+
     for (int n = 0; n < p->num_user_filters; n++) {
         struct mp_user_filter *u = p->user_filters[n];
         if (u->generated_label)
@@ -669,7 +898,8 @@ bool mp_output_chain_update_filters(struct mp_output_chain *c,
     MP_VERBOSE(p, "User filter list:\n");
     for (int n = 0; n < p->num_user_filters; n++) {
         struct mp_user_filter *u = p->user_filters[n];
-        MP_VERBOSE(p, "  %s (%s)\n", u->name, u->label ? u->label : "-");
+        MP_VERBOSE(p, "  %s (%s)%s\n", u->name, u->label ? u->label : "-",
+                   u->stage ? mp_tprintf(20, " [%s]", u->stage->wrapper->name) : "");
     }
     if (!p->num_user_filters)
         MP_VERBOSE(p, "  (empty)\n");
@@ -686,6 +916,17 @@ bool mp_output_chain_update_filters(struct mp_output_chain *c,
 error:
     for (int n = 0; n < num_add; n++)
         talloc_free(add[n]->wrapper);
+    // Drop stages that were created for the new list only.
+    int old_stages = 0;
+    for (int n = 0; n < p->num_user_filters; n++) {
+        for (int i = 0; i < p->num_stages; i++) {
+            if (p->user_filters[n]->stage == p->stages[i])
+                old_stages = MPMAX(old_stages, i + 1);
+        }
+    }
+    remove_stages(p, old_stages);
+    relink_filter_list(p);
+    thread_unlock(p);
     talloc_free(add);
     talloc_free(used);
     return false;
@@ -701,21 +942,21 @@ static void create_video_things(struct chain *p)
 
     p->f->stream_info = &p->stream_info;
 
-    struct mp_user_filter *f = create_wrapper_filter(p);
+    struct mp_user_filter *f = create_wrapper_filter(p, p->f);
     f->name = "userdeint";
     f->f = mp_deint_create(f->wrapper);
     if (!f->f)
         abort();
     MP_TARRAY_APPEND(p, p->pre_filters, p->num_pre_filters, f);
 
-    f = create_wrapper_filter(p);
+    f = create_wrapper_filter(p, p->f);
     f->name = "autovflip";
     f->f = mp_autovflip_create(f->wrapper);
     if (!f->f)
         abort();
     MP_TARRAY_APPEND(p, p->post_filters, p->num_post_filters, f);
 
-    f = create_wrapper_filter(p);
+    f = create_wrapper_filter(p, p->f);
     f->name = "autorotate";
     f->f = mp_autorotate_create(f->wrapper);
     if (!f->f)
@@ -727,7 +968,7 @@ static void create_audio_things(struct chain *p)
 {
     p->frame_type = MP_FRAME_AUDIO;
 
-    struct mp_user_filter *f = create_wrapper_filter(p);
+    struct mp_user_filter *f = create_wrapper_filter(p, p->f);
     f->name = "userspeed";
     f->f = mp_autoaspeed_create(f->wrapper);
     if (!f->f)
@@ -757,6 +998,10 @@ struct mp_output_chain *mp_output_chain_create(struct mp_filter *parent,
     p->f = f;
     p->log = f->log;
     p->type = type;
+    p->opt_cache = m_config_cache_alloc(p, f->global, &output_chain_conf);
+    struct output_chain_opts *opts = p->opt_cache->opts;
+    p->queue_opts = type == MP_OUTPUT_CHAIN_AUDIO ? opts->af_queue_opts
+                                                  : opts->vf_queue_opts;
 
     struct mp_output_chain *c = &p->public;
     c->f = f;
@@ -764,7 +1009,7 @@ struct mp_output_chain *mp_output_chain_create(struct mp_filter *parent,
     c->output_aformat = talloc_steal(p, mp_aframe_create());
 
     // Dummy filter for reporting and logging the input format.
-    p->input = create_wrapper_filter(p);
+    p->input = create_wrapper_filter(p, p->f);
     p->input->f = mp_bidir_nop_filter_create(p->input->wrapper);
     if (!p->input->f)
         abort();
@@ -776,7 +1021,7 @@ struct mp_output_chain *mp_output_chain_create(struct mp_filter *parent,
     case MP_OUTPUT_CHAIN_AUDIO: create_audio_things(p); break;
     }
 
-    p->convert_wrapper = create_wrapper_filter(p);
+    p->convert_wrapper = create_wrapper_filter(p, p->f);
     p->convert = mp_autoconvert_create(p->convert_wrapper->wrapper);
     if (!p->convert)
         abort();
@@ -790,14 +1035,16 @@ struct mp_output_chain *mp_output_chain_create(struct mp_filter *parent,
     }
 
     // Dummy filter for reporting and logging the output format.
-    p->output = create_wrapper_filter(p);
+    p->output = create_wrapper_filter(p, p->f);
     p->output->f = mp_bidir_nop_filter_create(p->output->wrapper);
     if (!p->output->f)
         abort();
     p->output->name = "out";
     MP_TARRAY_APPEND(p, p->post_filters, p->num_post_filters, p->output);
 
+    thread_lock(p);
     relink_filter_list(p);
+    thread_unlock(p);
 
     output_chain_reset(f);
 
@@ -26,6 +26,7 @@
 #include "audio/chmap_avchannel.h"
 #include "audio/fmt-conversion.h"
 #include "audio/format.h"
+#include "audio/sample_conv.h"
 #include "common/common.h"
 #include "common/av_common.h"
 #include "common/msg.h"
@@ -42,9 +43,12 @@ struct priv {
     struct mp_aframe *avrctx_fmt; // output format of avrctx
     struct mp_aframe *pool_fmt; // format used to allocate frames for avrctx output
     struct mp_aframe *pre_out_fmt; // format before final conversion
-    struct SwrContext *avrctx_out; // for output channel reordering
     struct mp_resample_opts *opts; // opts requested by the user
     int reorder_out[MP_NUM_CHANNELS];
+    // If set, the conversion is done with mp_sconv_convert() instead of
+    // avrctx, as long as no resampling is needed.
+    bool direct_conv;
+    int reorder_in[MP_NUM_CHANNELS];
     struct mp_aframe_pool *reorder_buffer;
     struct mp_aframe_pool *out_pool;
 
@@ -95,7 +99,6 @@ static int get_out_samples(struct priv *p, int in_samples)
 static void close_lavrr(struct priv *p)
 {
     swr_free(&p->avrctx);
-    swr_free(&p->avrctx_out);
 
     TA_FREEP(&p->pre_out_fmt);
     TA_FREEP(&p->avrctx_fmt);
@@ -120,8 +123,7 @@ static bool configure_lavrr(struct priv *p, bool verbose)
                af_fmt_to_str(p->out_format));
 
     p->avrctx = swr_alloc();
-    p->avrctx_out = swr_alloc();
-    if (!p->avrctx || !p->avrctx_out)
+    if (!p->avrctx)
         goto error;
 
     enum AVSampleFormat in_samplefmt = af_to_avformat(p->in_format);
@@ -228,19 +230,20 @@ static bool configure_lavrr(struct priv *p, bool verbose)
     av_opt_set_int(p->avrctx, "in_sample_fmt",      in_samplefmt, 0);
     av_opt_set_int(p->avrctx, "out_sample_fmt",     out_samplefmtp, 0);
 
-    AVChannelLayout fake_layout;
-    av_channel_layout_default(&fake_layout, map_out.num);
-    av_opt_set_chlayout(p->avrctx_out, "in_chlayout", &fake_layout, 0);
-    av_opt_set_chlayout(p->avrctx_out, "out_chlayout", &fake_layout, 0);
-    av_channel_layout_uninit(&fake_layout);
-    av_opt_set_int(p->avrctx_out, "in_sample_fmt",      out_samplefmtp, 0);
-    av_opt_set_int(p->avrctx_out, "out_sample_fmt",     out_samplefmt, 0);
-    av_opt_set_int(p->avrctx_out, "in_sample_rate",     p->out_rate, 0);
-    av_opt_set_int(p->avrctx_out, "out_sample_rate",    p->out_rate, 0);
+    // Without resampling and remixing, only the sample format and the channel
+    // order change, which is done directly. User options might change the
+    // result (e.g. dithering), so leave it to libswresample then.
+    p->direct_conv = p->in_rate == p->out_rate &&
+                     mp_chmap_equals_reordered(&map_in, &map_out) &&
+                     mp_sconv_can_convert(p->out_format, p->in_format) &&
+                     !(p->opts->avopts && p->opts->avopts[0]);
+    mp_chmap_get_reorder(p->reorder_in, &map_in, &map_out);
+    if (p->direct_conv && verbose)
+        MP_VERBOSE(p, "Using direct conversion.\n");
 
     p->is_resampling = false;
 
-    if (swr_init(p->avrctx) < 0 || swr_init(p->avrctx_out) < 0) {
+    if (swr_init(p->avrctx) < 0) {
         MP_ERR(p, "Cannot open Libavresample context.\n");
         goto error;
     }
@@ -322,6 +325,40 @@ static int resample_frame(struct SwrContext *r,
         av_i ? MPMIN(av_i->nb_samples, consume_in) : 0);
 }
 
+// Convert the input without libswresample (see direct_conv). avrctx was not
+// used since it was configured, so there is no delay.
+static struct mp_frame filter_direct_output(struct priv *p,
+                                            struct mp_aframe *in, int samples)
+{
+    if (!samples)
+        return MP_NO_FRAME;
+
+    struct mp_aframe *out = mp_aframe_create();
+    mp_aframe_config_copy(out, p->pre_out_fmt);
+    if (mp_aframe_pool_allocate(p->reorder_buffer, out, samples) < 0) {
+        talloc_free(out);
+        MP_ERR(p, "Error on resampling.\n");
+        mp_filter_internal_mark_failed(p->public.f);
+        return MP_NO_FRAME;
+    }
+
+    mp_sconv_convert(mp_aframe_get_data_rw(out), p->out_format,
+                     mp_aframe_get_data_ro(in), p->in_format,
+                     p->reorder_in, p->out_channels.num, samples);
+
+    mp_aframe_copy_attributes(out, in);
+    p->current_pts = mp_aframe_end_pts(in);
+    mp_aframe_skip_samples(in, samples);
+    if (p->current_pts != MP_NOPTS_VALUE) {
+        double delay = mp_aframe_duration(out) +
+                       (p->input ? mp_aframe_duration(p->input) : 0);
+        mp_aframe_set_pts(out, p->current_pts - delay);
+        mp_aframe_mul_speed(out, p->speed);
+    }
+
+    return MAKE_FRAME(MP_FRAME_AUDIO, out);
+}
+
 static struct mp_frame filter_resample_output(struct priv *p,
                                               struct mp_aframe *in)
 {
@@ -338,6 +375,9 @@ static struct mp_frame filter_resample_output(struct priv *p,
     int consume_in = in ? mp_aframe_get_size(in) : 0;
     consume_in = MPMIN(consume_in, max_in);
 
+    if (p->direct_conv && !p->is_resampling)
+        return filter_direct_output(p, in, consume_in);
+
     int samples = get_out_samples(p, consume_in);
     out = mp_aframe_create();
     mp_aframe_config_copy(out, p->pool_fmt);
@@ -365,13 +405,14 @@ static struct mp_frame filter_resample_output(struct priv *p,
             talloc_free(new);
             goto error;
         }
-        int got = 0;
-        if (out_samples)
-            got = resample_frame(p->avrctx_out, new, out, out_samples);
+        if (out_samples) {
+            mp_sconv_convert(mp_aframe_get_data_rw(new), p->out_format,
+                             mp_aframe_get_data_ro(out),
+                             mp_aframe_get_format(out), NULL,
+                             p->out_channels.num, out_samples);
+        }
         talloc_free(out);
         out = new;
-        if (got != out_samples)
-            goto error;
     }
 
     if (in) {
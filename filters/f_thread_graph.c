@@ -0,0 +1,170 @@
+#include <math.h>
+
+#include "common/common.h"
+#include "common/msg.h"
+#include "misc/dispatch.h"
+#include "osdep/threads.h"
+
+#include "f_thread_graph.h"
+#include "filter_internal.h"
+
+struct priv {
+    struct mp_thread_graph public;
+    char *name;
+    struct mp_async_queue *q_in, *q_out;
+    struct mp_dispatch_queue *dispatch;
+    mp_thread thread;
+    bool thread_valid;
+    bool terminate; // set with the thread locked
+    bool locked;    // debugging
+};
+
+static MP_THREAD_VOID graph_thread(void *ptr)
+{
+    struct priv *p = ptr;
+
+    mp_thread_set_name(p->name);
+
+    while (!p->terminate) {
+        mp_filter_graph_run(p->public.root);
+        mp_dispatch_queue_process(p->dispatch, INFINITY);
+    }
+
+    MP_THREAD_RETURN();
+}
+
+void mp_thread_graph_lock(struct mp_thread_graph *g)
+{
+    struct priv *p = g->f->priv;
+
+    mp_dispatch_lock(p->dispatch);
+    mp_assert(!p->locked);
+    p->locked = true;
+}
+
+void mp_thread_graph_unlock(struct mp_thread_graph *g)
+{
+    struct priv *p = g->f->priv;
+
+    mp_assert(p->locked);
+    p->locked = false;
+    mp_dispatch_unlock(p->dispatch);
+}
+
+void mp_thread_graph_set_config(struct mp_thread_graph *g,
+                                struct mp_async_queue_config cfg)
+{
+    struct priv *p = g->f->priv;
+
+    mp_async_queue_set_config(p->q_in, cfg);
+    mp_async_queue_set_config(p->q_out, cfg);
+}
+
+static void thread_graph_reset(struct mp_filter *f)
+{
+    struct priv *p = f->priv;
+
+    // The access filters in the parent graph were already reset, as they are
+    // children of f.
+    mp_async_queue_reset(p->q_in);
+    mp_async_queue_reset(p->q_out);
+    mp_thread_graph_lock(&p->public);
+    mp_filter_reset(p->public.root);
+    mp_dispatch_interrupt(p->dispatch);
+    mp_thread_graph_unlock(&p->public);
+    mp_async_queue_resume(p->q_in);
+    mp_async_queue_resume(p->q_out);
+}
+
+static void thread_graph_destroy(struct mp_filter *f)
+{
+    struct priv *p = f->priv;
+
+    if (p->thread_valid) {
+        mp_thread_graph_lock(&p->public);
+        p->terminate = true;
+        mp_dispatch_interrupt(p->dispatch);
+        mp_thread_graph_unlock(&p->public);
+        mp_thread_join(p->thread);
+        p->thread_valid = false;
+    }
+
+    mp_filter_free_children(f);
+
+    talloc_free(p->public.root);
+    talloc_free(p->q_in);
+    talloc_free(p->q_out);
+}
+
+static const struct mp_filter_info thread_graph_filter = {
+    .name = "thread_graph",
+    .priv_size = sizeof(struct priv),
+    .reset = thread_graph_reset,
+    .destroy = thread_graph_destroy,
+};
+
+static void wakeup_thread(void *ptr)
+{
+    struct priv *p = ptr;
+
+    mp_dispatch_interrupt(p->dispatch);
+}
+
+static void onlock_thread(void *ptr)
+{
+    struct priv *p = ptr;
+
+    mp_filter_graph_interrupt(p->public.root);
+}
+
+struct mp_thread_graph *mp_thread_graph_create(struct mp_filter *parent,
+                                               const char *name,
+                                               struct mp_async_queue_config cfg)
+{
+    struct mp_filter *f = mp_filter_create(parent, &thread_graph_filter);
+    if (!f)
+        return NULL;
+
+    struct priv *p = f->priv;
+    p->public.f = f;
+    p->name = talloc_strdup(p, name);
+
+    mp_filter_add_pin(f, MP_PIN_IN, "in");
+    mp_filter_add_pin(f, MP_PIN_OUT, "out");
+
+    p->q_in = mp_async_queue_create();
+    p->q_out = mp_async_queue_create();
+    mp_thread_graph_set_config(&p->public, cfg);
+
+    p->dispatch = mp_dispatch_create(p);
+    p->public.root = mp_filter_create_root(f->global);
+    p->public.root->stream_info = mp_filter_find_stream_info(parent);
+    mp_filter_graph_set_wakeup_cb(p->public.root, wakeup_thread, p);
+    mp_dispatch_set_onlock_fn(p->dispatch, onlock_thread, p);
+
+    // Parent graph side.
+    struct mp_filter *w_in = mp_async_queue_create_filter(f, MP_PIN_IN, p->q_in);
+    struct mp_filter *r_out = mp_async_queue_create_filter(f, MP_PIN_OUT, p->q_out);
+    mp_pin_connect(w_in->pins[0], f->ppins[0]);
+    mp_pin_connect(f->ppins[1], r_out->pins[0]);
+
+    // Thread side.
+    struct mp_filter *r_in =
+        mp_async_queue_create_filter(p->public.root, MP_PIN_OUT, p->q_in);
+    struct mp_filter *w_out =
+        mp_async_queue_create_filter(p->public.root, MP_PIN_IN, p->q_out);
+    p->public.in = r_in->pins[0];
+    p->public.out = w_out->pins[0];
+    mp_pin_connect(p->public.out, p->public.in);
+
+    p->thread_valid = true;
+    if (mp_thread_create(&p->thread, graph_thread, p)) {
+        p->thread_valid = false;
+        talloc_free(f);
+        return NULL;
+    }
+
+    thread_graph_reset(f);
+
+    return &p->public;
+}
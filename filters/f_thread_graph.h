@@ -0,0 +1,41 @@
+#pragma once
+
+#include "f_async_queue.h"
+#include "filter.h"
+
+// Runs a filter sub-graph on a separate thread. Frames are passed to and from
+// the thread with a pair of mp_async_queues, so this is useful to move CPU
+// heavy filters off the thread running the parent graph.
+struct mp_thread_graph {
+    // Filter in the parent graph with 1 input and 1 output pin. Frames written
+    // to the input are passed through the sub-graph, and its output appears on
+    // the output pin. Resetting this filter resets the whole sub-graph.
+    // Destroying it terminates the thread and frees the sub-graph.
+    struct mp_filter *f;
+
+    // Root of the sub-graph. Use it as parent for filters that should run on
+    // the thread. The sub-graph must only be accessed with the thread locked.
+    struct mp_filter *root;
+
+    // Pins within the sub-graph. "in" outputs the frames written to f, and
+    // "out" takes the frames that f should output. Connect the filters of the
+    // sub-graph between them (or "out" to "in" if there are none).
+    struct mp_pin *in, *out;
+};
+
+// name is used as thread name. cfg configures both queues; if the sample unit
+// is AQUEUE_UNIT_SAMPLES, audio filters in the sub-graph add a latency of up to
+// 2*cfg.max_samples samples.
+struct mp_thread_graph *mp_thread_graph_create(struct mp_filter *parent,
+                                               const char *name,
+                                               struct mp_async_queue_config cfg);
+
+// Change the queue configuration.
+void mp_thread_graph_set_config(struct mp_thread_graph *g,
+                                struct mp_async_queue_config cfg);
+
+// Synchronously stop the thread to access the sub-graph from the caller's
+// thread. This waits until the sub-graph is done with its current iteration,
+// so avoid calling it on every frame.
+void mp_thread_graph_lock(struct mp_thread_graph *g);
+void mp_thread_graph_unlock(struct mp_thread_graph *g);
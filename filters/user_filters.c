@@ -28,9 +28,26 @@ static bool check_unknown_entry(const char *name, int media_type)
     return mp_lavfi_is_usable(name, media_type);
 }
 
+static struct mp_filter *create_thread_marker(struct mp_filter *parent,
+                                              void *options)
+{
+    MP_ERR(parent, "'%s' can be used in --vf/--af lists only.\n",
+           MP_USER_FILTER_THREAD);
+    return NULL;
+}
+
+const struct mp_user_filter_entry filter_thread = {
+    .desc = {
+        .description = "run the following filters on a separate thread",
+        .name = MP_USER_FILTER_THREAD,
+    },
+    .create = create_thread_marker,
+};
+
 // --af option
 
 const struct mp_user_filter_entry *af_list[] = {
+    &filter_thread,
     &af_lavfi,
     &af_lavfi_bridge,
     &af_scaletempo,
@@ -82,6 +99,7 @@ const struct m_obj_list af_obj_list = {
 // --vf option
 
 const struct mp_user_filter_entry *vf_list[] = {
+    &filter_thread,
     &vf_format,
     &vf_lavfi,
     &vf_lavfi_bridge,
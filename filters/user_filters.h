@@ -14,10 +14,16 @@ struct mp_user_filter_entry {
     struct mp_filter *(*create)(struct mp_filter *parent, void *options);
 };
 
+// Name of the --vf/--af list entry that makes the following filters run on a
+// separate thread. It is handled by f_output_chain.c, and is not a filter.
+#define MP_USER_FILTER_THREAD "thread"
+
 struct mp_filter *mp_create_user_filter(struct mp_filter *parent,
                                         enum mp_output_chain_type type,
                                         const char *name, char **args);
 
+extern const struct mp_user_filter_entry filter_thread;
+
 extern const struct mp_user_filter_entry af_lavfi;
 extern const struct mp_user_filter_entry af_lavfi_bridge;
 extern const struct mp_user_filter_entry af_scaletempo;
@@ -248,7 +248,7 @@ extern "C" {
  * relational operators (<, >, <=, >=).
  */
 #define MPV_MAKE_VERSION(major, minor) (((major) << 16) | (minor) | 0UL)
-#define MPV_CLIENT_API_VERSION MPV_MAKE_VERSION(2, 5)
+#define MPV_CLIENT_API_VERSION MPV_MAKE_VERSION(2, 7)
 
 /**
  * The API user is allowed to "#define MPV_ENABLE_DEPRECATED 0" before
@@ -1173,6 +1173,85 @@ MPV_EXPORT char *mpv_get_property_osd_string(mpv_handle *ctx, const char *name);
 MPV_EXPORT int mpv_get_property_async(mpv_handle *ctx, uint64_t reply_userdata,
                                       const char *name, mpv_format format);
 
+typedef enum mpv_batch_op {
+    /**
+     * Run a command, like mpv_command_node(). mpv_batch_item.args contains
+     * the command, and mpv_batch_item.result receives the command result.
+     */
+    MPV_BATCH_COMMAND       = 1,
+    /**
+     * Read a property, like mpv_get_property(). Uses mpv_batch_item.name,
+     * format and data.
+     */
+    MPV_BATCH_GET_PROPERTY  = 2,
+    /**
+     * Set a property, like mpv_set_property(). Uses mpv_batch_item.name,
+     * format and data.
+     */
+    MPV_BATCH_SET_PROPERTY  = 3,
+} mpv_batch_op;
+
+/**
+ * A single operation for mpv_command_batch(). Fields not used by the operation
+ * are ignored.
+ */
+typedef struct mpv_batch_item {
+    mpv_batch_op op;
+    /**
+     * The command for MPV_BATCH_COMMAND (as with mpv_command_node()).
+     */
+    mpv_node *args;
+    /**
+     * The property name.
+     */
+    const char *name;
+    /**
+     * Format of the value pointed to by data.
+     */
+    mpv_format format;
+    /**
+     * Property value (MPV_BATCH_SET_PROPERTY), or pointer to the variable
+     * which receives the value (MPV_BATCH_GET_PROPERTY), exactly like the data
+     * argument of mpv_set_property() and mpv_get_property().
+     */
+    void *data;
+    /**
+     * Output: the error code of the operation.
+     */
+    int error;
+    /**
+     * Output: the command result (MPV_BATCH_COMMAND only). If error is >= 0,
+     * this must be freed with mpv_free_node_contents(). It is set to
+     * MPV_FORMAT_NONE otherwise.
+     */
+    mpv_node result;
+} mpv_batch_item;
+
+/**
+ * Run a list of commands and property accesses in order. This is the same as
+ * calling the corresponding functions one by one, except that the player is
+ * locked only once for the whole list, so no other player activity can happen
+ * between the operations. This is also much faster than separate calls if
+ * there are many operations.
+ *
+ * Commands which would still run or finish after the player is unlocked
+ * (those that run on a separate thread, such as "subprocess", "screenshot",
+ * "loadlist" or "sub-add") are not allowed. They fail with
+ * MPV_ERROR_INVALID_PARAMETER without being run, while the other operations
+ * of the batch are still run. Use separate calls for such commands.
+ *
+ * Before mpv_initialize(), this just runs the operations one by one (only
+ * MPV_BATCH_SET_PROPERTY is useful then, see mpv_set_property()).
+ *
+ * @param items the operations; mpv_batch_item.error and .result are set for
+ *              each item
+ * @param num_items number of entries in items
+ * @return the error code of the first failed operation, or 0 if all succeeded.
+ *         Also returns MPV_ERROR_INVALID_PARAMETER if num_items is negative.
+ */
+MPV_EXPORT int mpv_command_batch(mpv_handle *ctx, mpv_batch_item *items,
+                                 int num_items);
+
 /**
  * Get a notification whenever the given property changes. You will receive
  * updates as MPV_EVENT_PROPERTY_CHANGE. Note that this is not very precise:
@@ -1372,6 +1451,16 @@ typedef enum mpv_event_id {
      * See also mpv_event and mpv_event_hook.
      */
     MPV_EVENT_HOOK              = 25,
+    /**
+     * Incremental change to the playlist. This allows keeping a copy of the
+     * playlist in sync without re-reading the "playlist" property on every
+     * change, which is slow with large playlists.
+     * This event is disabled by default, and must be enabled with
+     * mpv_request_event().
+     * See also mpv_event and mpv_event_playlist_change.
+     * (Since API version 2.6.)
+     */
+    MPV_EVENT_PLAYLIST_CHANGE   = 26,
     // Internal note: adjust INTERNAL_EVENT_BASE when adding new events.
 } mpv_event_id;
 
@@ -1571,6 +1660,62 @@ typedef struct mpv_event_hook {
     uint64_t id;
 } mpv_event_hook;
 
+typedef enum mpv_playlist_change_type {
+    /**
+     * count entries were inserted at index. Their playlist entry IDs are
+     * playlist_entry_id, playlist_entry_id + 1, ... (playlist_entry_id +
+     * count - 1).
+     */
+    MPV_PLAYLIST_CHANGE_INSERT = 1,
+    /**
+     * count entries starting at index were removed.
+     */
+    MPV_PLAYLIST_CHANGE_REMOVE = 2,
+    /**
+     * The entry with the ID playlist_entry_id was moved from index to
+     * to_index (to_index is the index after the move).
+     */
+    MPV_PLAYLIST_CHANGE_MOVE = 3,
+    /**
+     * The current entry changed (see the "playlist-current-pos" property).
+     * index and playlist_entry_id are set to the new current entry, or -1
+     * and 0 if there is none.
+     */
+    MPV_PLAYLIST_CHANGE_CURRENT = 4,
+    /**
+     * The playlist was changed in a way that is not described by individual
+     * changes (such as shuffling, or too many changes at once). The client
+     * must re-read the entire playlist.
+     */
+    MPV_PLAYLIST_CHANGE_RESET = 5,
+} mpv_playlist_change_type;
+
+// Since API version 2.6.
+typedef struct mpv_event_playlist_change {
+    /**
+     * Type of the change. Later API versions may add new types, which should
+     * be handled like MPV_PLAYLIST_CHANGE_RESET.
+     */
+    mpv_playlist_change_type type;
+    /**
+     * Index of the first affected entry, -1 if not applicable.
+     */
+    int64_t index;
+    /**
+     * Number of inserted or removed entries, 0 if not applicable.
+     */
+    int64_t count;
+    /**
+     * Index of the moved entry after the move, -1 if not applicable.
+     */
+    int64_t to_index;
+    /**
+     * Playlist entry ID (see the "playlist/N/id" property), 0 if not
+     * applicable.
+     */
+    int64_t playlist_entry_id;
+} mpv_event_playlist_change;
+
 // Since API version 1.102.
 typedef struct mpv_event_command {
     /**
@@ -1621,6 +1766,7 @@ typedef struct mpv_event {
      *  MPV_EVENT_END_FILE:               mpv_event_end_file*
      *  MPV_EVENT_HOOK:                   mpv_event_hook*
      *  MPV_EVENT_COMMAND_REPLY*          mpv_event_command*
+     *  MPV_EVENT_PLAYLIST_CHANGE:        mpv_event_playlist_change* (since v2.6)
      *  other: NULL
      *
      * Note: future enhancements might add new event structs for existing or new
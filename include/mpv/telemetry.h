@@ -0,0 +1,195 @@
+/* Copyright (C) 2026 the mpv developers
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef MPV_CLIENT_API_TELEMETRY_H_
+#define MPV_CLIENT_API_TELEMETRY_H_
+
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Warning: this API is not stable yet.
+ *
+ * Overview
+ * --------
+ *
+ * If the --telemetry-shm option is set, mpv maps the given file (usually
+ * something under /dev/shm) and publishes a snapshot of some playback
+ * statistics into it once per playloop iteration. External processes can
+ * map the same file read-only and read the snapshot without talking to the
+ * player at all, unlike polling properties over IPC, which wakes up the
+ * player for every request.
+ *
+ * The file contains a single mpv_telemetry_shm struct. The snapshot is
+ * protected by a sequence counter: the writer makes it odd while it updates
+ * the snapshot, and even again when it is done. Use mpv_telemetry_read() to
+ * get a consistent copy. This header is all that is needed for reading; it
+ * does not require linking against libmpv.
+ *
+ * mpv_telemetry_read() is only defined if the compiler provides atomic
+ * operations this header knows about (GCC and clang, in C and C++, or any
+ * C11 compiler with <stdatomic.h>). Otherwise, MPV_TELEMETRY_HAVE_READ is not
+ * defined, and readers have to follow the protocol described for
+ * mpv_telemetry_shm.seq themselves.
+ *
+ * All values are in native byte order, because the file is only meant to be
+ * read on the same machine.
+ */
+
+/** Value of mpv_telemetry_shm.magic ("mpvt" on little endian machines). */
+#define MPV_TELEMETRY_MAGIC 0x7476706dU
+
+/**
+ * Value of mpv_telemetry_shm.version. Fields are only ever added to the end
+ * of mpv_telemetry_snapshot, which does not change the version; check
+ * snapshot_size to see whether newer fields are present.
+ */
+#define MPV_TELEMETRY_VERSION 1
+
+/** Bits for mpv_telemetry_snapshot.flags. */
+typedef enum mpv_telemetry_flags {
+    /** The player is running and updating the snapshot. Not set anymore once
+     *  the player exits or --telemetry-shm is changed. */
+    MPV_TELEMETRY_ACTIVE    = 1 << 0,
+    /** No file is loaded. */
+    MPV_TELEMETRY_IDLE      = 1 << 1,
+    /** Playback is paused (by the user or for buffering). */
+    MPV_TELEMETRY_PAUSED    = 1 << 2,
+    /** Playback is paused because the demuxer cache is too low. */
+    MPV_TELEMETRY_BUFFERING = 1 << 3,
+    /** A seek is in progress. */
+    MPV_TELEMETRY_SEEKING   = 1 << 4,
+    /** The demuxer cache reached the end of the file. */
+    MPV_TELEMETRY_EOF_CACHED = 1 << 5,
+} mpv_telemetry_flags;
+
+/**
+ * The published statistics. Times are in seconds and are NaN if unavailable.
+ * Counters are -1 if unavailable. The fields correspond to the properties of
+ * the same name.
+ */
+typedef struct mpv_telemetry_snapshot {
+    /** Incremented for each published snapshot. */
+    uint64_t update_count;
+    /** mpv_telemetry_flags bit mask. */
+    uint32_t flags;
+    /** playlist-pos, -1 if none. */
+    int32_t playlist_pos;
+    double time_pos;
+    double duration;
+    double speed;
+    double avsync;
+    double total_avsync_change;
+    /** demuxer-cache-duration */
+    double cache_duration;
+    /** Number of bytes cached ahead of the current demuxer position. */
+    int64_t cache_forward_bytes;
+    /** cache-speed, in bytes per second. */
+    int64_t cache_speed;
+    int64_t frame_drop_count;
+    int64_t decoder_frame_drop_count;
+    int64_t vo_delayed_frame_count;
+    int64_t mistimed_frame_count;
+} mpv_telemetry_snapshot;
+
+typedef struct mpv_telemetry_shm {
+    /** MPV_TELEMETRY_MAGIC. Written last when the file is initialized. */
+    uint32_t magic;
+    /** MPV_TELEMETRY_VERSION */
+    uint32_t version;
+    /** sizeof(mpv_telemetry_snapshot) as compiled into the player. */
+    uint32_t snapshot_size;
+    /** Process ID of the player. */
+    uint32_t pid;
+    /**
+     * Sequence counter; odd while the snapshot is being written. This is a
+     * plain integer so that the struct can be used from C++, but it must
+     * only be accessed atomically. The writer increments it with a relaxed
+     * store followed by a release fence before changing the snapshot, and
+     * increments it again with a release store when done. A reader loads it
+     * with acquire semantics, copies the snapshot if it is even, issues an
+     * acquire fence, and loads it again; the copy is consistent if both
+     * values are equal.
+     */
+    uint32_t seq;
+    uint32_t reserved;
+    mpv_telemetry_snapshot snapshot;
+} mpv_telemetry_shm;
+
+#if defined(__GNUC__) || defined(__clang__)
+#define MPV_TELEMETRY_HAVE_READ 1
+#define MPV_TELEMETRY_LOAD_ACQUIRE_(p) __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define MPV_TELEMETRY_LOAD_RELAXED_(p) __atomic_load_n(p, __ATOMIC_RELAXED)
+#define MPV_TELEMETRY_FENCE_ACQUIRE_() __atomic_thread_fence(__ATOMIC_ACQUIRE)
+#elif !defined(__cplusplus) && defined(__STDC_VERSION__) && \
+      __STDC_VERSION__ >= 201112L && !defined(__STDC_NO_ATOMICS__)
+#include <stdatomic.h>
+#define MPV_TELEMETRY_HAVE_READ 1
+#define MPV_TELEMETRY_LOAD_ACQUIRE_(p) \
+    atomic_load_explicit((_Atomic uint32_t *)(p), memory_order_acquire)
+#define MPV_TELEMETRY_LOAD_RELAXED_(p) \
+    atomic_load_explicit((_Atomic uint32_t *)(p), memory_order_relaxed)
+#define MPV_TELEMETRY_FENCE_ACQUIRE_() atomic_thread_fence(memory_order_acquire)
+#endif
+
+#ifdef MPV_TELEMETRY_HAVE_READ
+
+/**
+ * Copy a consistent snapshot from shm to *out. If the writer is updating the
+ * snapshot concurrently, this retries up to max_tries times. If the player
+ * is older than this header, the fields it does not know about are zeroed.
+ *
+ * @param shm the mapped telemetry file
+ * @param out set to the snapshot on success
+ * @param max_tries number of attempts before giving up
+ * @return 0 on success, -1 if the file was not (yet) initialized or has an
+ *         incompatible version, -2 if no consistent copy could be made
+ */
+static inline int mpv_telemetry_read(mpv_telemetry_shm *shm,
+                                     mpv_telemetry_snapshot *out,
+                                     int max_tries)
+{
+    if (MPV_TELEMETRY_LOAD_ACQUIRE_(&shm->magic) != MPV_TELEMETRY_MAGIC)
+        return -1;
+    if (shm->version != MPV_TELEMETRY_VERSION)
+        return -1;
+    size_t size = shm->snapshot_size;
+    if (size > sizeof(*out))
+        size = sizeof(*out);
+    for (int n = 0; n < max_tries; n++) {
+        uint32_t seq0 = MPV_TELEMETRY_LOAD_ACQUIRE_(&shm->seq);
+        if (seq0 & 1)
+            continue;
+        memset(out, 0, sizeof(*out));
+        memcpy(out, &shm->snapshot, size);
+        MPV_TELEMETRY_FENCE_ACQUIRE_();
+        uint32_t seq1 = MPV_TELEMETRY_LOAD_RELAXED_(&shm->seq);
+        if (seq0 == seq1)
+            return 0;
+    }
+    return -2;
+}
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
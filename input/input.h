@@ -282,4 +282,17 @@ char *mp_json_encode_event(struct mpv_event *event);
 struct mpv_handle;
 char *mp_ipc_consume_next_command(struct mpv_handle *client, void *ctx, bstr *buf);
 
+// Execute all complete binary protocol frames at the start of buf, remove them
+// from buf, and append the reply frames to *out. Returns <0 if the data can't
+// be a valid frame (the connection should be dropped).
+int mp_ipc_consume_frames(struct mpv_handle *client, bstr *buf, bstr *out);
+
+// Collects events for a binary protocol client, and merges property change
+// events of the same property until they are sent with the next flush.
+struct mp_ipc_event_queue;
+struct mp_ipc_event_queue *mp_ipc_event_queue_create(void *ta_parent);
+void mp_ipc_event_queue_add(struct mp_ipc_event_queue *q, struct mpv_event *event);
+// Append all queued events as frames to *out, and clear the queue.
+void mp_ipc_event_queue_flush(struct mp_ipc_event_queue *q, bstr *out);
+
 #endif /* MPLAYER_INPUT_H */
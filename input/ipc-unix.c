@@ -63,9 +63,8 @@ struct client_arg {
     bool writable;
 };
 
-static int ipc_write_str(struct client_arg *client, const char *buf)
+static int ipc_write(struct client_arg *client, const char *buf, size_t count)
 {
-    size_t count = strlen(buf);
     while (count > 0) {
         ssize_t rc = send(client->client_fd, buf, count, MSG_NOSIGNAL);
         if (rc <= 0) {
@@ -90,6 +89,11 @@ static int ipc_write_str(struct client_arg *client, const char *buf)
     return 0;
 }
 
+static int ipc_write_str(struct client_arg *client, const char *buf)
+{
+    return ipc_write(client, buf, strlen(buf));
+}
+
 static MP_THREAD_VOID client_thread(void *p)
 {
     // We don't use MSG_NOSIGNAL because the moldy fruit OS doesn't support it.
@@ -101,6 +105,12 @@ static MP_THREAD_VOID client_thread(void *p)
 
     struct client_arg *arg = p;
     bstr client_msg = { talloc_strdup(NULL, ""), 0 };
+    bstr out = {0};
+
+    // The first byte received decides between text/JSON and binary frames.
+    bool mode_known = false;
+    bool binary = false;
+    struct mp_ipc_event_queue *events = mp_ipc_event_queue_create(NULL);
 
     char *tname = talloc_asprintf(NULL, "ipc/%s", arg->client_name);
     mp_thread_set_name(tname);
@@ -145,6 +155,11 @@ static MP_THREAD_VOID client_thread(void *p)
                 if (!arg->writable)
                     continue;
 
+                if (binary) {
+                    mp_ipc_event_queue_add(events, event);
+                    continue;
+                }
+
                 char *event_msg = mp_json_encode_event(event);
                 if (!event_msg) {
                     MP_ERR(arg, "Encoding error\n");
@@ -158,11 +173,20 @@ static MP_THREAD_VOID client_thread(void *p)
                     goto done;
                 }
             }
+
+            if (binary) {
+                out.len = 0;
+                mp_ipc_event_queue_flush(events, &out);
+                if (ipc_write(arg, out.start, out.len) < 0) {
+                    MP_ERR(arg, "Write error (%s)\n", mp_strerror(errno));
+                    goto done;
+                }
+            }
         }
 
         if (fds[1].revents & (POLLIN | POLLHUP | POLLNVAL)) {
             while (1) {
-                char buf[128];
+                char buf[4096];
                 bstr append = { buf, 0 };
 
                 ssize_t bytes = read(arg->client_fd, buf, sizeof(buf));
@@ -183,6 +207,26 @@ static MP_THREAD_VOID client_thread(void *p)
 
                 bstr_xappend(NULL, &client_msg, append);
 
+                if (!mode_known) {
+                    mode_known = true;
+                    binary = client_msg.start[0] == '\0';
+                    if (binary)
+                        MP_VERBOSE(arg, "Using binary protocol\n");
+                }
+
+                if (binary) {
+                    out.len = 0;
+                    if (mp_ipc_consume_frames(arg->client, &client_msg, &out) < 0) {
+                        MP_ERR(arg, "Invalid frame received\n");
+                        goto done;
+                    }
+                    if (arg->writable && ipc_write(arg, out.start, out.len) < 0) {
+                        MP_ERR(arg, "Write error (%s)\n", mp_strerror(errno));
+                        goto done;
+                    }
+                    continue;
+                }
+
                 while (bstrchr(client_msg, '\n') != -1) {
                     char *reply_msg = mp_ipc_consume_next_command(arg->client,
                         NULL, &client_msg);
@@ -206,6 +250,8 @@ done:
     if (client_msg.len > 0)
         MP_WARN(arg, "Ignoring unterminated command on disconnect.\n");
     talloc_free(client_msg.start);
+    talloc_free(out.start);
+    talloc_free(events);
     if (arg->close_client_fd)
         close(arg->client_fd);
     struct mpv_handle *h = arg->client;
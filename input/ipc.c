@@ -20,6 +20,7 @@
 #include "common/msg.h"
 #include "input/input.h"
 #include "misc/json.h"
+#include "misc/msgpack.h"
 #include "misc/node.h"
 #include "options/m_option.h"
 #include "options/options.h"
@@ -56,12 +57,6 @@ static void mpv_node_map_add(void *ta_parent, mpv_node *src, const char *key, mp
     src->u.list->num++;
 }
 
-static void mpv_node_map_add_null(void *ta_parent, mpv_node *src, const char *key)
-{
-    mpv_node val_node = {.format = MPV_FORMAT_NONE};
-    mpv_node_map_add(ta_parent, src, key, &val_node);
-}
-
 static void mpv_node_map_add_int64(void *ta_parent, mpv_node *src, const char *key, int64_t val)
 {
     mpv_node val_node = {.format = MPV_FORMAT_INT64, .u.int64 = val};
@@ -89,19 +84,24 @@ static void mpv_format_command_reply(void *ta_parent, mpv_event *event,
     mpv_node_map_add(ta_parent, dst, "data", &cmd->result);
 }
 
-char *mp_json_encode_event(mpv_event *event)
+static void event_to_node(void *ta_parent, mpv_event *event, mpv_node *dst)
 {
-    void *ta_parent = talloc_new(NULL);
-
-    struct mpv_node event_node;
     if (event->event_id == MPV_EVENT_COMMAND_REPLY) {
-        event_node = (mpv_node){.format = MPV_FORMAT_NODE_MAP, .u.list = NULL};
-        mpv_format_command_reply(ta_parent, event, &event_node);
+        *dst = (mpv_node){.format = MPV_FORMAT_NODE_MAP, .u.list = NULL};
+        mpv_format_command_reply(ta_parent, event, dst);
     } else {
-        mpv_event_to_node(&event_node, event);
+        mpv_event_to_node(dst, event);
         // Abuse mpv_event_to_node() internals.
-        talloc_steal(ta_parent, node_get_alloc(&event_node));
+        talloc_steal(ta_parent, node_get_alloc(dst));
     }
+}
+
+char *mp_json_encode_event(mpv_event *event)
+{
+    void *ta_parent = talloc_new(NULL);
+
+    struct mpv_node event_node;
+    event_to_node(ta_parent, event, &event_node);
 
     char *output = talloc_strdup(NULL, "");
     json_write(&output, &event_node);
@@ -112,50 +112,51 @@ char *mp_json_encode_event(mpv_event *event)
     return output;
 }
 
-// Function is allowed to modify src[n].
-static char *json_execute_command(struct mpv_handle *client, void *ta_parent,
-                                  char *src)
+struct ipc_request {
+    mpv_node *reqid_node;
+    int64_t reqid;
+    bool async;
+    mpv_node *cmd_node;
+    const char *cmd;    // first command argument, if it's a string
+    int rc;             // <0 if the request is invalid
+    mpv_node value;     // get_property result
+    char *str;          // get_property_string result
+};
+
+// Commands handled by execute_special(). Everything else is a normal command.
+static const char *const special_commands[] = {
+    "client_name",
+    "get_time_us",
+    "get_version",
+    "observe_property",
+    "observe_property_string",
+    "unobserve_property",
+    "request_log_messages",
+    "enable_event",
+    "disable_event",
+};
+
+static void parse_request(struct mp_log *log, mpv_node *msg_node,
+                          struct ipc_request *req)
 {
-    int rc;
-    const char *cmd = NULL;
-    struct mp_log *log = mp_client_get_log(client);
-
-    mpv_node msg_node;
-    mpv_node reply_node = {.format = MPV_FORMAT_NODE_MAP, .u.list = NULL};
-    mpv_node *reqid_node = NULL;
-    int64_t reqid = 0;
-    mpv_node *async_node = NULL;
-    bool async = false;
-    bool send_reply = true;
+    *req = (struct ipc_request){0};
 
-    rc = json_parse(ta_parent, &msg_node, &src, MAX_JSON_DEPTH);
-    if (rc < 0) {
-        mp_err(log, "malformed JSON received: '%s'\n", src);
-        rc = MPV_ERROR_INVALID_PARAMETER;
-        goto error;
-    }
-
-    if (msg_node.format != MPV_FORMAT_NODE_MAP) {
-        rc = MPV_ERROR_INVALID_PARAMETER;
+    if (msg_node->format != MPV_FORMAT_NODE_MAP)
         goto error;
-    }
 
-    async_node = node_map_get(&msg_node, "async");
+    mpv_node *async_node = node_map_get(msg_node, "async");
     if (async_node) {
-        if (async_node->format != MPV_FORMAT_FLAG) {
-            rc = MPV_ERROR_INVALID_PARAMETER;
+        if (async_node->format != MPV_FORMAT_FLAG)
             goto error;
-        }
-        async = async_node->u.flag;
+        req->async = async_node->u.flag;
     }
 
-    reqid_node = node_map_get(&msg_node, "request_id");
-    if (reqid_node) {
-        if (reqid_node->format == MPV_FORMAT_INT64) {
-            reqid = reqid_node->u.int64;
-        } else if (async) {
+    req->reqid_node = node_map_get(msg_node, "request_id");
+    if (req->reqid_node) {
+        if (req->reqid_node->format == MPV_FORMAT_INT64) {
+            req->reqid = req->reqid_node->u.int64;
+        } else if (req->async) {
             mp_err(log, "'request_id' must be an integer for async commands.\n");
-            rc = MPV_ERROR_INVALID_PARAMETER;
             goto error;
         } else {
             mp_warn(log, "'request_id' must be an integer. Using other types is "
@@ -163,87 +164,157 @@ static char *json_execute_command(struct mpv_handle *client, void *ta_parent,
         }
     }
 
-    mpv_node *cmd_node = node_map_get(&msg_node, "command");
-    if (!cmd_node) {
-        rc = MPV_ERROR_INVALID_PARAMETER;
+    req->cmd_node = node_map_get(msg_node, "command");
+    if (!req->cmd_node)
         goto error;
-    }
 
-    if (cmd_node->format == MPV_FORMAT_NODE_ARRAY) {
-        mpv_node *cmd_str_node = mpv_node_array_get(cmd_node, 0);
-        if (!cmd_str_node || (cmd_str_node->format != MPV_FORMAT_STRING)) {
-            rc = MPV_ERROR_INVALID_PARAMETER;
+    if (req->cmd_node->format == MPV_FORMAT_NODE_ARRAY) {
+        mpv_node *cmd_str_node = mpv_node_array_get(req->cmd_node, 0);
+        if (!cmd_str_node || (cmd_str_node->format != MPV_FORMAT_STRING))
             goto error;
-        }
 
-        cmd = cmd_str_node->u.string;
+        req->cmd = cmd_str_node->u.string;
     }
+    return;
 
-    if (cmd && !strcmp("client_name", cmd)) {
-        const char *client_name = mpv_client_name(client);
-        mpv_node_map_add_string(ta_parent, &reply_node, "data", client_name);
-        rc = MPV_ERROR_SUCCESS;
-    } else if (cmd && !strcmp("get_time_us", cmd)) {
-        int64_t time_us = mpv_get_time_us(client);
-        mpv_node_map_add_int64(ta_parent, &reply_node, "data", time_us);
-        rc = MPV_ERROR_SUCCESS;
-    } else if (cmd && !strcmp("get_version", cmd)) {
-        int64_t ver = mpv_client_api_version();
-        mpv_node_map_add_int64(ta_parent, &reply_node, "data", ver);
-        rc = MPV_ERROR_SUCCESS;
-    } else if (cmd && !strcmp("get_property", cmd)) {
-        mpv_node result_node;
+error:
+    req->rc = MPV_ERROR_INVALID_PARAMETER;
+}
 
-        if (cmd_node->u.list->num != 2) {
-            rc = MPV_ERROR_INVALID_PARAMETER;
-            goto error;
-        }
+static void add_reply_status(void *ta_parent, struct ipc_request *req,
+                             mpv_node *reply_node)
+{
+    /* If the request contains a "request_id", copy it back into the response.
+     * This makes it easier on the requester to match up the IPC results with
+     * the original requests.
+     */
+    if (req->reqid_node) {
+        mpv_node_map_add(ta_parent, reply_node, "request_id", req->reqid_node);
+    } else {
+        mpv_node_map_add_int64(ta_parent, reply_node, "request_id", 0);
+    }
 
-        if (cmd_node->u.list->values[1].format != MPV_FORMAT_STRING) {
-            rc = MPV_ERROR_INVALID_PARAMETER;
-            goto error;
-        }
+    mpv_node_map_add_string(ta_parent, reply_node, "error",
+                            mpv_error_string(req->rc));
+}
 
-        rc = mpv_get_property(client, cmd_node->u.list->values[1].u.string,
-                              MPV_FORMAT_NODE, &result_node);
-        if (rc >= 0) {
-            mpv_node_map_add(ta_parent, &reply_node, "data", &result_node);
-            mpv_free_node_contents(&result_node);
-        }
-    } else if (cmd && !strcmp("get_property_string", cmd)) {
-        if (cmd_node->u.list->num != 2) {
-            rc = MPV_ERROR_INVALID_PARAMETER;
-            goto error;
-        }
+// If the request is a synchronous command or a property access, set *item to
+// run it with mpv_command_batch() and return true.
+static bool prepare_batch_item(struct mpv_handle *client,
+                               struct ipc_request *req, mpv_batch_item *item)
+{
+    if (req->rc < 0)
+        return false;
 
-        if (cmd_node->u.list->values[1].format != MPV_FORMAT_STRING) {
-            rc = MPV_ERROR_INVALID_PARAMETER;
-            goto error;
+    const char *cmd = req->cmd;
+    if (cmd && (!strcmp("get_property", cmd) ||
+                !strcmp("get_property_string", cmd)))
+    {
+        mpv_node_list *args = req->cmd_node->u.list;
+        if (args->num != 2 || args->values[1].format != MPV_FORMAT_STRING) {
+            req->rc = MPV_ERROR_INVALID_PARAMETER;
+            return false;
         }
+        bool str = !strcmp("get_property_string", cmd);
+        *item = (mpv_batch_item){
+            .op = MPV_BATCH_GET_PROPERTY,
+            .name = args->values[1].u.string,
+            .format = str ? MPV_FORMAT_STRING : MPV_FORMAT_NODE,
+            .data = str ? (void *)&req->str : &req->value,
+        };
+        return true;
+    }
 
-        char *result = mpv_get_property_string(client,
-                                        cmd_node->u.list->values[1].u.string);
-        if (result) {
-            mpv_node_map_add_string(ta_parent, &reply_node, "data", result);
-            mpv_free(result);
-        } else {
-            mpv_node_map_add_null(ta_parent, &reply_node, "data");
-        }
-    } else if (cmd && (!strcmp("set_property", cmd) ||
-                       !strcmp("set_property_string", cmd)))
+    if (cmd && (!strcmp("set_property", cmd) ||
+                !strcmp("set_property_string", cmd)))
     {
-        if (cmd_node->u.list->num != 3) {
-            rc = MPV_ERROR_INVALID_PARAMETER;
-            goto error;
+        mpv_node_list *args = req->cmd_node->u.list;
+        if (args->num != 3 || args->values[1].format != MPV_FORMAT_STRING) {
+            req->rc = MPV_ERROR_INVALID_PARAMETER;
+            return false;
         }
+        *item = (mpv_batch_item){
+            .op = MPV_BATCH_SET_PROPERTY,
+            .name = args->values[1].u.string,
+            .format = MPV_FORMAT_NODE,
+            .data = &args->values[2],
+        };
+        return true;
+    }
 
-        if (cmd_node->u.list->values[1].format != MPV_FORMAT_STRING) {
-            rc = MPV_ERROR_INVALID_PARAMETER;
-            goto error;
+    if (req->async)
+        return false;
+    for (int n = 0; cmd && n < MP_ARRAY_SIZE(special_commands); n++) {
+        if (!strcmp(special_commands[n], cmd))
+            return false;
+    }
+    if (!mp_batch_cmd_allowed(client, req->cmd_node))
+        return false;
+
+    *item = (mpv_batch_item){
+        .op = MPV_BATCH_COMMAND,
+        .args = req->cmd_node,
+    };
+    return true;
+}
+
+static void finish_batch_item(void *ta_parent, struct ipc_request *req,
+                              mpv_batch_item *item, mpv_node *reply_node)
+{
+    req->rc = item->error;
+    switch (item->op) {
+    case MPV_BATCH_COMMAND:
+        if (req->rc >= 0)
+            mpv_node_map_add(ta_parent, reply_node, "data", &item->result);
+        mpv_free_node_contents(&item->result);
+        break;
+    case MPV_BATCH_GET_PROPERTY:
+        if (item->format == MPV_FORMAT_STRING) {
+            // Failure is reported as success with null data.
+            req->rc = MPV_ERROR_SUCCESS;
+            if (req->str) {
+                mpv_node_map_add_string(ta_parent, reply_node, "data", req->str);
+            } else {
+                mpv_node_map_add(ta_parent, reply_node, "data",
+                                 &(mpv_node){.format = MPV_FORMAT_NONE});
+            }
+            mpv_free(req->str);
+        } else if (req->rc >= 0) {
+            mpv_node_map_add(ta_parent, reply_node, "data", &req->value);
+            mpv_free_node_contents(&req->value);
         }
+        break;
+    default: ;
+    }
+
+    add_reply_status(ta_parent, req, reply_node);
+}
+
+// Run a request that prepare_batch_item() rejected. Returns whether a reply
+// should be sent (async commands reply later with an event).
+static bool execute_special(struct mpv_handle *client, void *ta_parent,
+                            struct ipc_request *req, mpv_node *reply_node)
+{
+    int rc = req->rc;
+    const char *cmd = req->cmd;
+    mpv_node *cmd_node = req->cmd_node;
+    bool send_reply = true;
+
+    if (rc < 0)
+        goto error;
 
-        rc = mpv_set_property(client, cmd_node->u.list->values[1].u.string,
-                              MPV_FORMAT_NODE, &cmd_node->u.list->values[2]);
+    if (cmd && !strcmp("client_name", cmd)) {
+        const char *client_name = mpv_client_name(client);
+        mpv_node_map_add_string(ta_parent, reply_node, "data", client_name);
+        rc = MPV_ERROR_SUCCESS;
+    } else if (cmd && !strcmp("get_time_us", cmd)) {
+        int64_t time_us = mpv_get_time_us(client);
+        mpv_node_map_add_int64(ta_parent, reply_node, "data", time_us);
+        rc = MPV_ERROR_SUCCESS;
+    } else if (cmd && !strcmp("get_version", cmd)) {
+        int64_t ver = mpv_client_api_version();
+        mpv_node_map_add_int64(ta_parent, reply_node, "data", ver);
+        rc = MPV_ERROR_SUCCESS;
     } else if (cmd && !strcmp("observe_property", cmd)) {
         if (cmd_node->u.list->num != 3) {
             rc = MPV_ERROR_INVALID_PARAMETER;
@@ -343,38 +414,104 @@ static char *json_execute_command(struct mpv_handle *client, void *ta_parent,
             }
             rc = mpv_request_event(client, event, enable);
         }
+    } else if (req->async) {
+        rc = mpv_command_node_async(client, req->reqid, cmd_node);
+        if (rc >= 0)
+            send_reply = false;
     } else {
-        mpv_node result_node = {0};
+        // Commands which can't be run in a batch.
+        mpv_node result = {0};
+        rc = mpv_command_node(client, cmd_node, &result);
+        if (rc >= 0)
+            mpv_node_map_add(ta_parent, reply_node, "data", &result);
+        mpv_free_node_contents(&result);
+    }
 
-        if (async) {
-            rc = mpv_command_node_async(client, reqid, cmd_node);
-            if (rc >= 0)
-                send_reply = false;
-        } else {
-            rc = mpv_command_node(client, cmd_node, &result_node);
-            if (rc >= 0)
-                mpv_node_map_add(ta_parent, &reply_node, "data", &result_node);
+error:
+    req->rc = rc;
+    add_reply_status(ta_parent, req, reply_node);
+    return send_reply;
+}
+
+// Execute the requests msgs[0..num-1], and write the replies to replies[].
+// send[n] is set to false if msgs[n] has no immediate reply. Consecutive plain
+// commands and property accesses are run with a single mpv_command_batch().
+static void execute_requests(struct mpv_handle *client, void *ta_parent,
+                             mpv_node *msgs, int num, mpv_node *replies,
+                             bool *send)
+{
+    struct mp_log *log = mp_client_get_log(client);
+    struct ipc_request *reqs = talloc_array(ta_parent, struct ipc_request, num);
+    mpv_batch_item *items = talloc_array(ta_parent, mpv_batch_item, num);
+
+    for (int n = 0; n < num; n++) {
+        parse_request(log, &msgs[n], &reqs[n]);
+        replies[n] = (mpv_node){.format = MPV_FORMAT_NODE_MAP, .u.list = NULL};
+        send[n] = true;
+    }
+
+    int n = 0;
+    while (n < num) {
+        int end = n;
+        while (end < num && prepare_batch_item(client, &reqs[end], &items[end]))
+            end++;
+
+        if (end == n) {
+            send[n] = execute_special(client, ta_parent, &reqs[n], &replies[n]);
+            n++;
+            continue;
         }
 
-        mpv_free_node_contents(&result_node);
+        mpv_command_batch(client, &items[n], end - n);
+        for (; n < end; n++)
+            finish_batch_item(ta_parent, &reqs[n], &items[n], &replies[n]);
     }
+}
 
-error:
-    /* If the request contains a "request_id", copy it back into the response.
-     * This makes it easier on the requester to match up the IPC results with
-     * the original requests.
-     */
-    if (reqid_node) {
-        mpv_node_map_add(ta_parent, &reply_node, "request_id", reqid_node);
-    } else {
-        mpv_node_map_add_int64(ta_parent, &reply_node, "request_id", 0);
+// Execute the parsed message msg_node, which is either a single request, or an
+// array of requests (a batch). Returns false if there's nothing to reply.
+static bool execute_message(struct mpv_handle *client, void *ta_parent,
+                            mpv_node *msg_node, mpv_node *reply)
+{
+    // An array of requests is a batch, and gets an array of replies.
+    bool batch = msg_node->format == MPV_FORMAT_NODE_ARRAY;
+    mpv_node *msgs = batch ? msg_node->u.list->values : msg_node;
+    int num = batch ? msg_node->u.list->num : 1;
+
+    mpv_node *replies = talloc_array(ta_parent, mpv_node, num);
+    bool *send = talloc_array(ta_parent, bool, num);
+    execute_requests(client, ta_parent, msgs, num, replies, send);
+
+    if (!batch) {
+        *reply = replies[0];
+        return send[0];
     }
 
-    mpv_node_map_add_string(ta_parent, &reply_node, "error", mpv_error_string(rc));
+    mpv_node_list *list = talloc_zero(ta_parent, mpv_node_list);
+    for (int n = 0; n < num; n++) {
+        if (send[n])
+            MP_TARRAY_APPEND(list, list->values, list->num, replies[n]);
+    }
+    *reply = (mpv_node){.format = MPV_FORMAT_NODE_ARRAY, .u.list = list};
+    return true;
+}
+
+// Function is allowed to modify src[n].
+static char *json_execute_command(struct mpv_handle *client, void *ta_parent,
+                                  char *src)
+{
+    struct mp_log *log = mp_client_get_log(client);
+
+    mpv_node msg_node;
+    if (json_parse(ta_parent, &msg_node, &src, MAX_JSON_DEPTH) < 0) {
+        mp_err(log, "malformed JSON received: '%s'\n", src);
+        msg_node = (mpv_node){.format = MPV_FORMAT_NONE};
+    }
 
     char *output = talloc_strdup(ta_parent, "");
 
-    if (send_reply) {
+    mpv_node reply_node;
+    if (execute_message(client, ta_parent, &msg_node, &reply_node)) {
         json_write(&output, &reply_node);
         output = ta_talloc_strdup_append(output, "\n");
     }
@@ -404,7 +541,7 @@ char *mp_ipc_consume_next_command(struct mpv_handle *client, void *ctx, bstr *bu
     char *reply_msg = NULL;
     if (line0[0] == '\0' || line0[0] == '#') {
         // skip
-    } else if (line0[0] == '{') {
+    } else if (line0[0] == '{' || line0[0] == '[') {
         reply_msg = json_execute_command(client, tmp, line0);
     } else {
         reply_msg = text_execute_command(client, tmp, line0);
@@ -414,3 +551,127 @@ char *mp_ipc_consume_next_command(struct mpv_handle *client, void *ctx, bstr *bu
     talloc_free(tmp);
     return reply_msg;
 }
+
+// Maximum payload size of a frame sent by the client. This also makes sure the
+// first byte of a frame is always 0, which is how the protocol is detected.
+#define MAX_FRAME_SIZE 0xFFFFFF
+
+static bool append_frame(bstr *out, mpv_node *node)
+{
+    size_t start = out->len;
+    bstr_xappend(NULL, out, (bstr){(unsigned char[4]){0}, 4});
+    if (msgpack_append(out, node) < 0 || (uint64_t)(out->len - start - 4) > UINT32_MAX) {
+        out->len = start;
+        return false;
+    }
+    uint32_t size = out->len - start - 4;
+    for (int n = 0; n < 4; n++)
+        out->start[start + n] = size >> ((3 - n) * 8);
+    return true;
+}
+
+static void execute_frame(struct mpv_handle *client, bstr data, bstr *out)
+{
+    void *tmp = talloc_new(NULL);
+    struct mp_log *log = mp_client_get_log(client);
+
+    mpv_node msg_node;
+    if (msgpack_parse(tmp, &msg_node, &data, MAX_MSGPACK_DEPTH) < 0 || data.len) {
+        mp_err(log, "malformed binary frame received\n");
+        msg_node = (mpv_node){.format = MPV_FORMAT_NONE};
+    }
+
+    mpv_node reply;
+    if (execute_message(client, tmp, &msg_node, &reply) &&
+        !append_frame(out, &reply))
+        mp_err(log, "could not encode reply\n");
+
+    talloc_free(tmp);
+}
+
+int mp_ipc_consume_frames(struct mpv_handle *client, bstr *buf, bstr *out)
+{
+    size_t pos = 0;
+    int r = 0;
+    while (buf->len - pos >= 4) {
+        unsigned char *p = buf->start + pos;
+        uint32_t size = ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+                        ((uint32_t)p[2] << 8) | p[3];
+        if (size > MAX_FRAME_SIZE) {
+            r = -1;
+            break;
+        }
+        if (buf->len - pos - 4 < size)
+            break;
+        execute_frame(client, (bstr){p + 4, size}, out);
+        pos += 4 + size;
+    }
+    memmove(buf->start, buf->start + pos, buf->len - pos);
+    buf->len -= pos;
+    return r;
+}
+
+struct ipc_event {
+    uint64_t id;
+    char *name;     // property name if it's a property change event
+    bstr frame;
+};
+
+struct mp_ipc_event_queue {
+    struct ipc_event *events;
+    int num_events;
+};
+
+struct mp_ipc_event_queue *mp_ipc_event_queue_create(void *ta_parent)
+{
+    return talloc_zero(ta_parent, struct mp_ipc_event_queue);
+}
+
+void mp_ipc_event_queue_add(struct mp_ipc_event_queue *q, mpv_event *event)
+{
+    void *tmp = talloc_new(NULL);
+    mpv_node node;
+    event_to_node(tmp, event, &node);
+    bstr frame = {0};
+    bool ok = append_frame(&frame, &node);
+    talloc_free(tmp);
+    if (!ok)
+        return;
+
+    const char *name = NULL;
+    if (event->event_id == MPV_EVENT_PROPERTY_CHANGE) {
+        name = ((mpv_event_property *)event->data)->name;
+        // Only the most recent value of an observed property is relevant, so
+        // drop a pending older change. The new one is appended to the end to
+        // keep the ordering relative to other events.
+        for (int n = 0; n < q->num_events; n++) {
+            struct ipc_event *e = &q->events[n];
+            if (e->name && e->id == event->reply_userdata &&
+                strcmp(e->name, name) == 0)
+            {
+                talloc_free(e->name);
+                talloc_free(e->frame.start);
+                MP_TARRAY_REMOVE_AT(q->events, q->num_events, n);
+                break;
+            }
+        }
+    }
+
+    struct ipc_event e = {
+        .id = event->reply_userdata,
+        .name = talloc_strdup(q, name),
+        .frame = {talloc_steal(q, frame.start), frame.len},
+    };
+    MP_TARRAY_APPEND(q, q->events, q->num_events, e);
+}
+
+void mp_ipc_event_queue_flush(struct mp_ipc_event_queue *q, bstr *out)
+{
+    for (int n = 0; n < q->num_events; n++) {
+        struct ipc_event *e = &q->events[n];
+        bstr_xappend(NULL, out, e->frame);
+        talloc_free(e->name);
+        talloc_free(e->frame.start);
+    }
+    q->num_events = 0;
+}
@@ -0,0 +1,329 @@
+/*
+ * This file is part of mpv.
+ *
+ * mpv is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * mpv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* MessagePack parser and writer for mpv_node:
+ *
+ * Supports the subset of MessagePack that maps to mpv_node: nil, booleans,
+ * integers, floats, strings, binary data (MPV_FORMAT_BYTE_ARRAY), arrays, and
+ * maps with string keys. Extension types are rejected, as are unsigned
+ * integers that don't fit into int64_t.
+ *
+ * Strings are copied (they're not 0-terminated in the input). Strings can
+ * contain invalid UTF-8, and the writer doesn't check for it either.
+ *
+ * Also see: https://github.com/msgpack/msgpack/blob/master/spec.md
+ */
+
+#include <string.h>
+
+#include <mpv/client.h>
+
+#include "common/common.h"
+#include "misc/bstr.h"
+
+#include "msgpack.h"
+
+static bool read_bytes(struct bstr *src, void *dst, size_t len)
+{
+    if (src->len < len)
+        return false;
+    memcpy(dst, src->start, len);
+    *src = bstr_cut(*src, len);
+    return true;
+}
+
+// Read a big endian unsigned integer of the given size.
+static bool read_uint(struct bstr *src, int bytes, uint64_t *out)
+{
+    if (src->len < bytes)
+        return false;
+    uint64_t v = 0;
+    for (int n = 0; n < bytes; n++)
+        v = (v << 8) | src->start[n];
+    *src = bstr_cut(*src, bytes);
+    *out = v;
+    return true;
+}
+
+static bool read_int(struct bstr *src, int bytes, int64_t *out)
+{
+    uint64_t v;
+    if (!read_uint(src, bytes, &v))
+        return false;
+    int shift = 64 - bytes * 8;
+    // Sign extend.
+    *out = shift ? (int64_t)(v << shift) >> shift : (int64_t)v;
+    return true;
+}
+
+static char *read_str(void *ta_parent, struct bstr *src, uint64_t len)
+{
+    if (src->len < len)
+        return NULL;
+    char *s = bstrto0(ta_parent, (struct bstr){src->start, len});
+    *src = bstr_cut(*src, len);
+    return s;
+}
+
+static int read_list(void *ta_parent, struct mpv_node *dst, struct bstr *src,
+                     uint64_t num, bool is_map, int max_depth)
+{
+    // Each item takes at least 1 byte, so this rejects bogus sizes early.
+    if (num > src->len)
+        return -1;
+    struct mpv_node_list *list = talloc_zero(ta_parent, struct mpv_node_list);
+    list->values = talloc_array(list, struct mpv_node, num);
+    if (is_map)
+        list->keys = talloc_array(list, char *, num);
+    for (int n = 0; n < num; n++) {
+        if (is_map) {
+            struct mpv_node key;
+            if (msgpack_parse(list, &key, src, max_depth) < 0 ||
+                key.format != MPV_FORMAT_STRING)
+                return -1; // key is not a string
+            list->keys[n] = key.u.string;
+        }
+        if (msgpack_parse(list, &list->values[n], src, max_depth) < 0)
+            return -1;
+        list->num++;
+    }
+    dst->format = is_map ? MPV_FORMAT_NODE_MAP : MPV_FORMAT_NODE_ARRAY;
+    dst->u.list = list;
+    return 0;
+}
+
+/* Parse one MessagePack value at the start of *src, and write the result into
+ * *dst. max_depth limits the recursion and tree depth.
+ * Returns:
+ *   0: success, *dst is valid, *src is advanced to the end of the value
+ *  -1: failure (invalid or truncated data), *dst is invalid, there may be
+ *      dead allocs under ta_parent
+ */
+int msgpack_parse(void *ta_parent, struct mpv_node *dst, struct bstr *src,
+                  int max_depth)
+{
+    max_depth -= 1;
+    if (max_depth < 0)
+        return -1;
+
+    uint8_t c;
+    if (!read_bytes(src, &c, 1))
+        return -1; // early EOF
+
+    uint64_t len;
+    int64_t i;
+
+    if (c <= 0x7f || c >= 0xe0) {
+        dst->format = MPV_FORMAT_INT64;
+        dst->u.int64 = (int8_t)c;
+        return 0;
+    } else if (c >= 0xa0 && c <= 0xbf) {
+        len = c & 0x1f;
+        goto str;
+    } else if (c >= 0x90 && c <= 0x9f) {
+        return read_list(ta_parent, dst, src, c & 0xf, false, max_depth);
+    } else if (c >= 0x80 && c <= 0x8f) {
+        return read_list(ta_parent, dst, src, c & 0xf, true, max_depth);
+    }
+
+    switch (c) {
+    case 0xc0:
+        dst->format = MPV_FORMAT_NONE;
+        return 0;
+    case 0xc2:
+    case 0xc3:
+        dst->format = MPV_FORMAT_FLAG;
+        dst->u.flag = c == 0xc3;
+        return 0;
+    case 0xc4:
+    case 0xc5:
+    case 0xc6: {
+        if (!read_uint(src, 1 << (c - 0xc4), &len) || src->len < len)
+            return -1;
+        struct mpv_byte_array *ba = talloc_zero(ta_parent, struct mpv_byte_array);
+        ba->data = talloc_memdup(ba, src->start, len);
+        ba->size = len;
+        *src = bstr_cut(*src, len);
+        dst->format = MPV_FORMAT_BYTE_ARRAY;
+        dst->u.ba = ba;
+        return 0;
+    }
+    case 0xca: {
+        uint64_t v;
+        if (!read_uint(src, 4, &v))
+            return -1;
+        uint32_t v32 = v;
+        float f;
+        memcpy(&f, &v32, sizeof(f));
+        dst->format = MPV_FORMAT_DOUBLE;
+        dst->u.double_ = f;
+        return 0;
+    }
+    case 0xcb: {
+        uint64_t v;
+        if (!read_uint(src, 8, &v))
+            return -1;
+        dst->format = MPV_FORMAT_DOUBLE;
+        memcpy(&dst->u.double_, &v, sizeof(double));
+        return 0;
+    }
+    case 0xcc:
+    case 0xcd:
+    case 0xce:
+    case 0xcf: {
+        uint64_t v;
+        if (!read_uint(src, 1 << (c - 0xcc), &v) || v > INT64_MAX)
+            return -1;
+        dst->format = MPV_FORMAT_INT64;
+        dst->u.int64 = v;
+        return 0;
+    }
+    case 0xd0:
+    case 0xd1:
+    case 0xd2:
+    case 0xd3:
+        if (!read_int(src, 1 << (c - 0xd0), &i))
+            return -1;
+        dst->format = MPV_FORMAT_INT64;
+        dst->u.int64 = i;
+        return 0;
+    case 0xd9:
+    case 0xda:
+    case 0xdb:
+        if (!read_uint(src, 1 << (c - 0xd9), &len))
+            return -1;
+        goto str;
+    case 0xdc:
+    case 0xdd:
+        if (!read_uint(src, c == 0xdc ? 2 : 4, &len))
+            return -1;
+        return read_list(ta_parent, dst, src, len, false, max_depth);
+    case 0xde:
+    case 0xdf:
+        if (!read_uint(src, c == 0xde ? 2 : 4, &len))
+            return -1;
+        return read_list(ta_parent, dst, src, len, true, max_depth);
+    }
+    return -1; // unsupported type
+
+str:
+    dst->format = MPV_FORMAT_STRING;
+    dst->u.string = read_str(ta_parent, src, len);
+    return dst->u.string ? 0 : -1;
+}
+
+static void write_bytes(struct bstr *b, const void *data, size_t len)
+{
+    bstr_xappend(NULL, b, (struct bstr){(unsigned char *)data, len});
+}
+
+// Write the type byte c, followed by v as big endian integer of the given size.
+static void write_typed_uint(struct bstr *b, uint8_t c, int bytes, uint64_t v)
+{
+    uint8_t buf[9] = {c};
+    for (int n = 0; n < bytes; n++)
+        buf[1 + n] = v >> ((bytes - 1 - n) * 8);
+    write_bytes(b, buf, 1 + bytes);
+}
+
+static void write_int(struct bstr *b, int64_t v)
+{
+    if (v >= -32 && v <= 127) {
+        write_bytes(b, &(uint8_t){v}, 1);
+    } else if (v >= INT8_MIN && v <= INT8_MAX) {
+        write_typed_uint(b, 0xd0, 1, v);
+    } else if (v >= INT16_MIN && v <= INT16_MAX) {
+        write_typed_uint(b, 0xd1, 2, v);
+    } else if (v >= INT32_MIN && v <= INT32_MAX) {
+        write_typed_uint(b, 0xd2, 4, v);
+    } else {
+        write_typed_uint(b, 0xd3, 8, v);
+    }
+}
+
+// Write the header of a str/bin/array/map with the given type bytes. fix is
+// the type of the "fix" variant (0 if none), and fix_max its maximum length.
+static void write_len(struct bstr *b, uint64_t len, int fix, uint64_t fix_max,
+                      int c8, int c16, int c32)
+{
+    if (fix && len <= fix_max) {
+        write_bytes(b, &(uint8_t){fix | len}, 1);
+    } else if (c8 && len <= UINT8_MAX) {
+        write_typed_uint(b, c8, 1, len);
+    } else if (len <= UINT16_MAX) {
+        write_typed_uint(b, c16, 2, len);
+    } else {
+        write_typed_uint(b, c32, 4, len);
+    }
+}
+
+static void write_str(struct bstr *b, const char *s)
+{
+    size_t len = strlen(s);
+    write_len(b, len, 0xa0, 31, 0xd9, 0xda, 0xdb);
+    write_bytes(b, s, len);
+}
+
+/* Append the contents of *src as MessagePack to *b (bstr_xappend() is used
+ * to extend the allocation).
+ * Returns: 0 on success, <0 on failure.
+ */
+int msgpack_append(struct bstr *b, const struct mpv_node *src)
+{
+    switch (src->format) {
+    case MPV_FORMAT_NONE:
+        write_bytes(b, &(uint8_t){0xc0}, 1);
+        return 0;
+    case MPV_FORMAT_FLAG:
+        write_bytes(b, &(uint8_t){src->u.flag ? 0xc3 : 0xc2}, 1);
+        return 0;
+    case MPV_FORMAT_INT64:
+        write_int(b, src->u.int64);
+        return 0;
+    case MPV_FORMAT_DOUBLE: {
+        uint64_t v;
+        memcpy(&v, &src->u.double_, sizeof(v));
+        write_typed_uint(b, 0xcb, 8, v);
+        return 0;
+    }
+    case MPV_FORMAT_STRING:
+        write_str(b, src->u.string);
+        return 0;
+    case MPV_FORMAT_BYTE_ARRAY:
+        write_len(b, src->u.ba->size, 0, 0, 0xc4, 0xc5, 0xc6);
+        write_bytes(b, src->u.ba->data, src->u.ba->size);
+        return 0;
+    case MPV_FORMAT_NODE_ARRAY:
+    case MPV_FORMAT_NODE_MAP: {
+        struct mpv_node_list *list = src->u.list;
+        bool is_map = src->format == MPV_FORMAT_NODE_MAP;
+        if (is_map) {
+            write_len(b, list->num, 0x80, 15, 0, 0xde, 0xdf);
+        } else {
+            write_len(b, list->num, 0x90, 15, 0, 0xdc, 0xdd);
+        }
+        for (int n = 0; n < list->num; n++) {
+            if (is_map)
+                write_str(b, list->keys[n]);
+            if (msgpack_append(b, &list->values[n]) < 0)
+                return -1;
+        }
+        return 0;
+    }
+    }
+    return -1; // unknown format
+}
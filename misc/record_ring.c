@@ -0,0 +1,138 @@
+/*
+ * This file is part of mpv.
+ *
+ * mpv is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * mpv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Producers reserve space by advancing head, and commit the record by setting
+ * its size. The consumer zeroes the records it has processed and then
+ * advances tail. The ring consists of bytes which are all zero if not used,
+ * so a record becomes visible to the consumer only when its size is set.
+ */
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "common/common.h"
+#include "mpv_talloc.h"
+
+#include "record_ring.h"
+
+struct record_header {
+    _Atomic uint32_t size;  // total size, including padding; 0 if in progress
+    uint32_t skip;          // padding up to the start of the ring
+};
+
+// All records are a multiple of this, so the space left at the end of the
+// ring always fits at least a header.
+#define RECORD_ALIGN 16
+
+static_assert((RECORD_ALIGN & (RECORD_ALIGN - 1)) == 0,
+              "RECORD_ALIGN must be a power of 2");
+static_assert(RECORD_ALIGN >= sizeof(struct record_header), "");
+
+struct mp_record_ring {
+    _Atomic uint64_t head;
+    _Atomic uint64_t tail;
+    _Atomic uint64_t dropped;
+    size_t size;
+    unsigned char *data;
+};
+
+struct mp_record_ring *mp_record_ring_create(void *ta_parent, size_t size)
+{
+    mp_assert(size >= RECORD_ALIGN * 8 && (size & (size - 1)) == 0);
+    struct mp_record_ring *ring = talloc_zero(ta_parent, struct mp_record_ring);
+    ring->size = size;
+    ring->data = talloc_zero_size(ring, size);
+    return ring;
+}
+
+size_t mp_record_ring_max_size(struct mp_record_ring *ring)
+{
+    return ring->size / 8 - sizeof(struct record_header);
+}
+
+static struct record_header *get_header(struct mp_record_ring *ring,
+                                        uint64_t pos)
+{
+    return (void *)(ring->data + (pos & (ring->size - 1)));
+}
+
+void *mp_record_ring_reserve(struct mp_record_ring *ring, size_t size)
+{
+    mp_assert(size <= mp_record_ring_max_size(ring));
+    size = MP_ALIGN_UP(sizeof(struct record_header) + size, RECORD_ALIGN);
+
+    uint64_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    uint64_t pad;
+    do {
+        uint64_t offset = head & (ring->size - 1);
+        pad = offset + size > ring->size ? ring->size - offset : 0;
+        // Acquire: the consumer's zeroing must be visible before we write.
+        uint64_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+        if (head + pad + size - tail > ring->size) {
+            atomic_fetch_add(&ring->dropped, 1);
+            return NULL;
+        }
+    } while (!atomic_compare_exchange_weak_explicit(&ring->head, &head,
+                                                    head + pad + size,
+                                                    memory_order_relaxed,
+                                                    memory_order_relaxed));
+
+    if (pad) {
+        struct record_header *h = get_header(ring, head);
+        h->skip = 1;
+        atomic_store_explicit(&h->size, pad, memory_order_release);
+        head += pad;
+    }
+
+    struct record_header *h = get_header(ring, head);
+    // Stash the size until the record is committed.
+    h->skip = size;
+    return h + 1;
+}
+
+void mp_record_ring_commit(struct mp_record_ring *ring, void *record)
+{
+    struct record_header *h = (struct record_header *)record - 1;
+    uint32_t size = h->skip;
+    h->skip = 0;
+    atomic_store_explicit(&h->size, size, memory_order_release);
+}
+
+void mp_record_ring_drain(struct mp_record_ring *ring,
+                          void (*cb)(void *ctx, void *record), void *ctx)
+{
+    uint64_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    while (1) {
+        struct record_header *h = get_header(ring, tail);
+        uint32_t size = atomic_load_explicit(&h->size, memory_order_acquire);
+        if (!size)
+            break; // empty, or the producer did not finish writing yet
+        if (!h->skip)
+            cb(ctx, h + 1);
+        // Restore the all-zero state before handing the space back.
+        memset((char *)h + sizeof(h->size), 0, size - sizeof(h->size));
+        atomic_store_explicit(&h->size, 0, memory_order_relaxed);
+        tail += size;
+        atomic_store_explicit(&ring->tail, tail, memory_order_release);
+    }
+}
+
+uint64_t mp_record_ring_take_dropped(struct mp_record_ring *ring)
+{
+    return atomic_exchange(&ring->dropped, 0);
+}
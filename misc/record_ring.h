@@ -0,0 +1,40 @@
+#ifndef MPV_MP_RECORD_RING_H
+#define MPV_MP_RECORD_RING_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Lock-free multi-producer single-consumer ring of variable-sized records.
+struct mp_record_ring;
+
+// Create a ring of size bytes (must be a power of 2). Free it with
+// talloc_free(ring), or indirectly with talloc_free(ta_parent).
+struct mp_record_ring *mp_record_ring_create(void *ta_parent, size_t size);
+
+// Maximum size that can be passed to mp_record_ring_reserve().
+size_t mp_record_ring_max_size(struct mp_record_ring *ring);
+
+// Reserve space for a record of size bytes. Returns a pointer to zeroed
+// memory, which is aligned for any type that fits into 8 bytes. If the ring
+// is full, the record is counted as dropped, and NULL is returned.
+// size must be at most mp_record_ring_max_size().
+// This function is thread-safe.
+void *mp_record_ring_reserve(struct mp_record_ring *ring, size_t size);
+
+// Make a record returned by mp_record_ring_reserve() visible to the consumer.
+// Records are consumed in the order they were reserved, so a record that is
+// not committed yet holds back all following records.
+// This function is thread-safe.
+void mp_record_ring_commit(struct mp_record_ring *ring, void *record);
+
+// Call cb(ctx, record) for all committed records, in order, and release their
+// space. Stops at the first record that is not committed yet. Only one thread
+// at a time may call this.
+void mp_record_ring_drain(struct mp_record_ring *ring,
+                          void (*cb)(void *ctx, void *record), void *ctx);
+
+// Return the number of records dropped since the last call, and reset it.
+// This function is thread-safe.
+uint64_t mp_record_ring_take_dropped(struct mp_record_ring *ring);
+
+#endif
@@ -0,0 +1,144 @@
+/*
+ * This file is part of mpv.
+ *
+ * mpv is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * mpv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Writer side of the shared memory telemetry snapshot (see mpv/telemetry.h).
+ *
+ * This is a seqlock with a single writer: the sequence counter is made odd,
+ * the snapshot is overwritten, and the counter is made even again. Readers
+ * copy the snapshot and retry if the counter was odd or changed meanwhile.
+ */
+
+#include <errno.h>
+#include <stdatomic.h>
+#include <string.h>
+
+#include <mpv/telemetry.h>
+
+#include "config.h"
+
+#if HAVE_POSIX
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "common/common.h"
+#include "common/msg.h"
+#include "mpv_talloc.h"
+
+#include "telemetry.h"
+
+struct mp_telemetry {
+    struct mp_log *log;
+    mpv_telemetry_shm *shm;
+    int fd;
+    uint64_t update_count;
+};
+
+// The public struct uses plain integers so that it works in C++; they are
+// only ever accessed atomically.
+static_assert(sizeof(_Atomic uint32_t) == sizeof(uint32_t), "");
+#define SHM_ATOMIC(field) ((_Atomic uint32_t *)&(field))
+
+static void write_snapshot(mpv_telemetry_shm *shm,
+                           const mpv_telemetry_snapshot *snap)
+{
+    _Atomic uint32_t *seq_ptr = SHM_ATOMIC(shm->seq);
+    uint32_t seq = atomic_load_explicit(seq_ptr, memory_order_relaxed);
+    atomic_store_explicit(seq_ptr, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    memcpy(&shm->snapshot, snap, sizeof(*snap));
+    atomic_store_explicit(seq_ptr, seq + 2, memory_order_release);
+}
+
+#if HAVE_POSIX
+
+static void destroy(void *ptr)
+{
+    struct mp_telemetry *t = ptr;
+    mpv_telemetry_snapshot snap = t->shm->snapshot;
+    snap.flags &= ~MPV_TELEMETRY_ACTIVE;
+    write_snapshot(t->shm, &snap);
+    munmap(t->shm, sizeof(*t->shm));
+    close(t->fd);
+}
+
+struct mp_telemetry *mp_telemetry_create(void *ta_parent, struct mp_log *log,
+                                         const char *path)
+{
+    int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        mp_err(log, "Could not open telemetry file '%s': %s\n", path,
+               mp_strerror(errno));
+        return NULL;
+    }
+
+    // Truncating first makes sure stale contents of an older player are not
+    // visible with a valid magic value while the header is rewritten.
+    if (ftruncate(fd, 0) < 0 || ftruncate(fd, sizeof(mpv_telemetry_shm)) < 0) {
+        mp_err(log, "Could not resize telemetry file '%s': %s\n", path,
+               mp_strerror(errno));
+        close(fd);
+        return NULL;
+    }
+
+    mpv_telemetry_shm *shm = mmap(NULL, sizeof(*shm), PROT_READ | PROT_WRITE,
+                                  MAP_SHARED, fd, 0);
+    if (shm == MAP_FAILED) {
+        mp_err(log, "Could not map telemetry file '%s': %s\n", path,
+               mp_strerror(errno));
+        close(fd);
+        return NULL;
+    }
+
+    shm->version = MPV_TELEMETRY_VERSION;
+    shm->snapshot_size = sizeof(shm->snapshot);
+    shm->pid = getpid();
+    atomic_store_explicit(SHM_ATOMIC(shm->seq), 0, memory_order_relaxed);
+    atomic_store_explicit(SHM_ATOMIC(shm->magic), MPV_TELEMETRY_MAGIC,
+                          memory_order_release);
+
+    struct mp_telemetry *t = talloc_ptrtype(ta_parent, t);
+    *t = (struct mp_telemetry){
+        .log = log,
+        .shm = shm,
+        .fd = fd,
+    };
+    talloc_set_destructor(t, destroy);
+
+    mp_verbose(log, "Publishing telemetry to '%s'.\n", path);
+    return t;
+}
+
+#else
+
+struct mp_telemetry *mp_telemetry_create(void *ta_parent, struct mp_log *log,
+                                         const char *path)
+{
+    mp_err(log, "Telemetry output is not supported on this platform.\n");
+    return NULL;
+}
+
+#endif
+
+void mp_telemetry_publish(struct mp_telemetry *t,
+                          struct mpv_telemetry_snapshot *snap)
+{
+    snap->update_count = ++t->update_count;
+    snap->flags |= MPV_TELEMETRY_ACTIVE;
+    write_snapshot(t->shm, snap);
+}
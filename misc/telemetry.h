@@ -0,0 +1,37 @@
+/*
+ * This file is part of mpv.
+ *
+ * mpv is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * mpv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MP_TELEMETRY_H
+#define MP_TELEMETRY_H
+
+struct mp_log;
+struct mp_telemetry;
+struct mpv_telemetry_snapshot;
+
+// Create (or truncate) the file at path, map it, and initialize it with an
+// empty snapshot. Returns NULL on failure. Freeing the returned object clears
+// MPV_TELEMETRY_ACTIVE in the published snapshot and unmaps the file, but
+// does not remove it.
+struct mp_telemetry *mp_telemetry_create(void *ta_parent, struct mp_log *log,
+                                         const char *path);
+
+// Publish a new snapshot. Sets snap->update_count and MPV_TELEMETRY_ACTIVE.
+// Must not be called concurrently on the same object.
+void mp_telemetry_publish(struct mp_telemetry *t,
+                          struct mpv_telemetry_snapshot *snap);
+
+#endif
@@ -13,6 +13,8 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#include <stdatomic.h>
+
 #include "common/common.h"
 #include "osdep/threads.h"
 #include "osdep/timer.h"
@@ -61,6 +63,7 @@ static MP_THREAD_VOID worker_thread(void *arg)
     while (1) {
         struct work work = {0};
         if (pool->num_work > 0) {
+            // New work is inserted at the start, so this is the oldest item.
             work = pool->work[pool->num_work - 1];
             pool->num_work -= 1;
         }
@@ -221,3 +224,66 @@ bool mp_thread_pool_run(struct mp_thread_pool *pool, void (*fn)(void *ctx),
 {
     return thread_pool_add(pool, fn, fn_ctx, false);
 }
+
+struct run_all {
+    void (*fn)(void *ctx, int index);
+    void *fn_ctx;
+    int num;
+    atomic_int next;
+
+    mp_mutex lock;
+    mp_cond wakeup;
+    int pending;    // number of queued helper jobs not yet finished
+};
+
+static void run_all_indices(struct run_all *ra)
+{
+    int index;
+    while ((index = atomic_fetch_add(&ra->next, 1)) < ra->num)
+        ra->fn(ra->fn_ctx, index);
+}
+
+static void run_all_helper(void *ctx)
+{
+    struct run_all *ra = ctx;
+    run_all_indices(ra);
+
+    mp_mutex_lock(&ra->lock);
+    if (--ra->pending == 0)
+        mp_cond_signal(&ra->wakeup);
+    mp_mutex_unlock(&ra->lock);
+}
+
+void mp_thread_pool_run_all(struct mp_thread_pool *pool, int num,
+                            void (*fn)(void *ctx, int index), void *fn_ctx)
+{
+    struct run_all ra = {
+        .fn = fn,
+        .fn_ctx = fn_ctx,
+        .num = num,
+    };
+    mp_mutex_init(&ra.lock);
+    mp_cond_init(&ra.wakeup);
+
+    for (int n = 1; n < num && pool; n++) {
+        mp_mutex_lock(&ra.lock);
+        ra.pending++;
+        mp_mutex_unlock(&ra.lock);
+        if (!mp_thread_pool_run(pool, run_all_helper, &ra)) {
+            mp_mutex_lock(&ra.lock);
+            ra.pending--;
+            mp_mutex_unlock(&ra.lock);
+            break;
+        }
+    }
+
+    run_all_indices(&ra);
+
+    mp_mutex_lock(&ra.lock);
+    while (ra.pending)
+        mp_cond_wait(&ra.wakeup, &ra.lock);
+    mp_mutex_unlock(&ra.lock);
+
+    mp_cond_destroy(&ra.wakeup);
+    mp_mutex_destroy(&ra.lock);
+}
@@ -19,7 +19,8 @@ struct mp_thread_pool *mp_thread_pool_create(void *ta_parent, int init_threads,
 
 // Queue a function to be run on a worker thread: fn(fn_ctx)
 // If no worker thread is currently available, it's appended to a list in memory
-// with unbounded size. This function always returns immediately.
+// with unbounded size. Queued items are started in FIFO order. This function
+// always returns immediately.
 // Concurrent queue calls are allowed, as long as it does not overlap with
 // pool destruction.
 // This function is explicitly thread-safe.
@@ -32,4 +33,13 @@ bool mp_thread_pool_queue(struct mp_thread_pool *pool, void (*fn)(void *ctx),
 bool mp_thread_pool_run(struct mp_thread_pool *pool, void (*fn)(void *ctx),
                         void *fn_ctx);
 
+// Run fn(fn_ctx, index) for each index in [0, num), and return once all calls
+// have finished. The calling thread takes part in the work, and up to num-1
+// pool threads help with it, so this works with any pool size (including a
+// NULL pool, in which case everything runs on the calling thread).
+// Which thread gets which index is unspecified, so fn must only depend on the
+// index for the results to be deterministic.
+void mp_thread_pool_run_all(struct mp_thread_pool *pool, int num,
+                            void (*fn)(void *ctx, int index), void *fn_ctx);
+
 #endif
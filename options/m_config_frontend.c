@@ -29,6 +29,7 @@
 #include "common/common.h"
 #include "common/msg_control.h"
 #include "common/msg.h"
+#include "common/trace.h"
 #include "m_config_frontend.h"
 #include "m_config.h"
 #include "misc/dispatch.h"
@@ -1008,6 +1009,12 @@ int m_config_set_profile(struct m_config *config, char *name, int flags)
         config->profile_backup_flags = p->restore_mode == 2 ? BACKUP_NVAL : 0;
     }
 
+    char *trace_name = NULL;
+    if (config->global) {
+        trace_name = talloc_asprintf(NULL, "profile/%s", name);
+        trace_begin(config->global, trace_name);
+    }
+
     char *profile_name = talloc_strdup(NULL, name);
     // Note that we don't check if profile applied correctly, it doesn't matter.
     MP_TARRAY_APPEND(config, config->profile_stack, config->profile_stack_depth, profile_name);
@@ -1031,6 +1038,11 @@ int m_config_set_profile(struct m_config *config, char *name, int flags)
         }
     }
 
+    if (trace_name) {
+        trace_end(config->global, trace_name);
+        talloc_free(trace_name);
+    }
+
     return 0;
 }
 
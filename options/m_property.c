@@ -35,16 +35,15 @@
 #include "common/common.h"
 #include "player/client.h"
 
-static int do_action(const struct m_property *prop_list, const char *name,
+static int do_action(const struct m_property_index *props, const char *name,
                      int action, void *arg, void *ctx)
 {
     struct m_property *prop;
     struct m_property_action_arg ka;
     const char *sep = strchr(name, '/');
     if (sep && sep[1]) {
-        char base[128];
-        snprintf(base, sizeof(base), "%.*s", (int)(sep - name), name);
-        prop = m_property_list_find(prop_list, base);
+        bstr base = bstr_splice(bstr0(name), 0, sep - name);
+        prop = m_property_index_find(props, base);
         ka = (struct m_property_action_arg) {
             .key = sep + 1,
             .action = action,
@@ -53,14 +52,14 @@ static int do_action(const struct m_property *prop_list, const char *name,
         action = M_PROPERTY_KEY_ACTION;
         arg = &ka;
     } else
-        prop = m_property_list_find(prop_list, name);
+        prop = m_property_index_find(props, bstr0(name));
     if (!prop)
         return M_PROPERTY_UNKNOWN;
     return prop->call(ctx, prop, action, arg);
 }
 
 static int m_property_multiply(struct mp_log *log,
-                               const struct m_property *prop_list,
+                               const struct m_property_index *props,
                                const char *property, double f, void *ctx,
                                struct m_option *opt)
 {
@@ -71,17 +70,17 @@ static int m_property_multiply(struct mp_log *log,
     if (!opt->type->multiply)
         return M_PROPERTY_NOT_IMPLEMENTED;
 
-    r = m_property_do(log, prop_list, property, M_PROPERTY_GET, &val, ctx);
+    r = m_property_do(log, props, property, M_PROPERTY_GET, &val, ctx);
     if (r != M_PROPERTY_OK)
         return r;
     opt->type->multiply(opt, &val, f);
-    r = m_property_do(log, prop_list, property, M_PROPERTY_SET, &val, ctx);
+    r = m_property_do(log, props, property, M_PROPERTY_SET, &val, ctx);
     m_option_free(opt, &val);
     return r;
 }
 
 static int m_property_switch(struct mp_log *log,
-                             const struct m_property *prop_list,
+                             const struct m_property_index *props,
                              const char *property, void *arg, void *ctx,
                              struct m_option *opt)
 {
@@ -90,32 +89,77 @@ static int m_property_switch(struct mp_log *log,
 
     mp_require(log);
     struct m_property_switch_arg *sarg = arg;
-    if ((r = do_action(prop_list, property, M_PROPERTY_SWITCH, arg, ctx)) !=
+    if ((r = do_action(props, property, M_PROPERTY_SWITCH, arg, ctx)) !=
         M_PROPERTY_NOT_IMPLEMENTED)
         return r;
     // Fallback to m_option
     if (!opt->type->add)
         return M_PROPERTY_NOT_IMPLEMENTED;
-    if ((r = do_action(prop_list, property, M_PROPERTY_GET, &val, ctx)) <= 0)
+    if ((r = do_action(props, property, M_PROPERTY_GET, &val, ctx)) <= 0)
         return r;
     opt->type->add(opt, &val, sarg->inc, sarg->wrap);
-    r = do_action(prop_list, property, M_PROPERTY_SET, &val, ctx);
+    r = do_action(props, property, M_PROPERTY_SET, &val, ctx);
     m_option_free(opt, &val);
     return r;
 }
 
-struct m_property *m_property_list_find(const struct m_property *list,
-                                        const char *name)
+struct m_property_index {
+    struct m_property *list;
+    // Open addressing hash table of list indexes + 1 (0 means unused).
+    int *table;
+    uint32_t mask;
+};
+
+static uint32_t hash_name(bstr name)
 {
-    for (int n = 0; list && list[n].name; n++) {
-        if (strcmp(list[n].name, name) == 0)
-            return (struct m_property *)&list[n];
+    // FNV-1a
+    uint32_t h = 2166136261u;
+    for (int n = 0; n < name.len; n++)
+        h = (h ^ name.start[n]) * 16777619u;
+    return h;
+}
+
+struct m_property_index *m_property_index_create(void *ta_parent,
+                                                 struct m_property *list)
+{
+    struct m_property_index *index = talloc_zero(ta_parent,
+                                                 struct m_property_index);
+    index->list = list;
+
+    int count = 0;
+    while (list[count].name)
+        count++;
+    uint32_t size = mp_round_next_power_of_2(MPMAX(count, 8) * 2);
+    index->table = talloc_zero_array(index, int, size);
+    index->mask = size - 1;
+
+    for (int n = 0; n < count; n++) {
+        if (m_property_index_find(index, bstr0(list[n].name)))
+            continue; // keep the first entry, like a linear search would
+        uint32_t pos = hash_name(bstr0(list[n].name)) & index->mask;
+        while (index->table[pos])
+            pos = (pos + 1) & index->mask;
+        index->table[pos] = n + 1;
+    }
+
+    return index;
+}
+
+struct m_property *m_property_index_find(const struct m_property_index *index,
+                                         bstr name)
+{
+    uint32_t pos = hash_name(name) & index->mask;
+    while (index->table[pos]) {
+        struct m_property *prop = &index->list[index->table[pos] - 1];
+        if (bstr_equals0(name, prop->name))
+            return prop;
+        pos = (pos + 1) & index->mask;
     }
     return NULL;
 }
 
 // (as a hack, log can be NULL on read-only paths)
-int m_property_do(struct mp_log *log, const struct m_property *prop_list,
+int m_property_do(struct mp_log *log, const struct m_property_index *props,
                   const char *name, int action, void *arg, void *ctx)
 {
     union m_option_value val = m_option_value_default;
@@ -128,13 +172,13 @@ int m_property_do(struct mp_log *log, const struct m_property *prop_list,
         [M_PROPERTY_GET_NODE] = true, [M_PROPERTY_SET_NODE] = true,
     };
     if (get_opt_required[action]) {
-        r = do_action(prop_list, name, M_PROPERTY_GET_TYPE, &opt, ctx);
+        r = do_action(props, name, M_PROPERTY_GET_TYPE, &opt, ctx);
         if (r <= 0)
             return r;
         mp_assert(opt.type);
         // Make sure dynamic range from properties with M_PROPERTY_GET_CONSTRICTED_TYPE is applied
         struct m_option copt = {0};
-        r = do_action(prop_list, name, M_PROPERTY_GET_CONSTRICTED_TYPE, &copt, ctx);
+        r = do_action(props, name, M_PROPERTY_GET_CONSTRICTED_TYPE, &copt, ctx);
         if (r == M_PROPERTY_OK) {
             opt.min = copt.min;
             opt.max = copt.max;
@@ -144,10 +188,10 @@ int m_property_do(struct mp_log *log, const struct m_property *prop_list,
     switch (action) {
     case M_PROPERTY_FIXED_LEN_PRINT:
     case M_PROPERTY_PRINT: {
-        if ((r = do_action(prop_list, name, action, arg, ctx)) >= 0)
+        if ((r = do_action(props, name, action, arg, ctx)) >= 0)
             return r;
         // Fallback to m_option
-        if ((r = do_action(prop_list, name, M_PROPERTY_GET, &val, ctx)) <= 0)
+        if ((r = do_action(props, name, M_PROPERTY_GET, &val, ctx)) <= 0)
             return r;
         char *str = m_option_pretty_print(&opt, &val, action == M_PROPERTY_FIXED_LEN_PRINT);
         m_option_free(&opt, &val);
@@ -155,7 +199,7 @@ int m_property_do(struct mp_log *log, const struct m_property *prop_list,
         return str != NULL;
     }
     case M_PROPERTY_GET_STRING: {
-        if ((r = do_action(prop_list, name, M_PROPERTY_GET, &val, ctx)) <= 0)
+        if ((r = do_action(props, name, M_PROPERTY_GET, &val, ctx)) <= 0)
             return r;
         char *str = m_option_print(&opt, &val);
         m_option_free(&opt, &val);
@@ -164,30 +208,30 @@ int m_property_do(struct mp_log *log, const struct m_property *prop_list,
     }
     case M_PROPERTY_SET_STRING: {
         struct mpv_node node = { .format = MPV_FORMAT_STRING, .u.string = arg };
-        return m_property_do(log, prop_list, name, M_PROPERTY_SET_NODE, &node, ctx);
+        return m_property_do(log, props, name, M_PROPERTY_SET_NODE, &node, ctx);
     }
     case M_PROPERTY_MULTIPLY: {
-        return m_property_multiply(log, prop_list, name, *(double *)arg, ctx, &opt);
+        return m_property_multiply(log, props, name, *(double *)arg, ctx, &opt);
     }
     case M_PROPERTY_SWITCH: {
-        return m_property_switch(log, prop_list, name, arg, ctx, &opt);
+        return m_property_switch(log, props, name, arg, ctx, &opt);
     }
     case M_PROPERTY_GET_CONSTRICTED_TYPE: {
-        r = do_action(prop_list, name, action, arg, ctx);
+        r = do_action(props, name, action, arg, ctx);
         if (r >= 0 || r == M_PROPERTY_UNAVAILABLE)
             return r;
-        if ((r = do_action(prop_list, name, M_PROPERTY_GET_TYPE, arg, ctx)) >= 0)
+        if ((r = do_action(props, name, M_PROPERTY_GET_TYPE, arg, ctx)) >= 0)
             return r;
         return M_PROPERTY_NOT_IMPLEMENTED;
     }
     case M_PROPERTY_SET: {
-        return do_action(prop_list, name, M_PROPERTY_SET, arg, ctx);
+        return do_action(props, name, M_PROPERTY_SET, arg, ctx);
     }
     case M_PROPERTY_GET_NODE: {
-        if ((r = do_action(prop_list, name, M_PROPERTY_GET_NODE, arg, ctx)) !=
+        if ((r = do_action(props, name, M_PROPERTY_GET_NODE, arg, ctx)) !=
             M_PROPERTY_NOT_IMPLEMENTED)
             return r;
-        if ((r = do_action(prop_list, name, M_PROPERTY_GET, &val, ctx)) <= 0)
+        if ((r = do_action(props, name, M_PROPERTY_GET, &val, ctx)) <= 0)
             return r;
         struct mpv_node *node = arg;
         int err = m_option_get_node(&opt, NULL, node, &val);
@@ -204,7 +248,7 @@ int m_property_do(struct mp_log *log, const struct m_property *prop_list,
     case M_PROPERTY_SET_NODE: {
         if (!log)
             return M_PROPERTY_ERROR;
-        if ((r = do_action(prop_list, name, M_PROPERTY_SET_NODE, arg, ctx)) !=
+        if ((r = do_action(props, name, M_PROPERTY_SET_NODE, arg, ctx)) !=
             M_PROPERTY_NOT_IMPLEMENTED)
             return r;
         int err = m_option_set_node_or_string(log, &opt, bstr0(name), &val, arg);
@@ -213,13 +257,13 @@ int m_property_do(struct mp_log *log, const struct m_property *prop_list,
         } else if (err < 0) {
             r = M_PROPERTY_INVALID_FORMAT;
         } else {
-            r = do_action(prop_list, name, M_PROPERTY_SET, &val, ctx);
+            r = do_action(props, name, M_PROPERTY_SET, &val, ctx);
         }
         m_option_free(&opt, &val);
         return r;
     }
     default:
-        return do_action(prop_list, name, action, arg, ctx);
+        return do_action(props, name, action, arg, ctx);
     }
 }
 
@@ -250,11 +294,11 @@ static void m_property_unkey(int *action, void **arg)
     }
 }
 
-static int m_property_do_bstr(const struct m_property *prop_list, bstr name,
+static int m_property_do_bstr(const struct m_property_index *props, bstr name,
                               int action, void *arg, void *ctx)
 {
     char *name0 = bstrdup0(NULL, name);
-    int ret = m_property_do(NULL, prop_list, name0, action, arg, ctx);
+    int ret = m_property_do(NULL, props, name0, action, arg, ctx);
     talloc_free(name0);
     return ret;
 }
@@ -267,7 +311,7 @@ static void append_str(char **s, int *len, bstr append)
     *len = *len + append.len;
 }
 
-static int expand_property(const struct m_property *prop_list, char **ret,
+static int expand_property(const struct m_property_index *props, char **ret,
                            int *ret_len, bstr prop, bool silent_error, void *ctx)
 {
     bool cond_yes = bstr_eatstart0(&prop, "?");
@@ -283,7 +327,7 @@ static int expand_property(const struct m_property *prop_list, char **ret,
     method = fixed_len ? M_PROPERTY_FIXED_LEN_PRINT : method;
 
     char *s = NULL;
-    int r = m_property_do_bstr(prop_list, prop, method, &s, ctx);
+    int r = m_property_do_bstr(props, prop, method, &s, ctx);
     bool skip;
     if (comp) {
         skip = ((s && bstr_equals0(comp_with, s)) != cond_yes);
@@ -300,7 +344,7 @@ static int expand_property(const struct m_property *prop_list, char **ret,
     return skip;
 }
 
-char *m_properties_expand_string(const struct m_property *prop_list,
+char *m_properties_expand_string(const struct m_property_index *props,
                                  const char *str0, void *ctx)
 {
     char *ret = NULL;
@@ -334,7 +378,7 @@ char *m_properties_expand_string(const struct m_property *prop_list,
 #endif
 
             if (!skip) {
-                skip = expand_property(prop_list, &ret, &ret_len, name,
+                skip = expand_property(props, &ret, &ret_len, name,
                                        have_fallback, ctx);
                 if (skip)
                     skip_level = level;
@@ -565,6 +609,67 @@ int m_property_read_sub(const struct m_sub_property *props, int action, void *ar
 // count: number of items.
 // get_item: callback to access a single item.
 // ctx: userdata passed to get_item.
+// Return the items [start, start + count) as node array.
+static struct mpv_node get_list_node(int start, int count,
+                                     m_get_item_cb get_item, void *ctx)
+{
+    struct mpv_node node;
+    node.format = MPV_FORMAT_NODE_ARRAY;
+    node.u.list = talloc_zero(NULL, mpv_node_list);
+    node.u.list->num = count;
+    node.u.list->values = talloc_array(node.u.list, mpv_node, count);
+    for (int n = 0; n < count; n++) {
+        struct mpv_node *sub = &node.u.list->values[n];
+        sub->format = MPV_FORMAT_NONE;
+        int r;
+        r = get_item(start + n, M_PROPERTY_GET_NODE, sub, ctx);
+        if (r >= 0) {
+            talloc_steal(node.u.list, node_get_alloc(sub));
+        } else if (r == M_PROPERTY_NOT_IMPLEMENTED) {
+            struct m_option opt = {0};
+            r = get_item(start + n, M_PROPERTY_GET_TYPE, &opt, ctx);
+            if (r != M_PROPERTY_OK)
+                goto err;
+            union m_option_value val = m_option_value_default;
+            r = get_item(start + n, M_PROPERTY_GET, &val, ctx);
+            if (r != M_PROPERTY_OK)
+                goto err;
+            m_option_get_node(&opt, node.u.list, sub, &val);
+            m_option_free(&opt, &val);
+        err: ;
+        }
+    }
+    return node;
+}
+
+// Handle "range/<start>/<num>", which returns the items [start, start + num)
+// (clipped to the list size) as node array.
+static int read_list_range(struct m_property_action_arg *ka, int count,
+                           m_get_item_cb get_item, void *ctx)
+{
+    char *end;
+    long long start = strtoll(ka->key, &end, 10);
+    if (end == ka->key || end[0] != '/')
+        return M_PROPERTY_UNKNOWN;
+    const char *num_str = end + 1;
+    long long num = strtoll(num_str, &end, 10);
+    if (end == num_str || end[0] || start < 0 || num < 0)
+        return M_PROPERTY_UNKNOWN;
+    start = MPMIN(start, count);
+    num = MPMIN(num, count - start);
+
+    switch (ka->action) {
+    case M_PROPERTY_GET_TYPE:
+        *(struct m_option *)ka->arg = (struct m_option){.type = CONF_TYPE_NODE};
+        return M_PROPERTY_OK;
+    case M_PROPERTY_GET:
+    case M_PROPERTY_GET_NODE:
+        *(struct mpv_node *)ka->arg = get_list_node(start, num, get_item, ctx);
+        return M_PROPERTY_OK;
+    }
+    return M_PROPERTY_NOT_IMPLEMENTED;
+}
+
 int m_property_read_list(int action, void *arg, int count,
                          m_get_item_cb get_item, void *ctx)
 {
@@ -574,36 +679,9 @@ int m_property_read_list(int action, void *arg, int count,
         *(struct m_option *)arg = (struct m_option){.type = CONF_TYPE_NODE};
         return M_PROPERTY_OK;
     case M_PROPERTY_GET:
-    case M_PROPERTY_GET_NODE: {
-        struct mpv_node node;
-        node.format = MPV_FORMAT_NODE_ARRAY;
-        node.u.list = talloc_zero(NULL, mpv_node_list);
-        node.u.list->num = count;
-        node.u.list->values = talloc_array(node.u.list, mpv_node, count);
-        for (int n = 0; n < count; n++) {
-            struct mpv_node *sub = &node.u.list->values[n];
-            sub->format = MPV_FORMAT_NONE;
-            int r;
-            r = get_item(n, M_PROPERTY_GET_NODE, sub, ctx);
-            if (r >= 0) {
-                talloc_steal(node.u.list, node_get_alloc(sub));
-            } else if (r == M_PROPERTY_NOT_IMPLEMENTED) {
-                struct m_option opt = {0};
-                r = get_item(n, M_PROPERTY_GET_TYPE, &opt, ctx);
-                if (r != M_PROPERTY_OK)
-                    goto err;
-                union m_option_value val = m_option_value_default;
-                r = get_item(n, M_PROPERTY_GET, &val, ctx);
-                if (r != M_PROPERTY_OK)
-                    goto err;
-                m_option_get_node(&opt, node.u.list, sub, &val);
-                m_option_free(&opt, &val);
-            err: ;
-            }
-        }
-        *(struct mpv_node *)arg = node;
+    case M_PROPERTY_GET_NODE:
+        *(struct mpv_node *)arg = get_list_node(0, count, get_item, ctx);
         return M_PROPERTY_OK;
-    }
     case M_PROPERTY_PRINT: {
         // See m_property_read_sub() remarks.
         char *res = NULL;
@@ -635,6 +713,11 @@ int m_property_read_list(int action, void *arg, int count,
             }
             return M_PROPERTY_NOT_IMPLEMENTED;
         }
+        if (strncmp(ka->key, "range/", 6) == 0) {
+            struct m_property_action_arg r_ka = *ka;
+            r_ka.key += 6;
+            return read_list_range(&r_ka, count, get_item, ctx);
+        }
         // This is expected of the form "123" or "123/rest"
         char *end;
         long int item = strtol(ka->key, &end, 10);
@@ -156,14 +156,21 @@ struct m_property {
     bool is_noisy;
 };
 
-struct m_property *m_property_list_find(const struct m_property *list,
-                                        const char *name);
+// Hash table for looking up the properties of a {0} terminated list by name.
+// The list must not change while the index exists.
+struct m_property_index;
+struct m_property_index *m_property_index_create(void *ta_parent,
+                                                 struct m_property *list);
+
+// Return the property with exactly this name, or NULL.
+struct m_property *m_property_index_find(const struct m_property_index *index,
+                                         bstr name);
 
 // Access a property.
 // action: one of m_property_action
 // ctx: opaque value passed through to property implementation
 // returns: one of mp_property_return
-int m_property_do(struct mp_log *log, const struct m_property* prop_list,
+int m_property_do(struct mp_log *log, const struct m_property_index *props,
                   const char* property_name, int action, void* arg, void *ctx);
 
 // Given a path of the form "a/b/c", this function will set *prefix to "a",
@@ -188,7 +195,7 @@ void m_properties_print_help_list(struct mp_log *log,
 // STR is recursively expanded using the same rules.
 // "$$" can be used to escape "$", and "$}" to escape "}".
 // "$>" disables parsing of "$" for the rest of the string.
-char* m_properties_expand_string(const struct m_property *prop_list,
+char* m_properties_expand_string(const struct m_property_index *props,
                                  const char *str, void *ctx);
 
 // Trivial helpers for implementing properties.
@@ -255,6 +262,9 @@ int m_property_read_sub(const struct m_sub_property *props, int action, void *ar
 // ctx is userdata passed to m_property_read_list.
 typedef int (*m_get_item_cb)(int item, int action, void *arg, void *ctx);
 
+// Besides the whole list, this provides the sub-properties "count", "N" (item
+// N, possibly followed by "/sub-path"), and "range/START/NUM" (node array
+// with up to NUM items starting at START).
 int m_property_read_list(int action, void *arg, int count,
                          m_get_item_cb get_item, void *ctx);
 
@@ -538,6 +538,7 @@ static const m_option_t mp_opts[] = {
 #endif
     {"msg-module", OPT_BOOL(msg_module), .flags = UPDATE_TERM},
     {"msg-time", OPT_BOOL(msg_time), .flags = UPDATE_TERM},
+    {"msg-async", OPT_BOOL(msg_async), .flags = UPDATE_TERM},
 #if HAVE_WIN32_DESKTOP
     {"", OPT_SUBSTRUCT(w32_register_opts, w32_register_conf)},
     {"priority", OPT_CHOICE(w32_priority,
@@ -583,6 +584,9 @@ static const m_option_t mp_opts[] = {
     {"load-positioning", OPT_BOOL(lua_load_positioning), .flags = UPDATE_BUILTIN_SCRIPTS},
     {"load-commands", OPT_BOOL(lua_load_commands), .flags = UPDATE_BUILTIN_SCRIPTS},
     {"load-context-menu", OPT_BOOL(lua_load_context_menu), .flags = UPDATE_BUILTIN_SCRIPTS},
+    {"script-host-threads", OPT_INT(script_host_threads), M_RANGE(0, 64)},
+    {"lazy-builtin-scripts", OPT_BOOL(lua_lazy_builtin_scripts),
+        .flags = UPDATE_BUILTIN_SCRIPTS},
 #endif
 
 // ------------------------- stream options --------------------
@@ -706,6 +710,7 @@ static const m_option_t mp_opts[] = {
     {"", OPT_SUBSTRUCT(filter_opts, filter_conf)},
 
     {"", OPT_SUBSTRUCT(dec_wrapper, dec_wrapper_conf)},
+    {"", OPT_SUBSTRUCT(output_chain, output_chain_conf)},
     {"", OPT_SUBSTRUCT(vd_lavc_params, vd_lavc_conf)},
     {"ad-lavc", OPT_SUBSTRUCT(ad_lavc_params, ad_lavc_conf)},
 
@@ -787,6 +792,7 @@ static const m_option_t mp_opts[] = {
     {"replaygain-clip", OPT_BOOL(rgain_clip), .flags = UPDATE_VOL},
     {"replaygain-fallback", OPT_FLOAT(rgain_fallback), .flags = UPDATE_VOL,
         M_RANGE(-200, 60)},
+    {"replaygain-scan", OPT_BOOL(rgain_scan), .flags = UPDATE_VOL},
     {"gapless-audio", OPT_CHOICE(gapless_audio,
         {"no", 0},
         {"yes", 1},
@@ -882,6 +888,11 @@ static const m_option_t mp_opts[] = {
         {"no", -1}, {"absolute", 0}, {"yes", 1}, {"always", 1}, {"default", 2})},
     {"hr-seek-demuxer-offset", OPT_FLOAT(hr_seek_demuxer_offset)},
     {"hr-seek-framedrop", OPT_BOOL(hr_seek_framedrop)},
+    {"video-frame-cache", OPT_BYTE_SIZE(video_frame_cache),
+        M_RANGE(0, M_MAX_MEM_BYTES)},
+    {"thumbnail-cache", OPT_BYTE_SIZE(thumbnail_cache),
+        M_RANGE(0, M_MAX_MEM_BYTES)},
+    {"frame-index", OPT_BOOL(frame_index)},
     {"autosync", OPT_CHOICE(autosync, {"no", -1}), M_RANGE(0, 10000)},
 
     {"term-osd", OPT_CHOICE(term_osd,
@@ -917,6 +928,9 @@ static const m_option_t mp_opts[] = {
     {"input-ipc-server", OPT_STRING(ipc_path), .flags = M_OPT_FILE},
     {"input-ipc-client", OPT_STRING(ipc_client)},
 
+    {"telemetry-shm", OPT_STRING(telemetry_shm), .flags = M_OPT_FILE},
+    {"startup-trace", OPT_STRING(startup_trace), .flags = M_OPT_FILE},
+
     {"screenshot", OPT_SUBSTRUCT(screenshot_image_opts, screenshot_conf)},
     {"screenshot-template", OPT_STRING(screenshot_template)},
     {"screenshot-dir", OPT_STRING(screenshot_dir),
@@ -1041,6 +1055,7 @@ static const struct MPOpts mp_default_opts = {
     .chapter_seek_threshold = 5.0,
     .hr_seek = 2,
     .hr_seek_framedrop = true,
+    .thumbnail_cache = 16 * 1024 * 1024,
     .sync_max_video_change = 1,
     .sync_max_audio_change = 0.125,
     .sync_max_factor = 5,
@@ -174,6 +174,7 @@ typedef struct MPOpts {
     bool msg_color;
     bool msg_module;
     bool msg_time;
+    bool msg_async;
     char *log_file;
 
     int operation_mode;
@@ -193,8 +194,10 @@ typedef struct MPOpts {
     bool lua_load_positioning;
     bool lua_load_commands;
     bool lua_load_context_menu;
+    bool lua_lazy_builtin_scripts;
 
     bool auto_load_scripts;
+    int script_host_threads;
 
     bool audio_exclusive;
     bool ao_null_fallback;
@@ -206,6 +209,7 @@ typedef struct MPOpts {
     float rgain_preamp;         // Set replaygain pre-amplification
     bool rgain_clip;             // Enable/disable clipping prevention
     float rgain_fallback;
+    bool rgain_scan;
     bool softvol_mute;
     float softvol_max;
     float softvol_gain;
@@ -263,6 +267,9 @@ typedef struct MPOpts {
     int hr_seek;
     float hr_seek_demuxer_offset;
     bool hr_seek_framedrop;
+    int64_t video_frame_cache;
+    int64_t thumbnail_cache;
+    bool frame_index;
     double audio_delay;
     float default_max_pts_correction;
     int autosync;
@@ -345,6 +352,7 @@ typedef struct MPOpts {
     struct m_obj_settings *af_settings;
     struct filter_opts *filter_opts;
     struct dec_wrapper_opts *dec_wrapper;
+    struct output_chain_opts *output_chain;
     char **sub_name;
     char **sub_paths;
     char **audiofile_paths;
@@ -403,6 +411,9 @@ typedef struct MPOpts {
     char *ipc_path;
     char *ipc_client;
 
+    char *telemetry_shm;
+    char *startup_trace;
+
     struct mp_resample_opts *resample_opts;
 
     struct ra_ctx_opts *ra_ctx_opts;
@@ -446,6 +457,7 @@ extern const struct m_sub_options filter_conf;
 extern const struct m_sub_options resample_conf;
 extern const struct m_sub_options stream_conf;
 extern const struct m_sub_options dec_wrapper_conf;
+extern const struct m_sub_options output_chain_conf;
 extern const struct m_sub_options mp_opt_root;
 
 #endif
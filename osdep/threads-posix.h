@@ -185,6 +185,7 @@ static inline int mp_cond_timedwait(mp_cond *cond, mp_mutex *mutex, int64_t time
     // consider anything above 1000 days as infinity
     if (timeout > MP_TIME_S_TO_NS(1000 * 24 * 60 * 60))
         return pthread_cond_wait(&cond->cond, mutex);
+    timeout = mp_time_ns_to_real(timeout);
 
     struct timespec ts;
     clock_gettime(cond->clk_id, &ts);
@@ -230,6 +231,17 @@ static inline void mp_thread_set_name(const char *name)
 #endif
 }
 
+// Lower the scheduling priority of the calling thread as far as possible. For
+// background work that should only use otherwise idle CPU time.
+static inline void mp_thread_set_background(void)
+{
+#if defined(SCHED_IDLE)
+    pthread_setschedparam(pthread_self(), SCHED_IDLE, &(struct sched_param){0});
+#elif defined(__APPLE__)
+    pthread_set_qos_class_self_np(QOS_CLASS_BACKGROUND, 0);
+#endif
+}
+
 static inline int64_t mp_thread_cpu_time_ns(mp_thread_id thread)
 {
 #if defined(_POSIX_TIMERS) && _POSIX_TIMERS > 0 && defined(_POSIX_THREAD_CPUTIME)
@@ -90,6 +90,8 @@ static inline int mp_cond_signal(mp_cond *cond)
 
 static inline int mp_cond_timedwait(mp_cond *cond, mp_mutex *mutex, int64_t timeout)
 {
+    if (timeout < MP_TIME_MS_TO_NS(INFINITE))
+        timeout = mp_time_ns_to_real(timeout);
     timeout = MPCLAMP(timeout, 0, MP_TIME_MS_TO_NS(INFINITE)) / MP_TIME_MS_TO_NS(1);
 
     int ret = 0;
@@ -179,4 +181,11 @@ static inline void mp_thread_set_name(const char *name)
     talloc_free(wname);
 }
 
+static inline void mp_thread_set_background(void)
+{
+    // Also lowers I/O and memory priority.
+    if (!SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_BEGIN))
+        SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_IDLE);
+}
+
 int64_t mp_thread_cpu_time_ns(mp_thread_id thread_id);
@@ -30,6 +30,7 @@ static double timebase_ratio_ns;
 
 void mp_sleep_ns(int64_t ns)
 {
+    ns = mp_time_ns_to_real(ns);
     uint64_t deadline = ns / timebase_ratio_ns + mach_absolute_time();
     mach_wait_until(deadline);
 }
@@ -31,6 +31,7 @@ void mp_sleep_ns(int64_t ns)
 {
     if (ns < 0)
         return;
+    ns = mp_time_ns_to_real(ns);
     struct timespec ts;
     ts.tv_sec  = ns / MP_TIME_S_TO_NS(1);
     ts.tv_nsec = ns % MP_TIME_S_TO_NS(1);
@@ -68,6 +68,7 @@ void mp_sleep_ns(int64_t ns)
 {
     if (ns < 0)
         return;
+    ns = mp_time_ns_to_real(ns);
 
     int64_t hrt = mp_start_hires_timers(ns);
     HANDLE timer = CreateWaitableTimerEx(NULL, NULL,
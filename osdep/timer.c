@@ -15,6 +15,7 @@
  * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <stdatomic.h>
 #include <stdlib.h>
 #include <time.h>
 #include <limits.h>
@@ -25,14 +26,69 @@
 #include "threads.h"
 #include "timer.h"
 
-static uint64_t raw_time_offset;
 static mp_once timer_init_once = MP_STATIC_ONCE_INITIALIZER;
 
+// mp time = base + (raw time - raw_base) * speed. This is changed only by
+// mp_time_set_speed() (serialized by clock_lock), and read without locking:
+// clock_seq is odd while a change is in progress, and readers retry if it
+// changed while they read the fields.
+struct clock {
+    int64_t base;
+    uint64_t raw_base;
+    double speed;
+};
+
+static mp_static_mutex clock_lock = MP_STATIC_MUTEX_INITIALIZER;
+static atomic_uint clock_seq;
+static _Atomic int64_t clock_base;
+static _Atomic uint64_t clock_raw_base;
+static _Atomic double clock_speed = 1;
+
+static struct clock read_clock(void)
+{
+    while (1) {
+        unsigned seq = atomic_load_explicit(&clock_seq, memory_order_acquire);
+        struct clock c = {
+            .base = atomic_load_explicit(&clock_base, memory_order_relaxed),
+            .raw_base = atomic_load_explicit(&clock_raw_base, memory_order_relaxed),
+            .speed = atomic_load_explicit(&clock_speed, memory_order_relaxed),
+        };
+        atomic_thread_fence(memory_order_acquire);
+        if (!(seq & 1) &&
+            atomic_load_explicit(&clock_seq, memory_order_relaxed) == seq)
+            return c;
+    }
+}
+
+// Must be called with clock_lock held.
+static void write_clock(const struct clock *c)
+{
+    unsigned seq = atomic_load_explicit(&clock_seq, memory_order_relaxed);
+    atomic_store_explicit(&clock_seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&clock_base, c->base, memory_order_relaxed);
+    atomic_store_explicit(&clock_raw_base, c->raw_base, memory_order_relaxed);
+    atomic_store_explicit(&clock_speed, c->speed, memory_order_relaxed);
+    atomic_store_explicit(&clock_seq, seq + 2, memory_order_release);
+}
+
+static int64_t clock_time_ns(const struct clock *c, uint64_t raw_time)
+{
+    int64_t elapsed = raw_time - c->raw_base;
+    if (c->speed != 1)
+        elapsed *= c->speed;
+    return c->base + elapsed;
+}
+
 static void do_timer_init(void)
 {
     mp_raw_time_init();
-    raw_time_offset = mp_raw_time_ns();
+    uint64_t raw_time_offset = mp_raw_time_ns();
     mp_assert(raw_time_offset > 0);
+
+    mp_mutex_lock(&clock_lock);
+    write_clock(&(struct clock){ .raw_base = raw_time_offset, .speed = 1 });
+    mp_mutex_unlock(&clock_lock);
 }
 
 void mp_time_init(void)
@@ -47,7 +103,28 @@ int64_t mp_time_ns(void)
 
 int64_t mp_time_ns_from_raw_time(uint64_t raw_time)
 {
-    return raw_time - raw_time_offset;
+    struct clock c = read_clock();
+    return clock_time_ns(&c, raw_time);
+}
+
+void mp_time_set_speed(double speed)
+{
+    mp_assert(speed >= 1);
+
+    mp_mutex_lock(&clock_lock);
+    struct clock c = read_clock();
+    uint64_t raw_time = mp_raw_time_ns();
+    c.base = clock_time_ns(&c, raw_time);
+    c.raw_base = raw_time;
+    c.speed = speed;
+    write_clock(&c);
+    mp_mutex_unlock(&clock_lock);
+}
+
+int64_t mp_time_ns_to_real(int64_t ns)
+{
+    double speed = atomic_load_explicit(&clock_speed, memory_order_relaxed);
+    return speed == 1 ? ns : ns / speed;
 }
 
 double mp_time_sec(void)
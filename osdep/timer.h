@@ -34,6 +34,17 @@ int64_t mp_time_ns_from_raw_time(uint64_t raw_time);
 // be much worse when casted to float.
 double mp_time_sec(void);
 
+// Make mp time run speed (>= 1) times as fast as real time from now on. The
+// time stays continuous. mp_sleep_ns() and the timed waits in threads.h are
+// scaled accordingly. This affects the whole process, including other mpv
+// instances in it, client API timeouts and audio output timing. Only meant for
+// simulations and benchmarks (see vo_sim). Reading the time doesn't take a
+// lock, at any speed.
+void mp_time_set_speed(double speed);
+
+// Convert a duration in mp time to real time.
+int64_t mp_time_ns_to_real(int64_t ns);
+
 // Provided by OS specific functions (timer-linux.c)
 void mp_raw_time_init(void);
 // ensure this doesn't return 0
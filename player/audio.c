@@ -26,6 +26,7 @@
 
 #include "common/msg.h"
 #include "common/encode.h"
+#include "common/trace.h"
 #include "options/options.h"
 #include "common/common.h"
 #include "osdep/timer.h"
@@ -139,6 +140,9 @@ static float compute_replaygain(struct MPContext *mpctx)
     struct track *track = mpctx->current_track[0][STREAM_AUDIO];
     if (track)
         rg = track->stream->codec->replaygain_data;
+    struct replaygain_data scanned;
+    if (opts->rgain_mode && !rg && loudness_scan_get(mpctx, &scanned))
+        rg = &scanned;
     if (opts->rgain_mode && rg) {
         MP_VERBOSE(mpctx, "Replaygain: Track=%f/%f Album=%f/%f\n",
                    rg->track_gain, rg->track_peak,
@@ -443,9 +447,11 @@ static int reinit_audio_filters_and_output(struct MPContext *mpctx)
 
     mpctx->ao_filter_fmt = out_fmt;
 
+    trace_begin(mpctx->global, "ao-init");
     mpctx->ao = ao_init_best(mpctx->global, ao_flags, mp_wakeup_core_cb,
                              mpctx, mpctx->encode_lavc_ctx, out_rate,
                              out_format, out_channels);
+    trace_end(mpctx->global, "ao-init");
 
     int ao_rate = 0;
     int ao_format = 0;
@@ -26,6 +26,7 @@
 #include "common/global.h"
 #include "common/msg.h"
 #include "common/msg_control.h"
+#include "common/trace.h"
 #include "input/input.h"
 #include "input/cmd.h"
 #include "misc/ctype.h"
@@ -81,6 +82,17 @@ struct mp_client_api {
     int num_custom_protocols;
 
     struct mpv_render_context *render_context;
+
+    // Observed properties of all clients, indexed by property ID + 1 (so
+    // unknown properties are at 0). Used to find the observers affected by
+    // mp_client_property_change() without scanning all clients.
+    struct observer_list *observers;
+    int num_observers;
+};
+
+struct observer_list {
+    struct observe_property **props;
+    int num_props;
 };
 
 struct observe_property {
@@ -125,6 +137,8 @@ struct mpv_handle {
     bool need_wakeup;
     void (*wakeup_cb)(void *d);
     void *wakeup_cb_ctx;
+    void (*blocking_cb)(void *d);
+    void *blocking_cb_ctx;
     int wakeup_pipe[2];
 
     // -- protected by lock
@@ -176,6 +190,35 @@ static void prop_unref(struct observe_property *prop)
         talloc_free(prop);
 }
 
+// Must be called with clients->lock held.
+static void add_observer(struct mp_client_api *clients,
+                         struct observe_property *prop)
+{
+    int index = prop->id + 1;
+    if (index >= clients->num_observers) {
+        MP_TARRAY_GROW(clients, clients->observers, index);
+        for (int n = clients->num_observers; n <= index; n++)
+            clients->observers[n] = (struct observer_list){0};
+        clients->num_observers = index + 1;
+    }
+    struct observer_list *list = &clients->observers[index];
+    MP_TARRAY_APPEND(clients, list->props, list->num_props, prop);
+}
+
+// Must be called with clients->lock held.
+static void remove_observer(struct mp_client_api *clients,
+                            struct observe_property *prop)
+{
+    struct observer_list *list = &clients->observers[prop->id + 1];
+    for (int n = 0; n < list->num_props; n++) {
+        if (list->props[n] == prop) {
+            MP_TARRAY_REMOVE_AT(list->props, list->num_props, n);
+            return;
+        }
+    }
+    MP_ASSERT_UNREACHABLE();
+}
+
 void mp_clients_init(struct MPContext *mpctx)
 {
     mpctx->clients = talloc_ptrtype(NULL, mpctx->clients);
@@ -309,6 +352,7 @@ struct mpv_handle *mp_new_client(struct mp_client_api *clients, const char *name
     mp_mutex_unlock(&clients->lock);
 
     mpv_request_event(client, MPV_EVENT_TICK, 0);
+    mpv_request_event(client, MPV_EVENT_PLAYLIST_CHANGE, 0);
 
     return client;
 }
@@ -379,6 +423,24 @@ void mpv_set_wakeup_callback(mpv_handle *ctx, void (*cb)(void *d), void *d)
     mp_mutex_unlock(&ctx->wakeup_lock);
 }
 
+void mp_client_set_blocking_cb(mpv_handle *ctx, void (*cb)(void *d), void *d)
+{
+    mp_mutex_lock(&ctx->wakeup_lock);
+    ctx->blocking_cb = cb;
+    ctx->blocking_cb_ctx = d;
+    mp_mutex_unlock(&ctx->wakeup_lock);
+}
+
+static void notify_blocking(mpv_handle *ctx)
+{
+    mp_mutex_lock(&ctx->wakeup_lock);
+    void (*cb)(void *d) = ctx->blocking_cb;
+    void *cb_ctx = ctx->blocking_cb_ctx;
+    mp_mutex_unlock(&ctx->wakeup_lock);
+    if (cb)
+        cb(cb_ctx);
+}
+
 static void lock_core(mpv_handle *ctx)
 {
     mp_dispatch_lock(ctx->mpctx->dispatch);
@@ -434,12 +496,15 @@ static void mp_destroy_client(mpv_handle *ctx, bool terminate)
     if (terminate)
         mpv_command(ctx, (const char*[]){"quit", NULL});
 
+    mp_mutex_lock(&clients->lock);
     mp_mutex_lock(&ctx->lock);
 
     ctx->destroying = true;
 
-    for (int n = 0; n < ctx->num_properties; n++)
+    for (int n = 0; n < ctx->num_properties; n++) {
+        remove_observer(clients, ctx->properties[n]);
         prop_unref(ctx->properties[n]);
+    }
     ctx->num_properties = 0;
     ctx->properties_change_ts += 1;
 
@@ -447,6 +512,7 @@ static void mp_destroy_client(mpv_handle *ctx, bool terminate)
     ctx->cur_property = NULL;
 
     mp_mutex_unlock(&ctx->lock);
+    mp_mutex_unlock(&clients->lock);
 
     abort_async(mpctx, ctx, 0, 0);
 
@@ -689,6 +755,10 @@ static void dup_event_data(struct mpv_event *ev)
     case MPV_EVENT_END_FILE:
         ev->data = talloc_memdup(NULL, ev->data, sizeof(mpv_event_end_file));
         break;
+    case MPV_EVENT_PLAYLIST_CHANGE:
+        ev->data = talloc_memdup(NULL, ev->data,
+                                 sizeof(mpv_event_playlist_change));
+        break;
     default:
         // Doesn't use events with memory allocation.
         if (ev->data)
@@ -897,8 +967,11 @@ mpv_event *mpv_wait_event(mpv_handle *ctx, double timeout)
 
     mp_mutex_lock(&ctx->lock);
 
-    if (!ctx->fuzzy_initialized)
+    if (!ctx->fuzzy_initialized) {
         mp_wakeup_core(ctx->clients->mpctx);
+        trace_instant(ctx->mpctx->global,
+                      mp_tprintf(80, "client-ready/%s", ctx->name));
+    }
     ctx->fuzzy_initialized = true;
 
     if (timeout < 0)
@@ -1137,8 +1210,11 @@ static int run_client_command(mpv_handle *ctx, struct mp_cmd *cmd, mpv_node *res
     }
     unlock_core(ctx);
 
-    if (!async)
+    if (!async) {
+        if (!mp_waiter_poll(&req.completion))
+            notify_blocking(ctx);
         mp_waiter_wait(&req.completion);
+    }
 
     return req.status;
 }
@@ -1523,6 +1599,199 @@ int mpv_get_property_async(mpv_handle *ctx, uint64_t ud, const char *name,
     return run_async(ctx, getproperty_fn, req);
 }
 
+// Commands which run on a worker thread, or complete after the handler
+// returns, would let the player run before they finish.
+static bool cmd_is_batchable(struct mp_cmd *cmd)
+{
+    return !cmd->def->spawn_thread && !cmd->def->exec_async;
+}
+
+bool mp_batch_cmd_allowed(mpv_handle *ctx, mpv_node *args)
+{
+    struct mp_cmd *cmd = mp_input_parse_cmd_node(ctx->log, args);
+    // Invalid commands are rejected by mpv_command_batch() anyway.
+    bool ok = !cmd || cmd_is_batchable(cmd);
+    talloc_free(cmd);
+    return ok;
+}
+
+static int check_batch_item(mpv_batch_item *item)
+{
+    switch (item->op) {
+    case MPV_BATCH_COMMAND:
+        return item->args ? 0 : MPV_ERROR_INVALID_PARAMETER;
+    case MPV_BATCH_GET_PROPERTY:
+        if (!item->data)
+            return MPV_ERROR_INVALID_PARAMETER;
+        return get_mp_type_get(item->format) ? 0 : MPV_ERROR_PROPERTY_FORMAT;
+    case MPV_BATCH_SET_PROPERTY:
+        return get_mp_type(item->format) ? 0 : MPV_ERROR_PROPERTY_FORMAT;
+    }
+    return MPV_ERROR_INVALID_PARAMETER;
+}
+
+int mpv_command_batch(mpv_handle *ctx, mpv_batch_item *items, int num_items)
+{
+    if (num_items < 0)
+        return MPV_ERROR_INVALID_PARAMETER;
+
+    for (int n = 0; n < num_items; n++) {
+        items[n].error = 0;
+        items[n].result = (mpv_node){.format = MPV_FORMAT_NONE};
+    }
+
+    if (!ctx->mpctx->initialized) {
+        for (int n = 0; n < num_items; n++) {
+            mpv_batch_item *item = &items[n];
+            switch (item->op) {
+            case MPV_BATCH_COMMAND:
+                item->error = mpv_command_node(ctx, item->args, &item->result);
+                break;
+            case MPV_BATCH_GET_PROPERTY:
+                item->error = mpv_get_property(ctx, item->name, item->format,
+                                               item->data);
+                break;
+            case MPV_BATCH_SET_PROPERTY:
+                item->error = mpv_set_property(ctx, item->name, item->format,
+                                               item->data);
+                break;
+            default:
+                item->error = MPV_ERROR_INVALID_PARAMETER;
+            }
+        }
+        goto done;
+    }
+
+    struct cmd_request *reqs = talloc_zero_array(NULL, struct cmd_request, num_items);
+    bool *wait = talloc_zero_array(reqs, bool, num_items);
+
+    // Parse commands outside of the lock.
+    for (int n = 0; n < num_items; n++) {
+        mpv_batch_item *item = &items[n];
+        item->error = check_batch_item(item);
+        if (item->error < 0 || item->op != MPV_BATCH_COMMAND)
+            continue;
+        struct mp_cmd *cmd = mp_input_parse_cmd_node(ctx->log, item->args);
+        if (!cmd) {
+            item->error = MPV_ERROR_INVALID_PARAMETER;
+            continue;
+        }
+        if (!cmd_is_batchable(cmd)) {
+            MP_ERR(ctx, "Command %s can't be used in a batch.\n", cmd->name);
+            talloc_free(cmd);
+            item->error = MPV_ERROR_INVALID_PARAMETER;
+            continue;
+        }
+        cmd->sender = ctx->name;
+        reqs[n] = (struct cmd_request){
+            .mpctx = ctx->mpctx,
+            .cmd = cmd,
+            .res = &item->result,
+            .completion = MP_WAITER_INITIALIZER,
+        };
+    }
+
+    lock_core(ctx);
+    for (int n = 0; n < num_items; n++) {
+        mpv_batch_item *item = &items[n];
+        if (item->error < 0)
+            continue;
+        switch (item->op) {
+        case MPV_BATCH_COMMAND: {
+            struct mp_cmd *cmd = reqs[n].cmd;
+            if (cmd->flags & MP_ASYNC_CMD) {
+                run_command(ctx->mpctx, cmd, NULL, NULL, NULL);
+                break;
+            }
+            struct mp_abort_entry *abort = NULL;
+            if (cmd->def->can_abort) {
+                abort = talloc_zero(NULL, struct mp_abort_entry);
+                abort->client = ctx;
+            }
+            wait[n] = true;
+            run_command(ctx->mpctx, cmd, abort, cmd_complete, &reqs[n]);
+            break;
+        }
+        case MPV_BATCH_GET_PROPERTY: {
+            struct getproperty_request req = {
+                .mpctx = ctx->mpctx,
+                .name = item->name,
+                .format = item->format,
+                .data = item->data,
+            };
+            getproperty_fn(&req);
+            item->error = req.status;
+            break;
+        }
+        case MPV_BATCH_SET_PROPERTY: {
+            struct setproperty_request req = {
+                .mpctx = ctx->mpctx,
+                .name = item->name,
+                .format = item->format,
+                .data = item->data,
+            };
+            setproperty_fn(&req);
+            item->error = req.status;
+            break;
+        }
+        }
+    }
+    unlock_core(ctx);
+
+    for (int n = 0; n < num_items; n++) {
+        if (wait[n]) {
+            mp_waiter_wait(&reqs[n].completion);
+            items[n].error = reqs[n].status;
+        }
+    }
+
+    talloc_free(reqs);
+
+done:
+    for (int n = 0; n < num_items; n++) {
+        if (items[n].error < 0)
+            return items[n].error;
+    }
+    return 0;
+}
+
+int mp_batch_item_from_node(mpv_batch_item *item, mpv_node *node)
+{
+    const char *op = NULL;
+    mpv_node_list *args = NULL;
+    if (node->format == MPV_FORMAT_NODE_ARRAY) {
+        args = node->u.list;
+        if (args->num && args->values[0].format == MPV_FORMAT_STRING)
+            op = args->values[0].u.string;
+    }
+
+    if (op && strcmp(op, "get_property") == 0) {
+        if (args->num != 2 || args->values[1].format != MPV_FORMAT_STRING)
+            return MPV_ERROR_INVALID_PARAMETER;
+        *item = (mpv_batch_item){
+            .op = MPV_BATCH_GET_PROPERTY,
+            .name = args->values[1].u.string,
+            .format = MPV_FORMAT_NODE,
+            .data = &item->result,
+        };
+    } else if (op && strcmp(op, "set_property") == 0) {
+        if (args->num != 3 || args->values[1].format != MPV_FORMAT_STRING)
+            return MPV_ERROR_INVALID_PARAMETER;
+        *item = (mpv_batch_item){
+            .op = MPV_BATCH_SET_PROPERTY,
+            .name = args->values[1].u.string,
+            .format = MPV_FORMAT_NODE,
+            .data = &args->values[2],
+        };
+    } else {
+        *item = (mpv_batch_item){
+            .op = MPV_BATCH_COMMAND,
+            .args = node,
+        };
+    }
+    return 0;
+}
+
 static void property_free(void *p)
 {
     struct observe_property *prop = p;
@@ -1545,6 +1814,8 @@ int mpv_observe_property(mpv_handle *ctx, uint64_t userdata,
     if (format == MPV_FORMAT_OSD_STRING)
         return MPV_ERROR_PROPERTY_FORMAT;
 
+    // Lock order is the same as in mp_client_property_change().
+    mp_mutex_lock(&ctx->clients->lock);
     mp_mutex_lock(&ctx->lock);
     mp_assert(!ctx->destroying);
     struct observe_property *prop = talloc_ptrtype(ctx, prop);
@@ -1564,17 +1835,20 @@ int mpv_observe_property(mpv_handle *ctx, uint64_t userdata,
     };
     ctx->properties_change_ts += 1;
     MP_TARRAY_APPEND(ctx, ctx->properties, ctx->num_properties, prop);
+    add_observer(ctx->clients, prop);
     ctx->property_event_masks |= prop->event_mask;
     ctx->new_property_events = true;
     ctx->cur_property_index = 0;
     ctx->has_pending_properties = true;
     mp_mutex_unlock(&ctx->lock);
+    mp_mutex_unlock(&ctx->clients->lock);
     mp_wakeup_core(ctx->mpctx);
     return 0;
 }
 
 int mpv_unobserve_property(mpv_handle *ctx, uint64_t userdata)
 {
+    mp_mutex_lock(&ctx->clients->lock);
     mp_mutex_lock(&ctx->lock);
     int count = 0;
     for (int n = ctx->num_properties - 1; n >= 0; n--) {
@@ -1582,6 +1856,7 @@ int mpv_unobserve_property(mpv_handle *ctx, uint64_t userdata)
         // Perform actual removal of the property lazily to avoid creating
         // dangling pointers and such.
         if (prop->reply_id == userdata) {
+            remove_observer(ctx->clients, prop);
             prop_unref(prop);
             ctx->properties_change_ts += 1;
             MP_TARRAY_REMOVE_AT(ctx->properties, ctx->num_properties, n);
@@ -1590,6 +1865,7 @@ int mpv_unobserve_property(mpv_handle *ctx, uint64_t userdata)
         }
     }
     mp_mutex_unlock(&ctx->lock);
+    mp_mutex_unlock(&ctx->clients->lock);
     return count;
 }
 
@@ -1626,18 +1902,19 @@ void mp_client_property_change(struct MPContext *mpctx, const char *name)
 
     mp_mutex_lock(&clients->lock);
 
-    for (int n = 0; n < clients->num_clients; n++) {
-        struct mpv_handle *client = clients->clients[n];
-        mp_mutex_lock(&client->lock);
-        for (int i = 0; i < client->num_properties; i++) {
-            if (client->properties[i]->id == id &&
-                property_shared_prefix(name, client->properties[i]->name)) {
-                client->properties[i]->change_ts += 1;
-                client->has_pending_properties = true;
-                any_pending = true;
-            }
+    if (id + 1 < clients->num_observers) {
+        struct observer_list *list = &clients->observers[id + 1];
+        for (int n = 0; n < list->num_props; n++) {
+            struct observe_property *prop = list->props[n];
+            if (!property_shared_prefix(name, prop->name))
+                continue;
+            struct mpv_handle *client = prop->owner;
+            mp_mutex_lock(&client->lock);
+            prop->change_ts += 1;
+            client->has_pending_properties = true;
+            any_pending = true;
+            mp_mutex_unlock(&client->lock);
         }
-        mp_mutex_unlock(&client->lock);
     }
 
     mp_mutex_unlock(&clients->lock);
@@ -2057,6 +2334,31 @@ int mpv_event_to_node(mpv_node *dst, mpv_event *event)
         break;
     }
 
+    case MPV_EVENT_PLAYLIST_CHANGE: {
+        mpv_event_playlist_change *pc = event->data;
+
+        const char *type;
+        switch (pc->type) {
+        case MPV_PLAYLIST_CHANGE_INSERT: type = "insert"; break;
+        case MPV_PLAYLIST_CHANGE_REMOVE: type = "remove"; break;
+        case MPV_PLAYLIST_CHANGE_MOVE: type = "move"; break;
+        case MPV_PLAYLIST_CHANGE_CURRENT: type = "current"; break;
+        default:
+            type = "reset";
+        }
+        node_map_add_string(dst, "type", type);
+
+        if (pc->index >= 0)
+            node_map_add_int64(dst, "index", pc->index);
+        if (pc->count > 0)
+            node_map_add_int64(dst, "count", pc->count);
+        if (pc->to_index >= 0)
+            node_map_add_int64(dst, "to_index", pc->to_index);
+        if (pc->playlist_entry_id)
+            node_map_add_int64(dst, "playlist_entry_id", pc->playlist_entry_id);
+        break;
+    }
+
     }
     return 0;
 }
@@ -2116,6 +2418,7 @@ static const char *const event_table[] = {
     [MPV_EVENT_PROPERTY_CHANGE] = "property-change",
     [MPV_EVENT_QUEUE_OVERFLOW] = "event-queue-overflow",
     [MPV_EVENT_HOOK] = "hook",
+    [MPV_EVENT_PLAYLIST_CHANGE] = "playlist-change",
 };
 
 const char *mpv_event_name(mpv_event_id event)
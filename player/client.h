@@ -35,10 +35,22 @@ struct mpv_handle *mp_new_client(struct mp_client_api *clients, const char *name
 void mp_client_set_weak(struct mpv_handle *ctx);
 struct mp_log *mp_client_get_log(struct mpv_handle *ctx);
 struct mpv_global *mp_client_get_global(struct mpv_handle *ctx);
+// cb is called on the client's thread before it waits for a synchronous
+// command that did not complete immediately (e.g. a subprocess).
+void mp_client_set_blocking_cb(struct mpv_handle *ctx, void (*cb)(void *d),
+                               void *d);
 
 void mp_client_broadcast_event_external(struct mp_client_api *api, int event,
                                         void *data);
 
+// For scripting: set *item from a batch entry, which is either a normal
+// command, or ["get_property", name] or ["set_property", name, value]. The
+// property value is returned in item->result, like a command result.
+int mp_batch_item_from_node(struct mpv_batch_item *item, struct mpv_node *node);
+// Whether mpv_command_batch() accepts the command. Commands which don't
+// complete while the player is locked (see mpv_command_batch()) are rejected.
+bool mp_batch_cmd_allowed(struct mpv_handle *ctx, struct mpv_node *args);
+
 // m_option.c
 void *node_get_alloc(struct mpv_node *node);
 
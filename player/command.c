@@ -44,6 +44,7 @@
 #include "common/msg.h"
 #include "common/msg_control.h"
 #include "common/stats.h"
+#include "common/trace.h"
 #include "filters/f_decoder_wrapper.h"
 #include "command.h"
 #include "osdep/als.h"
@@ -67,6 +68,8 @@
 #include "osdep/getpid.h"
 #include "video/out/vo.h"
 #include "video/csputils.h"
+#include "video/fingerprint_index.h"
+#include "video/frame_cache.h"
 #include "video/hwdec.h"
 #include "audio/aframe.h"
 #include "audio/format.h"
@@ -93,6 +96,7 @@
 struct command_ctx {
     // All properties, terminated with a {0} item.
     struct m_property *properties;
+    struct m_property_index *prop_index;
 
     double last_seek_time;
     double last_seek_pts;
@@ -127,6 +131,9 @@ struct command_ctx {
     int hwdec_osd_mode;
 
     double cached_window_scale;
+
+    // Playlist entry ID of the last MPV_PLAYLIST_CHANGE_CURRENT event.
+    uint64_t playlist_current_id;
 };
 
 static const struct m_option script_props_type = {
@@ -2415,6 +2422,9 @@ static int get_frame_count(struct MPContext *mpctx)
         return -1;
     if (!mpctx->vo_chain)
         return -1;
+    int frames = frame_index_get_count(mpctx);
+    if (frames >= 0)
+        return frames;
     double len = get_time_length(mpctx);
     double fps = mpctx->vo_chain->filter->container_fps;
     if (len < 0 || fps <= 0)
@@ -2423,16 +2433,26 @@ static int get_frame_count(struct MPContext *mpctx)
     return len * fps;
 }
 
+static int get_frame_number(struct MPContext *mpctx)
+{
+    int frames = get_frame_count(mpctx);
+    if (frames < 0)
+        return -1;
+    int frame = frame_index_get_frame(mpctx, mpctx->video_pts);
+    if (frame >= 0)
+        return frame;
+    return lrint(get_current_pos_ratio(mpctx, false) * frames);
+}
+
 static int mp_property_frame_number(void *ctx, struct m_property *prop,
                                     int action, void *arg)
 {
     MPContext *mpctx = ctx;
-    int frames = get_frame_count(mpctx);
-    if (frames < 0)
+    int frame = get_frame_number(mpctx);
+    if (frame < 0)
         return M_PROPERTY_UNAVAILABLE;
 
-    return m_property_int_ro(action, arg,
-        lrint(get_current_pos_ratio(mpctx, false) * frames));
+    return m_property_int_ro(action, arg, frame);
 }
 
 static int mp_property_frame_count(void *ctx, struct m_property *prop,
@@ -2744,7 +2764,7 @@ static int mp_property_video_frame_info(void *ctx, struct m_property *prop,
                 .rate = av_d2q(mpctx->vo_chain->filter->container_fps, INT_MAX),
                 .fps = container_fps,
             };
-            int frame = lrint(get_current_pos_ratio(mpctx, false) * get_frame_count(mpctx));
+            int frame = MPMAX(get_frame_number(mpctx), 0);
             av_timecode_make_string(&tcr, approx_smpte, frame);
         }
     }
@@ -3078,6 +3098,82 @@ static int mp_property_perf_info(void *ctx, struct m_property *p, int action,
     return M_PROPERTY_NOT_IMPLEMENTED;
 }
 
+static int mp_property_startup_trace_spans(void *ctx, struct m_property *p,
+                                           int action, void *arg)
+{
+    MPContext *mpctx = ctx;
+
+    switch (action) {
+    case M_PROPERTY_GET_TYPE:
+        *(struct m_option *)arg = (struct m_option){.type = CONF_TYPE_NODE};
+        return M_PROPERTY_OK;
+    case M_PROPERTY_GET:
+        trace_query(mpctx->global, (struct mpv_node *)arg);
+        return M_PROPERTY_OK;
+    }
+    return M_PROPERTY_NOT_IMPLEMENTED;
+}
+
+static int mp_property_frame_cache(void *ctx, struct m_property *p,
+                                   int action, void *arg)
+{
+    MPContext *mpctx = ctx;
+
+    if (action == M_PROPERTY_GET_TYPE) {
+        *(struct m_option *)arg = (struct m_option){.type = CONF_TYPE_NODE};
+        return M_PROPERTY_OK;
+    }
+    if (action != M_PROPERTY_GET)
+        return M_PROPERTY_NOT_IMPLEMENTED;
+
+    struct mp_frame_cache *cache = mpctx->frame_cache;
+    int num = mp_frame_cache_num_frames(cache);
+
+    struct mpv_node *r = (struct mpv_node *)arg;
+    node_init(r, MPV_FORMAT_NODE_MAP, NULL);
+    node_map_add_int64(r, "frames", num);
+    node_map_add_int64(r, "bytes", mp_frame_cache_get_bytes(cache));
+    if (num) {
+        node_map_add_double(r, "start", mp_frame_cache_get(cache, 0)->pts);
+        node_map_add_double(r, "end", mp_frame_cache_get(cache, num - 1)->pts);
+    }
+    node_map_add_int64(r, "hits", mpctx->frame_cache_hits);
+    node_map_add_int64(r, "misses", mpctx->frame_cache_misses);
+    return M_PROPERTY_OK;
+}
+
+static int mp_property_thumbnail_cache_stats(void *ctx, struct m_property *p,
+                                             int action, void *arg)
+{
+    MPContext *mpctx = ctx;
+
+    if (action == M_PROPERTY_GET_TYPE) {
+        *(struct m_option *)arg = (struct m_option){.type = CONF_TYPE_NODE};
+        return M_PROPERTY_OK;
+    }
+    if (action != M_PROPERTY_GET)
+        return M_PROPERTY_NOT_IMPLEMENTED;
+
+    thumbnail_get_stats(mpctx, arg);
+    return M_PROPERTY_OK;
+}
+
+static int mp_property_frame_index_state(void *ctx, struct m_property *p,
+                                         int action, void *arg)
+{
+    MPContext *mpctx = ctx;
+
+    if (action == M_PROPERTY_GET_TYPE) {
+        *(struct m_option *)arg = (struct m_option){.type = CONF_TYPE_NODE};
+        return M_PROPERTY_OK;
+    }
+    if (action != M_PROPERTY_GET)
+        return M_PROPERTY_NOT_IMPLEMENTED;
+
+    frame_index_get_info(mpctx, arg);
+    return M_PROPERTY_OK;
+}
+
 static int mp_property_vo(void *ctx, struct m_property *p, int action, void *arg)
 {
     MPContext *mpctx = ctx;
@@ -4717,6 +4813,10 @@ static const struct m_property mp_properties_base[] = {
     {"vo-configured", mp_property_vo_configured},
     {"vo-passes", mp_property_vo_passes},
     {"perf-info", mp_property_perf_info},
+    {"startup-trace-spans", mp_property_startup_trace_spans},
+    {"frame-cache", mp_property_frame_cache},
+    {"thumbnail-cache-stats", mp_property_thumbnail_cache_stats},
+    {"frame-index-state", mp_property_frame_index_state},
     {"current-vo", mp_property_vo},
     {"current-gpu-context", mp_property_gpu_context},
     {"container-fps", mp_property_fps},
@@ -4933,11 +5033,15 @@ uint64_t mp_get_property_event_mask(const char *name)
 int mp_get_property_id(struct MPContext *mpctx, const char *name)
 {
     struct command_ctx *ctx = mpctx->command_ctx;
-    for (int n = 0; ctx->properties[n].name; n++) {
-        if (match_property(ctx->properties[n].name, name))
-            return n;
-    }
-    return -1;
+    // Same as match_property(): "options/<name>" maps to the property <name>,
+    // and sub-properties to their top-level property.
+    if (strncmp(name, "options/", 8) == 0)
+        name += 8;
+    bstr prefix;
+    const char *rem;
+    m_property_split_path(name, &prefix, &rem);
+    struct m_property *prop = m_property_index_find(ctx->prop_index, prefix);
+    return prop ? prop - ctx->properties : -1;
 }
 
 static bool is_property_set(int action, void *val)
@@ -4962,10 +5066,11 @@ int mp_property_do(const char *name, int action, void *val,
                    struct MPContext *ctx)
 {
     struct command_ctx *cmd = ctx->command_ctx;
-    int r = m_property_do(ctx->log, cmd->properties, name, action, val, ctx);
+    int r = m_property_do(ctx->log, cmd->prop_index, name, action, val, ctx);
 
     if (mp_msg_test(ctx->log, MSGL_V) && is_property_set(action, val)) {
-        struct m_property *property = m_property_list_find(cmd->properties, name);
+        struct m_property *property =
+            m_property_index_find(cmd->prop_index, bstr0(name));
         if (property && property->is_noisy && !mp_msg_test(ctx->log, MSGL_TRACE))
             return r;
 
@@ -4991,7 +5096,7 @@ int mp_property_do(const char *name, int action, void *val,
 char *mp_property_expand_string(struct MPContext *mpctx, const char *str)
 {
     struct command_ctx *ctx = mpctx->command_ctx;
-    return m_properties_expand_string(ctx->properties, str, mpctx);
+    return m_properties_expand_string(ctx->prop_index, str, mpctx);
 }
 
 // Before expanding properties, parse C-style escapes like "\n"
@@ -5614,7 +5719,7 @@ static void change_property_cmd(struct mp_cmd_ctx *cmd,
     struct m_property *prop = NULL;
     if (cmd->cmd->coalesce) {
         struct command_ctx *ctx = cmd->mpctx->command_ctx;
-        prop = m_property_list_find(ctx->properties, name);
+        prop = m_property_index_find(ctx->prop_index, bstr0(name));
         if (prop)
             prop->coalesce = true;
     }
@@ -5930,6 +6035,9 @@ static void cmd_seek(void *p)
     case 1: precision = MPSEEK_KEYFRAME; break;
     case 2: precision = MPSEEK_EXACT; break;
     }
+    int flags = MPSEEK_FLAG_DELAY;
+    if (cmd->args[1].v.i & 64)
+        flags |= MPSEEK_FLAG_SCRUB;
     if (!mpctx->playback_initialized) {
         cmd->success = false;
         return;
@@ -5938,14 +6046,14 @@ static void cmd_seek(void *p)
     mark_seek(mpctx);
     switch (abs) {
     case 0: { // Relative seek
-        queue_seek(mpctx, MPSEEK_RELATIVE, v, precision, MPSEEK_FLAG_DELAY);
+        queue_seek(mpctx, MPSEEK_RELATIVE, v, precision, flags);
         set_osd_function(mpctx, (v > 0) ? OSD_FFW : OSD_REW);
         break;
     }
     case 1: { // Absolute seek by percentage
         double ratio = v / 100.0;
         double cur_pos = get_current_pos_ratio(mpctx, false);
-        queue_seek(mpctx, MPSEEK_FACTOR, ratio, precision, MPSEEK_FLAG_DELAY);
+        queue_seek(mpctx, MPSEEK_FACTOR, ratio, precision, flags);
         set_osd_function(mpctx, cur_pos < ratio ? OSD_FFW : OSD_REW);
         break;
     }
@@ -5959,7 +6067,7 @@ static void cmd_seek(void *p)
             }
             v = MPMAX(0, len + v);
         }
-        queue_seek(mpctx, MPSEEK_ABSOLUTE, v, precision, MPSEEK_FLAG_DELAY);
+        queue_seek(mpctx, MPSEEK_ABSOLUTE, v, precision, flags);
         set_osd_function(mpctx,
                          v > get_current_time(mpctx) ? OSD_FFW : OSD_REW);
         break;
@@ -5967,7 +6075,7 @@ static void cmd_seek(void *p)
     case 3: { // Relative seek by percentage
         queue_seek(mpctx, MPSEEK_FACTOR,
                    get_current_pos_ratio(mpctx, false) + v / 100.0,
-                   precision, MPSEEK_FLAG_DELAY);
+                   precision, flags);
         set_osd_function(mpctx, v > 0 ? OSD_FFW : OSD_REW);
         break;
     }}
@@ -6352,6 +6460,81 @@ static void cmd_expand_path(void *p)
     };
 }
 
+static void cmd_fingerprint_query(void *p)
+{
+    struct mp_cmd_ctx *cmd = p;
+    struct MPContext *mpctx = cmd->mpctx;
+    void *tmp = talloc_new(NULL);
+
+    char *path = mp_get_user_path(tmp, mpctx->global, cmd->args[0].v.s);
+    bstr hash = {0};
+    bool hash_ok = bstr_decode_hex(tmp, bstr0(cmd->args[1].v.s), &hash);
+    int max_distance = cmd->args[2].v.i;
+
+    // Index files can be large; don't block the core while reading them.
+    mp_core_unlock(mpctx);
+
+    bool success = false;
+    struct mp_fp_index *idx = mp_fp_index_load(tmp, mpctx->log, path);
+    if (!idx)
+        goto done;
+
+    if (!hash_ok || hash.len != idx->hash_size) {
+        MP_ERR(mpctx, "fingerprint-query: hash does not match the index type.\n");
+        goto done;
+    }
+
+    struct mp_fp_match *matches;
+    int num_matches = mp_fp_index_find(idx, hash.start, max_distance, tmp,
+                                       &matches);
+
+    struct mpv_node *res = &cmd->result;
+    node_init(res, MPV_FORMAT_NODE_ARRAY, NULL);
+    for (int n = 0; n < num_matches; n++) {
+        struct mp_fp_match *m = &matches[n];
+        struct mpv_node *e = node_array_add(res, MPV_FORMAT_NODE_MAP);
+        if (m->pts != MP_NOPTS_VALUE)
+            node_map_add_double(e, "pts", m->pts);
+        node_map_add_int64(e, "distance", m->distance);
+        node_map_add_flag(e, "scene-cut",
+                          idx->entries[m->index].flags & MP_FP_SCENE_CUT);
+    }
+    success = true;
+
+done:
+    talloc_free(tmp);
+    mp_core_lock(mpctx);
+    cmd->success = success;
+}
+
+static void cmd_frame_index_lookup(void *p)
+{
+    struct mp_cmd_ctx *cmd = p;
+    struct MPContext *mpctx = cmd->mpctx;
+    int frame = cmd->args[0].v.i;
+
+    int frames = frame_index_get_count(mpctx);
+    if (frames < 0) {
+        mp_cmd_msg(cmd, MSGL_ERR, "No frame index available.");
+        cmd->success = false;
+        return;
+    }
+    if (frame >= frames) {
+        mp_cmd_msg(cmd, MSGL_ERR, "Frame %d out of range (%d frames).",
+                   frame, frames);
+        cmd->success = false;
+        return;
+    }
+
+    double pts = frame_index_get_pts(mpctx, frame);
+    double keyframe = frame_index_get_keyframe(mpctx, pts);
+    struct mpv_node *res = &cmd->result;
+    node_init(res, MPV_FORMAT_NODE_MAP, NULL);
+    node_map_add_double(res, "pts", pts);
+    if (keyframe != MP_NOPTS_VALUE)
+        node_map_add_double(res, "keyframe-pts", keyframe);
+}
+
 static void cmd_normalize_path(void *p)
 {
     struct mp_cmd_ctx *cmd = p;
@@ -7064,6 +7247,7 @@ static void cmd_script_binding(void *p)
         snprintf(space, sizeof(space), "%.*s", (int)(sep - name), name);
         target = space;
         name = sep + 1;
+        mp_load_pending_script(mpctx, target);
     }
     char state[4] = {'p', incmd->is_mouse_button ? 'm' : '-',
                           incmd->canceled ? 'c' : '-'};
@@ -7107,6 +7291,7 @@ static void cmd_script_message_to(void *p)
         MP_TARRAY_APPEND(event, event->args, event->num_args,
                          talloc_strdup(event, cmd->args[n].v.s));
     }
+    mp_load_pending_script(mpctx, cmd->args[0].v.s);
     if (mp_client_send_event(mpctx, cmd->args[0].v.s, 0,
                                 MPV_EVENT_CLIENT_MESSAGE, event) < 0)
     {
@@ -7466,7 +7651,8 @@ const struct mp_cmd_def mp_cmds[] = {
                 {"absolute", 4|2},
                 {"relative-percent", 4|3},
                 {"keyframes", 32|8},
-                {"exact", 32|16}),
+                {"exact", 32|16},
+                {"scrub", 64}),
                 OPTDEF_INT(4|0)},
             // backwards compatibility only
             {"legacy", OPT_CHOICE(v.i,
@@ -7723,6 +7909,28 @@ const struct mp_cmd_def mp_cmds[] = {
                 OPTDEF_INT(0)},
         },
     },
+    { "thumbnail", cmd_thumbnail,
+        {
+            {"time", OPT_TIME(v.d)},
+            {"width", OPT_INT(v.i), M_RANGE(0, 4096), OPTDEF_INT(0)},
+            {"height", OPT_INT(v.i), M_RANGE(0, 4096), OPTDEF_INT(0)},
+        },
+        .spawn_thread = true,
+        .can_abort = true,
+    },
+    { "fingerprint-query", cmd_fingerprint_query,
+        {
+            {"index", OPT_STRING(v.s)},
+            {"hash", OPT_STRING(v.s)},
+            {"max-distance", OPT_INT(v.i), M_RANGE(0, 255), OPTDEF_INT(8)},
+        },
+        .spawn_thread = true,
+    },
+    { "frame-index-lookup", cmd_frame_index_lookup,
+        {
+            {"frame", OPT_INT(v.i), M_RANGE(0, INT_MAX)},
+        },
+    },
     { "loadfile", cmd_loadfile,
         {
             {"url", OPT_STRING(v.s)},
@@ -8062,6 +8270,8 @@ void command_init(struct MPContext *mpctx)
         ctx->properties[count++] = prop;
     }
 
+    ctx->prop_index = m_property_index_create(ctx, ctx->properties);
+
     node_init(&ctx->mdata, MPV_FORMAT_NODE_ARRAY, NULL);
     talloc_steal(ctx, ctx->mdata.u.list);
 
@@ -8148,11 +8358,65 @@ void run_command_opts(struct MPContext *mpctx)
     ctx->command_opts_processed = true;
 }
 
+// Send MPV_EVENT_PLAYLIST_CHANGE for the playlist changes since the last call.
+static void send_playlist_changes(struct MPContext *mpctx)
+{
+    struct command_ctx *cmd = mpctx->command_ctx;
+    struct playlist *pl = mpctx->playlist;
+
+    for (int n = 0; n < pl->num_changes; n++) {
+        struct playlist_change *ch = &pl->changes[n];
+        mpv_event_playlist_change ev = {
+            .index = -1,
+            .to_index = -1,
+        };
+        switch (ch->type) {
+        case PLAYLIST_CHANGE_INSERT:
+            ev.type = MPV_PLAYLIST_CHANGE_INSERT;
+            ev.index = ch->index;
+            ev.count = ch->count;
+            ev.playlist_entry_id = ch->id;
+            break;
+        case PLAYLIST_CHANGE_REMOVE:
+            ev.type = MPV_PLAYLIST_CHANGE_REMOVE;
+            ev.index = ch->index;
+            ev.count = ch->count;
+            break;
+        case PLAYLIST_CHANGE_MOVE:
+            ev.type = MPV_PLAYLIST_CHANGE_MOVE;
+            ev.index = ch->index;
+            ev.to_index = ch->to_index;
+            ev.playlist_entry_id = ch->id;
+            break;
+        default:
+            ev.type = MPV_PLAYLIST_CHANGE_RESET;
+        }
+        mp_client_broadcast_event(mpctx, MPV_EVENT_PLAYLIST_CHANGE, &ev);
+    }
+    pl->num_changes = 0;
+
+    uint64_t current_id = pl->current ? pl->current->id : 0;
+    if (current_id != cmd->playlist_current_id) {
+        cmd->playlist_current_id = current_id;
+        mpv_event_playlist_change ev = {
+            .type = MPV_PLAYLIST_CHANGE_CURRENT,
+            .index = playlist_entry_to_index(pl, pl->current),
+            .to_index = -1,
+            .playlist_entry_id = current_id,
+        };
+        mp_client_broadcast_event(mpctx, MPV_EVENT_PLAYLIST_CHANGE, &ev);
+    }
+}
+
 void mp_notify(struct MPContext *mpctx, int event, void *arg)
 {
     // The OSD can implicitly reference some properties.
     mpctx->osd_idle_update = true;
 
+    // Send pending playlist changes first, so that clients see them in the
+    // order relative to other events (like end-file with playlist_insert_id).
+    send_playlist_changes(mpctx);
+
     command_event(mpctx, event, arg);
 
     mp_client_broadcast_event(mpctx, event, arg);
@@ -8278,6 +8542,9 @@ void mp_option_run_callback(struct MPContext *mpctx, struct mp_option_callback *
         mpctx->ipc_ctx = mp_init_ipc(mpctx->clients, mpctx->global);
     }
 
+    if (opt_ptr == &opts->telemetry_shm)
+        reinit_telemetry(mpctx);
+
     if (flags & UPDATE_VO && mpctx->video_out) {
         struct track *track = mpctx->current_track[0][STREAM_VIDEO];
         uninit_video_out(mpctx);
@@ -8416,6 +8683,12 @@ void mp_option_run_callback(struct MPContext *mpctx, struct mp_option_callback *
     }
 #endif
 
+    if (opt_ptr == &opts->rgain_mode || opt_ptr == &opts->rgain_scan)
+        loudness_scan_update(mpctx);
+
+    if (opt_ptr == &opts->frame_index)
+        frame_index_update(mpctx);
+
     if (opt_ptr == &opts->pause)
         set_pause_state(mpctx, opts->pause);
 
@@ -84,6 +84,7 @@ enum seek_precision {
 enum seek_flags {
     MPSEEK_FLAG_DELAY = 1 << 0, // give player chance to coalesce multiple seeks
     MPSEEK_FLAG_NOFLUSH = 1 << 1, // keeping remaining data for seamless loops
+    MPSEEK_FLAG_SCRUB = 1 << 2, // part of an interactive drag (see mp_seek())
 };
 
 struct seek_params {
@@ -93,6 +94,20 @@ struct seek_params {
     unsigned flags; // MPSEEK_FLAG_*
 };
 
+// State of interactive scrubbing (seeks with MPSEEK_FLAG_SCRUB).
+struct scrub_state {
+    bool active;
+    double target;          // last requested target (not predicted)
+    double time;            // mp_time_sec() of the last request
+    double velocity;        // smoothed target change per second
+    double latency;         // smoothed seek-to-frame time, 0 if unknown
+    double seek_time;       // mp_time_sec() of the running seek, or -1
+    double seek_target;     // demuxer target of the running/last seek
+    // Targets in this range are known to map to the displayed keyframe.
+    double keyframe_start, keyframe_end;
+    int64_t seeks, skipped;
+};
+
 // Information about past video frames that have been sent to the VO.
 struct frame_info {
     double pts;
@@ -295,6 +310,10 @@ typedef struct MPContext {
 
     struct clipboard_ctx *clipboard;
 
+    struct loudness_scan *loudness_scan;
+    struct thumbnailer *thumbnailer;
+    struct frame_index *frame_index;
+
     // Return code to use with PT_QUIT
     int quit_custom_rc;
     bool has_quit_custom_rc;
@@ -340,6 +359,13 @@ typedef struct MPContext {
     struct mp_image *next_frames[VO_MAX_REQ_FRAMES + 1];
     int num_next_frames;
     struct mp_image *saved_frame;   // for hrseek_lastframe and hrseek_backstep
+    // Recently decoded frames, for seeking back without decoding (see
+    // --video-frame-cache).
+    struct mp_frame_cache *frame_cache;
+    int frame_cache_pos;            // next frame to replay from it, or -1
+    bool frame_cache_av_desync;     // audio not seeked along with the video
+    int frame_cache_dropped;        // decoder drop counter at the last add
+    int64_t frame_cache_hits, frame_cache_misses;
 
     enum playback_status video_status, audio_status;
     bool restart_complete;
@@ -414,6 +440,7 @@ typedef struct MPContext {
     int64_t last_time;
 
     struct seek_params seek;
+    struct scrub_state scrub;
 
     /* Heuristic for relative chapter seeks: keep track which chapter
      * the user wanted to go to, even if we aren't exactly within the
@@ -452,8 +479,12 @@ typedef struct MPContext {
     int num_option_callbacks;
 
     struct mp_ipc_ctx *ipc_ctx;
+    struct script_host *script_host;
+    struct mp_telemetry *telemetry;
 
     int64_t builtin_script_ids[9];
+    // Built-in scripts waiting for their first use (--lazy-builtin-scripts).
+    const char *builtin_script_pending[9];
 
     mp_mutex abort_lock;
 
@@ -570,6 +601,26 @@ void prefetch_next(struct MPContext *mpctx);
 void update_lavfi_complex(struct MPContext *mpctx);
 void update_vo_chain_el_pair(struct MPContext *mpctx);
 
+// loudness.c
+void loudness_scan_update(struct MPContext *mpctx);
+bool loudness_scan_get(struct MPContext *mpctx, struct replaygain_data *rg);
+void handle_loudness_scan(struct MPContext *mpctx);
+void loudness_scan_destroy(struct MPContext *mpctx);
+
+// thumbnail.c
+void cmd_thumbnail(void *p);
+void thumbnail_get_stats(struct MPContext *mpctx, struct mpv_node *res);
+void thumbnail_destroy(struct MPContext *mpctx);
+
+// frame_index.c
+void frame_index_update(struct MPContext *mpctx);
+int frame_index_get_count(struct MPContext *mpctx);
+int frame_index_get_frame(struct MPContext *mpctx, double pts);
+double frame_index_get_pts(struct MPContext *mpctx, int frame);
+double frame_index_get_keyframe(struct MPContext *mpctx, double pts);
+void frame_index_get_info(struct MPContext *mpctx, struct mpv_node *res);
+void frame_index_destroy(struct MPContext *mpctx);
+
 // main.c
 int mp_initialize(struct MPContext *mpctx, char **argv);
 struct MPContext *mp_create(void);
@@ -633,6 +684,7 @@ double chapter_start_time(struct MPContext *mpctx, int chapter);
 int get_chapter_count(struct MPContext *mpctx);
 int get_cache_buffering_percentage(struct MPContext *mpctx);
 void execute_queued_seek(struct MPContext *mpctx);
+void reinit_telemetry(struct MPContext *mpctx);
 void run_playloop(struct MPContext *mpctx);
 void mp_idle(struct MPContext *mpctx);
 void idle_loop(struct MPContext *mpctx);
@@ -656,9 +708,21 @@ struct mp_scripting {
     const char *file_ext;   // e.g. "lua"
     bool no_thread;         // don't run load() on dedicated thread
     int (*load)(struct mp_script_args *args);
+    // Optional, for running on the shared script host (--script-host-threads).
+    // host_start() loads the script and returns its state, or NULL on error.
+    // It sets *need_thread if the script can't be driven by host_step().
+    // host_step() handles pending events and timers, and returns the number
+    // of seconds until it wants to be called again, or <0 if the script
+    // exited. host_run() runs the script's normal event loop until it exits.
+    void *(*host_start)(struct mp_script_args *args, bool *need_thread);
+    double (*host_step)(void *state);
+    void (*host_run)(void *state);
+    void (*host_destroy)(void *state);
 };
 bool mp_load_scripts(struct MPContext *mpctx);
+void mp_script_host_destroy(struct MPContext *mpctx);
 void mp_load_builtin_scripts(struct MPContext *mpctx);
+void mp_load_pending_script(struct MPContext *mpctx, const char *name);
 int64_t mp_load_user_script(struct MPContext *mpctx, const char *fname);
 
 // sub.c
@@ -682,5 +746,7 @@ void mp_force_video_refresh(struct MPContext *mpctx);
 void uninit_video_out(struct MPContext *mpctx);
 void uninit_video_chain(struct MPContext *mpctx);
 double calc_average_frame_duration(struct MPContext *mpctx);
+void reset_frame_cache(struct MPContext *mpctx);
+bool seek_frame_cache(struct MPContext *mpctx, double pts, int step);
 
 #endif /* MPLAYER_MP_CORE_H */
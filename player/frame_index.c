@@ -0,0 +1,388 @@
+/*
+ * This file is part of mpv.
+ *
+ * mpv is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * mpv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Background frame index (--frame-index). A low priority thread opens its own
+// demuxer for the playing video stream and reads all of its packets, without
+// decoding them. The presentation timestamps of all frames and keyframes are
+// collected into sorted arrays. Once complete, the index is used for exact
+// frame numbers and frame stepping, and to seek directly to the keyframe
+// before the target of an exact seek, which matters for VFR files and
+// demuxers with unreliable seeking.
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "mpv_talloc.h"
+
+#include "common/common.h"
+#include "common/global.h"
+#include "common/msg.h"
+#include "demux/demux.h"
+#include "demux/packet.h"
+#include "demux/stheader.h"
+#include "misc/node.h"
+#include "misc/thread_tools.h"
+#include "options/options.h"
+#include "osdep/threads.h"
+#include "osdep/timer.h"
+
+#include "client.h"
+#include "core.h"
+#include "video_source.h"
+
+// Timestamps are compared with this tolerance, because the player's video pts
+// can differ from the packet pts by rounding.
+#define PTS_EPS 1e-4
+
+// Check for a new job or termination after this many packets.
+#define CHECK_INTERVAL 256
+
+struct index {
+    double *frames;     // sorted presentation timestamps of all frames
+    int num_frames;
+    double *keyframes;  // sorted presentation timestamps of keyframes
+    int num_keyframes;
+};
+
+struct frame_index {
+    struct mpv_global *global;
+    struct mp_log *log;
+    struct mp_cancel *cancel;
+    mp_thread thread;
+
+    mp_mutex lock;
+    mp_cond wakeup;
+    // --- protected by lock
+    bool terminate;
+    struct video_source *src; // stream the results are for, or NULL
+    unsigned generation;    // incremented when src changes
+    bool pending;           // src was not picked up by the thread yet
+    bool failed;
+    int64_t packets;        // packets read so far
+    struct index *index;    // complete index for src, or NULL
+};
+
+static int compare_double(const void *pa, const void *pb)
+{
+    double a = *(const double *)pa, b = *(const double *)pb;
+    return a < b ? -1 : (a > b ? 1 : 0);
+}
+
+static void sort_unique(double *a, int *num)
+{
+    qsort(a, *num, sizeof(a[0]), compare_double);
+    int out = 0;
+    for (int n = 0; n < *num; n++) {
+        if (!out || a[n] != a[out - 1])
+            a[out++] = a[n];
+    }
+    *num = out;
+}
+
+// Index of the last entry <= pts, or -1.
+static int find_entry(double *a, int num, double pts)
+{
+    int lo = 0, hi = num;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (a[mid] <= pts + PTS_EPS) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo - 1;
+}
+
+// Returns whether the current job is still wanted.
+static bool update_progress(struct frame_index *p, unsigned generation,
+                            int64_t packets)
+{
+    mp_mutex_lock(&p->lock);
+    bool ok = !p->terminate && p->generation == generation;
+    if (ok)
+        p->packets = packets;
+    mp_mutex_unlock(&p->lock);
+    return ok;
+}
+
+// Read all packets of the video stream. Returns NULL on failure or if the job
+// was replaced while running.
+static struct index *scan_source(struct frame_index *p,
+                                 struct video_source *src, unsigned generation)
+{
+    struct index *res = NULL;
+    struct index *idx = talloc_zero(NULL, struct index);
+
+    struct sh_stream *sh;
+    struct demuxer *demuxer = video_source_open(src, p->cancel, p->global, &sh);
+    if (!demuxer)
+        goto done;
+
+    int64_t start = mp_time_ns();
+    int64_t packets = 0;
+    while (1) {
+        if (packets % CHECK_INTERVAL == 0 &&
+            !update_progress(p, generation, packets))
+            goto done;
+        struct demux_packet *pkt = demux_read_any_packet(demuxer);
+        if (!pkt)
+            break;
+        if (pkt->stream != sh->index) {
+            talloc_free(pkt);
+            continue;
+        }
+        packets++;
+        double pts = pkt->pts;
+        bool keyframe = pkt->keyframe;
+        talloc_free(pkt);
+        if (pts == MP_NOPTS_VALUE) {
+            MP_VERBOSE(p, "Packet without timestamp in %s, not indexing.\n",
+                       src->url);
+            goto done;
+        }
+        MP_TARRAY_APPEND(idx, idx->frames, idx->num_frames, pts);
+        if (keyframe)
+            MP_TARRAY_APPEND(idx, idx->keyframes, idx->num_keyframes, pts);
+    }
+    if (mp_cancel_test(p->cancel) || !update_progress(p, generation, packets))
+        goto done;
+
+    sort_unique(idx->frames, &idx->num_frames);
+    sort_unique(idx->keyframes, &idx->num_keyframes);
+    if (!idx->num_keyframes)
+        goto done;
+
+    MP_VERBOSE(p, "Indexed %d frames (%d keyframes) of %s in %.1fs.\n",
+               idx->num_frames, idx->num_keyframes, src->url,
+               MP_TIME_NS_TO_S(mp_time_ns() - start));
+    res = idx;
+    idx = NULL;
+
+done:
+    demux_free(demuxer);
+    talloc_free(idx);
+    return res;
+}
+
+static MP_THREAD_VOID index_thread(void *ctx)
+{
+    struct frame_index *p = ctx;
+    mp_thread_set_name("frame-index");
+    mp_thread_set_background();
+
+    mp_mutex_lock(&p->lock);
+    while (!p->terminate) {
+        if (!p->pending) {
+            mp_cond_wait(&p->wakeup, &p->lock);
+            continue;
+        }
+        p->pending = false;
+        unsigned generation = p->generation;
+        struct video_source *src = video_source_dup(NULL, p->src);
+        mp_mutex_unlock(&p->lock);
+
+        struct index *idx = scan_source(p, src, generation);
+
+        mp_mutex_lock(&p->lock);
+        if (p->generation == generation) {
+            p->index = talloc_steal(p, idx);
+            p->failed = !idx;
+            idx = NULL;
+        }
+        talloc_free(idx);
+        talloc_free(src);
+    }
+    mp_mutex_unlock(&p->lock);
+
+    MP_THREAD_RETURN();
+}
+
+static struct frame_index *get_frame_index(struct MPContext *mpctx)
+{
+    if (mpctx->frame_index)
+        return mpctx->frame_index;
+
+    struct frame_index *p = talloc_zero(NULL, struct frame_index);
+    p->global = mpctx->global;
+    p->log = mp_log_new(p, mpctx->log, "frame-index");
+    p->cancel = mp_cancel_new(p);
+    mp_mutex_init(&p->lock);
+    mp_cond_init(&p->wakeup);
+    if (mp_thread_create(&p->thread, index_thread, p)) {
+        mp_cond_destroy(&p->wakeup);
+        mp_mutex_destroy(&p->lock);
+        talloc_free(p);
+        return NULL;
+    }
+    mpctx->frame_index = p;
+    return p;
+}
+
+// Describe the current video stream, if it is a local file. The result points
+// into mpctx.
+static bool get_source(struct MPContext *mpctx, struct video_source *out)
+{
+    if (!mpctx->demuxer || mpctx->demuxer->is_network)
+        return false;
+    return video_source_get(mpctx, out);
+}
+
+// Start indexing the current video stream, if it isn't indexed yet.
+void frame_index_update(struct MPContext *mpctx)
+{
+    struct video_source src;
+    bool wanted = mpctx->opts->frame_index && get_source(mpctx, &src);
+    if (!wanted && !mpctx->frame_index)
+        return;
+
+    struct frame_index *p = get_frame_index(mpctx);
+    if (!p)
+        return;
+
+    mp_mutex_lock(&p->lock);
+    if (!wanted || !video_source_equals(p->src, &src)) {
+        TA_FREEP(&p->src);
+        TA_FREEP(&p->index);
+        p->generation++;
+        p->pending = false;
+        p->failed = false;
+        p->packets = 0;
+        if (wanted) {
+            p->src = video_source_dup(p, &src);
+            p->pending = true;
+            MP_VERBOSE(p, "Indexing %s\n", src.url);
+        }
+        mp_cond_signal(&p->wakeup);
+    }
+    mp_mutex_unlock(&p->lock);
+}
+
+// Return the complete index for the current video stream, or NULL. Returns
+// with the lock held if successful.
+static struct index *lock_index(struct MPContext *mpctx)
+{
+    struct frame_index *p = mpctx->frame_index;
+    struct video_source src;
+    if (!p || !mpctx->opts->frame_index || !get_source(mpctx, &src))
+        return NULL;
+    mp_mutex_lock(&p->lock);
+    if (p->index && video_source_equals(p->src, &src))
+        return p->index;
+    mp_mutex_unlock(&p->lock);
+    return NULL;
+}
+
+static void unlock_index(struct MPContext *mpctx)
+{
+    mp_mutex_unlock(&mpctx->frame_index->lock);
+}
+
+// Return the number of frames, or -1 if no index is available.
+int frame_index_get_count(struct MPContext *mpctx)
+{
+    struct index *idx = lock_index(mpctx);
+    if (!idx)
+        return -1;
+    int res = idx->num_frames;
+    unlock_index(mpctx);
+    return res;
+}
+
+// Return the number of the frame displayed at pts (0 for timestamps before the
+// first frame), or -1 if no index is available.
+int frame_index_get_frame(struct MPContext *mpctx, double pts)
+{
+    if (pts == MP_NOPTS_VALUE)
+        return -1;
+    struct index *idx = lock_index(mpctx);
+    if (!idx)
+        return -1;
+    int res = MPMAX(find_entry(idx->frames, idx->num_frames, pts), 0);
+    unlock_index(mpctx);
+    return res;
+}
+
+// Return the pts of the given frame (clamped to the valid range), or
+// MP_NOPTS_VALUE if no index is available.
+double frame_index_get_pts(struct MPContext *mpctx, int frame)
+{
+    struct index *idx = lock_index(mpctx);
+    if (!idx)
+        return MP_NOPTS_VALUE;
+    double res = idx->frames[MPCLAMP(frame, 0, idx->num_frames - 1)];
+    unlock_index(mpctx);
+    return res;
+}
+
+// Return the pts of the last keyframe at or before pts, or MP_NOPTS_VALUE if
+// no index is available or pts is before the first keyframe.
+double frame_index_get_keyframe(struct MPContext *mpctx, double pts)
+{
+    if (pts == MP_NOPTS_VALUE)
+        return MP_NOPTS_VALUE;
+    struct index *idx = lock_index(mpctx);
+    if (!idx)
+        return MP_NOPTS_VALUE;
+    int n = find_entry(idx->keyframes, idx->num_keyframes, pts);
+    double res = n >= 0 ? idx->keyframes[n] : MP_NOPTS_VALUE;
+    unlock_index(mpctx);
+    return res;
+}
+
+void frame_index_get_info(struct MPContext *mpctx, struct mpv_node *res)
+{
+    struct frame_index *p = mpctx->frame_index;
+    node_init(res, MPV_FORMAT_NODE_MAP, NULL);
+    const char *state = "disabled";
+    int64_t packets = 0, frames = 0, keyframes = 0;
+    if (p) {
+        mp_mutex_lock(&p->lock);
+        if (p->index) {
+            state = "complete";
+            frames = p->index->num_frames;
+            keyframes = p->index->num_keyframes;
+        } else if (p->failed) {
+            state = "failed";
+        } else if (p->src) {
+            state = "indexing";
+        }
+        packets = p->packets;
+        mp_mutex_unlock(&p->lock);
+    }
+    node_map_add_string(res, "state", state);
+    node_map_add_int64(res, "packets", packets);
+    node_map_add_int64(res, "frames", frames);
+    node_map_add_int64(res, "keyframes", keyframes);
+}
+
+void frame_index_destroy(struct MPContext *mpctx)
+{
+    struct frame_index *p = mpctx->frame_index;
+    if (!p)
+        return;
+    mp_mutex_lock(&p->lock);
+    p->terminate = true;
+    mp_cond_signal(&p->wakeup);
+    mp_mutex_unlock(&p->lock);
+    mp_cancel_trigger(p->cancel);
+    mp_thread_join(p->thread);
+    mp_cond_destroy(&p->wakeup);
+    mp_mutex_destroy(&p->lock);
+    talloc_free(p);
+    mpctx->frame_index = NULL;
+}
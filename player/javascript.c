@@ -782,6 +782,37 @@ static void script_command_native(js_State *J, void *af)
         pushnode(J, presult_node);
 }
 
+// args: array of native commands
+static void script_command_batch(js_State *J, void *af)
+{
+    mpv_node list;
+    makenode(af, &list, J, 1);
+    if (list.format != MPV_FORMAT_NODE_ARRAY)
+        js_error(J, "array of commands expected");
+    int num = list.u.list->num;
+    mpv_batch_item *items = talloc_zero_array(af, mpv_batch_item, num);
+    for (int n = 0; n < num; n++) {
+        if (mp_batch_item_from_node(&items[n], &list.u.list->values[n]) < 0)
+            js_error(J, "invalid batch entry %d", n);
+    }
+    int e = mpv_command_batch(jclient(J), items, num);
+    set_last_error(jctx(J), e < 0, e < 0 ? mpv_error_string(e) : NULL);
+    for (int n = 0; n < num; n++)
+        *new_af_mpv_node(af) = items[n].result;  // free it with af
+    js_newarray(J);  // the return value
+    for (int n = 0; n < num; n++) {
+        js_newobject(J);
+        if (items[n].error >= 0) {
+            pushnode(J, &items[n].result);
+            js_setproperty(J, -2, "data");
+        } else {
+            js_pushstring(J, mpv_error_string(items[n].error));
+            js_setproperty(J, -2, "error");
+        }
+        js_setindex(J, -2, n);
+    }
+}
+
 // args: async-command-id, native-command
 static void script__command_native_async(js_State *J, void *af)
 {
@@ -1180,6 +1211,7 @@ static const struct fn_entry main_fns[] = {
     FN_ENTRY(command, 1),
     FN_ENTRY(commandv, 0),
     AF_ENTRY(command_native, 2),
+    AF_ENTRY(command_batch, 1),
     AF_ENTRY(_command_native_async, 2),
     FN_ENTRY(_abort_async_command, 1),
     FN_ENTRY(del_property, 1),
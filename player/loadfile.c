@@ -44,6 +44,7 @@
 #include "common/common.h"
 #include "common/encode.h"
 #include "common/stats.h"
+#include "common/trace.h"
 #include "input/input.h"
 #include "misc/json.h"
 #include "misc/language.h"
@@ -823,6 +824,7 @@ void mp_switch_track_n(struct MPContext *mpctx, int order, enum stream_type type
 
     if (type == STREAM_VIDEO && order == 0) {
         reinit_video_chain(mpctx);
+        frame_index_update(mpctx);
     } else if (type == STREAM_AUDIO && order == 0) {
         reinit_audio_chain(mpctx);
     } else if (type == STREAM_SUB && order >= 0 && order <= 2) {
@@ -1784,6 +1786,7 @@ static void play_current_file(struct MPContext *mpctx)
     // let get_current_time() show 0 as start time (before playback_pts is set)
     mpctx->last_seek_pts = 0.0;
     mpctx->seek = (struct seek_params){ 0 };
+    mpctx->scrub = (struct scrub_state){ 0 };
     mpctx->filter_root = mp_filter_create_root(mpctx->global);
     mp_filter_graph_set_wakeup_cb(mpctx->filter_root, mp_wakeup_core_cb, mpctx);
     mp_filter_graph_set_max_run_time(mpctx->filter_root, 0.1);
@@ -1818,12 +1821,14 @@ static void play_current_file(struct MPContext *mpctx)
         }
     }
 
+    trace_begin(mpctx->global, "per-file-options");
     mp_load_auto_profiles(mpctx);
 
     bool watch_later = mp_load_playback_resume(mpctx, mpctx->filename);
 
     load_per_file_options(mpctx->mconfig, mpctx->playing->params,
                           mpctx->playing->num_params);
+    trace_end(mpctx->global, "per-file-options");
 
     mpctx->remaining_file_loops = mpctx->opts->loop_file;
     mp_notify_property(mpctx, "remaining-file-loops");
@@ -1998,6 +2003,8 @@ static void play_current_file(struct MPContext *mpctx)
     mpctx->playlist->playlist_started = true;
     mp_notify(mpctx, MPV_EVENT_FILE_LOADED, NULL);
     update_screensaver_state(mpctx);
+    loudness_scan_update(mpctx);
+    frame_index_update(mpctx);
     clear_playlist_paths(mpctx);
 
     // Clear out subs from the previous file if the video track is a still image.
@@ -2220,8 +2227,10 @@ void mp_play_files(struct MPContext *mpctx)
     // Wait for all scripts to load before possibly starting playback.
     if (!mp_clients_all_initialized(mpctx)) {
         MP_VERBOSE(mpctx, "Waiting for scripts...\n");
+        trace_begin(mpctx->global, "wait-scripts");
         while (!mp_clients_all_initialized(mpctx))
             mp_idle(mpctx);
+        trace_end(mpctx->global, "wait-scripts");
         mp_wakeup_core(mpctx); // avoid lost wakeups during waiting
         MP_VERBOSE(mpctx, "Done loading scripts.\n");
     }
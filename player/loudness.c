@@ -0,0 +1,618 @@
+/*
+ * This file is part of mpv.
+ *
+ * mpv is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * mpv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Background ReplayGain scanner. Files without ReplayGain tags are decoded on
+// a low priority thread, and their EBU R128 loudness is stored in a cache file
+// in the cache directory. Each line of the cache file contains:
+//
+//   <file-hash> <size> <mtime> <album-hash|-> <peak> <bin>:<count>...
+//
+// where the hashes are MD5 of the normalized path, and of the directory plus
+// album tag, and the bins are the non-empty entries of the gating block
+// histogram (see audio/ebur128.h). Storing the histogram instead of the
+// loudness value allows computing the album loudness over all scanned tracks
+// of an album. Later entries override earlier ones with the same file hash.
+
+#include <inttypes.h>
+#include <math.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "mpv_talloc.h"
+
+#include "audio/aframe.h"
+#include "audio/chmap.h"
+#include "audio/ebur128.h"
+#include "audio/format.h"
+#include "common/common.h"
+#include "common/global.h"
+#include "common/msg.h"
+#include "common/playlist.h"
+#include "common/tags.h"
+#include "demux/demux.h"
+#include "demux/stheader.h"
+#include "filters/f_autoconvert.h"
+#include "filters/f_decoder_wrapper.h"
+#include "filters/filter.h"
+#include "misc/bstr.h"
+#include "misc/hash.h"
+#include "misc/path_utils.h"
+#include "misc/thread_tools.h"
+#include "options/options.h"
+#include "options/path.h"
+#include "osdep/io.h"
+#include "osdep/threads.h"
+#include "osdep/timer.h"
+#include "stream/stream.h"
+
+#include "core.h"
+
+#define CACHE_FILE "loudness-cache"
+#define CACHE_HEADER "mpv loudness cache v1\n"
+
+// Number of upcoming playlist entries to scan in advance.
+#define SCAN_AHEAD 5
+
+// ReplayGain 2.0 reference level.
+#define RG_REFERENCE_LUFS -18.0
+
+struct entry {
+    char *key;          // MD5 of the normalized path
+    int64_t size;
+    int64_t mtime;
+    char *album;        // MD5 of directory + album tag, or NULL
+    double peak;
+    uint32_t hist[MP_EBUR128_HIST_BINS];
+};
+
+struct job {
+    char *path;
+    char *key;
+    int64_t size;
+    int64_t mtime;
+    int stream_flags;   // of the playlist entry
+};
+
+struct loudness_scan {
+    struct MPContext *mpctx;
+    struct mp_log *log;
+    struct mpv_global *global;
+    struct mp_cancel *cancel;
+    char *cache_file;
+    mp_thread thread;
+
+    mp_mutex lock;
+    mp_cond wakeup;
+    // --- protected by lock
+    bool terminate;
+    bool graph_wakeup;
+    struct job **queue;
+    int num_queue;
+    struct entry **entries;
+    int num_entries;
+    char **skipped;     // keys of tagged or unscannable files
+    int num_skipped;
+
+    // Incremented on each new result.
+    atomic_uint results;
+    unsigned seen_results;  // core thread only
+};
+
+// Identify a local file by its normalized path, size, and modification time.
+// Returns false for non-local or inaccessible files.
+static bool get_identity(void *ta_ctx, const char *url, struct job *out)
+{
+    char *path = mp_file_get_path(ta_ctx, bstr0(url));
+    if (!path)
+        return false;
+    path = mp_normalize_path(ta_ctx, path);
+    struct stat st;
+    if (stat(path, &st) != 0 || !S_ISREG(st.st_mode))
+        return false;
+    *out = (struct job){
+        .path = path,
+        .key = bstrto0(ta_ctx, mp_hash_to_bstr(ta_ctx, path, strlen(path), "MD5")),
+        .size = st.st_size,
+        .mtime = st.st_mtime,
+    };
+    return true;
+}
+
+// Must hold lock.
+static struct entry *find_entry(struct loudness_scan *p, struct job *id)
+{
+    for (int n = p->num_entries - 1; n >= 0; n--) {
+        struct entry *e = p->entries[n];
+        if (strcmp(e->key, id->key) == 0)
+            return e->size == id->size && e->mtime == id->mtime ? e : NULL;
+    }
+    return NULL;
+}
+
+// Must hold lock.
+static bool is_known(struct loudness_scan *p, struct job *id)
+{
+    if (find_entry(p, id))
+        return true;
+    for (int n = 0; n < p->num_skipped; n++) {
+        if (strcmp(p->skipped[n], id->key) == 0)
+            return true;
+    }
+    for (int n = 0; n < p->num_queue; n++) {
+        if (strcmp(p->queue[n]->key, id->key) == 0)
+            return true;
+    }
+    return false;
+}
+
+// Must hold lock.
+static void add_entry(struct loudness_scan *p, struct entry *e)
+{
+    for (int n = 0; n < p->num_entries; n++) {
+        if (strcmp(p->entries[n]->key, e->key) == 0) {
+            talloc_free(p->entries[n]);
+            MP_TARRAY_REMOVE_AT(p->entries, p->num_entries, n);
+            break;
+        }
+    }
+    talloc_steal(p, e);
+    MP_TARRAY_APPEND(p, p->entries, p->num_entries, e);
+}
+
+static struct entry *parse_entry(void *ta_ctx, bstr line)
+{
+    struct entry *e = talloc_zero(ta_ctx, struct entry);
+    bstr key = bstr_split(line, " ", &line);
+    bstr size = bstr_split(line, " ", &line);
+    bstr mtime = bstr_split(line, " ", &line);
+    bstr album = bstr_split(line, " ", &line);
+    bstr peak = bstr_split(line, " ", &line);
+    if (!key.len || !album.len || !peak.len)
+        goto error;
+    e->key = bstrto0(e, key);
+    e->album = bstr_equals0(album, "-") ? NULL : bstrto0(e, album);
+    bstr rest;
+    e->size = bstrtoll(size, &rest, 10);
+    if (rest.len)
+        goto error;
+    e->mtime = bstrtoll(mtime, &rest, 10);
+    if (rest.len)
+        goto error;
+    e->peak = bstrtod(peak, &rest);
+    if (rest.len || !isfinite(e->peak))
+        goto error;
+    while (line.len) {
+        bstr bin = bstr_split(line, " ", &line);
+        if (!bin.len)
+            continue;
+        long long idx = bstrtoll(bin, &bin, 10);
+        if (!bstr_eatstart0(&bin, ":") || idx < 0 || idx >= MP_EBUR128_HIST_BINS)
+            goto error;
+        e->hist[idx] = bstrtoll(bin, &rest, 10);
+        if (rest.len)
+            goto error;
+    }
+    return e;
+error:
+    talloc_free(e);
+    return NULL;
+}
+
+static void print_entry(FILE *f, struct entry *e)
+{
+    fprintf(f, "%s %"PRId64" %"PRId64" %s %.9g", e->key, e->size, e->mtime,
+            e->album ? e->album : "-", e->peak);
+    for (int n = 0; n < MP_EBUR128_HIST_BINS; n++) {
+        if (e->hist[n])
+            fprintf(f, " %d:%"PRIu32, n, e->hist[n]);
+    }
+    fputs("\n", f);
+}
+
+// Replace the cache file with the current entries. Must hold lock.
+static void rewrite_cache(struct loudness_scan *p)
+{
+    char *tmp_file = talloc_asprintf(NULL, "%s.tmp", p->cache_file);
+    FILE *f = fopen(tmp_file, "wb");
+    if (!f) {
+        MP_ERR(p, "Could not write to %s\n", tmp_file);
+        goto done;
+    }
+    fputs(CACHE_HEADER, f);
+    for (int n = 0; n < p->num_entries; n++)
+        print_entry(f, p->entries[n]);
+    bool ok = !ferror(f);
+    ok &= fclose(f) == 0;
+    if (!ok || rename(tmp_file, p->cache_file) != 0) {
+        MP_ERR(p, "Could not write to %s\n", p->cache_file);
+        unlink(tmp_file);
+    }
+done:
+    talloc_free(tmp_file);
+}
+
+// Load the cache file. If it contains duplicate, overridden or invalid lines,
+// it is rewritten with the remaining entries, so that it doesn't grow forever.
+static void load_cache(struct loudness_scan *p)
+{
+    void *tmp = talloc_new(NULL);
+    if (!mp_path_exists(p->cache_file))
+        goto done;
+    bstr data = stream_read_file(p->cache_file, tmp, p->global, 1000000000);
+    if (!bstr_eatstart0(&data, CACHE_HEADER)) {
+        MP_WARN(p, "Ignoring invalid cache file %s\n", p->cache_file);
+        goto done;
+    }
+    int num_lines = 0;
+    mp_mutex_lock(&p->lock);
+    while (data.len) {
+        bstr line = bstr_strip_linebreaks(bstr_getline(data, &data));
+        struct entry *e = parse_entry(tmp, line);
+        if (e) {
+            add_entry(p, e);
+        } else if (line.len) {
+            MP_WARN(p, "Invalid line in cache file: %.*s\n", BSTR_P(line));
+        }
+        num_lines += line.len > 0;
+    }
+    if (num_lines > p->num_entries) {
+        MP_VERBOSE(p, "Compacting cache file (%d lines, %d entries).\n",
+                   num_lines, p->num_entries);
+        rewrite_cache(p);
+    }
+    mp_mutex_unlock(&p->lock);
+done:
+    talloc_free(tmp);
+}
+
+static void write_entry(struct loudness_scan *p, struct entry *e)
+{
+    mp_mk_user_dir(p->global, "cache", "");
+    bool new_file = !mp_path_exists(p->cache_file);
+    FILE *f = fopen(p->cache_file, "ab");
+    if (!f) {
+        MP_ERR(p, "Could not write to %s\n", p->cache_file);
+        return;
+    }
+    if (new_file)
+        fputs(CACHE_HEADER, f);
+    print_entry(f, e);
+    fclose(f);
+}
+
+static void wakeup_graph(void *ctx)
+{
+    struct loudness_scan *p = ctx;
+    mp_mutex_lock(&p->lock);
+    p->graph_wakeup = true;
+    mp_cond_signal(&p->wakeup);
+    mp_mutex_unlock(&p->lock);
+}
+
+// Decode the first audio stream of the file and measure it. Returns NULL if
+// the file has ReplayGain tags, or on errors.
+static struct entry *scan_file(struct loudness_scan *p, struct job *job)
+{
+    void *tmp = talloc_new(NULL);
+    struct entry *res = NULL;
+    struct mp_filter *root = NULL;
+
+    struct demuxer_params params = {
+        .stream_flags = job->stream_flags,
+    };
+    struct demuxer *demuxer = demux_open_url(job->path, &params, p->cancel,
+                                             p->global);
+    if (!demuxer)
+        goto done;
+    demux_update(demuxer, MP_NOPTS_VALUE);
+
+    struct sh_stream *sh = NULL;
+    for (int n = 0; n < demux_get_num_stream(demuxer); n++) {
+        struct sh_stream *s = demux_get_stream(demuxer, n);
+        if (s->type == STREAM_AUDIO && (!sh || (s->default_track && !sh->default_track)))
+            sh = s;
+    }
+    if (!sh)
+        goto done;
+    if (sh->codec->replaygain_data) {
+        MP_VERBOSE(p, "%s has ReplayGain tags.\n", job->path);
+        goto done;
+    }
+    demuxer_select_track(demuxer, sh, MP_NOPTS_VALUE, true);
+
+    root = mp_filter_create_root(p->global);
+    mp_filter_graph_set_wakeup_cb(root, wakeup_graph, p);
+    struct mp_decoder_wrapper *dec = mp_decoder_wrapper_create(root, sh);
+    if (!dec)
+        goto done;
+    struct mp_autoconvert *conv = mp_autoconvert_create(root);
+    if (!conv)
+        goto done;
+    mp_autoconvert_add_afmt(conv, AF_FORMAT_FLOATP);
+    mp_pin_connect(conv->f->pins[0], dec->f->pins[0]);
+    struct mp_pin *out = conv->f->pins[1];
+    mp_pin_set_manual_connection(out, true);
+
+    int64_t start = mp_time_ns();
+    double duration = 0;
+    struct mp_ebur128 *meter = NULL;
+    int rate = 0;
+    struct mp_chmap chmap = {0};
+
+    while (!mp_cancel_test(p->cancel)) {
+        struct mp_frame frame = mp_pin_out_read(out);
+        if (frame.type == MP_FRAME_EOF) {
+            if (meter) {
+                res = talloc_zero(NULL, struct entry);
+                res->peak = mp_ebur128_get_peak(meter);
+                memcpy(res->hist, mp_ebur128_get_histogram(meter), sizeof(res->hist));
+            }
+            break;
+        } else if (frame.type == MP_FRAME_AUDIO) {
+            struct mp_aframe *aframe = frame.data;
+            struct mp_chmap fchmap;
+            mp_aframe_get_chmap(aframe, &fchmap);
+            if (!meter) {
+                rate = mp_aframe_get_rate(aframe);
+                chmap = fchmap;
+                meter = mp_ebur128_create(tmp, rate, &chmap);
+            } else if (rate != mp_aframe_get_rate(aframe) ||
+                       !mp_chmap_equals(&chmap, &fchmap))
+            {
+                MP_WARN(p, "Audio format changes in %s, not scanning.\n",
+                        job->path);
+                mp_frame_unref(&frame);
+                break;
+            }
+            int samples = mp_aframe_get_size(aframe);
+            mp_ebur128_add_planar(meter, (float **)mp_aframe_get_data_ro(aframe),
+                                  samples);
+            duration += samples / (double)rate;
+            mp_frame_unref(&frame);
+        } else if (frame.type) {
+            mp_frame_unref(&frame);
+        } else if (mp_filter_has_failed(dec->f)) {
+            break;
+        } else if (!mp_filter_graph_run(root)) {
+            mp_mutex_lock(&p->lock);
+            if (!p->graph_wakeup && !p->terminate)
+                mp_cond_timedwait(&p->wakeup, &p->lock, MP_TIME_MS_TO_NS(50));
+            p->graph_wakeup = false;
+            mp_mutex_unlock(&p->lock);
+        }
+    }
+
+    if (res) {
+        res->key = talloc_strdup(res, job->key);
+        res->size = job->size;
+        res->mtime = job->mtime;
+        char *album = mp_tags_get_str(demuxer->metadata, "album");
+        if (album && album[0]) {
+            bstr dir = mp_dirname(job->path);
+            char *id = talloc_asprintf(tmp, "%.*s\n%s", BSTR_P(dir), album);
+            res->album = bstrto0(res, mp_hash_to_bstr(tmp, id, strlen(id), "MD5"));
+        }
+        double secs = MP_TIME_NS_TO_S(mp_time_ns() - start);
+        MP_VERBOSE(p, "Scanned %s: %.1fs of audio in %.1fs.\n", job->path,
+                   duration, secs);
+    }
+
+done:
+    talloc_free(root);
+    demux_free(demuxer);
+    talloc_free(tmp);
+    return res;
+}
+
+static MP_THREAD_VOID scan_thread(void *ctx)
+{
+    struct loudness_scan *p = ctx;
+    mp_thread_set_name("loudness");
+    mp_thread_set_background();
+
+    // Jobs queued before this finished are not checked against the cache yet,
+    // which is done below when taking them from the queue.
+    load_cache(p);
+    // Let the core apply cached results for the current file.
+    atomic_fetch_add(&p->results, 1);
+    mp_wakeup_core(p->mpctx);
+
+    mp_mutex_lock(&p->lock);
+    while (!p->terminate) {
+        if (!p->num_queue) {
+            mp_cond_wait(&p->wakeup, &p->lock);
+            continue;
+        }
+        struct job *job = p->queue[0];
+        MP_TARRAY_REMOVE_AT(p->queue, p->num_queue, 0);
+        if (find_entry(p, job)) {
+            talloc_free(job);
+            continue;
+        }
+        mp_mutex_unlock(&p->lock);
+
+        struct entry *e = scan_file(p, job);
+        if (e)
+            write_entry(p, e);
+
+        mp_mutex_lock(&p->lock);
+        if (e) {
+            add_entry(p, e);
+            atomic_fetch_add(&p->results, 1);
+            mp_wakeup_core(p->mpctx);
+        } else if (!mp_cancel_test(p->cancel)) {
+            MP_TARRAY_APPEND(p, p->skipped, p->num_skipped,
+                             talloc_steal(p, job->key));
+        }
+        talloc_free(job);
+    }
+    mp_mutex_unlock(&p->lock);
+
+    MP_THREAD_RETURN();
+}
+
+static struct loudness_scan *get_scanner(struct MPContext *mpctx)
+{
+    if (mpctx->loudness_scan)
+        return mpctx->loudness_scan;
+
+    struct loudness_scan *p = talloc_zero(NULL, struct loudness_scan);
+    p->mpctx = mpctx;
+    p->global = mpctx->global;
+    p->log = mp_log_new(p, mpctx->log, "loudness");
+    p->cancel = mp_cancel_new(p);
+    p->cache_file = mp_find_user_file(p, mpctx->global, "cache", CACHE_FILE);
+    mp_mutex_init(&p->lock);
+    mp_cond_init(&p->wakeup);
+    if (!p->cache_file || mp_thread_create(&p->thread, scan_thread, p)) {
+        mp_cond_destroy(&p->wakeup);
+        mp_mutex_destroy(&p->lock);
+        talloc_free(p);
+        return NULL;
+    }
+    mpctx->loudness_scan = p;
+    return p;
+}
+
+// Must hold lock.
+static void queue_file(struct loudness_scan *p, struct playlist_entry *e,
+                       bool first)
+{
+    struct job *job = talloc_zero(NULL, struct job);
+    if (!get_identity(job, e->filename, job) || is_known(p, job)) {
+        talloc_free(job);
+        return;
+    }
+    // The entry's flags limit what it may open, e.g. for remote playlists.
+    job->stream_flags = e->stream_flags;
+    MP_DBG(p, "Queuing %s\n", job->path);
+    MP_TARRAY_INSERT_AT(p, p->queue, p->num_queue, first ? 0 : p->num_queue, job);
+}
+
+// Queue the current file (unless its audio track has ReplayGain tags) and the
+// next few playlist entries for scanning.
+void loudness_scan_update(struct MPContext *mpctx)
+{
+    struct MPOpts *opts = mpctx->opts;
+    if (!opts->rgain_mode || !opts->rgain_scan || !mpctx->playing)
+        return;
+
+    struct loudness_scan *p = get_scanner(mpctx);
+    if (!p)
+        return;
+
+    mp_mutex_lock(&p->lock);
+    for (int n = 0; n < p->num_queue; n++)
+        talloc_free(p->queue[n]);
+    p->num_queue = 0;
+
+    struct track *track = mpctx->current_track[0][STREAM_AUDIO];
+    if (track && track->stream && !track->stream->codec->replaygain_data &&
+        !track->is_external)
+        queue_file(p, mpctx->playing, true);
+
+    struct playlist_entry *e = mpctx->playing;
+    for (int n = 0; n < SCAN_AHEAD; n++) {
+        e = playlist_entry_get_rel(e, 1);
+        if (!e)
+            break;
+        queue_file(p, e, false);
+    }
+    mp_cond_signal(&p->wakeup);
+    mp_mutex_unlock(&p->lock);
+}
+
+// Return the scan results for the currently playing file.
+bool loudness_scan_get(struct MPContext *mpctx, struct replaygain_data *rg)
+{
+    struct loudness_scan *p = mpctx->loudness_scan;
+    if (!p || !mpctx->opts->rgain_scan || !mpctx->playing)
+        return false;
+
+    void *tmp = talloc_new(NULL);
+    bool ok = false;
+    struct job id;
+    if (!get_identity(tmp, mpctx->playing->filename, &id))
+        goto done;
+
+    mp_mutex_lock(&p->lock);
+    struct entry *e = find_entry(p, &id);
+    if (e) {
+        const uint32_t **hists = NULL;
+        int num_hists = 0;
+        double album_peak = e->peak;
+        for (int n = 0; n < p->num_entries; n++) {
+            struct entry *other = p->entries[n];
+            if (other == e || (e->album && other->album &&
+                               strcmp(e->album, other->album) == 0))
+            {
+                MP_TARRAY_APPEND(tmp, hists, num_hists, other->hist);
+                album_peak = MPMAX(album_peak, other->peak);
+            }
+        }
+        double track = mp_ebur128_loudness((const uint32_t *[]){e->hist}, 1);
+        double album = mp_ebur128_loudness(hists, num_hists);
+        if (isfinite(track) && isfinite(album)) {
+            *rg = (struct replaygain_data){
+                .track_gain = RG_REFERENCE_LUFS - track,
+                .track_peak = MPMAX(e->peak, 1e-6),
+                .album_gain = RG_REFERENCE_LUFS - album,
+                .album_peak = MPMAX(album_peak, 1e-6),
+            };
+            ok = true;
+        }
+    }
+    mp_mutex_unlock(&p->lock);
+
+done:
+    talloc_free(tmp);
+    return ok;
+}
+
+// Apply new scan results to the current file.
+void handle_loudness_scan(struct MPContext *mpctx)
+{
+    struct loudness_scan *p = mpctx->loudness_scan;
+    if (!p)
+        return;
+    unsigned results = atomic_load(&p->results);
+    if (results != p->seen_results) {
+        p->seen_results = results;
+        audio_update_volume(mpctx);
+    }
+}
+
+void loudness_scan_destroy(struct MPContext *mpctx)
+{
+    struct loudness_scan *p = mpctx->loudness_scan;
+    if (!p)
+        return;
+    mp_mutex_lock(&p->lock);
+    p->terminate = true;
+    mp_cond_signal(&p->wakeup);
+    mp_mutex_unlock(&p->lock);
+    mp_cancel_trigger(p->cancel);
+    mp_thread_join(p->thread);
+    for (int n = 0; n < p->num_queue; n++)
+        talloc_free(p->queue[n]);
+    mp_cond_destroy(&p->wakeup);
+    mp_mutex_destroy(&p->lock);
+    talloc_free(p);
+    mpctx->loudness_scan = NULL;
+}
@@ -111,6 +111,9 @@ struct script_ctx {
     lua_Alloc lua_allocf;
     void *lua_alloc_ud;
     struct stats_ctx *stats;
+    bool hosted;        // running on the shared script host
+    bool load_failed;
+    double next_wait;   // result of run_event_loop_step()
 };
 
 #if LUA_VERSION_NUM <= 501
@@ -322,6 +325,28 @@ static void push_module_table(lua_State *L, const char *module)
     lua_remove(L, -2); // module
 }
 
+static int run_event_loop(lua_State *L)
+{
+    lua_getglobal(L, "mp_event_loop"); // fn
+    if (lua_isnil(L, -1))
+        luaL_error(L, "no event loop function\n");
+    lua_call(L, 0, 0); // -
+
+    return 0;
+}
+
+static int run_event_loop_step(lua_State *L)
+{
+    struct script_ctx *ctx = get_ctx(L);
+
+    lua_getglobal(L, "mp_event_loop_step"); // fn
+    lua_call(L, 0, 1); // wait
+    ctx->next_wait = lua_isnumber(L, -1) ? lua_tonumber(L, -1) : -1;
+    lua_pop(L, 1); // -
+
+    return 0;
+}
+
 static int load_scripts(lua_State *L)
 {
     struct script_ctx *ctx = get_ctx(L);
@@ -329,18 +354,37 @@ static int load_scripts(lua_State *L)
 
     require(L, "mp.defaults");
 
+    // Remember the default event loop to detect scripts replacing it.
+    lua_getglobal(L, "mp_event_loop"); // fn
+    lua_setfield(L, LUA_REGISTRYINDEX, "default_event_loop"); // -
+
     if (fname[0] == '@') {
         require(L, fname);
     } else {
         load_file(L, fname);
     }
 
-    lua_getglobal(L, "mp_event_loop"); // fn
-    if (lua_isnil(L, -1))
-        luaL_error(L, "no event loop function\n");
-    lua_call(L, 0, 0); // -
+    // The script host calls run_event_loop_step() instead.
+    if (ctx->hosted)
+        return 0;
 
-    return 0;
+    return run_event_loop(L);
+}
+
+// Run fn under an error handler that can do backtraces. Must be called from
+// within mp_cpcall(). Returns false if fn raised an error.
+static bool run_protected(struct script_ctx *ctx, lua_CFunction fn)
+{
+    lua_State *L = ctx->state;
+    lua_pushcfunction(L, error_handler); // errf
+    lua_pushcfunction(L, fn); // errf fn
+    bool ok = !lua_pcall(L, 0, 0, -2); // errf [error]
+    if (!ok) {
+        const char *e = lua_tostring(L, -1);
+        MP_FATAL(ctx, "Lua error: %s\n", e ? e : "(unknown)");
+    }
+    lua_settop(L, 0); // -
+    return ok;
 }
 
 static void fuck_lua(lua_State *L, const char *search_path, const char *extra)
@@ -437,21 +481,39 @@ static int run_lua(lua_State *L)
     fuck_lua(L, "cpath", NULL);
     mp_assert(lua_gettop(L) == 0);
 
-    // run this under an error handler that can do backtraces
-    lua_pushcfunction(L, error_handler); // errf
-    lua_pushcfunction(L, load_scripts); // errf fn
-    if (lua_pcall(L, 0, 0, -2)) { // errf [error]
-        const char *e = lua_tostring(L, -1);
-        MP_FATAL(ctx, "Lua error: %s\n", e ? e : "(unknown)");
-    }
+    ctx->load_failed = !run_protected(ctx, load_scripts);
 
     return 0;
 }
 
-static int load_lua(struct mp_script_args *args)
+// Report an error returned by mp_cpcall().
+static void report_cpcall_error(struct script_ctx *ctx)
+{
+    lua_State *L = ctx->state;
+    const char *err = "unknown error";
+    if (lua_type(L, -1) == LUA_TSTRING) // avoid allocation
+        err = lua_tostring(L, -1);
+    MP_FATAL(ctx, "Lua error: %s\n", err);
+    lua_pop(L, 1);
+}
+
+static void destroy_lua(void *p)
 {
-    int r = -1;
+    struct script_ctx *ctx = p;
+    if (!ctx)
+        return;
+    if (ctx->lua_allocf)
+        lua_setallocf(ctx->state, ctx->lua_allocf, ctx->lua_alloc_ud);
+    if (ctx->state)
+        lua_close(ctx->state);
+    talloc_free(ctx);
+}
 
+// Create the Lua state and run the script. If hosted is set, this returns
+// after loading the script, and the event loop is driven by step_lua().
+// Returns NULL on failure.
+static struct script_ctx *create_lua(struct mp_script_args *args, bool hosted)
+{
     struct script_ctx *ctx = talloc_ptrtype(NULL, ctx);
     *ctx = (struct script_ctx) {
         .mpctx = args->mpctx,
@@ -462,9 +524,12 @@ static int load_lua(struct mp_script_args *args)
         .path = args->path,
         .stats = stats_ctx_create(ctx, args->mpctx->global,
                     mp_tprintf(80, "script/%s", mpv_client_name(args->client))),
+        .hosted = hosted,
     };
 
-    stats_register_thread_cputime(ctx->stats, "cpu");
+    // Hosted scripts share the thread with other scripts.
+    if (!hosted)
+        stats_register_thread_cputime(ctx->stats, "cpu");
 
     if (LUA_VERSION_NUM != 501 && LUA_VERSION_NUM != 502) {
         MP_FATAL(ctx, "Only Lua 5.1 and 5.2 are supported.\n");
@@ -482,22 +547,79 @@ static int load_lua(struct mp_script_args *args)
     lua_setallocf(L, mp_lua_alloc, ctx);
 
     if (mp_cpcall(L, run_lua, ctx)) {
-        const char *err = "unknown error";
-        if (lua_type(L, -1) == LUA_TSTRING) // avoid allocation
-            err = lua_tostring(L, -1);
-        MP_FATAL(ctx, "Lua error: %s\n", err);
+        report_cpcall_error(ctx);
         goto error_out;
     }
 
-    r = 0;
+    return ctx;
 
 error_out:
-    if (ctx->lua_allocf)
-        lua_setallocf(L, ctx->lua_allocf, ctx->lua_alloc_ud);
-    if (ctx->state)
-        lua_close(ctx->state);
-    talloc_free(ctx);
-    return r;
+    destroy_lua(ctx);
+    return NULL;
+}
+
+static int load_lua(struct mp_script_args *args)
+{
+    struct script_ctx *ctx = create_lua(args, false);
+    destroy_lua(ctx);
+    return ctx ? 0 : -1;
+}
+
+static void *start_lua(struct mp_script_args *args, bool *need_thread)
+{
+    struct script_ctx *ctx = create_lua(args, true);
+    if (ctx && !ctx->load_failed) {
+        // Scripts with their own event loop block in it.
+        lua_State *L = ctx->state;
+        lua_getglobal(L, "mp_event_loop"); // fn
+        lua_getfield(L, LUA_REGISTRYINDEX, "default_event_loop"); // fn fn
+        *need_thread = !lua_rawequal(L, -1, -2);
+        lua_pop(L, 2); // -
+    }
+    return ctx;
+}
+
+static int step_lua_cb(lua_State *L)
+{
+    struct script_ctx *ctx = lua_touserdata(L, -1);
+    lua_pop(L, 1); // -
+
+    if (!run_protected(ctx, run_event_loop_step))
+        ctx->next_wait = -1;
+
+    return 0;
+}
+
+static double step_lua(void *p)
+{
+    struct script_ctx *ctx = p;
+    if (ctx->load_failed)
+        return -1;
+    if (mp_cpcall(ctx->state, step_lua_cb, ctx)) {
+        report_cpcall_error(ctx);
+        return -1;
+    }
+    return ctx->next_wait;
+}
+
+static int run_lua_cb(lua_State *L)
+{
+    struct script_ctx *ctx = lua_touserdata(L, -1);
+    lua_pop(L, 1); // -
+
+    run_protected(ctx, run_event_loop);
+
+    return 0;
+}
+
+static void run_lua_loop(void *p)
+{
+    struct script_ctx *ctx = p;
+    if (ctx->load_failed)
+        return;
+    stats_register_thread_cputime(ctx->stats, "cpu");
+    if (mp_cpcall(ctx->state, run_lua_cb, ctx))
+        report_cpcall_error(ctx);
 }
 
 static int check_loglevel(lua_State *L, int arg)
@@ -998,6 +1120,37 @@ static int script_command_native(lua_State *L, void *tmp)
     return 2;
 }
 
+static int script_command_batch(lua_State *L, void *tmp)
+{
+    struct script_ctx *ctx = get_ctx(L);
+    struct mpv_node list;
+    makenode(tmp, &list, L, 1);
+    if (list.format != MPV_FORMAT_NODE_ARRAY)
+        luaL_error(L, "array of commands expected");
+    int num = list.u.list->num;
+    mpv_batch_item *items = talloc_zero_array(tmp, mpv_batch_item, num);
+    for (int n = 0; n < num; n++) {
+        if (mp_batch_item_from_node(&items[n], &list.u.list->values[n]) < 0)
+            luaL_error(L, "invalid batch entry %d", n + 1);
+    }
+    mpv_command_batch(ctx->client, items, num);
+    for (int n = 0; n < num; n++)
+        steal_node_allocations(tmp, &items[n].result);
+    lua_createtable(L, num, 0); // res
+    for (int n = 0; n < num; n++) {
+        lua_createtable(L, 0, 1); // res entry
+        if (items[n].error >= 0) {
+            pushnode(L, &items[n].result); // res entry data
+            lua_setfield(L, -2, "data"); // res entry
+        } else {
+            lua_pushstring(L, mpv_error_string(items[n].error)); // res entry err
+            lua_setfield(L, -2, "error"); // res entry
+        }
+        lua_rawseti(L, -2, n + 1); // res
+    }
+    return 1;
+}
+
 static int script_raw_command_native_async(lua_State *L, void *tmp)
 {
     struct script_ctx *ctx = get_ctx(L);
@@ -1243,6 +1396,7 @@ static const struct fn_entry main_fns[] = {
     FN_ENTRY(command),
     FN_ENTRY(commandv),
     AF_ENTRY(command_native),
+    AF_ENTRY(command_batch),
     AF_ENTRY(raw_command_native_async),
     FN_ENTRY(raw_abort_async_command),
     AF_ENTRY(get_property),
@@ -1364,4 +1518,8 @@ const struct mp_scripting mp_scripting_lua = {
     .name = "lua",
     .file_ext = "lua",
     .load = load_lua,
+    .host_start = start_lua,
+    .host_step = step_lua,
+    .host_run = run_lua_loop,
+    .host_destroy = destroy_lua,
 };
@@ -506,6 +506,16 @@ _G.mp_event_loop = function()
     mp.dispatch_events(true)
 end
 
+-- used instead of mp_event_loop() if the script runs on the shared script
+-- host: handle pending events and timers, and return the time until the next
+-- timer is due, or nil if the script should exit
+_G.mp_event_loop_step = function()
+    mp.dispatch_events(false)
+    if mp.keep_running then
+        return math.max(mp.get_next_timeout() or 1e20, 0)
+    end
+end
+
 local function call_event_handlers(e)
     local handlers = event_handlers[e.event]
     if handlers then
@@ -2558,20 +2558,29 @@ local function osc_init()
             if element.state.lastseek == nil or
                 element.state.lastseek ~= seekto then
                     local flags = "absolute-percent"
-                    if not user_opts.seekbarkeyframes then
+                    if user_opts.seekbarkeyframes then
+                        flags = flags .. "+scrub"
+                    else
                         flags = flags .. "+exact"
                     end
                     mp.commandv("seek", seekto, flags)
                     element.state.lastseek = seekto
+                    element.state.dragged = true
             end
 
         end
     ne.eventresponder["mbtn_left_down"] = function (element)
         element.state.mbtn_left = true
+        element.state.dragged = false
         mp.commandv("seek", get_slider_value(element), "absolute-percent+exact")
     end
     ne.eventresponder["mbtn_left_up"] = function (element)
         element.state.mbtn_left = false
+        -- settle on the exact position after keyframe previews
+        if element.state.dragged and user_opts.seekbarkeyframes then
+            mp.commandv("seek", element.state.lastseek, "absolute-percent+exact")
+        end
+        element.state.dragged = false
     end
     ne.eventresponder["mbtn_right_up"] = function (element)
         local chapter
@@ -49,6 +49,7 @@
 #include "common/msg.h"
 #include "common/msg_control.h"
 #include "common/stats.h"
+#include "common/trace.h"
 #include "common/global.h"
 #include "filters/f_decoder_wrapper.h"
 #include "options/parse_configfile.h"
@@ -64,6 +65,7 @@
 #include "misc/thread_tools.h"
 #include "sub/osd.h"
 #include "video/out/vo.h"
+#include "video/frame_cache.h"
 
 #include "core.h"
 #include "client.h"
@@ -178,13 +180,20 @@ void mp_print_version(struct mp_log *log, int always)
 void mp_destroy(struct MPContext *mpctx)
 {
     mp_shutdown_clients(mpctx);
+    mp_script_host_destroy(mpctx);
 
     mp_uninit_ipc(mpctx->ipc_ctx);
     mpctx->ipc_ctx = NULL;
 
+    TA_FREEP(&mpctx->telemetry);
+
     uninit_audio_out(mpctx);
     uninit_video_out(mpctx);
 
+    loudness_scan_destroy(mpctx);
+    thumbnail_destroy(mpctx);
+    frame_index_destroy(mpctx);
+
     // If it's still set here, it's an error.
     encode_lavc_free(mpctx->encode_lavc_ctx);
     mpctx->encode_lavc_ctx = NULL;
@@ -283,14 +292,20 @@ struct MPContext *mp_create(void)
         .thread_pool = mp_thread_pool_create(mpctx, 0, 1, 30),
         .stop_play = PT_NEXT_ENTRY,
         .play_dir = 1,
+        .frame_cache_pos = -1,
     };
 
+    mpctx->frame_cache = mp_frame_cache_new(mpctx);
+
+    mpctx->playlist->track_changes = true;
+
     mp_mutex_init(&mpctx->abort_lock);
 
     mpctx->global = talloc_zero(mpctx, struct mpv_global);
 
     demux_packet_pool_init(mpctx->global);
     stats_global_init(mpctx->global);
+    trace_global_init(mpctx->global);
 #if HAVE_LIBCURL
     mp_curl_global_init(mpctx->global);
 #endif
@@ -347,8 +362,10 @@ int mp_initialize(struct MPContext *mpctx, char **options)
 
     // Preparse the command line, so we can init the terminal early.
     if (options) {
+        trace_begin(mpctx->global, "preparse-command-line");
         m_config_preparse_command_line(mpctx->mconfig, mpctx->global,
                                        &opts->verbose, options);
+        trace_end(mpctx->global, "preparse-command-line");
     }
 
     mp_init_paths(mpctx->global, opts);
@@ -364,11 +381,15 @@ int mp_initialize(struct MPContext *mpctx, char **options)
 
     mp_print_version(mpctx->log, false);
 
+    trace_begin(mpctx->global, "parse-config-files");
     mp_parse_cfgfiles(mpctx);
+    trace_end(mpctx->global, "parse-config-files");
 
     if (options) {
+        trace_begin(mpctx->global, "parse-command-line");
         int r = m_config_parse_mp_command_line(mpctx->mconfig, mpctx->playlist,
                                                mpctx->global, options);
+        trace_end(mpctx->global, "parse-command-line");
         if (r < 0)
             return r == M_OPT_EXIT ? 1 : -1;
     }
@@ -392,8 +413,10 @@ int mp_initialize(struct MPContext *mpctx, char **options)
     mpctx->mconfig->option_change_callback_ctx = mpctx;
     m_config_set_update_dispatch_queue(mpctx->mconfig, mpctx->dispatch);
     // Run all update handlers.
+    trace_begin(mpctx->global, "apply-options");
     mp_option_change_callback(mpctx, NULL, UPDATE_OPTS_MASK, false);
     handle_option_callbacks(mpctx);
+    trace_end(mpctx->global, "apply-options");
 
     if (handle_help_options(mpctx))
         return 1; // help
@@ -430,6 +453,8 @@ int mp_initialize(struct MPContext *mpctx, char **options)
 
     mpctx->ipc_ctx = mp_init_ipc(mpctx->clients, mpctx->global);
 
+    reinit_telemetry(mpctx);
+
     if (opts->encode_opts->file && opts->encode_opts->file[0]) {
         mpctx->encode_lavc_ctx = encode_lavc_init(mpctx->global);
         if(!mpctx->encode_lavc_ctx) {
@@ -438,7 +463,9 @@ int mp_initialize(struct MPContext *mpctx, char **options)
         }
     }
 
+    trace_begin(mpctx->global, "load-scripts");
     mp_load_scripts(mpctx);
+    trace_end(mpctx->global, "load-scripts");
 
     if (opts->force_vo == 2 && handle_force_window(mpctx, false) < 0)
         return -1;
@@ -21,6 +21,8 @@
 #include <stdbool.h>
 #include <stddef.h>
 
+#include <mpv/telemetry.h>
+
 #include "client.h"
 #include "command.h"
 #include "core.h"
@@ -33,15 +35,18 @@
 #include "common/msg.h"
 #include "common/playlist.h"
 #include "common/stats.h"
+#include "common/trace.h"
 #include "demux/demux.h"
 #include "demux/packet_pool.h"
 #include "filters/f_decoder_wrapper.h"
 #include "filters/filter_internal.h"
 #include "input/input.h"
 #include "misc/dispatch.h"
+#include "misc/telemetry.h"
 #include "options/m_config_frontend.h"
 #include "options/m_property.h"
 #include "options/options.h"
+#include "options/path.h"
 #include "osdep/terminal.h"
 #include "osdep/timer.h"
 #include "stream/stream.h"
@@ -189,6 +194,12 @@ void set_pause_state(struct MPContext *mpctx, bool user_pause)
             mpctx->time_frame -= get_relative_time(mpctx);
         } else {
             (void)get_relative_time(mpctx); // ignore time that passed during pause
+            // Video was seeked from the frame cache while paused: bring audio
+            // to the same position with a real seek.
+            if (mpctx->frame_cache_av_desync) {
+                queue_seek(mpctx, MPSEEK_ABSOLUTE, get_current_time(mpctx),
+                           MPSEEK_EXACT, 0);
+            }
         }
     }
 
@@ -217,7 +228,9 @@ void add_step_frame(struct MPContext *mpctx, int dir, bool use_seek)
 {
     if (!mpctx->vo_chain)
         return;
-    if (dir > 0 && !use_seek) {
+    // Stepping by unpausing would resync audio with a real seek; seek in the
+    // frame cache instead.
+    if (dir > 0 && !use_seek && !mpctx->frame_cache_av_desync) {
         mpctx->step_frames += dir;
         set_pause_state(mpctx, false);
     } else {
@@ -245,6 +258,7 @@ void reset_playback_state(struct MPContext *mpctx)
     reset_video_state(mpctx);
     reset_audio_state(mpctx);
     reset_subtitle_state(mpctx);
+    reset_frame_cache(mpctx);
 
     for (int n = 0; n < mpctx->num_tracks; n++) {
         struct track *t = mpctx->tracks[n];
@@ -262,6 +276,7 @@ void reset_playback_state(struct MPContext *mpctx)
     mpctx->hrseek_active = false;
     mpctx->hrseek_lastframe = false;
     mpctx->hrseek_backstep = false;
+    mpctx->frame_cache_av_desync = false;
     mpctx->current_seek = (struct seek_params){0};
     mpctx->playback_pts = MP_NOPTS_VALUE;
     mpctx->step_frames = 0;
@@ -280,6 +295,11 @@ void reset_playback_state(struct MPContext *mpctx)
 static double calculate_framestep_pts(MPContext *mpctx, double current_time,
                                       int step_frames)
 {
+    // Exact with a frame index. (A single back step is done by hrseek_backstep.)
+    int frame = frame_index_get_frame(mpctx, current_time);
+    if (frame >= 0 && step_frames != -1)
+        return frame_index_get_pts(mpctx, frame + step_frames);
+
     // Crude guess at the pts. Use current_time if step_frames is -1.
     int previous_frame = mpctx->num_past_frames - 1;
     int offset = step_frames == -1 ? 0 : step_frames;
@@ -287,6 +307,156 @@ static double calculate_framestep_pts(MPContext *mpctx, double current_time,
     return current_time + pts;
 }
 
+// Perform an hr-seek by replaying frames from the decoded frame cache. This
+// leaves demuxers, decoders and audio alone, so it's done only if audio is
+// paused or not present. Returns false if the seek must be done normally.
+static bool seek_from_frame_cache(struct MPContext *mpctx,
+                                  struct seek_params seek, double seek_pts)
+{
+    struct MPOpts *opts = mpctx->opts;
+
+    if (!opts->video_frame_cache || !mpctx->vo_chain || mpctx->play_dir != 1 ||
+        opts->play_dir != 1 || (mpctx->ao_chain && !mpctx->paused))
+        return false;
+
+    int step = seek.type == MPSEEK_FRAMESTEP ? (int)seek.amount : 0;
+    if (!seek_frame_cache(mpctx, seek_pts, step)) {
+        mpctx->frame_cache_misses++;
+        return false;
+    }
+    mpctx->frame_cache_hits++;
+
+    MP_VERBOSE(mpctx, "hr-seek from frame cache, skipping to %f\n",
+               mpctx->hrseek_pts);
+
+    // The rest mirrors what a normal seek does.
+    mpctx->hrseek_active = true;
+    mpctx->hrseek_lastframe = false;
+    mpctx->hrseek_backstep = false;
+    mpctx->playback_pts = MP_NOPTS_VALUE;
+    mpctx->last_seek_pts = mpctx->hrseek_pts;
+    mpctx->step_frames = 0;
+    mpctx->restart_complete = false;
+    if (mpctx->ao_chain)
+        mpctx->frame_cache_av_desync = true;
+
+    if (mpctx->stop_play == AT_END_OF_FILE)
+        mpctx->stop_play = KEEP_PLAYING;
+
+    mpctx->start_timestamp = mp_time_sec();
+    mp_wakeup_core(mpctx);
+
+    mp_notify(mpctx, MPV_EVENT_SEEK, NULL);
+    mp_notify(mpctx, MPV_EVENT_TICK, NULL);
+
+    update_ab_loop_clip(mpctx);
+
+    mpctx->current_seek = seek;
+    redraw_subs(mpctx);
+    return true;
+}
+
+// Scrubbing: while the user drags a seek bar, seeks with MPSEEK_FLAG_SCRUB
+// arrive faster than they can be completed, and each one costs a demuxer seek
+// (a round trip on network streams). They are done as keyframe seeks, and:
+//  - the target is moved ahead by the drag velocity times the measured
+//    seek-to-frame latency, so that the frame appears where the user is when
+//    it's shown, rather than where the user was when the seek started
+//  - seeks are skipped if they would show the displayed keyframe again
+//  - once no scrub seek arrived for a while, an exact seek to the last
+//    requested target is done (see handle_scrub())
+
+// Settle with an exact seek after this time without scrub seeks.
+#define SCRUB_SETTLE_TIME 0.3
+// Don't derive a velocity from scrub seeks further apart than this.
+#define SCRUB_MAX_GAP 0.5
+// Don't predict further ahead than this (in seconds of wall time).
+#define SCRUB_MAX_LEAD 1.0
+
+// Update the scrub state for a scrub seek to *pts, and replace *pts with the
+// predicted target. Returns false if the seek can be skipped.
+static bool scrub_seek(struct MPContext *mpctx, struct seek_params *seek,
+                       double *pts)
+{
+    struct scrub_state *s = &mpctx->scrub;
+    double now = mp_time_sec();
+
+    double target = *pts;
+    if (!s->active) {
+        s->active = true;
+        s->velocity = 0;
+        s->seek_time = -1;
+        s->keyframe_start = s->keyframe_end = MP_NOPTS_VALUE;
+    } else {
+        // Relative scrub seeks continue from the requested position, not from
+        // the predicted one that is displayed.
+        if (seek->type == MPSEEK_RELATIVE)
+            target = s->target + seek->amount;
+        double dt = now - s->time;
+        double v = dt > 0 && dt < SCRUB_MAX_GAP ? (target - s->target) / dt : 0;
+        s->velocity = s->velocity * 0.5 + v * 0.5;
+    }
+    s->target = target;
+    s->time = now;
+
+    double predicted = target + s->velocity * MPMIN(s->latency, SCRUB_MAX_LEAD);
+    double start = get_start_time(mpctx, 1);
+    double len = get_time_length(mpctx);
+    predicted = MPMAX(predicted, start);
+    if (len >= 0)
+        predicted = MPMIN(predicted, start + len);
+
+    // A keyframe seek to a target between the displayed keyframe and the
+    // furthest target that led to it would show that keyframe again. Skip it,
+    // unless playback has moved past the target.
+    double kf = frame_index_get_keyframe(mpctx, predicted);
+    bool same_kf = kf != MP_NOPTS_VALUE ? kf == s->keyframe_start :
+        predicted >= s->keyframe_start && predicted <= s->keyframe_end;
+    if (s->seek_time < 0 && same_kf && mpctx->video_pts != MP_NOPTS_VALUE &&
+        mpctx->video_pts >= s->keyframe_start && mpctx->video_pts <= predicted)
+    {
+        s->skipped++;
+        return false;
+    }
+
+    s->seeks++;
+    s->seek_time = now;
+    s->seek_target = predicted;
+    *pts = predicted;
+    return true;
+}
+
+// Called when the first frame after a seek is displayed.
+static void scrub_frame_shown(struct MPContext *mpctx)
+{
+    struct scrub_state *s = &mpctx->scrub;
+    if (!s->active || s->seek_time < 0)
+        return;
+    double latency = mp_time_sec() - s->seek_time;
+    s->latency = s->latency > 0 ? s->latency * 0.5 + latency * 0.5 : latency;
+    s->keyframe_start = mpctx->video_pts;
+    s->keyframe_end = s->seek_target;
+    s->seek_time = -1;
+}
+
+// Settle with an exact seek once scrubbing stopped.
+static void handle_scrub(struct MPContext *mpctx)
+{
+    struct scrub_state *s = &mpctx->scrub;
+    if (!s->active || mpctx->seek.type)
+        return;
+    double wait = s->time + SCRUB_SETTLE_TIME - mp_time_sec();
+    if (wait > 0) {
+        mp_set_timeout(mpctx, wait);
+        return;
+    }
+    MP_VERBOSE(mpctx, "Scrubbing stopped after %"PRId64" seeks (%"PRId64
+               " skipped, %.0f ms latency), settling at %f.\n", s->seeks,
+               s->skipped, s->latency * 1e3, s->target);
+    queue_seek(mpctx, MPSEEK_ABSOLUTE, s->target, MPSEEK_EXACT, 0);
+    s->active = false;
+}
+
 static void mp_seek(MPContext *mpctx, struct seek_params seek)
 {
     struct MPOpts *opts = mpctx->opts;
@@ -329,6 +499,18 @@ static void mp_seek(MPContext *mpctx, struct seek_params seek)
     default: MP_ASSERT_UNREACHABLE();
     }
 
+    if (seek.flags & MPSEEK_FLAG_SCRUB) {
+        if (seek_pts != MP_NOPTS_VALUE && !mpctx->demuxer->ts_resets_possible) {
+            if (!scrub_seek(mpctx, &seek, &seek_pts))
+                return;
+            seek.type = MPSEEK_ABSOLUTE;
+            demux_flags &= ~SEEK_FORWARD;
+        }
+        seek.exact = MPSEEK_KEYFRAME;
+    } else {
+        mpctx->scrub.active = false;
+    }
+
     double demux_pts = seek_pts;
 
     bool hr_seek = seek.exact != MPSEEK_KEYFRAME && seek_pts != MP_NOPTS_VALUE &&
@@ -336,6 +518,9 @@ static void mp_seek(MPContext *mpctx, struct seek_params seek)
          (opts->hr_seek >= 0 && seek.type == MPSEEK_ABSOLUTE) ||
          (opts->hr_seek == 2 && (!mpctx->vo_chain || mpctx->vo_chain->is_sparse)));
 
+    if (hr_seek && seek_from_frame_cache(mpctx, seek, seek_pts))
+        return;
+
     // Under certain circumstances, prefer SEEK_FACTOR.
     if (seek.type == MPSEEK_FACTOR && !hr_seek &&
         (mpctx->demuxer->ts_resets_possible || seek_pts == MP_NOPTS_VALUE))
@@ -350,12 +535,20 @@ static void mp_seek(MPContext *mpctx, struct seek_params seek)
 
     if (hr_seek) {
         double hr_seek_offset = opts->hr_seek_demuxer_offset;
-        // Always try to compensate for possibly bad demuxers in "special"
-        // situations where we need more robustness from the hr-seek code, even
-        // if the user doesn't use --hr-seek-demuxer-offset.
-        // The value is arbitrary, but should be "good enough" in most situations.
-        if (hr_seek_very_exact)
+        double keyframe = play_dir > 0 ?
+            frame_index_get_keyframe(mpctx, seek_pts) : MP_NOPTS_VALUE;
+        if (keyframe != MP_NOPTS_VALUE) {
+            // The frame index knows the keyframe before the target, so let
+            // the demuxer seek exactly to it.
+            hr_seek_offset = MPMAX(hr_seek_offset, seek_pts - keyframe);
+        } else if (hr_seek_very_exact) {
+            // Always try to compensate for possibly bad demuxers in "special"
+            // situations where we need more robustness from the hr-seek code,
+            // even if the user doesn't use --hr-seek-demuxer-offset.
+            // The value is arbitrary, but should be "good enough" in most
+            // situations.
             hr_seek_offset = MPMAX(hr_seek_offset, 0.5); // arbitrary
+        }
         for (int n = 0; n < mpctx->num_tracks; n++) {
             double offset = 0;
             if (!mpctx->tracks[n]->is_external)
@@ -1055,7 +1248,9 @@ int handle_force_window(struct MPContext *mpctx, bool force)
             .wakeup_cb = mp_wakeup_core_cb,
             .wakeup_ctx = mpctx,
         };
+        trace_begin(mpctx->global, "vo-init");
         mpctx->video_out = init_best_video_out(mpctx->global, &ex);
+        trace_end(mpctx->global, "vo-init");
         if (!mpctx->video_out)
             goto err;
         mpctx->mouse_cursor_visible = true;
@@ -1148,6 +1343,24 @@ static void handle_playback_time(struct MPContext *mpctx)
     }
 }
 
+// Called on every playback restart, but only the first one ends the trace.
+static void finish_startup_trace(struct MPContext *mpctx)
+{
+    trace_instant(mpctx->global, "playback-restart");
+    if (!trace_finish(mpctx->global))
+        return;
+
+    trace_log_summary(mpctx->global, mpctx->log, MSGL_V);
+
+    char *path = mpctx->opts->startup_trace;
+    if (path && path[0]) {
+        path = mp_get_user_path(NULL, mpctx->global, path);
+        if (trace_write_chrome_json(mpctx->global, mpctx->log, path))
+            MP_VERBOSE(mpctx, "Startup trace written to '%s'.\n", path);
+        talloc_free(path);
+    }
+}
+
 // We always make sure audio and video buffers are filled before actually
 // starting playback. This code handles starting them at the same time.
 static void handle_playback_restart(struct MPContext *mpctx)
@@ -1160,8 +1373,11 @@ static void handle_playback_restart(struct MPContext *mpctx)
 
     handle_update_cache(mpctx);
 
+    handle_loudness_scan(mpctx);
+
     if (mpctx->video_status == STATUS_READY) {
         mpctx->video_status = STATUS_PLAYING;
+        scrub_frame_shown(mpctx);
         get_relative_time(mpctx);
         mp_wakeup_core(mpctx);
         MP_DBG(mpctx, "starting video playback\n");
@@ -1187,6 +1403,7 @@ static void handle_playback_restart(struct MPContext *mpctx)
         handle_playback_time(mpctx);
         mp_notify(mpctx, MPV_EVENT_PLAYBACK_RESTART, NULL);
         update_core_idle_state(mpctx);
+        finish_startup_trace(mpctx);
         if (!mpctx->playing_msg_shown) {
             if (opts->playing_msg && opts->playing_msg[0]) {
                 char *msg =
@@ -1257,6 +1474,91 @@ static void handle_clipboard_updates(struct MPContext *mpctx)
         mp_notify_property(mpctx, "clipboard");
 }
 
+void reinit_telemetry(struct MPContext *mpctx)
+{
+    TA_FREEP(&mpctx->telemetry);
+
+    char *path = mpctx->opts->telemetry_shm;
+    if (path && path[0]) {
+        path = mp_get_user_path(NULL, mpctx->global, path);
+        mpctx->telemetry = mp_telemetry_create(mpctx, mpctx->log, path);
+        talloc_free(path);
+    }
+}
+
+static double telemetry_time(double t)
+{
+    return t == MP_NOPTS_VALUE ? NAN : t;
+}
+
+// Publish the statistics for external monitoring (--telemetry-shm).
+static void handle_telemetry(struct MPContext *mpctx)
+{
+    if (!mpctx->telemetry)
+        return;
+
+    struct mpv_telemetry_snapshot snap = {
+        .playlist_pos = playlist_entry_to_index(mpctx->playlist,
+                                                mpctx->playlist->current),
+        .time_pos = NAN,
+        .duration = NAN,
+        .speed = mpctx->opts->playback_speed,
+        .avsync = NAN,
+        .total_avsync_change = NAN,
+        .cache_duration = NAN,
+        .cache_forward_bytes = -1,
+        .cache_speed = -1,
+        .frame_drop_count = -1,
+        .decoder_frame_drop_count = -1,
+        .vo_delayed_frame_count = -1,
+        .mistimed_frame_count = -1,
+    };
+
+    if (!mpctx->playback_initialized)
+        snap.flags |= MPV_TELEMETRY_IDLE;
+    if (mpctx->paused)
+        snap.flags |= MPV_TELEMETRY_PAUSED;
+    if (mpctx->paused_for_cache)
+        snap.flags |= MPV_TELEMETRY_BUFFERING;
+    if (mpctx->playback_initialized && !mpctx->restart_complete)
+        snap.flags |= MPV_TELEMETRY_SEEKING;
+
+    if (mpctx->playback_initialized) {
+        snap.time_pos = telemetry_time(get_current_time(mpctx));
+        snap.duration = telemetry_time(get_time_length(mpctx));
+    }
+
+    if (mpctx->demuxer) {
+        struct demux_reader_state s;
+        demux_get_reader_state(mpctx->demuxer, &s);
+        if (s.ts_info.duration >= 0)
+            snap.cache_duration = s.ts_info.duration;
+        snap.cache_forward_bytes = s.fw_bytes;
+        snap.cache_speed = s.bytes_per_second;
+        if (s.eof_cached)
+            snap.flags |= MPV_TELEMETRY_EOF_CACHED;
+    }
+
+    if (mpctx->ao_chain && mpctx->vo_chain) {
+        snap.avsync = mpctx->last_av_difference;
+        snap.total_avsync_change = telemetry_time(mpctx->total_avsync_change);
+    }
+
+    if (mpctx->vo_chain) {
+        snap.frame_drop_count = vo_get_drop_count(mpctx->video_out);
+        snap.vo_delayed_frame_count = vo_get_delayed_count(mpctx->video_out);
+        if (mpctx->display_sync_active)
+            snap.mistimed_frame_count = mpctx->mistimed_frames_total;
+        struct track *track = mpctx->vo_chain->track;
+        if (track && track->dec) {
+            snap.decoder_frame_drop_count =
+                mp_decoder_wrapper_get_frames_dropped(track->dec);
+        }
+    }
+
+    mp_telemetry_publish(mpctx->telemetry, &snap);
+}
+
 void run_playloop(struct MPContext *mpctx)
 {
     if (encode_lavc_didfail(mpctx->encode_lavc_ctx)) {
@@ -1300,6 +1602,8 @@ void run_playloop(struct MPContext *mpctx)
 
     update_core_idle_state(mpctx);
 
+    handle_scrub(mpctx);
+
     execute_queued_seek(mpctx);
 
     if (mpctx->stop_play)
@@ -1314,6 +1618,8 @@ void run_playloop(struct MPContext *mpctx)
 
     handle_update_cache(mpctx);
 
+    handle_telemetry(mpctx);
+
     mp_process_input(mpctx);
 
     handle_option_callbacks(mpctx);
@@ -1332,6 +1638,7 @@ void mp_idle(struct MPContext *mpctx)
     handle_option_callbacks(mpctx);
     handle_command_updates(mpctx);
     handle_update_cache(mpctx);
+    handle_telemetry(mpctx);
     handle_cursor_autohide(mpctx);
     handle_vo_events(mpctx);
     update_osd_msg(mpctx);
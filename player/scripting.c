@@ -25,6 +25,7 @@
 #include "osdep/io.h"
 #include "osdep/subprocess.h"
 #include "osdep/threads.h"
+#include "osdep/timer.h"
 
 #include "common/common.h"
 #include "common/msg.h"
@@ -102,6 +103,293 @@ static MP_THREAD_VOID script_thread(void *p)
     MP_THREAD_RETURN();
 }
 
+// Shared script host: a small pool of threads which drives the event loops of
+// scripts whose backend supports it, instead of one thread per script. Each
+// script is run by at most one thread at a time. A script which starts a
+// command that blocks (e.g. a synchronous subprocess) keeps the host thread it
+// runs on as its dedicated thread, and a new host thread replaces it. Scripts
+// which block for too long otherwise are moved to a dedicated thread as well.
+
+// Steps taking longer than this move the script to its own thread.
+#define HOST_MAX_STEP_NS MP_TIME_MS_TO_NS(100)
+
+struct hosted_script {
+    struct script_host *host;
+    struct mp_script_args *args;
+    void *state;            // backend state, NULL before host_start()
+    bool running;           // a host thread is working on it
+    bool dedicated;         // the thread running it was handed over to it
+    bool wakeup;            // new events are pending
+    int64_t deadline;       // mp_time_ns() when a timer is due
+};
+
+struct script_host {
+    struct mp_log *log;
+    mp_mutex lock;
+    mp_cond wakeup;
+    bool terminate;
+    struct hosted_script **scripts;
+    int num_scripts;
+    mp_thread *threads;
+    int num_threads;
+};
+
+static void host_wakeup_cb(void *p)
+{
+    struct hosted_script *hs = p;
+    struct script_host *host = hs->host;
+    mp_mutex_lock(&host->lock);
+    hs->wakeup = true;
+    mp_cond_signal(&host->wakeup);
+    mp_mutex_unlock(&host->lock);
+}
+
+// Must be called with host->lock held, and hs->running set.
+static void host_remove(struct script_host *host, struct hosted_script *hs)
+{
+    for (int n = 0; n < host->num_scripts; n++) {
+        if (host->scripts[n] == hs) {
+            MP_TARRAY_REMOVE_AT(host->scripts, host->num_scripts, n);
+            break;
+        }
+    }
+}
+
+static void hosted_script_destroy(struct hosted_script *hs)
+{
+    struct mp_script_args *arg = hs->args;
+    if (hs->state)
+        arg->backend->host_destroy(hs->state);
+    mpv_handle *client = arg->client;
+    talloc_free(hs);
+    mpv_destroy(client);
+}
+
+// Run the script's own event loop on the calling thread until it exits.
+static void run_hosted_script(struct hosted_script *hs)
+{
+    struct mp_script_args *arg = hs->args;
+
+    char *name = talloc_asprintf(NULL, "%s/%s", arg->backend->name,
+                                 mpv_client_name(arg->client));
+    mp_thread_set_name(name);
+    talloc_free(name);
+
+    arg->backend->host_run(hs->state);
+    hosted_script_destroy(hs);
+}
+
+static MP_THREAD_VOID hosted_script_thread(void *p)
+{
+    run_hosted_script(p);
+    MP_THREAD_RETURN();
+}
+
+static MP_THREAD_VOID host_thread(void *p);
+
+// Called on the thread running the script, before it waits for a command that
+// didn't complete immediately. Give the thread to the script, and start a new
+// host thread in its place, so the other scripts don't have to wait.
+static void host_blocking_cb(void *p)
+{
+    struct hosted_script *hs = p;
+    struct script_host *host = hs->host;
+    if (hs->dedicated)
+        return;
+
+    mp_mutex_lock(&host->lock);
+    mp_thread thread;
+    if (!host->terminate && !mp_thread_create(&thread, host_thread, host)) {
+        MP_TARRAY_APPEND(host, host->threads, host->num_threads, thread);
+        hs->dedicated = true;
+    }
+    mp_mutex_unlock(&host->lock);
+
+    if (hs->dedicated)
+        MP_VERBOSE(hs->args, "Script is blocking, moving it to its own thread.\n");
+}
+
+// Run one step of the script. Called without lock. Returns false if the
+// calling thread was handed over to the script and must leave the host.
+static bool host_run_step(struct script_host *host, struct hosted_script *hs)
+{
+    struct mp_script_args *arg = hs->args;
+    const struct mp_scripting *backend = arg->backend;
+
+    int64_t start = mp_time_ns();
+    double wait = -1;
+    bool need_thread = false;
+    if (!hs->state) {
+        hs->state = backend->host_start(arg, &need_thread);
+        if (!hs->state)
+            MP_ERR(arg, "Could not load %s script %s\n", backend->name, arg->filename);
+        wait = 0;
+    } else {
+        wait = backend->host_step(hs->state);
+    }
+    int64_t duration = mp_time_ns() - start;
+    bool dedicated = hs->dedicated;
+    need_thread |= dedicated;
+
+    if (hs->state && wait >= 0 && !need_thread && duration > HOST_MAX_STEP_NS) {
+        MP_VERBOSE(arg, "Script blocked for %.0f ms, moving it to its own "
+                   "thread.\n", MP_TIME_NS_TO_MS(duration));
+        need_thread = true;
+    }
+
+    bool keep = hs->state && wait >= 0 && !need_thread;
+
+    mp_mutex_lock(&host->lock);
+    hs->running = false;
+    if (keep) {
+        hs->deadline = wait > 1e9 ? INT64_MAX : start + duration +
+                       (int64_t)(wait * 1e9);
+    } else {
+        host_remove(host, hs);
+    }
+    mp_mutex_unlock(&host->lock);
+
+    if (keep)
+        return true;
+
+    // Nothing calls the callbacks anymore after this returns.
+    mpv_set_wakeup_callback(arg->client, NULL, NULL);
+    mp_client_set_blocking_cb(arg->client, NULL, NULL);
+
+    if (hs->state && wait >= 0) {
+        if (dedicated) {
+            run_hosted_script(hs);
+            return false;
+        }
+        mp_thread thread;
+        if (!mp_thread_create(&thread, hosted_script_thread, hs)) {
+            mp_thread_detach(thread);
+            return true;
+        }
+        MP_ERR(arg, "Could not create thread for script.\n");
+    }
+
+    hosted_script_destroy(hs);
+    return !dedicated;
+}
+
+static MP_THREAD_VOID host_thread(void *p)
+{
+    struct script_host *host = p;
+    mp_thread_set_name("script-host");
+
+    mp_mutex_lock(&host->lock);
+    while (!host->terminate) {
+        int64_t now = mp_time_ns();
+        int64_t until = INT64_MAX;
+        struct hosted_script *hs = NULL;
+        for (int n = 0; n < host->num_scripts; n++) {
+            struct hosted_script *cur = host->scripts[n];
+            if (cur->running)
+                continue;
+            if (cur->wakeup || cur->deadline <= now) {
+                hs = cur;
+                // Move it to the end of the list, so other scripts get a turn.
+                MP_TARRAY_REMOVE_AT(host->scripts, host->num_scripts, n);
+                MP_TARRAY_APPEND(host, host->scripts, host->num_scripts, hs);
+                break;
+            }
+            until = MPMIN(until, cur->deadline);
+        }
+        if (!hs) {
+            if (until == INT64_MAX) {
+                mp_cond_wait(&host->wakeup, &host->lock);
+            } else {
+                mp_cond_timedwait_until(&host->wakeup, &host->lock, until);
+            }
+            continue;
+        }
+
+        hs->running = true;
+        hs->wakeup = false;
+        mp_mutex_unlock(&host->lock);
+        if (!host_run_step(host, hs))
+            MP_THREAD_RETURN();
+        mp_mutex_lock(&host->lock);
+    }
+    mp_mutex_unlock(&host->lock);
+
+    MP_THREAD_RETURN();
+}
+
+static struct script_host *get_script_host(struct MPContext *mpctx)
+{
+    if (mpctx->script_host)
+        return mpctx->script_host;
+
+    struct script_host *host = talloc_ptrtype(NULL, host);
+    *host = (struct script_host){
+        .log = mp_log_new(host, mpctx->log, "script-host"),
+    };
+    mp_mutex_init(&host->lock);
+    mp_cond_init(&host->wakeup);
+
+    int num_threads = mpctx->opts->script_host_threads;
+    host->threads = talloc_array(host, mp_thread, num_threads);
+    for (int n = 0; n < num_threads; n++) {
+        if (mp_thread_create(&host->threads[n], host_thread, host))
+            break;
+        host->num_threads++;
+    }
+
+    MP_VERBOSE(host, "Started %d threads.\n", host->num_threads);
+
+    mpctx->script_host = host;
+    return host;
+}
+
+static bool host_add_script(struct MPContext *mpctx, struct mp_script_args *arg)
+{
+    struct script_host *host = get_script_host(mpctx);
+    if (!host->num_threads)
+        return false;
+
+    struct hosted_script *hs = talloc_ptrtype(NULL, hs);
+    *hs = (struct hosted_script){
+        .host = host,
+        .args = talloc_steal(hs, arg),
+        .wakeup = true,
+        .deadline = INT64_MAX,
+    };
+
+    // Set this before the script can run, so no wakeups are lost.
+    mpv_set_wakeup_callback(arg->client, host_wakeup_cb, hs);
+    mp_client_set_blocking_cb(arg->client, host_blocking_cb, hs);
+
+    mp_mutex_lock(&host->lock);
+    MP_TARRAY_APPEND(host, host->scripts, host->num_scripts, hs);
+    mp_cond_signal(&host->wakeup);
+    mp_mutex_unlock(&host->lock);
+    return true;
+}
+
+// Called after all clients are destroyed, so no scripts are left.
+void mp_script_host_destroy(struct MPContext *mpctx)
+{
+    struct script_host *host = mpctx->script_host;
+    if (!host)
+        return;
+
+    mp_mutex_lock(&host->lock);
+    mp_assert(!host->num_scripts);
+    host->terminate = true;
+    mp_cond_broadcast(&host->wakeup);
+    mp_mutex_unlock(&host->lock);
+
+    for (int n = 0; n < host->num_threads; n++)
+        mp_thread_join(host->threads[n]);
+
+    mp_cond_destroy(&host->wakeup);
+    mp_mutex_destroy(&host->lock);
+    talloc_free(host);
+    mpctx->script_host = NULL;
+}
+
 static int64_t mp_load_script(struct MPContext *mpctx, const char *fname)
 {
     bstr ext = mp_get_ext(bstr0(fname));
@@ -187,6 +475,10 @@ static int64_t mp_load_script(struct MPContext *mpctx, const char *fname)
 
     if (backend->no_thread) {
         run_script(arg);
+    } else if (backend->host_step && mpctx->opts->script_host_threads > 0 &&
+               host_add_script(mpctx, arg))
+    {
+        // Loaded and run by the shared script host.
     } else {
         mp_thread thread;
         if (mp_thread_create(&thread, script_thread, arg)) {
@@ -238,16 +530,24 @@ static char **list_script_files(void *talloc_ctx, char *path)
     return files;
 }
 
+// If lazy is set, the script may be loaded on first use instead. This is only
+// for scripts which are reached exclusively through script-binding and
+// script-message-to with the script name as target.
 static void load_builtin_script(struct MPContext *mpctx, int slot, bool enable,
-                                const char *fname)
+                                bool lazy, const char *fname)
 {
     mp_assert(slot < MP_ARRAY_SIZE(mpctx->builtin_script_ids));
     int64_t *pid = &mpctx->builtin_script_ids[slot];
+    const char **pending = &mpctx->builtin_script_pending[slot];
     if (*pid > 0 && !mp_client_id_exists(mpctx, *pid)) {
         MP_DBG(mpctx, "Client for script %s is no longer alive. Marking as unloaded.\n", fname);
         *pid = 0; // died
     }
-    if ((*pid > 0) != enable) {
+    lazy &= mpctx->opts->lua_lazy_builtin_scripts;
+    *pending = enable && lazy && *pid <= 0 ? fname : NULL;
+    if (*pending) {
+        MP_DBG(mpctx, "Deferring loading of script %s until first use.\n", fname);
+    } else if ((*pid > 0) != enable) {
         if (enable) {
             *pid = mp_load_script(mpctx, fname);
         } else {
@@ -259,18 +559,59 @@ static void load_builtin_script(struct MPContext *mpctx, int slot, bool enable,
     }
 }
 
+// Whether --script-opts sets the given key to something other than "no".
+static bool script_opt_enabled(struct MPContext *mpctx, const char *key)
+{
+    char **opts = mpctx->opts->script_opts;
+    for (int n = 0; opts && opts[n] && opts[n + 1]; n += 2) {
+        if (strcmp(opts[n], key) == 0)
+            return strcmp(opts[n + 1], "no") != 0;
+    }
+    return false;
+}
+
 void mp_load_builtin_scripts(struct MPContext *mpctx)
 {
-    load_builtin_script(mpctx, 0, mpctx->opts->lua_load_osc, "@osc.lua");
-    load_builtin_script(mpctx, 1, mpctx->opts->lua_load_ytdl, "@ytdl_hook.lua");
-    load_builtin_script(mpctx, 2, mpctx->opts->lua_load_stats, "@stats.lua");
-    load_builtin_script(mpctx, 3, mpctx->opts->lua_load_console, "@console.lua");
-    load_builtin_script(mpctx, 4, mpctx->opts->lua_load_auto_profiles,
+    // osc, ytdl_hook and auto_profiles act on their own, select sets
+    // menu-data, and commands records the log, so they are never lazy.
+    // stats-bindlist makes stats print the bindings at startup.
+    load_builtin_script(mpctx, 0, mpctx->opts->lua_load_osc, false, "@osc.lua");
+    load_builtin_script(mpctx, 1, mpctx->opts->lua_load_ytdl, false,
+                        "@ytdl_hook.lua");
+    load_builtin_script(mpctx, 2, mpctx->opts->lua_load_stats,
+                        !script_opt_enabled(mpctx, "stats-bindlist"),
+                        "@stats.lua");
+    load_builtin_script(mpctx, 3, mpctx->opts->lua_load_console, true,
+                        "@console.lua");
+    load_builtin_script(mpctx, 4, mpctx->opts->lua_load_auto_profiles, false,
                         "@auto_profiles.lua");
-    load_builtin_script(mpctx, 5, mpctx->opts->lua_load_select, "@select.lua");
-    load_builtin_script(mpctx, 6, mpctx->opts->lua_load_positioning, "@positioning.lua");
-    load_builtin_script(mpctx, 7, mpctx->opts->lua_load_commands, "@commands.lua");
-    load_builtin_script(mpctx, 8, mpctx->opts->lua_load_context_menu, "@context_menu.lua");
+    load_builtin_script(mpctx, 5, mpctx->opts->lua_load_select, false,
+                        "@select.lua");
+    load_builtin_script(mpctx, 6, mpctx->opts->lua_load_positioning, true,
+                        "@positioning.lua");
+    load_builtin_script(mpctx, 7, mpctx->opts->lua_load_commands, false,
+                        "@commands.lua");
+    load_builtin_script(mpctx, 8, mpctx->opts->lua_load_context_menu, true,
+                        "@context_menu.lua");
+}
+
+// Load the built-in script with the given client name, if its loading was
+// deferred. Messages sent to the script right after this are queued until
+// it is ready.
+void mp_load_pending_script(struct MPContext *mpctx, const char *name)
+{
+    for (int n = 0; n < MP_ARRAY_SIZE(mpctx->builtin_script_pending); n++) {
+        const char *fname = mpctx->builtin_script_pending[n];
+        if (!fname)
+            continue;
+        char *script_name = script_name_from_filename(NULL, fname);
+        if (strcmp(script_name, name) == 0) {
+            MP_VERBOSE(mpctx, "Loading script %s on first use.\n", fname);
+            mpctx->builtin_script_pending[n] = NULL;
+            mpctx->builtin_script_ids[n] = mp_load_script(mpctx, fname);
+        }
+        talloc_free(script_name);
+    }
 }
 
 bool mp_load_scripts(struct MPContext *mpctx)
@@ -0,0 +1,544 @@
+/*
+ * This file is part of mpv.
+ *
+ * mpv is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * mpv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Background thumbnailer for seek bar previews. Requests are served on a low
+// priority thread, which opens its own demuxer for the playing file, seeks to
+// the keyframe before the requested time, and decodes only that keyframe.
+// Results are downscaled to RGBA and kept in a LRU cache. A cache entry exists
+// for both the requested time and the keyframe time, so that requests for
+// other times that map to the same keyframe don't need to decode again.
+
+#include <math.h>
+#include <string.h>
+
+#include "mpv_talloc.h"
+
+#include "common/codecs.h"
+#include "common/common.h"
+#include "common/global.h"
+#include "common/msg.h"
+#include "demux/demux.h"
+#include "demux/packet.h"
+#include "demux/stheader.h"
+#include "filters/f_decoder_wrapper.h"
+#include "filters/filter.h"
+#include "input/cmd.h"
+#include "misc/node.h"
+#include "misc/thread_tools.h"
+#include "options/options.h"
+#include "osdep/threads.h"
+#include "osdep/timer.h"
+#include "video/mp_image.h"
+#include "video/sws_utils.h"
+
+#include "command.h"
+#include "core.h"
+#include "video_source.h"
+
+// Give up if the demuxer returns this many packets without a keyframe.
+#define MAX_PACKETS 1000
+
+struct entry {
+    struct video_source *src;
+    double time;
+    int w, h;           // requested size
+    struct mp_image *img;
+};
+
+struct request {
+    struct video_source *src;
+    double time;
+    int w, h;
+    bool done;
+    bool abandoned;     // the command was aborted while the request was running
+    struct mp_image *img; // result, or NULL on failure
+};
+
+struct thumbnailer {
+    struct mpv_global *global;
+    struct mp_log *log;
+    struct mp_cancel *cancel;
+    mp_thread thread;
+    struct mp_sws_context *sws;
+    struct mp_stream_info stream_info;
+
+    // --- worker thread only
+    struct video_source *cur_src;
+    struct demuxer *demuxer;
+    struct sh_stream *sh;
+    struct mp_filter *root;
+    struct mp_decoder *dec;
+
+    mp_mutex lock;
+    mp_cond wakeup;
+    // --- protected by lock
+    bool terminate;
+    bool graph_wakeup;
+    struct request **queue;
+    int num_queue;
+    struct entry **entries;     // LRU order, most recently used last
+    int num_entries;
+    int64_t bytes;
+    int64_t max_bytes;
+    uint64_t hits, misses;
+};
+
+// Must hold lock.
+static struct mp_image *find_entry(struct thumbnailer *p,
+                                   struct video_source *src, double time,
+                                   int w, int h)
+{
+    for (int n = p->num_entries - 1; n >= 0; n--) {
+        struct entry *e = p->entries[n];
+        if (e->time == time && e->w == w && e->h == h &&
+            video_source_equals(e->src, src))
+        {
+            // Move to the end to mark it as most recently used.
+            MP_TARRAY_REMOVE_AT(p->entries, p->num_entries, n);
+            MP_TARRAY_APPEND(p, p->entries, p->num_entries, e);
+            return e->img;
+        }
+    }
+    return NULL;
+}
+
+// Must hold lock.
+static void prune_entries(struct thumbnailer *p)
+{
+    while (p->num_entries && p->bytes > p->max_bytes) {
+        struct entry *e = p->entries[0];
+        p->bytes -= mp_image_approx_byte_size(e->img);
+        talloc_free(e);
+        MP_TARRAY_REMOVE_AT(p->entries, p->num_entries, 0);
+    }
+}
+
+// Must hold lock.
+static void add_entry(struct thumbnailer *p, struct video_source *src,
+                      double time, int w, int h, struct mp_image *img)
+{
+    if (find_entry(p, src, time, w, h))
+        return;
+    struct entry *e = talloc_zero(NULL, struct entry);
+    e->src = video_source_dup(e, src);
+    e->time = time;
+    e->w = w;
+    e->h = h;
+    e->img = talloc_steal(e, mp_image_new_ref(img));
+    MP_HANDLE_OOM(e->img);
+    p->bytes += mp_image_approx_byte_size(e->img);
+    MP_TARRAY_APPEND(p, p->entries, p->num_entries, e);
+    prune_entries(p);
+}
+
+static void wakeup_graph(void *ctx)
+{
+    struct thumbnailer *p = ctx;
+    mp_mutex_lock(&p->lock);
+    p->graph_wakeup = true;
+    mp_cond_broadcast(&p->wakeup); // command threads wait on it too
+    mp_mutex_unlock(&p->lock);
+}
+
+static void close_source(struct thumbnailer *p)
+{
+    TA_FREEP(&p->root);
+    p->dec = NULL;
+    demux_free(p->demuxer);
+    p->demuxer = NULL;
+    p->sh = NULL;
+    TA_FREEP(&p->cur_src);
+}
+
+static bool open_source(struct thumbnailer *p, struct video_source *src)
+{
+    if (video_source_equals(p->cur_src, src))
+        return !!p->dec;
+
+    close_source(p);
+    p->cur_src = video_source_dup(NULL, src);
+
+    p->demuxer = video_source_open(src, p->cancel, p->global, &p->sh);
+    if (!p->demuxer)
+        return false;
+
+    // The user's --vd is ignored, because it is not meant for this decoder.
+    struct mp_decoder_list *full = talloc_zero(NULL, struct mp_decoder_list);
+    vd_lavc.add_decoders(full);
+    struct mp_decoder_list *list =
+        mp_select_decoders(p->log, full, p->sh->codec->codec, NULL);
+    talloc_steal(list, full);
+
+    // Hardware decoding would compete with the main decoder.
+    p->stream_info = (struct mp_stream_info){.force_swdec = true};
+    p->root = mp_filter_create_root(p->global);
+    p->root->stream_info = &p->stream_info;
+    mp_filter_graph_set_wakeup_cb(p->root, wakeup_graph, p);
+    for (int n = 0; n < list->num_entries && !p->dec; n++) {
+        p->dec = vd_lavc.create(p->root, p->sh->codec,
+                                list->entries[n].decoder);
+    }
+    talloc_free(list);
+    if (!p->dec)
+        MP_ERR(p, "Could not create a decoder for %s.\n", src->url);
+    return !!p->dec;
+}
+
+// Return the first keyframe at or before time, or NULL.
+static struct demux_packet *read_keyframe(struct thumbnailer *p, double time)
+{
+    if (!demux_seek(p->demuxer, time, 0))
+        return NULL;
+    for (int n = 0; n < MAX_PACKETS && !mp_cancel_test(p->cancel); n++) {
+        struct demux_packet *pkt = demux_read_any_packet(p->demuxer);
+        if (!pkt)
+            break;
+        if (pkt->stream == p->sh->index && pkt->keyframe &&
+            (pkt->pts != MP_NOPTS_VALUE || pkt->dts != MP_NOPTS_VALUE))
+            return pkt;
+        talloc_free(pkt);
+    }
+    return NULL;
+}
+
+// Decode a single keyframe packet. Since no other packets are fed to the
+// decoder, this has the same effect as --vd-lavc-skipframe=nonkey, without
+// touching the options of the main decoder.
+static struct mp_image *decode_keyframe(struct thumbnailer *p,
+                                        struct demux_packet *pkt)
+{
+    struct mp_image *res = NULL;
+    struct mp_pin *in = p->dec->f->pins[0];
+    struct mp_pin *out = p->dec->f->pins[1];
+    bool eof_sent = false;
+
+    while (!mp_cancel_test(p->cancel)) {
+        if (!eof_sent && mp_pin_in_needs_data(in)) {
+            if (pkt) {
+                mp_pin_in_write(in, MAKE_FRAME(MP_FRAME_PACKET, pkt));
+                pkt = NULL;
+            } else {
+                mp_pin_in_write(in, MP_EOF_FRAME);
+                eof_sent = true;
+            }
+            continue;
+        }
+
+        struct mp_frame frame = mp_pin_out_read(out);
+        if (frame.type == MP_FRAME_EOF) {
+            break;
+        } else if (frame.type == MP_FRAME_VIDEO && !res) {
+            res = frame.data;
+        } else if (frame.type) {
+            mp_frame_unref(&frame);
+        } else if (mp_filter_has_failed(p->dec->f)) {
+            break;
+        } else if (!mp_filter_graph_run(p->root)) {
+            mp_mutex_lock(&p->lock);
+            if (!p->graph_wakeup && !p->terminate)
+                mp_cond_timedwait(&p->wakeup, &p->lock, MP_TIME_MS_TO_NS(50));
+            p->graph_wakeup = false;
+            mp_mutex_unlock(&p->lock);
+        }
+    }
+
+    talloc_free(pkt);
+    // Flush the decoder for the next request.
+    mp_filter_reset(p->dec->f);
+    return res;
+}
+
+// Scale img to fit into w x h (either can be 0 to derive it from the aspect).
+static struct mp_image *scale_image(struct thumbnailer *p, struct mp_image *img,
+                                    int w, int h)
+{
+    int d_w, d_h;
+    mp_image_params_get_dsize(&img->params, &d_w, &d_h);
+    if (d_w < 1 || d_h < 1)
+        return NULL;
+    if (!h || (w && (int64_t)w * d_h <= (int64_t)h * d_w)) {
+        h = MPMAX(lrint(w * (double)d_h / d_w), 1);
+    } else {
+        w = MPMAX(lrint(h * (double)d_w / d_h), 1);
+    }
+
+    if (mp_image_crop_valid(&img->params))
+        mp_image_crop_rc(img, img->params.crop);
+
+    struct mp_image *dst = mp_image_alloc(IMGFMT_RGBA, w, h);
+    if (!dst)
+        return NULL;
+    mp_image_copy_attributes(dst, img);
+    dst->params = (struct mp_image_params){
+        .imgfmt = IMGFMT_RGBA,
+        .w = w,
+        .h = h,
+        .p_w = 1,
+        .p_h = 1,
+        .color = img->params.color,
+        .crop = {0, 0, w, h},
+    };
+    mp_image_params_guess_csp(&dst->params);
+    if (mp_sws_scale(p->sws, dst, img) < 0)
+        TA_FREEP(&dst);
+    return dst;
+}
+
+static struct mp_image *make_thumbnail(struct thumbnailer *p,
+                                       struct request *req)
+{
+    if (!open_source(p, req->src))
+        return NULL;
+
+    struct demux_packet *pkt = read_keyframe(p, req->time);
+    if (!pkt)
+        return NULL;
+    double time = pkt->pts != MP_NOPTS_VALUE ? pkt->pts : pkt->dts;
+
+    mp_mutex_lock(&p->lock);
+    struct mp_image *res = find_entry(p, req->src, time, req->w, req->h);
+    res = res ? mp_image_new_ref(res) : NULL;
+    mp_mutex_unlock(&p->lock);
+    if (res) {
+        talloc_free(pkt);
+        return res;
+    }
+
+    int64_t start = mp_time_ns();
+    struct mp_image *img = decode_keyframe(p, pkt);
+    if (img) {
+        res = scale_image(p, img, req->w, req->h);
+        talloc_free(img);
+    }
+    if (res) {
+        res->pts = time;
+        MP_DBG(p, "Thumbnail for %f (keyframe at %f) took %.1f ms.\n",
+               req->time, time, MP_TIME_NS_TO_MS(mp_time_ns() - start));
+        mp_mutex_lock(&p->lock);
+        add_entry(p, req->src, time, req->w, req->h, res);
+        mp_mutex_unlock(&p->lock);
+    }
+    return res;
+}
+
+static MP_THREAD_VOID thumbnail_thread(void *ctx)
+{
+    struct thumbnailer *p = ctx;
+    mp_thread_set_name("thumbnail");
+    mp_thread_set_background();
+
+    mp_mutex_lock(&p->lock);
+    while (!p->terminate) {
+        if (!p->num_queue) {
+            mp_cond_wait(&p->wakeup, &p->lock);
+            continue;
+        }
+        // Newest requests first: with a seek bar preview, older requests are
+        // often not interesting anymore.
+        struct request *req = p->queue[p->num_queue - 1];
+        MP_TARRAY_REMOVE_AT(p->queue, p->num_queue, p->num_queue - 1);
+        mp_mutex_unlock(&p->lock);
+
+        struct mp_image *img = make_thumbnail(p, req);
+
+        mp_mutex_lock(&p->lock);
+        if (img)
+            add_entry(p, req->src, req->time, req->w, req->h, img);
+        if (req->abandoned) {
+            talloc_free(img);
+            talloc_free(req);
+        } else {
+            req->img = img;
+            req->done = true;
+        }
+        mp_cond_broadcast(&p->wakeup);
+    }
+    mp_mutex_unlock(&p->lock);
+
+    close_source(p);
+
+    MP_THREAD_RETURN();
+}
+
+static struct thumbnailer *get_thumbnailer(struct MPContext *mpctx)
+{
+    if (mpctx->thumbnailer)
+        return mpctx->thumbnailer;
+
+    struct thumbnailer *p = talloc_zero(NULL, struct thumbnailer);
+    p->global = mpctx->global;
+    p->log = mp_log_new(p, mpctx->log, "thumbnail");
+    p->cancel = mp_cancel_new(p);
+    p->sws = mp_sws_alloc(p);
+    p->sws->log = p->log;
+    mp_sws_enable_cmdline_opts(p->sws, p->global);
+    mp_mutex_init(&p->lock);
+    mp_cond_init(&p->wakeup);
+    if (mp_thread_create(&p->thread, thumbnail_thread, p)) {
+        mp_cond_destroy(&p->wakeup);
+        mp_mutex_destroy(&p->lock);
+        talloc_free(p);
+        return NULL;
+    }
+    mpctx->thumbnailer = p;
+    return p;
+}
+
+static void image_to_node(struct mpv_node *res, struct mp_image *img,
+                          double time)
+{
+    node_init(res, MPV_FORMAT_NODE_MAP, NULL);
+    node_map_add_int64(res, "w", img->w);
+    node_map_add_int64(res, "h", img->h);
+    node_map_add_int64(res, "stride", img->stride[0]);
+    node_map_add_string(res, "format", "rgba");
+    node_map_add_double(res, "time", time);
+    struct mpv_byte_array *ba =
+        node_map_add(res, "data", MPV_FORMAT_BYTE_ARRAY)->u.ba;
+    *ba = (struct mpv_byte_array){
+        .data = img->planes[0],
+        .size = img->stride[0] * img->h,
+    };
+    talloc_steal(ba, img);
+}
+
+void cmd_thumbnail(void *ptr)
+{
+    struct mp_cmd_ctx *cmd = ptr;
+    struct MPContext *mpctx = cmd->mpctx;
+    double time = cmd->args[0].v.d;
+    int w = cmd->args[1].v.i;
+    int h = cmd->args[2].v.i;
+
+    struct video_source src;
+    if (!video_source_get(mpctx, &src)) {
+        mp_cmd_msg(cmd, MSGL_ERR, "No video to take thumbnails from.");
+        cmd->success = false;
+        return;
+    }
+
+    struct thumbnailer *p = get_thumbnailer(mpctx);
+    if (!p) {
+        cmd->success = false;
+        return;
+    }
+
+    if (!w && !h)
+        w = 256;
+
+    struct request *req = talloc_zero(NULL, struct request);
+    req->src = video_source_dup(req, &src);
+    req->time = time;
+    req->w = w;
+    req->h = h;
+
+    mp_mutex_lock(&p->lock);
+    p->max_bytes = mpctx->opts->thumbnail_cache;
+    prune_entries(p);
+    struct mp_image *img = find_entry(p, req->src, time, w, h);
+    if (img) {
+        p->hits++;
+        req->img = mp_image_new_ref(img);
+        req->done = true;
+    } else {
+        p->misses++;
+        MP_TARRAY_APPEND(p, p->queue, p->num_queue, req);
+        mp_cond_broadcast(&p->wakeup);
+    }
+    mp_mutex_unlock(&p->lock);
+
+    mp_core_unlock(mpctx);
+
+    mp_mutex_lock(&p->lock);
+    while (!req->done && !mp_cancel_test(cmd->abort->cancel))
+        mp_cond_timedwait(&p->wakeup, &p->lock, MP_TIME_MS_TO_NS(50));
+    bool done = req->done;
+    bool abandoned = false;
+    if (!done) {
+        int idx = -1;
+        for (int n = 0; n < p->num_queue; n++) {
+            if (p->queue[n] == req)
+                idx = n;
+        }
+        if (idx >= 0) {
+            MP_TARRAY_REMOVE_AT(p->queue, p->num_queue, idx);
+        } else {
+            req->abandoned = abandoned = true; // freed by the worker
+        }
+    }
+    mp_mutex_unlock(&p->lock);
+
+    mp_core_lock(mpctx);
+
+    if (!done) {
+        if (!abandoned)
+            talloc_free(req);
+        cmd->success = false;
+        return;
+    }
+
+    if (req->img) {
+        image_to_node(&cmd->result, req->img, req->img->pts);
+        req->img = NULL;
+    } else {
+        mp_cmd_msg(cmd, MSGL_ERR, "Could not create thumbnail for %f.", time);
+        cmd->success = false;
+    }
+    talloc_free(req);
+}
+
+void thumbnail_get_stats(struct MPContext *mpctx, struct mpv_node *res)
+{
+    struct thumbnailer *p = mpctx->thumbnailer;
+    node_init(res, MPV_FORMAT_NODE_MAP, NULL);
+    int64_t entries = 0, bytes = 0, hits = 0, misses = 0, queued = 0;
+    if (p) {
+        mp_mutex_lock(&p->lock);
+        entries = p->num_entries;
+        bytes = p->bytes;
+        hits = p->hits;
+        misses = p->misses;
+        queued = p->num_queue;
+        mp_mutex_unlock(&p->lock);
+    }
+    node_map_add_int64(res, "entries", entries);
+    node_map_add_int64(res, "bytes", bytes);
+    node_map_add_int64(res, "hits", hits);
+    node_map_add_int64(res, "misses", misses);
+    node_map_add_int64(res, "queued", queued);
+}
+
+void thumbnail_destroy(struct MPContext *mpctx)
+{
+    struct thumbnailer *p = mpctx->thumbnailer;
+    if (!p)
+        return;
+    mp_mutex_lock(&p->lock);
+    p->terminate = true;
+    mp_cond_broadcast(&p->wakeup);
+    mp_mutex_unlock(&p->lock);
+    mp_cancel_trigger(p->cancel);
+    mp_thread_join(p->thread);
+    for (int n = 0; n < p->num_queue; n++)
+        talloc_free(p->queue[n]);
+    for (int n = 0; n < p->num_entries; n++)
+        talloc_free(p->entries[n]);
+    mp_cond_destroy(&p->wakeup);
+    mp_mutex_destroy(&p->lock);
+    talloc_free(p);
+    mpctx->thumbnailer = NULL;
+}
@@ -29,6 +29,7 @@
 #include "options/m_option.h"
 #include "common/common.h"
 #include "common/encode.h"
+#include "common/trace.h"
 #include "options/m_property.h"
 #include "osdep/timer.h"
 
@@ -37,6 +38,7 @@
 #include "demux/demux.h"
 #include "stream/stream.h"
 #include "sub/osd.h"
+#include "video/frame_cache.h"
 #include "video/hwdec.h"
 #include "filters/f_decoder_wrapper.h"
 #include "filters/f_enhancement_pair.h"
@@ -69,6 +71,9 @@ static bool recreate_video_filters(struct MPContext *mpctx)
     struct vo_chain *vo_c = mpctx->vo_chain;
     mp_assert(vo_c);
 
+    // The cached frames were produced by the old filters.
+    reset_frame_cache(mpctx);
+
     return mp_output_chain_update_filters(vo_c->filter, opts->vf_settings);
 }
 
@@ -164,6 +169,7 @@ void uninit_video_chain(struct MPContext *mpctx)
 {
     if (mpctx->vo_chain) {
         reset_video_state(mpctx);
+        reset_frame_cache(mpctx);
         vo_chain_uninit(mpctx->vo_chain);
         mpctx->vo_chain = NULL;
 
@@ -240,7 +246,9 @@ void reinit_video_chain_src(struct MPContext *mpctx, struct track *track)
             .wakeup_cb = mp_wakeup_core_cb,
             .wakeup_ctx = mpctx,
         };
+        trace_begin(mpctx->global, "vo-init");
         mpctx->video_out = init_best_video_out(mpctx->global, &ex);
+        trace_end(mpctx->global, "vo-init");
         if (!mpctx->video_out) {
             MP_FATAL(mpctx, "Error opening/initializing "
                     "the selected video_out (--vo) device.\n");
@@ -470,6 +478,69 @@ static bool have_new_frame(struct MPContext *mpctx, bool eof)
     return mpctx->num_next_frames >= get_req_frames(mpctx, eof);
 }
 
+void reset_frame_cache(struct MPContext *mpctx)
+{
+    mp_frame_cache_clear(mpctx->frame_cache);
+    mpctx->frame_cache_pos = -1;
+}
+
+// Remember a frame that was just read from the filter chain.
+static void add_cached_frame(struct MPContext *mpctx, struct mp_image *img)
+{
+    struct MPOpts *opts = mpctx->opts;
+    struct vo_chain *vo_c = mpctx->vo_chain;
+
+    // Hardware frames would starve the decoder's surface pool.
+    if (!opts->video_frame_cache || vo_c->is_coverart || mpctx->play_dir != 1 ||
+        IMGFMT_IS_HWACCEL(img->imgfmt) || img->pts == MP_NOPTS_VALUE)
+    {
+        reset_frame_cache(mpctx);
+        return;
+    }
+
+    // Frames dropped by the decoder leave a gap in the cached sequence.
+    struct track *track = vo_c->track;
+    int dropped = track && track->dec ?
+                  mp_decoder_wrapper_get_frames_dropped(track->dec) : 0;
+    if (dropped != mpctx->frame_cache_dropped) {
+        reset_frame_cache(mpctx);
+        mpctx->frame_cache_dropped = dropped;
+    }
+
+    mp_frame_cache_set_max_bytes(mpctx->frame_cache, opts->video_frame_cache);
+    mp_frame_cache_add(mpctx->frame_cache, img);
+}
+
+// Seek by replaying cached frames instead of decoding them again. If step is
+// not 0, go that many frames from the current frame, otherwise go to the first
+// frame at or after pts. Returns false if the cache does not have the frame.
+bool seek_frame_cache(struct MPContext *mpctx, double pts, int step)
+{
+    struct mp_frame_cache *cache = mpctx->frame_cache;
+    int index;
+    if (step) {
+        if (mpctx->video_pts == MP_NOPTS_VALUE)
+            return false;
+        int cur = mp_frame_cache_find(cache, mpctx->video_pts);
+        if (cur < 0 || mp_frame_cache_get(cache, cur)->pts != mpctx->video_pts)
+            return false;
+        index = cur + step;
+    } else {
+        index = mp_frame_cache_find(cache, pts - .005);
+        // Nothing is known about the frames before the oldest cached one, so
+        // it can't be the target.
+        if (index < 1)
+            return false;
+    }
+    if (index < 0 || index >= mp_frame_cache_num_frames(cache))
+        return false;
+
+    reset_video_state(mpctx);
+    mpctx->frame_cache_pos = index;
+    mpctx->hrseek_pts = mp_frame_cache_get(cache, index)->pts;
+    return true;
+}
+
 // Fill mpctx->next_frames[] with a newly filtered or decoded image.
 // logical_eof: is set to true if there is EOF after currently queued frames
 // returns VD_* code
@@ -503,9 +574,24 @@ static int video_output_image(struct MPContext *mpctx, bool *logical_eof)
     // Get a new frame if we need one.
     int r = VD_PROGRESS;
     if (needs_new_frame(mpctx)) {
-        // Filter a new frame.
+        // Filter a new frame, or replay a cached one after a cached seek.
         struct mp_image *img = NULL;
-        struct mp_frame frame = mp_pin_out_read(vo_c->filter->f->pins[1]);
+        struct mp_frame frame;
+        int cache_pos = mpctx->frame_cache_pos;
+        if (cache_pos >= 0) {
+            struct mp_image *cached =
+                mp_image_new_ref(mp_frame_cache_get(mpctx->frame_cache,
+                                                    cache_pos));
+            MP_HANDLE_OOM(cached);
+            frame = MAKE_FRAME(MP_FRAME_VIDEO, cached);
+            mpctx->frame_cache_pos++;
+            // Past the end, the filter output continues with the next frame.
+            if (mpctx->frame_cache_pos >=
+                mp_frame_cache_num_frames(mpctx->frame_cache))
+                mpctx->frame_cache_pos = -1;
+        } else {
+            frame = mp_pin_out_read(vo_c->filter->f->pins[1]);
+        }
         if (frame.type == MP_FRAME_NONE) {
             r = vo_c->filter->got_output_eof ? VD_EOF : VD_WAIT;
         } else if (frame.type == MP_FRAME_EOF) {
@@ -522,11 +608,17 @@ static int video_output_image(struct MPContext *mpctx, bool *logical_eof)
             double endpts = get_play_end_pts(mpctx);
             if (endpts != MP_NOPTS_VALUE)
                 endpts *= mpctx->play_dir;
-            if ((endpts != MP_NOPTS_VALUE && img->pts >= endpts) ||
-                mpctx->max_frames == 0)
-            {
-                mp_pin_out_unread(vo_c->filter->f->pins[1], frame);
-                img = NULL;
+            bool at_end = (endpts != MP_NOPTS_VALUE && img->pts >= endpts) ||
+                          mpctx->max_frames == 0;
+            if (!at_end && cache_pos < 0)
+                add_cached_frame(mpctx, img);
+            if (at_end) {
+                if (cache_pos >= 0) {
+                    mpctx->frame_cache_pos = cache_pos;
+                } else {
+                    mp_pin_out_unread(vo_c->filter->f->pins[1], frame);
+                    img = NULL;
+                }
                 r = VD_EOF;
             } else if (hrseek && (img->pts < hrseek_pts - tolerance ||
                                   mpctx->hrseek_lastframe))
@@ -1275,7 +1367,9 @@ void write_video(struct MPContext *mpctx)
         mpctx->video_status = STATUS_READY;
         // After a seek, make sure to wait until the first frame is visible.
         if (!opts->video_latency_hacks) {
+            trace_begin(mpctx->global, "present-first-frame");
             vo_wait_frame(vo);
+            trace_end(mpctx->global, "present-first-frame");
             MP_VERBOSE(mpctx, "first video frame after restart shown\n");
         }
     }
@@ -0,0 +1,96 @@
+/*
+ * This file is part of mpv.
+ *
+ * mpv is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * mpv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include "mpv_talloc.h"
+
+#include "common/common.h"
+#include "common/playlist.h"
+#include "demux/demux.h"
+#include "demux/stheader.h"
+#include "options/options.h"
+#include "stream/stream.h"
+
+#include "core.h"
+#include "video_source.h"
+
+bool video_source_get(struct MPContext *mpctx, struct video_source *out)
+{
+    struct track *track = mpctx->current_track[0][STREAM_VIDEO];
+    if (!mpctx->playing || !track || !track->stream ||
+        track->stream->attached_picture)
+        return false;
+    char *url = track->is_external ? track->external_filename
+                                   : mpctx->stream_open_filename;
+    *out = (struct video_source){
+        .url = url ? url : mpctx->playing->filename,
+        // Apply the same origin restrictions as the player did when it opened
+        // the main file or the external track.
+        .stream_flags = track->is_external ? STREAM_ORIGIN_DIRECT
+                                           : mpctx->playing->stream_flags,
+        .demuxer_id = track->stream->demuxer_id,
+        .rebase = mpctx->opts->rebase_start_time,
+    };
+    return true;
+}
+
+struct video_source *video_source_dup(void *ta_parent,
+                                      const struct video_source *src)
+{
+    struct video_source *res = talloc_dup(ta_parent, (struct video_source *)src);
+    res->url = talloc_strdup(res, src->url);
+    return res;
+}
+
+bool video_source_equals(const struct video_source *a,
+                         const struct video_source *b)
+{
+    return a && b && strcmp(a->url, b->url) == 0 &&
+           a->stream_flags == b->stream_flags &&
+           a->demuxer_id == b->demuxer_id && a->rebase == b->rebase;
+}
+
+struct demuxer *video_source_open(const struct video_source *src,
+                                  struct mp_cancel *cancel,
+                                  struct mpv_global *global,
+                                  struct sh_stream **out_sh)
+{
+    struct demuxer_params params = {
+        .stream_flags = src->stream_flags,
+    };
+    struct demuxer *demuxer = demux_open_url(src->url, &params, cancel, global);
+    if (!demuxer)
+        return NULL;
+    if (src->rebase)
+        demux_set_ts_offset(demuxer, -demuxer->start_time);
+
+    struct sh_stream *sh = NULL;
+    for (int n = 0; n < demux_get_num_stream(demuxer); n++) {
+        struct sh_stream *s = demux_get_stream(demuxer, n);
+        if (s->type == STREAM_VIDEO && !s->attached_picture &&
+            s->demuxer_id == src->demuxer_id)
+            sh = s;
+    }
+    if (!sh) {
+        demux_free(demuxer);
+        return NULL;
+    }
+    demuxer_select_track(demuxer, sh, MP_NOPTS_VALUE, true);
+    *out_sh = sh;
+    return demuxer;
+}
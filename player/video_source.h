@@ -0,0 +1,57 @@
+/*
+ * This file is part of mpv.
+ *
+ * mpv is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * mpv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MPLAYER_VIDEO_SOURCE_H
+#define MPLAYER_VIDEO_SOURCE_H
+
+#include <stdbool.h>
+
+struct MPContext;
+struct demuxer;
+struct mp_cancel;
+struct mpv_global;
+struct sh_stream;
+
+// Identifies the playing video stream, so that background workers (such as
+// the thumbnailer and the frame index) can open it again on their own.
+struct video_source {
+    char *url;
+    int stream_flags;   // STREAM_ORIGIN_* etc., as used by the player
+    int demuxer_id;
+    bool rebase;        // --rebase-start-time
+};
+
+// Describe the current video track. Returns false if there is none, or if it
+// is cover art. The result points into mpctx; use video_source_dup() to keep
+// it.
+bool video_source_get(struct MPContext *mpctx, struct video_source *out);
+
+struct video_source *video_source_dup(void *ta_parent,
+                                      const struct video_source *src);
+
+// NULL is not equal to anything.
+bool video_source_equals(const struct video_source *a,
+                         const struct video_source *b);
+
+// Open a new demuxer for src, with only its video stream selected, which is
+// returned in *out_sh. Returns NULL on failure.
+struct demuxer *video_source_open(const struct video_source *src,
+                                  struct mp_cancel *cancel,
+                                  struct mpv_global *global,
+                                  struct sh_stream **out_sh);
+
+#endif
@@ -0,0 +1,103 @@
+#include "audio/chmap.h"
+#include "audio/ebur128.h"
+#include "test_utils.h"
+
+#define RATE 48000
+
+// Feed secs seconds of a sine with the given peak level in dBFS to the first
+// active channels (or silence if db is -INFINITY). Other channels are silent.
+static void add_sine_ch(struct mp_ebur128 *m, int channels, int active,
+                        double db, double secs)
+{
+    int samples = secs * RATE;
+    float *data = talloc_array(NULL, float, samples);
+    float *silence = talloc_zero_array(NULL, float, samples);
+    double amp = isfinite(db) ? pow(10.0, db / 20.0) : 0;
+    for (int n = 0; n < samples; n++)
+        data[n] = amp * sin(2 * M_PI * 1000 * n / RATE);
+    // Odd chunk size to exercise step handling across calls.
+    for (int pos = 0; pos < samples; pos += 1237) {
+        float *planes[MP_NUM_CHANNELS];
+        for (int c = 0; c < channels; c++)
+            planes[c] = (c < active ? data : silence) + pos;
+        mp_ebur128_add_planar(m, planes, MPMIN(1237, samples - pos));
+    }
+    talloc_free(data);
+    talloc_free(silence);
+}
+
+static void add_sine(struct mp_ebur128 *m, int channels, double db, double secs)
+{
+    add_sine_ch(m, channels, channels, db, secs);
+}
+
+static struct mp_ebur128 *create(void *ta_ctx, int channels)
+{
+    struct mp_chmap chmap;
+    mp_chmap_from_channels(&chmap, channels);
+    return mp_ebur128_create(ta_ctx, RATE, &chmap);
+}
+
+static double loudness(struct mp_ebur128 *m)
+{
+    const uint32_t *hist = mp_ebur128_get_histogram(m);
+    return mp_ebur128_loudness(&hist, 1);
+}
+
+int main(void)
+{
+    void *ta_ctx = talloc_new(NULL);
+
+    // EBU Tech 3341, test cases 1 and 2.
+    struct mp_ebur128 *m = create(ta_ctx, 2);
+    add_sine(m, 2, -23, 20);
+    assert_float_equal(loudness(m), -23, 0.1);
+    assert_float_equal(mp_ebur128_get_peak(m), pow(10, -23 / 20.0), 1e-4);
+
+    m = create(ta_ctx, 2);
+    add_sine(m, 2, -33, 20);
+    assert_float_equal(loudness(m), -33, 0.1);
+
+    // EBU Tech 3341, test case 3: relative gate removes the quiet part.
+    m = create(ta_ctx, 2);
+    add_sine(m, 2, -36, 10);
+    add_sine(m, 2, -23, 60);
+    add_sine(m, 2, -36, 10);
+    assert_float_equal(loudness(m), -23, 0.1);
+
+    // Absolute gate: silence does not count.
+    m = create(ta_ctx, 2);
+    add_sine(m, 2, -23, 10);
+    add_sine(m, 2, -INFINITY, 30);
+    assert_float_equal(loudness(m), -23, 0.1);
+
+    m = create(ta_ctx, 2);
+    add_sine(m, 2, -INFINITY, 5);
+    assert_true(loudness(m) == -INFINITY);
+
+    // Mono has half the power of the same signal on 2 channels.
+    m = create(ta_ctx, 1);
+    add_sine(m, 1, -20, 10);
+    assert_float_equal(loudness(m), -23, 0.1);
+
+    // 5.1 (FL FR FC LFE BL BR): LFE is ignored.
+    m = create(ta_ctx, 6);
+    add_sine_ch(m, 6, 4, -23, 10);
+    struct mp_ebur128 *ref = create(ta_ctx, 3);
+    add_sine(ref, 3, -23, 10);
+    assert_float_equal(loudness(m), loudness(ref), 0.01);
+
+    // Combining histograms (album loudness) equals measuring the whole.
+    struct mp_ebur128 *a = create(ta_ctx, 2), *b = create(ta_ctx, 2);
+    struct mp_ebur128 *all = create(ta_ctx, 2);
+    add_sine(a, 2, -20, 10);
+    add_sine(b, 2, -26, 30);
+    add_sine(all, 2, -20, 10);
+    add_sine(all, 2, -26, 30);
+    const uint32_t *hists[2] = {mp_ebur128_get_histogram(a),
+                                mp_ebur128_get_histogram(b)};
+    assert_float_equal(mp_ebur128_loudness(hists, 2), loudness(all), 0.1);
+
+    talloc_free(ta_ctx);
+    return 0;
+}
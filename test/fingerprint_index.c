@@ -0,0 +1,90 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "test_utils.h"
+#include "video/fingerprint_index.h"
+
+#define HASH_SIZE 64
+
+static void make_hash(uint8_t *hash, int value)
+{
+    for (int n = 0; n < HASH_SIZE; n++)
+        hash[n] = value;
+}
+
+int main(void)
+{
+    char path[] = "/tmp/mpv-fingerprint-index-test-XXXXXX";
+    int tmp = mkstemp(path);
+    assert_true(tmp >= 0);
+    close(tmp);
+
+    uint8_t a[HASH_SIZE], b[HASH_SIZE], c[HASH_SIZE];
+    make_hash(a, 10);
+    make_hash(b, 200);
+    make_hash(c, 12);
+    c[0] = 60;
+
+    assert_int_equal(mp_fp_distance(a, a, HASH_SIZE), 0);
+    assert_int_equal(mp_fp_distance(a, b, HASH_SIZE), 190);
+    assert_int_equal(mp_fp_distance(b, a, HASH_SIZE), 190);
+    // (50 + 63 * 2) / 64, rounded
+    assert_int_equal(mp_fp_distance(a, c, HASH_SIZE), 3);
+
+    struct mp_fp_index_writer *w =
+        mp_fp_index_writer_open(NULL, NULL, path, HASH_SIZE);
+    assert_true(w);
+    assert_true(mp_fp_index_writer_add(w, 0.0, 0, a));
+    assert_true(mp_fp_index_writer_add(w, 0.04, 0, c));
+    assert_true(mp_fp_index_writer_add(w, 0.08, MP_FP_SCENE_CUT, b));
+    assert_true(mp_fp_index_writer_add(w, MP_NOPTS_VALUE, 0, b));
+    assert_true(mp_fp_index_writer_add(w, 12.5, MP_FP_SCENE_CUT, c));
+    assert_true(mp_fp_index_writer_close(w));
+
+    struct mp_fp_index *idx = mp_fp_index_load(NULL, NULL, path);
+    assert_true(idx);
+    assert_int_equal(idx->hash_size, HASH_SIZE);
+    assert_int_equal(idx->num_entries, 5);
+    assert_float_equal(idx->entries[1].pts, 0.04, 1e-6);
+    assert_int_equal(idx->entries[2].flags, MP_FP_SCENE_CUT);
+    assert_true(idx->entries[3].pts == MP_NOPTS_VALUE);
+    assert_float_equal(idx->entries[4].pts, 12.5, 1e-6);
+    assert_memcmp(idx->entries[4].hash, c, HASH_SIZE);
+
+    // Consecutive matches are collapsed to the closest one.
+    struct mp_fp_match *m;
+    int num = mp_fp_index_find(idx, a, 5, idx, &m);
+    assert_int_equal(num, 2);
+    assert_int_equal(m[0].index, 0);
+    assert_int_equal(m[0].distance, 0);
+    assert_int_equal(m[1].index, 4);
+    assert_float_equal(m[1].pts, 12.5, 1e-6);
+    assert_int_equal(m[1].distance, 3);
+
+    num = mp_fp_index_find(idx, b, 0, idx, &m);
+    assert_int_equal(num, 1);
+    assert_int_equal(m[0].index, 2);
+
+    talloc_free(idx);
+
+    // A truncated last entry is ignored.
+    FILE *f = fopen(path, "ab");
+    assert_true(f);
+    assert_int_equal(fwrite(a, 5, 1, f), 1);
+    assert_int_equal(fclose(f), 0);
+    idx = mp_fp_index_load(NULL, NULL, path);
+    assert_true(idx);
+    assert_int_equal(idx->num_entries, 5);
+    talloc_free(idx);
+
+    // Not an index.
+    f = fopen(path, "wb");
+    assert_true(f);
+    assert_int_equal(fwrite("garbage garbage garbage", 23, 1, f), 1);
+    assert_int_equal(fclose(f), 0);
+    assert_false(mp_fp_index_load(NULL, NULL, path));
+
+    unlink(path);
+    return 0;
+}
@@ -0,0 +1,78 @@
+#include "test_utils.h"
+#include "video/frame_cache.h"
+#include "video/img_format.h"
+#include "video/mp_image.h"
+
+static struct mp_image *new_frame(double pts)
+{
+    struct mp_image *img = mp_image_alloc(IMGFMT_420P, 64, 64);
+    mp_require(img);
+    img->pts = pts;
+    return img;
+}
+
+static void add_frame(struct mp_frame_cache *c, double pts)
+{
+    struct mp_image *img = new_frame(pts);
+    mp_frame_cache_add(c, img);
+    talloc_free(img);
+}
+
+int main(void)
+{
+    struct mp_frame_cache *c = mp_frame_cache_new(NULL);
+
+    struct mp_image *img = new_frame(0);
+    int64_t frame_size = mp_image_approx_byte_size(img);
+    talloc_free(img);
+    assert_true(frame_size > 0);
+
+    // Oldest frames are evicted to stay within the limit.
+    mp_frame_cache_set_max_bytes(c, frame_size * 4);
+    for (int n = 0; n < 10; n++)
+        add_frame(c, n);
+    assert_int_equal(mp_frame_cache_num_frames(c), 4);
+    assert_int_equal(mp_frame_cache_get_bytes(c), frame_size * 4);
+    for (int n = 0; n < 4; n++)
+        assert_float_equal(mp_frame_cache_get(c, n)->pts, 6 + n, 0);
+
+    assert_int_equal(mp_frame_cache_find(c, 0), 0);
+    assert_int_equal(mp_frame_cache_find(c, 6), 0);
+    assert_int_equal(mp_frame_cache_find(c, 7.5), 2);
+    assert_int_equal(mp_frame_cache_find(c, 9), 3);
+    assert_int_equal(mp_frame_cache_find(c, 9.5), -1);
+
+    // The cache keeps its own references.
+    struct mp_image *last = mp_frame_cache_get(c, 3);
+    assert_true(last->planes[0]);
+
+    // A timestamp that does not increase starts a new sequence.
+    add_frame(c, 3);
+    assert_int_equal(mp_frame_cache_num_frames(c), 1);
+    assert_float_equal(mp_frame_cache_get(c, 0)->pts, 3, 0);
+
+    // A frame is kept even if it alone exceeds the limit.
+    mp_frame_cache_set_max_bytes(c, 1);
+    add_frame(c, 4);
+    add_frame(c, 5);
+    assert_int_equal(mp_frame_cache_num_frames(c), 1);
+    assert_float_equal(mp_frame_cache_get(c, 0)->pts, 5, 0);
+
+    // Growing the ring while it wraps around keeps the order.
+    mp_frame_cache_clear(c);
+    assert_int_equal(mp_frame_cache_num_frames(c), 0);
+    assert_int_equal(mp_frame_cache_get_bytes(c), 0);
+    mp_frame_cache_set_max_bytes(c, frame_size * 10);
+    for (int n = 0; n < 100; n++)
+        add_frame(c, n);
+    mp_frame_cache_set_max_bytes(c, frame_size * 50);
+    for (int n = 100; n < 200; n++)
+        add_frame(c, n);
+    assert_int_equal(mp_frame_cache_num_frames(c), 50);
+    for (int n = 0; n < 50; n++)
+        assert_float_equal(mp_frame_cache_get(c, n)->pts, 150 + n, 0);
+    assert_int_equal(mp_frame_cache_find(c, 175), 25);
+
+    talloc_free(c);
+    return 0;
+}
@@ -0,0 +1,142 @@
+/*
+ * This file is part of mpv.
+ *
+ * mpv is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * mpv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Audio scheduling benchmark. Plays tone bursts on ao_null simulating various
+// devices, seeks and pauses, and collects --audio-timing-report output of each
+// run into a JSON lines report given as argument.
+
+#include "libmpv_common.h"
+
+// 1 kHz bursts of 50 ms every 250 ms.
+#define TONE_BURSTS "av://lavfi:aevalsrc='0.5*sin(2*PI*1000*t)*lt(mod(t,0.25),0.05)'" \
+                    ":sample_rate=48000:duration=4"
+
+struct scenario {
+    const char *name;
+    const char *options[8]; // name/value pairs
+};
+
+static const struct scenario scenarios[] = {
+    {"ideal", {0}},
+    {"periods", {"ao-null-period", "1024", "ao-null-outburst", "1024"}},
+    {"drift-fast", {"ao-null-speed", "1.01"}},
+    {"drift-slow", {"ao-null-speed", "0.99"}},
+    {"latency", {"ao-null-latency", "0.1", "ao-null-period", "480"}},
+    {"broken-delay", {"ao-null-broken-delay", "yes", "ao-null-outburst", "2048"}},
+};
+
+static double now(void)
+{
+    return mpv_get_time_us(ctx) / 1e6;
+}
+
+// Process events for the given time, or until the given event arrives.
+static double run_until(double secs, mpv_event_id until)
+{
+    double start = now();
+    while (1) {
+        double left = start + secs - now();
+        if (left <= 0)
+            return -1;
+        mpv_event *ev = mpv_wait_event(ctx, left);
+        if (ev->event_id == MPV_EVENT_LOG_MESSAGE) {
+            mpv_event_log_message *msg = ev->data;
+            if (msg->log_level <= MPV_LOG_LEVEL_ERROR)
+                fail("[%s] %s", msg->prefix, msg->text);
+        } else if (ev->event_id == MPV_EVENT_END_FILE) {
+            fail("playback ended unexpectedly\n");
+        } else if (until && ev->event_id == until) {
+            return now() - start;
+        }
+    }
+}
+
+static char *read_line(const char *path)
+{
+    static char buf[4096];
+    FILE *f = fopen(path, "rb");
+    if (!f)
+        fail("no timing report written to %s\n", path);
+    if (!fgets(buf, sizeof(buf), f))
+        buf[0] = '\0';
+    fclose(f);
+    buf[strcspn(buf, "\r\n")] = '\0';
+    return buf;
+}
+
+static void run_scenario(const struct scenario *sc, const char *tmp, FILE *out)
+{
+    remove(tmp);
+
+    ctx = mpv_create();
+    if (!ctx)
+        fail("could not create mpv handle\n");
+
+    set_property_string("vo", "null");
+    set_property_string("ao", "null");
+    set_property_string("audio-timing-report", tmp);
+    for (int n = 0; sc->options[n]; n += 2)
+        set_property_string(sc->options[n], sc->options[n + 1]);
+    mpv_request_log_messages(ctx, "warn");
+    if (mpv_initialize(ctx) < 0)
+        fail("could not initialize mpv\n");
+
+    const char *load[] = {"loadfile", TONE_BURSTS, NULL};
+    command(load);
+    if (run_until(10, MPV_EVENT_PLAYBACK_RESTART) < 0)
+        fail("%s: playback did not start\n", sc->name);
+    run_until(0.5, 0);
+
+    const char *seek[] = {"seek", "2", "absolute", NULL};
+    command(seek);
+    double seek_time = run_until(10, MPV_EVENT_PLAYBACK_RESTART);
+    run_until(0.5, 0);
+
+    set_property_string("pause", "yes");
+    run_until(0.3, 0);
+    set_property_string("pause", "no");
+    run_until(0.5, 0);
+
+    mpv_terminate_destroy(ctx);
+    ctx = NULL;
+
+    fprintf(out, "{\"scenario\":\"%s\",\"seek\":%f,\"ao\":%s}\n",
+            sc->name, seek_time, read_line(tmp));
+    printf("%s: %s\n", sc->name, read_line(tmp));
+    remove(tmp);
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc != 2)
+        return 1;
+
+    atexit(exit_cleanup);
+
+    FILE *out = fopen(argv[1], "wb");
+    if (!out)
+        fail("could not open %s\n", argv[1]);
+
+    char tmp[4096];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", argv[1]);
+
+    for (int n = 0; n < sizeof(scenarios) / sizeof(scenarios[0]); n++)
+        run_scenario(&scenarios[n], tmp, out);
+
+    fclose(out);
+    return 0;
+}
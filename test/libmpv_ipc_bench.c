@@ -0,0 +1,233 @@
+/*
+ * This file is part of mpv.
+ *
+ * mpv is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * mpv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// IPC benchmark. Connects to --input-ipc-server twice, once using JSON lines
+// and once using binary frames, and prints the time per get_property request
+// when sending requests one by one, and when sending BATCH requests at once
+// (pipelined lines for JSON, a single batch frame for the binary protocol).
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "libmpv_common.h"
+
+#define ITERATIONS 20000
+#define BATCH 64
+
+struct conn {
+    int fd;
+    unsigned char buf[65536];
+    size_t pos, len;
+};
+
+static void write_all(struct conn *c, const void *data, size_t size)
+{
+    const char *p = data;
+    while (size > 0) {
+        ssize_t r = write(c->fd, p, size);
+        if (r <= 0)
+            fail("write error\n");
+        p += r;
+        size -= r;
+    }
+}
+
+static unsigned char read_byte(struct conn *c)
+{
+    if (c->pos == c->len) {
+        ssize_t r = read(c->fd, c->buf, sizeof(c->buf));
+        if (r <= 0)
+            fail("read error\n");
+        c->pos = 0;
+        c->len = r;
+    }
+    return c->buf[c->pos++];
+}
+
+static void read_line(struct conn *c, char *line, size_t size)
+{
+    size_t n = 0;
+    char ch;
+    while ((ch = read_byte(c)) != '\n') {
+        if (n + 1 < size)
+            line[n++] = ch;
+    }
+    line[n] = '\0';
+}
+
+// Skip a reply frame. JSON lines sent before the protocol switch are skipped.
+static void read_frame(struct conn *c)
+{
+    unsigned char b = read_byte(c);
+    while (b == '{') {
+        while (read_byte(c) != '\n') {}
+        b = read_byte(c);
+    }
+    uint32_t size = b;
+    for (int n = 0; n < 3; n++)
+        size = (size << 8) | read_byte(c);
+    while (size--)
+        read_byte(c);
+}
+
+static void connect_ipc(struct conn *c, const char *path)
+{
+    struct sockaddr_un addr = {.sun_family = AF_UNIX};
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+    // The IPC server is started asynchronously.
+    for (int n = 0; n < 200; n++) {
+        c->fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (c->fd < 0)
+            fail("could not create socket\n");
+        if (connect(c->fd, (struct sockaddr *)&addr, sizeof(addr)) == 0)
+            return;
+        close(c->fd);
+        usleep(10000);
+    }
+    fail("could not connect to %s\n", path);
+}
+
+static const char json_req[] = "{\"command\":[\"get_property\",\"pause\"]}\n";
+
+// {"command": ["get_property", "pause"]}
+static const unsigned char msgpack_req[] =
+    "\x81\xa7" "command" "\x92\xac" "get_property" "\xa5" "pause";
+
+static size_t add_frame_header(unsigned char *dst, uint32_t size)
+{
+    for (int n = 0; n < 4; n++)
+        dst[n] = size >> ((3 - n) * 8);
+    return 4;
+}
+
+static void report(const char *name, int64_t start, int requests)
+{
+    double us = (mpv_get_time_us(ctx) - start) / (double)requests;
+    printf("%-28s %7.2f us/request\n", name, us);
+}
+
+static void bench_json(const char *path)
+{
+    struct conn *c = calloc(1, sizeof(*c));
+    connect_ipc(c, path);
+
+    char line[4096];
+    const char *init = "{\"command\":[\"disable_event\",\"all\"],\"request_id\":1}\n";
+    write_all(c, init, strlen(init));
+    do {
+        read_line(c, line, sizeof(line));
+    } while (!strstr(line, "\"request_id\":1"));
+
+    int64_t start = mpv_get_time_us(ctx);
+    for (int i = 0; i < ITERATIONS; i++) {
+        write_all(c, json_req, sizeof(json_req) - 1);
+        read_line(c, line, sizeof(line));
+    }
+    report("json, one by one:", start, ITERATIONS);
+
+    char batch[BATCH * sizeof(json_req)];
+    size_t batch_size = 0;
+    for (int n = 0; n < BATCH; n++) {
+        memcpy(batch + batch_size, json_req, sizeof(json_req) - 1);
+        batch_size += sizeof(json_req) - 1;
+    }
+    start = mpv_get_time_us(ctx);
+    for (int i = 0; i < ITERATIONS / BATCH; i++) {
+        write_all(c, batch, batch_size);
+        for (int n = 0; n < BATCH; n++)
+            read_line(c, line, sizeof(line));
+    }
+    report("json, pipelined:", start, ITERATIONS / BATCH * BATCH);
+
+    close(c->fd);
+    free(c);
+}
+
+static void bench_binary(const char *path)
+{
+    struct conn *c = calloc(1, sizeof(*c));
+    connect_ipc(c, path);
+
+    // {"command": ["disable_event", "all"]}; also selects the binary protocol.
+    static const unsigned char init[] =
+        "\x81\xa7" "command" "\x92\xad" "disable_event" "\xa3" "all";
+    unsigned char frame[4 + sizeof(init)];
+    size_t size = add_frame_header(frame, sizeof(init) - 1);
+    memcpy(frame + size, init, sizeof(init) - 1);
+    write_all(c, frame, size + sizeof(init) - 1);
+    read_frame(c);
+
+    unsigned char single[4 + sizeof(msgpack_req)];
+    size_t single_size = add_frame_header(single, sizeof(msgpack_req) - 1);
+    memcpy(single + single_size, msgpack_req, sizeof(msgpack_req) - 1);
+    single_size += sizeof(msgpack_req) - 1;
+
+    int64_t start = mpv_get_time_us(ctx);
+    for (int i = 0; i < ITERATIONS; i++) {
+        write_all(c, single, single_size);
+        read_frame(c);
+    }
+    report("binary, one by one:", start, ITERATIONS);
+
+    // Array of BATCH requests in one frame.
+    unsigned char batch[4 + 3 + BATCH * sizeof(msgpack_req)];
+    size_t batch_size = 4;
+    batch[batch_size++] = 0xdc;
+    batch[batch_size++] = BATCH >> 8;
+    batch[batch_size++] = BATCH & 0xFF;
+    for (int n = 0; n < BATCH; n++) {
+        memcpy(batch + batch_size, msgpack_req, sizeof(msgpack_req) - 1);
+        batch_size += sizeof(msgpack_req) - 1;
+    }
+    add_frame_header(batch, batch_size - 4);
+
+    start = mpv_get_time_us(ctx);
+    for (int i = 0; i < ITERATIONS / BATCH; i++) {
+        write_all(c, batch, batch_size);
+        read_frame(c);
+    }
+    report("binary, batched:", start, ITERATIONS / BATCH * BATCH);
+
+    close(c->fd);
+    free(c);
+}
+
+int main(void)
+{
+    atexit(exit_cleanup);
+
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/mpv-ipc-bench-%d", (int)getpid());
+
+    ctx = mpv_create();
+    if (!ctx)
+        fail("could not create mpv handle\n");
+
+    set_property_string("vo", "null");
+    set_property_string("ao", "null");
+    set_property_string("idle", "yes");
+    set_property_string("input-ipc-server", path);
+    if (mpv_initialize(ctx) < 0)
+        fail("could not initialize mpv\n");
+
+    bench_json(path);
+    bench_binary(path);
+
+    unlink(path);
+    return 0;
+}
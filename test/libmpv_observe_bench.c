@@ -0,0 +1,89 @@
+/*
+ * This file is part of mpv.
+ *
+ * mpv is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * mpv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Property change notification benchmark. Creates a number of clients which
+// each observe a number of properties (like scripts do), then repeatedly
+// changes an unrelated property and prints the time per change.
+
+#include "libmpv_common.h"
+
+#define ITERATIONS 20000
+#define MAX_CLIENTS 64
+
+static const int num_clients[] = {0, 8, 32, MAX_CLIENTS};
+static const int num_observed[] = {16, 64};
+
+static void run(mpv_node *names, int clients, int observed)
+{
+    mpv_handle *handles[MAX_CLIENTS];
+    for (int n = 0; n < clients; n++) {
+        handles[n] = mpv_create_client(ctx, NULL);
+        if (!handles[n])
+            fail("could not create client\n");
+        for (int i = 0; i < observed; i++) {
+            mpv_node_list *list = names->u.list;
+            const char *name = list->values[(n + i) % list->num].u.string;
+            mpv_observe_property(handles[n], 0, name, MPV_FORMAT_NONE);
+        }
+    }
+
+    int64_t start = mpv_get_time_us(ctx);
+    for (int i = 0; i < ITERATIONS; i++) {
+        const char *level = i & 1 ? "1" : "2";
+        if (mpv_set_property_string(ctx, "osd-level", level) < 0)
+            fail("could not set property\n");
+    }
+    double us = (mpv_get_time_us(ctx) - start) / (double)ITERATIONS;
+    printf("%3d clients x %3d observed properties: %7.2f us/change\n",
+           clients, observed, us);
+
+    for (int n = 0; n < clients; n++)
+        mpv_destroy(handles[n]);
+}
+
+int main(void)
+{
+    atexit(exit_cleanup);
+
+    ctx = mpv_create();
+    if (!ctx)
+        fail("could not create mpv handle\n");
+
+    set_property_string("vo", "null");
+    set_property_string("ao", "null");
+    set_property_string("idle", "yes");
+    if (mpv_initialize(ctx) < 0)
+        fail("could not initialize mpv\n");
+
+    // Observe properties other than osd-level.
+    mpv_node names;
+    if (mpv_get_property(ctx, "property-list", MPV_FORMAT_NODE, &names) < 0 ||
+        names.format != MPV_FORMAT_NODE_ARRAY)
+        fail("could not get property list\n");
+    for (int n = names.u.list->num - 1; n >= 0; n--) {
+        if (strcmp(names.u.list->values[n].u.string, "osd-level") == 0)
+            names.u.list->values[n] = names.u.list->values[--names.u.list->num];
+    }
+
+    for (int c = 0; c < sizeof(num_clients) / sizeof(num_clients[0]); c++) {
+        for (int o = 0; o < sizeof(num_observed) / sizeof(num_observed[0]); o++)
+            run(&names, num_clients[c], num_observed[o]);
+    }
+
+    mpv_free_node_contents(&names);
+    return 0;
+}
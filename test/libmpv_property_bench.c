@@ -0,0 +1,63 @@
+/*
+ * This file is part of mpv.
+ *
+ * mpv is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * mpv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Property access benchmark. Reads various kinds of properties from the client
+// thread in a loop and prints the throughput for each.
+
+#include "libmpv_common.h"
+
+#define ITERATIONS 200000
+
+static const char *const properties[] = {
+    "volume",                   // manual property near the end of the list
+    "pause",                    // manual property near the start
+    "options/volume",           // option prefix
+    "osd-level",                // option bridge (after all manual properties)
+    "track-list/count",         // sub-property path
+    "playlist/0/filename",      // nested sub-property path
+    "does-not-exist",           // unknown property
+};
+
+int main(void)
+{
+    atexit(exit_cleanup);
+
+    ctx = mpv_create();
+    if (!ctx)
+        fail("could not create mpv handle\n");
+
+    set_property_string("vo", "null");
+    set_property_string("ao", "null");
+    set_property_string("idle", "yes");
+    if (mpv_initialize(ctx) < 0)
+        fail("could not initialize mpv\n");
+
+    const char *load[] = {"loadfile", "av://lavfi:anullsrc", NULL};
+    command(load);
+
+    for (int n = 0; n < sizeof(properties) / sizeof(properties[0]); n++) {
+        int64_t start = mpv_get_time_us(ctx);
+        for (int i = 0; i < ITERATIONS; i++) {
+            char *s = mpv_get_property_string(ctx, properties[n]);
+            mpv_free(s);
+        }
+        double secs = (mpv_get_time_us(ctx) - start) / 1e6;
+        printf("%-24s %10.0f gets/s\n", properties[n], ITERATIONS / secs);
+    }
+
+    return 0;
+}
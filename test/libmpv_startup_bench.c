@@ -0,0 +1,162 @@
+/*
+ * This file is part of mpv.
+ *
+ * mpv is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * mpv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Startup benchmark. Measures the time from mpv_initialize() to the first
+// playback restart with all builtin scripts enabled, with and without
+// --lazy-builtin-scripts. Also reports the distribution of the individual
+// spans of the startup-trace-spans property.
+
+#include "libmpv_common.h"
+
+#define RUNS 10
+#define MAX_SPANS 64
+
+// Durations of the spans with the same name, summed per run. For instant
+// events, the time since player creation is used instead.
+struct span_stats {
+    char name[64];
+    bool instant;
+    double times[RUNS];
+};
+
+static struct span_stats spans[MAX_SPANS];
+static int num_spans;
+
+static struct span_stats *get_span(const char *name, bool instant)
+{
+    for (int n = 0; n < num_spans; n++) {
+        if (strcmp(spans[n].name, name) == 0)
+            return &spans[n];
+    }
+    if (num_spans == MAX_SPANS)
+        return NULL;
+    struct span_stats *s = &spans[num_spans++];
+    *s = (struct span_stats){.instant = instant};
+    snprintf(s->name, sizeof(s->name), "%s", name);
+    return s;
+}
+
+static void add_trace(int run)
+{
+    mpv_node trace;
+    if (mpv_get_property(ctx, "startup-trace-spans", MPV_FORMAT_NODE,
+                         &trace) < 0)
+        fail("could not get startup-trace-spans\n");
+    if (trace.format != MPV_FORMAT_NODE_ARRAY)
+        fail("unexpected startup-trace-spans format\n");
+
+    for (int n = 0; n < trace.u.list->num; n++) {
+        mpv_node_list *entry = trace.u.list->values[n].u.list;
+        const char *name = NULL;
+        double start = 0, duration = -1;
+        for (int i = 0; i < entry->num; i++) {
+            mpv_node *val = &entry->values[i];
+            if (strcmp(entry->keys[i], "name") == 0)
+                name = val->u.string;
+            if (strcmp(entry->keys[i], "start") == 0)
+                start = val->u.double_;
+            if (strcmp(entry->keys[i], "duration") == 0)
+                duration = val->u.double_;
+        }
+        if (!name || duration < 0)
+            continue;
+        struct span_stats *s = get_span(name, duration == 0);
+        if (s)
+            s->times[run] += (s->instant ? start : duration) * 1e3;
+    }
+
+    mpv_free_node_contents(&trace);
+}
+
+static const char *const builtin_scripts[] = {
+    "osc", "ytdl", "load-stats-overlay", "load-console", "load-select",
+    "load-positioning", "load-commands", "load-context-menu",
+};
+
+static double run_once(const char *file, bool lazy, int run)
+{
+    ctx = mpv_create();
+    if (!ctx)
+        fail("could not create mpv handle\n");
+
+    set_property_string("vo", "null");
+    set_property_string("ao", "null");
+    for (int n = 0; n < sizeof(builtin_scripts) / sizeof(builtin_scripts[0]); n++)
+        set_property_string(builtin_scripts[n], "yes");
+    set_property_string("lazy-builtin-scripts", lazy ? "yes" : "no");
+
+    int64_t start = mpv_get_time_ns(ctx);
+    if (mpv_initialize(ctx) < 0)
+        fail("could not initialize mpv\n");
+
+    const char *cmd[] = {"loadfile", file, NULL};
+    command(cmd);
+    while (1) {
+        mpv_event *ev = mpv_wait_event(ctx, 10);
+        if (ev->event_id == MPV_EVENT_PLAYBACK_RESTART)
+            break;
+        if (ev->event_id == MPV_EVENT_NONE || ev->event_id == MPV_EVENT_END_FILE)
+            fail("playback did not start\n");
+    }
+    double res = (mpv_get_time_ns(ctx) - start) / 1e6;
+
+    add_trace(run);
+
+    mpv_terminate_destroy(ctx);
+    ctx = NULL;
+    return res;
+}
+
+static int compare_double(const void *a, const void *b)
+{
+    double da = *(const double *)a, db = *(const double *)b;
+    return da < db ? -1 : da > db;
+}
+
+static void run(const char *file, bool lazy)
+{
+    num_spans = 0;
+
+    double times[RUNS];
+    for (int n = 0; n < RUNS; n++)
+        times[n] = run_once(file, lazy, n);
+    qsort(times, RUNS, sizeof(times[0]), compare_double);
+    printf("lazy-builtin-scripts=%s: median %.2f ms, min %.2f ms\n",
+           lazy ? "yes" : "no", times[RUNS / 2], times[0]);
+
+    printf("  %-32s %9s %9s %9s %9s\n", "span (ms, @ = at)", "min",
+           "median", "p90", "max");
+    for (int n = 0; n < num_spans; n++) {
+        struct span_stats *s = &spans[n];
+        qsort(s->times, RUNS, sizeof(s->times[0]), compare_double);
+        printf("  %s%-31s %9.3f %9.3f %9.3f %9.3f\n", s->instant ? "@" : " ",
+               s->name, s->times[0], s->times[RUNS / 2],
+               s->times[(RUNS - 1) * 9 / 10], s->times[RUNS - 1]);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc != 2)
+        return 1;
+
+    atexit(exit_cleanup);
+
+    run(argv[1], false);
+    run(argv[1], true);
+    return 0;
+}
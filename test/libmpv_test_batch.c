@@ -0,0 +1,115 @@
+/*
+ * This file is part of mpv.
+ *
+ * mpv is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * mpv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "libmpv_common.h"
+
+static void test_command_batch(void)
+{
+    int64_t volume = 42;
+    int64_t volume_res = 0;
+    char *title = NULL;
+    const char *cmd_args[] = {"expand-text", "${volume}"};
+    mpv_node cmd_values[2] = {
+        {.format = MPV_FORMAT_STRING, .u.string = (char *)cmd_args[0]},
+        {.format = MPV_FORMAT_STRING, .u.string = (char *)cmd_args[1]},
+    };
+    mpv_node_list cmd_list = {.num = 2, .values = cmd_values};
+    mpv_node cmd = {.format = MPV_FORMAT_NODE_ARRAY, .u.list = &cmd_list};
+
+    mpv_batch_item items[] = {
+        {.op = MPV_BATCH_SET_PROPERTY, .name = "volume",
+         .format = MPV_FORMAT_INT64, .data = &volume},
+        {.op = MPV_BATCH_GET_PROPERTY, .name = "volume",
+         .format = MPV_FORMAT_INT64, .data = &volume_res},
+        {.op = MPV_BATCH_COMMAND, .args = &cmd},
+        {.op = MPV_BATCH_GET_PROPERTY, .name = "does-not-exist",
+         .format = MPV_FORMAT_STRING, .data = &title},
+    };
+
+    int err = mpv_command_batch(ctx, items, sizeof(items) / sizeof(items[0]));
+    if (err != MPV_ERROR_PROPERTY_NOT_FOUND)
+        fail("batch: expected first error to be returned, got %d\n", err);
+    for (int n = 0; n < 3; n++) {
+        if (items[n].error < 0)
+            fail("batch item %d failed: %s\n", n, mpv_error_string(items[n].error));
+    }
+    if (items[3].error != MPV_ERROR_PROPERTY_NOT_FOUND || title)
+        fail("batch item 3: expected failure\n");
+    if (volume_res != 42)
+        fail("batch: expected volume 42, got %" PRId64 "\n", volume_res);
+    if (items[2].result.format != MPV_FORMAT_STRING ||
+        strcmp(items[2].result.u.string, "42") != 0)
+        fail("batch: unexpected command result\n");
+    mpv_free_node_contents(&items[2].result);
+
+    if (mpv_command_batch(ctx, items, -1) != MPV_ERROR_INVALID_PARAMETER)
+        fail("batch: negative item count accepted\n");
+}
+
+static void test_command_batch_threaded(void)
+{
+    // Runs on a separate thread, so it would finish after the batch.
+    mpv_node cmd_value = {.format = MPV_FORMAT_STRING,
+                          .u.string = (char *)"rescan-external-files"};
+    mpv_node_list cmd_list = {.num = 1, .values = &cmd_value};
+    mpv_node cmd = {.format = MPV_FORMAT_NODE_ARRAY, .u.list = &cmd_list};
+    int64_t volume = 43;
+    int64_t volume_res = 0;
+
+    mpv_batch_item items[] = {
+        {.op = MPV_BATCH_SET_PROPERTY, .name = "volume",
+         .format = MPV_FORMAT_INT64, .data = &volume},
+        {.op = MPV_BATCH_COMMAND, .args = &cmd},
+        {.op = MPV_BATCH_GET_PROPERTY, .name = "volume",
+         .format = MPV_FORMAT_INT64, .data = &volume_res},
+    };
+
+    int err = mpv_command_batch(ctx, items, sizeof(items) / sizeof(items[0]));
+    if (err != MPV_ERROR_INVALID_PARAMETER)
+        fail("batch: threaded command accepted, got %d\n", err);
+    if (items[1].error != MPV_ERROR_INVALID_PARAMETER ||
+        items[1].result.format != MPV_FORMAT_NONE)
+        fail("batch: expected threaded command to be rejected\n");
+    if (items[0].error < 0 || items[2].error < 0 || volume_res != 43)
+        fail("batch: other items were not run\n");
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc != 1)
+        return 1;
+
+    ctx = mpv_create();
+    if (!ctx)
+        return 1;
+
+    atexit(exit_cleanup);
+
+    initialize();
+
+    const char *fmt = "================ TEST: %s ================\n";
+    printf(fmt, "test_command_batch");
+    test_command_batch();
+    printf(fmt, "test_command_batch_threaded");
+    test_command_batch_threaded();
+    printf("================ SHUTDOWN ================\n");
+
+    command_string("quit");
+    while (wrap_wait_event()->event_id != MPV_EVENT_SHUTDOWN) {}
+
+    return 0;
+}
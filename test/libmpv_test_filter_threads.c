@@ -0,0 +1,148 @@
+/*
+ * This file is part of mpv.
+ *
+ * mpv is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * mpv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Encode a file twice to the framecrc muxer: once with a plain video filter
+// chain, and once with the same filters split over two threads with "thread"
+// entries. The file is looped once, which seeks back to the start and resets
+// the filter chain. Both runs must output the same frames in the same order,
+// so frames are neither reordered between the stages nor left over from
+// before the reset.
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "libmpv_common.h"
+
+#define MAX_FRAMES 1000
+
+struct output {
+    double pts[MAX_FRAMES];
+    char crc[MAX_FRAMES][16];
+    int num_frames;
+};
+
+static char out_path[] = "./testout.XXXXXX";
+
+static void cleanup(void)
+{
+    exit_cleanup();
+    unlink(out_path);
+}
+
+static void read_output(struct output *out)
+{
+    FILE *fp = fopen(out_path, "r");
+    if (!fp)
+        fail("output file doesn't exist\n");
+
+    char line[256];
+    while (fgets(line, sizeof(line), fp)) {
+        if (line[0] == '#')
+            continue;
+        // stream_index, dts, pts, duration, size, crc
+        long long dts, pts, duration, size;
+        int index;
+        char crc[16];
+        if (sscanf(line, "%d, %lld, %lld, %lld, %lld, %15s", &index, &dts,
+                   &pts, &duration, &size, crc) != 6)
+            fail("unexpected line in output: %s", line);
+        if (out->num_frames == MAX_FRAMES)
+            fail("too many frames\n");
+        out->pts[out->num_frames] = pts;
+        snprintf(out->crc[out->num_frames], sizeof(out->crc[0]), "%s", crc);
+        out->num_frames++;
+    }
+    fclose(fp);
+}
+
+static void encode(const char *path, const char *vf, struct output *out)
+{
+    ctx = mpv_create();
+    if (!ctx)
+        fail("could not create mpv handle\n");
+
+    set_property_string("o", out_path);
+    set_property_string("of", "framecrc");
+    set_property_string("ovc", "rawvideo");
+    set_property_string("loop-file", "1");
+    set_property_string("vf", vf);
+    // Small queues, so that the stages have to wait for each other.
+    set_property_string("vf-queue-max-samples", "2");
+    if (mpv_initialize(ctx) < 0)
+        fail("could not initialize mpv\n");
+    set_property_string("idle", "once");
+
+    const char *cmd[] = {"loadfile", path, NULL};
+    command(cmd);
+    while (1) {
+        mpv_event *ev = mpv_wait_event(ctx, -1);
+        if (ev->event_id == MPV_EVENT_SHUTDOWN)
+            break;
+    }
+    mpv_terminate_destroy(ctx);
+    ctx = NULL;
+
+    read_output(out);
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+        return 1;
+
+#ifdef _WIN32
+    if (!_mktemp(out_path))
+        fail("tmpfile failed\n");
+#else
+    int fd = mkstemp(out_path);
+    if (fd == -1)
+        fail("tmpfile failed\n");
+    close(fd);
+#endif
+    atexit(cleanup);
+
+    struct output *plain = calloc(1, sizeof(*plain));
+    struct output *threads = calloc(1, sizeof(*threads));
+    if (!plain || !threads)
+        fail("out of memory\n");
+
+    encode(argv[1], "format=yuv420p,format=yuv420p", plain);
+    encode(argv[1], "thread,format=yuv420p,thread,format=yuv420p", threads);
+
+    printf("%d frames without threads, %d frames with 2 threads\n",
+           plain->num_frames, threads->num_frames);
+
+    if (plain->num_frames < 2)
+        fail("nothing was encoded\n");
+    if (threads->num_frames != plain->num_frames)
+        fail("expected %d frames but got %d\n", plain->num_frames,
+             threads->num_frames);
+    for (int n = 0; n < threads->num_frames; n++) {
+        if (n && threads->pts[n] <= threads->pts[n - 1])
+            fail("frame %d is out of order\n", n);
+        if (strcmp(threads->crc[n], plain->crc[n]) != 0)
+            fail("frame %d differs: expected %s but got %s\n", n,
+                 plain->crc[n], threads->crc[n]);
+    }
+
+    free(plain);
+    free(threads);
+    return 0;
+}
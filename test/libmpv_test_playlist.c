@@ -0,0 +1,115 @@
+/*
+ * This file is part of mpv.
+ *
+ * mpv is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * mpv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "libmpv_common.h"
+
+static void check_change(mpv_playlist_change_type type, int64_t index,
+                         int64_t count, int64_t to_index, int64_t id)
+{
+    mpv_event *event;
+    do {
+        event = wrap_wait_event();
+    } while (event->event_id != MPV_EVENT_PLAYLIST_CHANGE);
+
+    mpv_event_playlist_change *pc = event->data;
+    if (pc->type != type || pc->index != index || pc->count != count ||
+        pc->to_index != to_index || pc->playlist_entry_id != id)
+    {
+        fail("playlist change: expected %d/%" PRId64 "/%" PRId64 "/%" PRId64
+             "/%" PRId64 " but got %d/%" PRId64 "/%" PRId64 "/%" PRId64
+             "/%" PRId64 "!\n", type, index, count, to_index, id, pc->type,
+             pc->index, pc->count, pc->to_index, pc->playlist_entry_id);
+    }
+}
+
+static void check_range(const char *property, const char *const *expect,
+                        int num)
+{
+    mpv_node res;
+    get_property(property, MPV_FORMAT_NODE, &res);
+    if (res.format != MPV_FORMAT_NODE_ARRAY || res.u.list->num != num)
+        fail("%s: expected %d entries!\n", property, num);
+    for (int n = 0; n < num; n++) {
+        mpv_node *entry = &res.u.list->values[n];
+        const char *filename = NULL;
+        for (int i = 0; entry->format == MPV_FORMAT_NODE_MAP &&
+                        i < entry->u.list->num; i++)
+        {
+            if (strcmp(entry->u.list->keys[i], "filename") == 0)
+                filename = entry->u.list->values[i].u.string;
+        }
+        if (!filename || strcmp(filename, expect[n]) != 0)
+            fail("%s: expected '%s' at %d but got '%s'!\n", property,
+                 expect[n], n, filename ? filename : "(none)");
+    }
+    mpv_free_node_contents(&res);
+}
+
+static void test_playlist_changes(void)
+{
+    if (mpv_request_event(ctx, MPV_EVENT_PLAYLIST_CHANGE, 1) < 0)
+        fail("could not enable playlist-change event\n");
+
+    command_string("loadfile a append");
+    check_change(MPV_PLAYLIST_CHANGE_INSERT, 0, 1, -1, 1);
+    command_string("loadfile b append");
+    check_change(MPV_PLAYLIST_CHANGE_INSERT, 1, 1, -1, 2);
+    command_string("loadfile c append");
+    check_change(MPV_PLAYLIST_CHANGE_INSERT, 2, 1, -1, 3);
+
+    command_string("playlist-move 2 0");
+    check_change(MPV_PLAYLIST_CHANGE_MOVE, 2, 0, 0, 3);
+    command_string("playlist-move 0 2");
+    check_change(MPV_PLAYLIST_CHANGE_MOVE, 0, 0, 1, 3);
+
+    check_range("playlist/range/0/10", (const char *[]){"a", "c", "b"}, 3);
+    check_range("playlist/range/1/1", (const char *[]){"c"}, 1);
+    check_range("playlist/range/5/1", NULL, 0);
+
+    command_string("playlist-remove 1");
+    check_change(MPV_PLAYLIST_CHANGE_REMOVE, 1, 1, -1, 0);
+    check_int("playlist-count", 2);
+
+    // Removes all entries in a single change.
+    command_string("playlist-clear");
+    check_change(MPV_PLAYLIST_CHANGE_REMOVE, 0, 2, -1, 0);
+    check_int("playlist-count", 0);
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc != 1)
+        return 1;
+
+    ctx = mpv_create();
+    if (!ctx)
+        return 1;
+
+    atexit(exit_cleanup);
+
+    initialize();
+
+    const char *fmt = "================ TEST: %s ================\n";
+    printf(fmt, "test_playlist_changes");
+    test_playlist_changes();
+    printf("================ SHUTDOWN ================\n");
+
+    command_string("quit");
+    while (wrap_wait_event()->event_id != MPV_EVENT_SHUTDOWN) {}
+
+    return 0;
+}
@@ -0,0 +1,125 @@
+/*
+ * This file is part of mpv.
+ *
+ * mpv is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * mpv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Play a file backward with serial and with parallel backward decoding
+// (--video-reversal-threads), and check that the same frames are output in
+// the same order. The frame timestamps are taken from the showinfo filter.
+// Also prints how long each run took.
+
+#include "libmpv_common.h"
+
+#define MAX_FRAMES 10000
+
+struct run {
+    const char *threads;
+    double pts[MAX_FRAMES];
+    int num_pts;
+    double time;
+};
+
+static void add_frame(struct run *r, const char *text)
+{
+    const char *s = strstr(text, "pts_time:");
+    if (!s)
+        return;
+    if (r->num_pts == MAX_FRAMES)
+        fail("too many frames\n");
+    r->pts[r->num_pts++] = strtod(s + 9, NULL);
+}
+
+static void play_backward(struct run *r, const char *path)
+{
+    ctx = mpv_create();
+    if (!ctx)
+        fail("mpv_create failed\n");
+
+    set_property_string("vo", "null");
+    set_property_string("ao", "null");
+    set_property_string("untimed", "yes");
+    set_property_string("play-direction", "backward");
+    set_property_string("video-reversal-threads", r->threads);
+    set_property_string("vf", "lavfi=[showinfo]");
+    int ret = mpv_request_log_messages(ctx, "v");
+    if (ret < 0)
+        fail("mpv API error while setting log level: %s\n", mpv_error_string(ret));
+    ret = mpv_initialize(ctx);
+    if (ret < 0)
+        fail("mpv API error while initializing mpv: %s\n", mpv_error_string(ret));
+
+    int64_t start = mpv_get_time_us(ctx);
+    const char *cmd[] = {"loadfile", path, NULL};
+    command(cmd);
+
+    while (1) {
+        mpv_event *ev = mpv_wait_event(ctx, -1);
+        if (ev->event_id == MPV_EVENT_LOG_MESSAGE) {
+            mpv_event_log_message *msg = ev->data;
+            if (msg->log_level <= MPV_LOG_LEVEL_ERROR)
+                fail("[%s] %s", msg->prefix, msg->text);
+            if (strcmp(msg->prefix, "ffmpeg") == 0)
+                add_frame(r, msg->text);
+        } else if (ev->event_id == MPV_EVENT_END_FILE) {
+            mpv_event_end_file *end = ev->data;
+            if (end->reason != MPV_END_FILE_REASON_EOF)
+                fail("playback did not end normally\n");
+            break;
+        }
+    }
+
+    r->time = (mpv_get_time_us(ctx) - start) / 1e6;
+    mpv_terminate_destroy(ctx);
+    ctx = NULL;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+        return 1;
+
+    struct run *serial = calloc(1, sizeof(*serial));
+    struct run *parallel = calloc(1, sizeof(*parallel));
+    if (!serial || !parallel)
+        fail("out of memory\n");
+    serial->threads = "no";
+    parallel->threads = "4";
+
+    play_backward(serial, argv[1]);
+    play_backward(parallel, argv[1]);
+
+    printf("serial: %d frames in %.3fs, 4 threads: %d frames in %.3fs\n",
+           serial->num_pts, serial->time, parallel->num_pts, parallel->time);
+
+    if (serial->num_pts < 2)
+        fail("no frames were decoded\n");
+    for (int n = 1; n < serial->num_pts; n++) {
+        if (serial->pts[n] >= serial->pts[n - 1])
+            fail("frame %d is not in backward order\n", n);
+    }
+    if (parallel->num_pts != serial->num_pts)
+        fail("expected %d frames but got %d\n", serial->num_pts,
+             parallel->num_pts);
+    for (int n = 0; n < serial->num_pts; n++) {
+        if (parallel->pts[n] != serial->pts[n]) {
+            fail("frame %d: expected pts %f but got %f\n", n, serial->pts[n],
+                 parallel->pts[n]);
+        }
+    }
+
+    free(serial);
+    free(parallel);
+    return 0;
+}
@@ -0,0 +1,102 @@
+#include <mpv/client.h>
+
+#include "misc/bstr.h"
+#include "misc/msgpack.h"
+#include "misc/node.h"
+#include "test_utils.h"
+
+struct entry {
+    const char *src;
+    int src_len;
+    struct mpv_node out_data;
+    bool expect_fail;
+    bool not_canonical; // re-encoding yields different bytes
+};
+
+#define DATA(s) s, sizeof(s) - 1
+
+#define VAL_LIST(...) (struct mpv_node[]){__VA_ARGS__}
+
+#define L(...) __VA_ARGS__
+
+#define NODE_INT64(v) {.format = MPV_FORMAT_INT64,  .u = { .int64 = (v) }}
+#define NODE_STR(v)   {.format = MPV_FORMAT_STRING, .u = { .string = (v) }}
+#define NODE_BOOL(v)  {.format = MPV_FORMAT_FLAG,   .u = { .flag = (bool)(v) }}
+#define NODE_FLOAT(v) {.format = MPV_FORMAT_DOUBLE, .u = { .double_ = (v) }}
+#define NODE_NONE()   {.format = MPV_FORMAT_NONE }
+#define NODE_ARRAY(...) {.format = MPV_FORMAT_NODE_ARRAY, .u = { .list =    \
+    &(struct mpv_node_list) {                                               \
+        .num = sizeof(VAL_LIST(__VA_ARGS__)) / sizeof(struct mpv_node),     \
+        .values = VAL_LIST(__VA_ARGS__)}}}
+#define NODE_MAP(k, v) {.format = MPV_FORMAT_NODE_MAP, .u = { .list =       \
+    &(struct mpv_node_list) {                                               \
+        .num = sizeof(VAL_LIST(v)) / sizeof(struct mpv_node),               \
+        .values = VAL_LIST(v),                                              \
+        .keys = (char**)(const char *[]){k}}}}
+
+static const struct entry entries[] = {
+    { DATA("\xc0"), NODE_NONE()},
+    { DATA("\xc3"), NODE_BOOL(true)},
+    { DATA("\xc2"), NODE_BOOL(false)},
+    { DATA(""), .expect_fail = true},
+    { DATA("\xc1"), .expect_fail = true},
+    { DATA("\x7f"), NODE_INT64(127)},
+    { DATA("\xe0"), NODE_INT64(-32)},
+    { DATA("\xd0\xdf"), NODE_INT64(-33)},
+    { DATA("\xd1\x01\x00"), NODE_INT64(256)},
+    { DATA("\xd2\xff\xfe\xff\xff"), NODE_INT64(-65537)},
+    { DATA("\xd3\x7f\xff\xff\xff\xff\xff\xff\xff"), NODE_INT64(INT64_MAX)},
+    { DATA("\xcc\x80"), NODE_INT64(128), .not_canonical = true},
+    { DATA("\xcf\x80\x00\x00\x00\x00\x00\x00\x00"), .expect_fail = true},
+    { DATA("\xcb\x40\x5e\xd0\x00\x00\x00\x00\x00"), NODE_FLOAT(123.25)},
+    { DATA("\xca\x42\xf6\x80\x00"), NODE_FLOAT(123.25), .not_canonical = true},
+    { DATA("\xa3" "abc"), NODE_STR("abc")},
+    { DATA("\xd9\x03" "abc"), NODE_STR("abc"), .not_canonical = true},
+    { DATA("\xa4" "abc"), .expect_fail = true},
+    { DATA("\x93\x01\x02\x03"),
+        NODE_ARRAY(NODE_INT64(1), NODE_INT64(2), NODE_INT64(3))},
+    { DATA("\x93\x01\x02"), .expect_fail = true},
+    { DATA("\xdc\xff\xff\x01"), .expect_fail = true},
+    { DATA("\x82\xa1" "a" "\x01\xa1" "b" "\x91\xc0"),
+        NODE_MAP(L("a", "b"), L(NODE_INT64(1), NODE_ARRAY(NODE_NONE())))},
+    { DATA("\x81\x01\x01"), .expect_fail = true},
+    { DATA("\xd4\x01\x00"), .expect_fail = true},
+};
+
+int main(void)
+{
+    for (int n = 0; n < MP_ARRAY_SIZE(entries); n++) {
+        const struct entry *e = &entries[n];
+        void *tmp = talloc_new(NULL);
+        bstr src = {(unsigned char *)e->src, e->src_len};
+        struct mpv_node res;
+        bool ok = msgpack_parse(tmp, &res, &src, MAX_MSGPACK_DEPTH) >= 0;
+        assert_true(ok != e->expect_fail);
+        if (!ok) {
+            talloc_free(tmp);
+            continue;
+        }
+        assert_int_equal(src.len, 0);
+        assert_true(equal_mpv_node(&e->out_data, &res));
+        bstr d = {0};
+        assert_true(msgpack_append(&d, &res) >= 0);
+        talloc_steal(tmp, d.start);
+        if (!e->not_canonical) {
+            assert_int_equal(d.len, e->src_len);
+            assert_memcmp(d.start, e->src, d.len);
+        }
+        talloc_free(tmp);
+    }
+
+    // Nesting deeper than the limit.
+    char deep[MAX_MSGPACK_DEPTH + 1];
+    memset(deep, 0x91, sizeof(deep) - 1);
+    deep[sizeof(deep) - 1] = '\xc0';
+    void *tmp = talloc_new(NULL);
+    bstr src = {(unsigned char *)deep, sizeof(deep)};
+    struct mpv_node res;
+    assert_true(msgpack_parse(tmp, &res, &src, MAX_MSGPACK_DEPTH) < 0);
+    talloc_free(tmp);
+
+    return 0;
+}
@@ -0,0 +1,164 @@
+#include <stdatomic.h>
+
+#include "misc/record_ring.h"
+#include "mpv_talloc.h"
+#include "osdep/threads.h"
+#include "test_utils.h"
+
+#define RING_SIZE 4096
+#define NUM_PRODUCERS 4
+#define NUM_RECORDS 200000
+
+struct record {
+    int producer;
+    int seq;
+    int len;
+    // followed by len bytes, each set to (seq & 0xFF)
+};
+
+struct state {
+    struct mp_record_ring *ring;
+    atomic_int producers_done;
+    // Per producer, written by the producer and read after joining.
+    int pushed[NUM_PRODUCERS];
+    // Consumer side.
+    int next_seq[NUM_PRODUCERS];
+    int received[NUM_PRODUCERS];
+    uint64_t dropped;
+};
+
+struct producer {
+    struct state *s;
+    int id;
+};
+
+// Some variation in record size, so that padding at the end of the ring is
+// exercised, but small enough that the ring fits many records.
+static int payload_len(int seq)
+{
+    return (seq * 7) % 53;
+}
+
+static bool push(struct mp_record_ring *ring, int producer, int seq)
+{
+    int len = payload_len(seq);
+    struct record *rec = mp_record_ring_reserve(ring, sizeof(*rec) + len);
+    if (!rec)
+        return false;
+    assert_int_equal((uintptr_t)rec % 8, 0);
+    for (int n = 0; n < sizeof(*rec) + len; n++)
+        assert_int_equal(((unsigned char *)rec)[n], 0);
+    *rec = (struct record){producer, seq, len};
+    memset(rec + 1, seq & 0xFF, len);
+    mp_record_ring_commit(ring, rec);
+    return true;
+}
+
+static void check_record(void *ctx, void *record)
+{
+    struct state *s = ctx;
+    struct record *rec = record;
+    assert_true(rec->producer >= 0 && rec->producer < NUM_PRODUCERS);
+    // Records of a producer arrive in order; dropped ones leave gaps.
+    assert_true(rec->seq >= s->next_seq[rec->producer]);
+    s->next_seq[rec->producer] = rec->seq + 1;
+    s->received[rec->producer]++;
+    assert_int_equal(rec->len, payload_len(rec->seq));
+    unsigned char *data = (unsigned char *)(rec + 1);
+    for (int n = 0; n < rec->len; n++)
+        assert_int_equal(data[n], rec->seq & 0xFF);
+}
+
+static MP_THREAD_VOID producer_thread(void *arg)
+{
+    struct producer *p = arg;
+    struct state *s = p->s;
+    for (int seq = 0; seq < NUM_RECORDS; seq++)
+        s->pushed[p->id] += push(s->ring, p->id, seq);
+    atomic_fetch_add(&s->producers_done, 1);
+    MP_THREAD_RETURN();
+}
+
+static void test_concurrent(void)
+{
+    struct state s = {
+        .ring = mp_record_ring_create(NULL, RING_SIZE),
+    };
+
+    mp_thread threads[NUM_PRODUCERS];
+    struct producer producers[NUM_PRODUCERS];
+    for (int n = 0; n < NUM_PRODUCERS; n++) {
+        producers[n] = (struct producer){&s, n};
+        assert_false(mp_thread_create(&threads[n], producer_thread,
+                                      &producers[n]));
+    }
+
+    while (atomic_load(&s.producers_done) < NUM_PRODUCERS) {
+        mp_record_ring_drain(s.ring, check_record, &s);
+        s.dropped += mp_record_ring_take_dropped(s.ring);
+    }
+    for (int n = 0; n < NUM_PRODUCERS; n++)
+        mp_thread_join(threads[n]);
+    mp_record_ring_drain(s.ring, check_record, &s);
+    s.dropped += mp_record_ring_take_dropped(s.ring);
+
+    uint64_t received = 0;
+    for (int n = 0; n < NUM_PRODUCERS; n++) {
+        assert_int_equal(s.received[n], s.pushed[n]);
+        received += s.received[n];
+    }
+    assert_int_equal(received + s.dropped, NUM_PRODUCERS * NUM_RECORDS);
+    printf("%"PRIu64" records received, %"PRIu64" dropped\n", received,
+           s.dropped);
+
+    talloc_free(s.ring);
+}
+
+static void test_overflow(void)
+{
+    struct state s = {
+        .ring = mp_record_ring_create(NULL, RING_SIZE),
+    };
+
+    // Fill the ring without consuming; everything after that is dropped.
+    int pushed = 0;
+    while (push(s.ring, 0, pushed))
+        pushed++;
+    assert_true(pushed > 0);
+    for (int n = 0; n < 10; n++)
+        assert_false(push(s.ring, 0, pushed + n));
+    assert_int_equal(mp_record_ring_take_dropped(s.ring), 11);
+    assert_int_equal(mp_record_ring_take_dropped(s.ring), 0);
+
+    mp_record_ring_drain(s.ring, check_record, &s);
+    assert_int_equal(s.received[0], pushed);
+
+    // The ring is usable again after draining, across many wrap-arounds.
+    int seq = pushed + 10;
+    for (int round = 0; round < 1000; round++) {
+        for (int n = 0; n < 7; n++)
+            assert_true(push(s.ring, 0, seq++));
+        mp_record_ring_drain(s.ring, check_record, &s);
+    }
+    assert_int_equal(s.received[0], pushed + 7000);
+    assert_int_equal(mp_record_ring_take_dropped(s.ring), 0);
+
+    // A record that was reserved but not committed holds back later ones.
+    struct record *a = mp_record_ring_reserve(s.ring, sizeof(*a));
+    assert_true(push(s.ring, 1, 1));
+    mp_record_ring_drain(s.ring, check_record, &s);
+    assert_int_equal(s.received[1], 0);
+    *a = (struct record){1, 0, payload_len(0)};
+    mp_record_ring_commit(s.ring, a);
+    mp_record_ring_drain(s.ring, check_record, &s);
+    assert_int_equal(s.received[1], 2);
+
+    talloc_free(s.ring);
+}
+
+int main(void)
+{
+    test_overflow();
+    test_concurrent();
+    return 0;
+}
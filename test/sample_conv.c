@@ -0,0 +1,186 @@
+#include "audio/chmap.h"
+#include "audio/format.h"
+#include "audio/sample_conv.h"
+#include "misc/random.h"
+#include "osdep/endian.h"
+#include "test_utils.h"
+
+#define MAX_SAMPLES 1500
+
+static mp_rand_state rng;
+
+// Scalar reference, as done by libswresample.
+static double ref_read(const uint8_t *p, int fmt)
+{
+    switch (af_fmt_from_planar(fmt)) {
+    case AF_FORMAT_U8:      return *p;
+    case AF_FORMAT_S16:     return *(int16_t *)p;
+    case AF_FORMAT_S32:     return *(int32_t *)p;
+    case AF_FORMAT_S64:     return *(int64_t *)p;
+    case AF_FORMAT_FLOAT:   return *(float *)p;
+    case AF_FORMAT_DOUBLE:  return *(double *)p;
+    }
+    abort();
+}
+
+static void ref_convert(uint8_t *dst, int dst_fmt, const uint8_t *src,
+                        int src_fmt)
+{
+    int d = af_fmt_from_planar(dst_fmt), s = af_fmt_from_planar(src_fmt);
+    if (d == s) {
+        memcpy(dst, src, af_fmt_to_bytes(d));
+    } else if (s == AF_FORMAT_S16 && d == AF_FORMAT_S32) {
+        *(int32_t *)dst = *(int16_t *)src * (1 << 16);
+    } else if (s == AF_FORMAT_S16 && d == AF_FORMAT_FLOAT) {
+        *(float *)dst = *(int16_t *)src * (1.0f / (1 << 15));
+    } else if (s == AF_FORMAT_S32 && d == AF_FORMAT_S16) {
+        *(int16_t *)dst = *(int32_t *)src >> 16;
+    } else if (s == AF_FORMAT_S32 && d == AF_FORMAT_FLOAT) {
+        *(float *)dst = *(int32_t *)src * (1.0f / (1U << 31));
+    } else if (s == AF_FORMAT_FLOAT && d == AF_FORMAT_S16) {
+        long v = lrintf(*(float *)src * (1 << 15));
+        *(int16_t *)dst = MPCLAMP(v, INT16_MIN, INT16_MAX);
+    } else if (s == AF_FORMAT_FLOAT && d == AF_FORMAT_S32) {
+        long long v = llrintf(*(float *)src * (1U << 31));
+        *(int32_t *)dst = MPCLAMP(v, INT32_MIN, INT32_MAX);
+    } else {
+        abort();
+    }
+}
+
+static void fill_random(uint8_t *p, int fmt, int num)
+{
+    int bytes = af_fmt_to_bytes(fmt);
+    for (int n = 0; n < num; n++) {
+        uint8_t *s = p + n * bytes;
+        if (af_fmt_from_planar(fmt) == AF_FORMAT_FLOAT) {
+            // Include out of range values and exact halves for rounding.
+            double v = mp_rand_next_double(&rng) * 2.4 - 1.2;
+            if (n % 7 == 0)
+                v = (mp_rand_in_range32(&rng, 0, 65536) - 32768 + 0.5) / 32768;
+            *(float *)s = v;
+        } else {
+            uint64_t v = mp_rand_next(&rng);
+            memcpy(s, &v, bytes);
+        }
+    }
+}
+
+static void test_convert(int dst_fmt, int src_fmt, int channels, int samples,
+                         const int *reorder)
+{
+    int dst_bytes = af_fmt_to_bytes(dst_fmt);
+    int src_bytes = af_fmt_to_bytes(src_fmt);
+    bool dst_planar = af_fmt_is_planar(dst_fmt);
+    bool src_planar = af_fmt_is_planar(src_fmt);
+
+    uint8_t *src_buf = talloc_size(NULL, channels * samples * src_bytes);
+    uint8_t *dst_buf = talloc_size(NULL, channels * samples * dst_bytes);
+    uint8_t *ref_buf = talloc_size(NULL, channels * samples * dst_bytes);
+    fill_random(src_buf, src_fmt, channels * samples);
+    memset(dst_buf, 0x55, channels * samples * dst_bytes);
+
+    uint8_t *src[MP_NUM_CHANNELS], *dst[MP_NUM_CHANNELS];
+    for (int c = 0; c < channels; c++) {
+        src[c] = src_buf + (src_planar ? c * samples * src_bytes : 0);
+        dst[c] = dst_buf + (dst_planar ? c * samples * dst_bytes : 0);
+    }
+
+    for (int c = 0; c < channels; c++) {
+        int s = reorder ? reorder[c] : c;
+        for (int n = 0; n < samples; n++) {
+            uint8_t *d = ref_buf + (dst_planar ? c * samples + n
+                                               : n * channels + c) * dst_bytes;
+            if (s < 0) {
+                af_fill_silence(d, dst_bytes, dst_fmt);
+                continue;
+            }
+            uint8_t *p = src_buf + (src_planar ? s * samples + n
+                                               : n * channels + s) * src_bytes;
+            ref_convert(d, dst_fmt, p, src_fmt);
+        }
+    }
+
+    assert_true(mp_sconv_can_convert(dst_fmt, src_fmt));
+    mp_sconv_convert(dst, dst_fmt, src, src_fmt, reorder, channels, samples);
+
+    for (int c = 0; c < channels; c++) {
+        for (int n = 0; n < samples; n++) {
+            size_t off = (dst_planar ? c * samples + n
+                                     : n * channels + c) * dst_bytes;
+            if (memcmp(dst_buf + off, ref_buf + off, dst_bytes)) {
+                printf("%s -> %s, %d channels, channel %d sample %d: "
+                       "%f != %f\n", af_fmt_to_str(src_fmt),
+                       af_fmt_to_str(dst_fmt), channels, c, n,
+                       ref_read(dst_buf + off, dst_fmt),
+                       ref_read(ref_buf + off, dst_fmt));
+                exit(1);
+            }
+        }
+    }
+
+    talloc_free(src_buf);
+    talloc_free(dst_buf);
+    talloc_free(ref_buf);
+}
+
+static const int formats[] = {
+    AF_FORMAT_U8, AF_FORMAT_S16, AF_FORMAT_S32, AF_FORMAT_S64,
+    AF_FORMAT_FLOAT, AF_FORMAT_DOUBLE,
+};
+
+// Formats that can be converted to each other (and not just copied).
+static bool is_convertible(int fmt)
+{
+    return fmt == AF_FORMAT_S16 || fmt == AF_FORMAT_S32 ||
+           fmt == AF_FORMAT_FLOAT;
+}
+
+int main(void)
+{
+    rng = mp_rand_seed(1);
+
+    for (int a = 0; a < MP_ARRAY_SIZE(formats); a++) {
+        for (int b = 0; b < MP_ARRAY_SIZE(formats); b++) {
+            int src_fmt = formats[a], dst_fmt = formats[b];
+            bool supported = src_fmt == dst_fmt ||
+                (is_convertible(src_fmt) && is_convertible(dst_fmt));
+            assert_int_equal(mp_sconv_can_convert(dst_fmt, src_fmt), supported);
+            if (!supported)
+                continue;
+            for (int p = 0; p < 4; p++) {
+                int s = p & 1 ? af_fmt_to_planar(src_fmt) : src_fmt;
+                int d = p & 2 ? af_fmt_to_planar(dst_fmt) : dst_fmt;
+                for (int ch = 1; ch <= 8; ch++)
+                    test_convert(d, s, ch, MAX_SAMPLES - ch, NULL);
+            }
+        }
+    }
+
+    // Reordering, with unmapped (silent) channels.
+    const int reorder[] = {2, 0, 1, -1, 5, 4, -1, 3};
+    test_convert(AF_FORMAT_S16, AF_FORMAT_FLOATP, 8, 1000, reorder);
+    test_convert(AF_FORMAT_FLOATP, AF_FORMAT_FLOAT, 8, 1000, reorder);
+    test_convert(AF_FORMAT_S32, AF_FORMAT_S32, 8, 1000, reorder);
+    test_convert(AF_FORMAT_U8, AF_FORMAT_U8P, 8, 1000, reorder);
+
+    // 24 bit packing.
+    int32_t s24[] = {0x12345678, -0x12345678, INT32_MAX, INT32_MIN};
+    uint8_t packed[4][4];
+    for (int n = 0; n < 4; n++) {
+        uint32_t v = s24[n];
+        for (int b = 0; b < 3; b++)
+            packed[n][BYTE_ORDER == BIG_ENDIAN ? 2 - b : b] = v >> ((b + 1) * 8);
+        packed[n][3] = 0;
+    }
+    int32_t buf[4];
+    memcpy(buf, s24, sizeof(buf));
+    mp_sconv_pack_s24(buf, 4, true);
+    assert_memcmp(buf, packed, sizeof(packed));
+    memcpy(buf, s24, sizeof(buf));
+    mp_sconv_pack_s24(buf, 4, false);
+    for (int n = 0; n < 4; n++)
+        assert_memcmp((uint8_t *)buf + n * 3, packed[n], 3);
+
+    return 0;
+}
@@ -0,0 +1,124 @@
+#include <string.h>
+
+#include "audio/filter/af_scaletempo2_internals.h"
+#include "misc/random.h"
+#include "osdep/timer.h"
+#include "test_utils.h"
+
+#define CHANNELS 16
+#define RATE 48000
+#define FRAMES (RATE * 2)
+#define CHUNK 1024
+
+// Time-stretch the input with the given number of threads and return the
+// interleaved output.
+static float *run(void *ta_ctx, float **input, int threads, int *out_frames)
+{
+    struct mp_scaletempo2_opts opts = {
+        .min_playback_rate = 0.25,
+        .max_playback_rate = 8.0,
+        .ola_window_size_ms = 12,
+        .wsola_search_interval_ms = 40,
+        .threads = threads,
+    };
+    struct mp_scaletempo2 *p = talloc_zero(ta_ctx, struct mp_scaletempo2);
+    p->opts = &opts;
+    mp_scaletempo2_init(p, CHANNELS, RATE);
+    assert_int_equal(p->num_channel_groups, threads);
+
+    double speed = 1.5;
+    float *out = NULL;
+    int num_out = 0;
+    float *planes[CHANNELS];
+    float *dest[CHANNELS];
+    float *buf = talloc_array(ta_ctx, float, CHANNELS * CHUNK);
+    for (int c = 0; c < CHANNELS; c++)
+        dest[c] = buf + c * CHUNK;
+
+    int pos = 0;
+    bool final = false;
+    while (1) {
+        if (pos < FRAMES) {
+            for (int c = 0; c < CHANNELS; c++)
+                planes[c] = input[c] + pos;
+            pos += mp_scaletempo2_fill_input_buffer(p, (uint8_t **)planes,
+                                                    MPMIN(CHUNK, FRAMES - pos),
+                                                    speed);
+        } else if (!final) {
+            mp_scaletempo2_set_final(p);
+            final = true;
+        }
+        if (!mp_scaletempo2_frames_available(p, speed)) {
+            if (final)
+                break;
+            continue;
+        }
+        int got = mp_scaletempo2_fill_buffer(p, dest, CHUNK, speed);
+        MP_RESIZE_ARRAY(ta_ctx, out, (num_out + got) * CHANNELS);
+        for (int n = 0; n < got; n++) {
+            for (int c = 0; c < CHANNELS; c++)
+                out[(num_out + n) * CHANNELS + c] = dest[c][n];
+        }
+        num_out += got;
+    }
+
+    talloc_free(p);
+    *out_frames = num_out;
+    return out;
+}
+
+// Print the processing time for each thread count (for "meson test
+// --benchmark"). The output is checked as in the normal test.
+static void benchmark(void *ta_ctx, float **input)
+{
+    int threads[] = {1, 2, 4, 8, CHANNELS};
+    double base = 0;
+    for (int n = 0; n < MP_ARRAY_SIZE(threads); n++) {
+        int frames;
+        int64_t start = mp_time_ns();
+        run(ta_ctx, input, threads[n], &frames);
+        double secs = MP_TIME_NS_TO_S(mp_time_ns() - start);
+        if (!n)
+            base = secs;
+        printf("%2d threads: %7.1f ms (%.2fx)\n", threads[n], secs * 1e3,
+               base / secs);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    void *ta_ctx = talloc_new(NULL);
+
+    // Independent noise per channel, so that every channel affects the search.
+    mp_rand_state rng = mp_rand_seed(1);
+    float *input[CHANNELS];
+    for (int c = 0; c < CHANNELS; c++) {
+        input[c] = talloc_array(ta_ctx, float, FRAMES);
+        for (int n = 0; n < FRAMES; n++) {
+            input[c][n] = 0.5 * sin(2 * M_PI * (100 + 50 * c) * n / RATE) +
+                          0.1 * (mp_rand_next_double(&rng) - 0.5);
+        }
+    }
+
+    if (argc > 1 && strcmp(argv[1], "benchmark") == 0) {
+        benchmark(ta_ctx, input);
+        talloc_free(ta_ctx);
+        return 0;
+    }
+
+    int ref_frames;
+    float *ref = run(ta_ctx, input, 1, &ref_frames);
+    assert_true(ref_frames > FRAMES / 1.5 * 0.9);
+
+    // The result must not depend on the number of threads.
+    int threads[] = {2, 3, 4, CHANNELS};
+    for (int n = 0; n < MP_ARRAY_SIZE(threads); n++) {
+        int frames;
+        float *out = run(ta_ctx, input, threads[n], &frames);
+        assert_int_equal(frames, ref_frames);
+        assert_memcmp(out, ref, frames * CHANNELS * sizeof(float));
+    }
+
+    talloc_free(ta_ctx);
+    return 0;
+}
@@ -0,0 +1,118 @@
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <mpv/telemetry.h>
+
+#include "misc/telemetry.h"
+#include "mpv_talloc.h"
+#include "osdep/threads.h"
+#include "test_utils.h"
+
+#define NUM_UPDATES 2000000
+
+static atomic_bool writer_done;
+
+static MP_THREAD_VOID writer_thread(void *arg)
+{
+    struct mp_telemetry *t = arg;
+    for (int n = 1; n <= NUM_UPDATES; n++) {
+        // All fields carry the same value, so a torn read is easy to detect.
+        struct mpv_telemetry_snapshot snap = {
+            .playlist_pos = n,
+            .time_pos = n,
+            .duration = n,
+            .speed = n,
+            .avsync = n,
+            .total_avsync_change = n,
+            .cache_duration = n,
+            .cache_forward_bytes = n,
+            .cache_speed = n,
+            .frame_drop_count = n,
+            .decoder_frame_drop_count = n,
+            .vo_delayed_frame_count = n,
+            .mistimed_frame_count = n,
+        };
+        mp_telemetry_publish(t, &snap);
+    }
+    atomic_store(&writer_done, true);
+    MP_THREAD_RETURN();
+}
+
+static void check_snapshot(const struct mpv_telemetry_snapshot *s)
+{
+    int64_t n = s->playlist_pos;
+    assert_int_equal(s->update_count, n);
+    assert_true(s->flags & MPV_TELEMETRY_ACTIVE);
+    assert_float_equal(s->time_pos, n, 0);
+    assert_float_equal(s->duration, n, 0);
+    assert_float_equal(s->speed, n, 0);
+    assert_float_equal(s->avsync, n, 0);
+    assert_float_equal(s->total_avsync_change, n, 0);
+    assert_float_equal(s->cache_duration, n, 0);
+    assert_int_equal(s->cache_forward_bytes, n);
+    assert_int_equal(s->cache_speed, n);
+    assert_int_equal(s->frame_drop_count, n);
+    assert_int_equal(s->decoder_frame_drop_count, n);
+    assert_int_equal(s->vo_delayed_frame_count, n);
+    assert_int_equal(s->mistimed_frame_count, n);
+}
+
+int main(void)
+{
+    char path[] = "/tmp/mpv-telemetry-test-XXXXXX";
+    int tmp = mkstemp(path);
+    assert_true(tmp >= 0);
+    close(tmp);
+
+    struct mp_telemetry *t = mp_telemetry_create(NULL, NULL, path);
+    assert_true(t);
+
+    // Map the file separately, like an external reader would.
+    int fd = open(path, O_RDWR);
+    assert_true(fd >= 0);
+    mpv_telemetry_shm *shm = mmap(NULL, sizeof(*shm), PROT_READ | PROT_WRITE,
+                                  MAP_SHARED, fd, 0);
+    assert_true(shm != MAP_FAILED);
+
+    assert_int_equal(shm->magic, MPV_TELEMETRY_MAGIC);
+    assert_int_equal(shm->version, MPV_TELEMETRY_VERSION);
+    assert_int_equal(shm->snapshot_size, sizeof(mpv_telemetry_snapshot));
+    assert_int_equal(shm->pid, getpid());
+
+    mp_thread writer;
+    assert_false(mp_thread_create(&writer, writer_thread, t));
+
+    struct mpv_telemetry_snapshot s;
+    uint64_t last = 0;
+    int reads = 0;
+    while (!atomic_load(&writer_done)) {
+        int r = mpv_telemetry_read(shm, &s, 1000);
+        assert_true(r == 0 || r == -2);
+        if (r < 0 || !s.update_count)
+            continue;
+        check_snapshot(&s);
+        assert_true(s.update_count >= last);
+        last = s.update_count;
+        reads++;
+    }
+    mp_thread_join(writer);
+
+    assert_int_equal(mpv_telemetry_read(shm, &s, 1), 0);
+    check_snapshot(&s);
+    assert_int_equal(s.update_count, NUM_UPDATES);
+    printf("%d consistent reads\n", reads);
+
+    // Destroying the writer marks the snapshot inactive, but keeps the values.
+    talloc_free(t);
+    assert_int_equal(mpv_telemetry_read(shm, &s, 1), 0);
+    assert_false(s.flags & MPV_TELEMETRY_ACTIVE);
+    assert_int_equal(s.update_count, NUM_UPDATES);
+
+    munmap(shm, sizeof(*shm));
+    close(fd);
+    unlink(path);
+    return 0;
+}
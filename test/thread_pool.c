@@ -0,0 +1,64 @@
+#include "misc/thread_pool.h"
+#include "mpv_talloc.h"
+#include "osdep/threads.h"
+#include "test_utils.h"
+
+#define NUM_ITEMS 100
+
+struct state {
+    mp_mutex lock;
+    mp_cond wakeup;
+    bool start;
+    int order[NUM_ITEMS];
+    int num_done;
+};
+
+struct item {
+    struct state *s;
+    int index;
+};
+
+static void run_item(void *ctx)
+{
+    struct item *item = ctx;
+    struct state *s = item->s;
+    mp_mutex_lock(&s->lock);
+    // Block the single worker until everything is queued.
+    while (!s->start)
+        mp_cond_wait(&s->wakeup, &s->lock);
+    s->order[s->num_done++] = item->index;
+    mp_cond_broadcast(&s->wakeup);
+    mp_mutex_unlock(&s->lock);
+}
+
+int main(void)
+{
+    struct state s = {0};
+    mp_mutex_init(&s.lock);
+    mp_cond_init(&s.wakeup);
+
+    struct mp_thread_pool *pool = mp_thread_pool_create(NULL, 1, 1, 1);
+    assert_true(pool);
+
+    struct item items[NUM_ITEMS];
+    for (int n = 0; n < NUM_ITEMS; n++) {
+        items[n] = (struct item){&s, n};
+        assert_true(mp_thread_pool_queue(pool, run_item, &items[n]));
+    }
+
+    mp_mutex_lock(&s.lock);
+    s.start = true;
+    mp_cond_broadcast(&s.wakeup);
+    while (s.num_done < NUM_ITEMS)
+        mp_cond_wait(&s.wakeup, &s.lock);
+    mp_mutex_unlock(&s.lock);
+
+    // Queued items are started in FIFO order.
+    for (int n = 0; n < NUM_ITEMS; n++)
+        assert_int_equal(s.order[n], n);
+
+    talloc_free(pool);
+    mp_cond_destroy(&s.wakeup);
+    mp_mutex_destroy(&s.lock);
+    return 0;
+}
@@ -36,5 +36,28 @@ int main(void)
         assert_int_equal(mp_time_ns_add(test2, 20.44), INT64_MAX);
     }
 
+    /* clock speed */
+    {
+        mp_time_set_speed(10);
+        assert_int_equal(mp_time_ns_to_real(MP_TIME_MS_TO_NS(100)),
+                         MP_TIME_MS_TO_NS(10));
+
+        uint64_t raw = mp_raw_time_ns();
+        int64_t now = mp_time_ns();
+        mp_sleep_ns(MP_TIME_MS_TO_NS(200));
+        int64_t now2 = mp_time_ns();
+        assert_true(now2 - now >= MP_TIME_MS_TO_NS(200));
+        // Took 20ms of real time, plus scheduling latency.
+        assert_true(mp_raw_time_ns() - raw < MP_TIME_MS_TO_NS(150));
+
+        // Changing the speed keeps the time continuous.
+        mp_time_set_speed(1);
+        int64_t now3 = mp_time_ns();
+        assert_true(now3 >= now2);
+        assert_int_equal(mp_time_ns_to_real(123), 123);
+        mp_sleep_ns(MP_TIME_MS_TO_NS(10));
+        assert_true(mp_time_ns() - now3 >= MP_TIME_MS_TO_NS(10));
+    }
+
     return 0;
 }
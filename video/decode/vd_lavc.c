@@ -34,6 +34,7 @@
 #include "options/m_config.h"
 #include "options/options.h"
 #include "osdep/threads.h"
+#include "osdep/timer.h"
 #include "misc/bstr.h"
 #include "common/av_common.h"
 #include "common/codecs.h"
@@ -75,6 +76,11 @@ static int hwdec_opt_help(struct mp_log *log, const m_option_t *opt,
 // Surfaces referenced outside of libavcodec on top of what the VO declares
 #define HWDEC_EXTRA_INFLIGHT_FRAMES 3
 
+// --vd-lavc-threads=adaptive: minimum amount of decoded frames and media time
+// before the thread count is re-evaluated.
+#define ADAPT_MIN_FRAMES 30
+#define ADAPT_MIN_TIME 2.0
+
 #define OPT_BASE_STRUCT struct vd_lavc_params
 
 struct vd_lavc_params {
@@ -115,7 +121,8 @@ const struct m_sub_options vd_lavc_conf = {
         {"vd-lavc-skipidct", OPT_DISCARD(skip_idct)},
         {"vd-lavc-skipframe", OPT_DISCARD(skip_frame)},
         {"vd-lavc-framedrop", OPT_DISCARD(framedrop)},
-        {"vd-lavc-threads", OPT_INT(threads), M_RANGE(0, DBL_MAX)},
+        {"vd-lavc-threads", OPT_CHOICE(threads, {"adaptive", -1}),
+            M_RANGE(0, DBL_MAX)},
         {"vd-lavc-bitexact", OPT_BOOL(bitexact)},
         {"vd-lavc-assume-old-x264", OPT_BOOL(old_x264)},
         {"vd-lavc-check-hw-profile", OPT_BOOL(check_hw_profile)},
@@ -234,6 +241,25 @@ typedef struct lavc_ctx {
     int num_delay_queue;
     int max_delay_queue;
 
+    // For --vd-lavc-threads=adaptive. Only used with software decoding.
+    struct {
+        bool enabled;
+        int threads;            // thread count of the current avctx
+        int max_threads;
+        int pending;            // switch to this count at the next keyframe
+        char reason[80];
+        bool draining;          // old avctx is drained before the switch
+        // Statistics of the current evaluation window.
+        int64_t decode_ns;      // time spent in libavcodec calls
+        double media_time;      // duration of the decoded frames
+        double last_pts;
+        int frames;
+        int framedrops;         // packets sent with framedropping requested
+        int64_t vo_drops;       // VO drop count at the start of the window
+        int64_t queued_sum;     // VDCTRL_SET_QUEUED_FRAMES samples
+        int queued_samples;
+    } adapt;
+
     // From VO
     struct vo *vo;
     struct mp_hwdec_devices *hwdec_devs;
@@ -724,6 +750,19 @@ static void reinit(struct mp_filter *vd)
     ctx->wait_for_keyframe = ctx->use_hwdec ? HWDEC_WAIT_KEYFRAME_COUNT : 0;
 }
 
+static void reset_adapt_window(struct mp_filter *vd)
+{
+    vd_ffmpeg_ctx *ctx = vd->priv;
+
+    ctx->adapt.decode_ns = 0;
+    ctx->adapt.media_time = 0;
+    ctx->adapt.frames = 0;
+    ctx->adapt.framedrops = 0;
+    ctx->adapt.vo_drops = ctx->vo ? vo_get_drop_count(ctx->vo) : 0;
+    ctx->adapt.queued_sum = 0;
+    ctx->adapt.queued_samples = 0;
+}
+
 static void init_avctx(struct mp_filter *vd)
 {
     vd_ffmpeg_ctx *ctx = vd->priv;
@@ -767,7 +806,8 @@ static void init_avctx(struct mp_filter *vd)
     if (!ctx->avpkt)
         goto error;
 
-    int threads = lavc_param->threads;
+    ctx->adapt.enabled = lavc_param->threads < 0 && !ctx->use_hwdec;
+    int threads = ctx->adapt.enabled ? ctx->adapt.threads : lavc_param->threads;
     if (ctx->use_hwdec) {
         avctx->opaque = vd;
         avctx->hwaccel_flags |= AV_HWACCEL_FLAG_IGNORE_LEVEL;
@@ -814,6 +854,14 @@ static void init_avctx(struct mp_filter *vd)
     }
 
     mp_set_avcodec_threads(vd->log, avctx, threads);
+    if (ctx->adapt.enabled) {
+        // Start with the automatic thread count, which is also the maximum.
+        ctx->adapt.threads = avctx->thread_count;
+        if (!ctx->adapt.max_threads)
+            ctx->adapt.max_threads = avctx->thread_count;
+        ctx->adapt.last_pts = MP_NOPTS_VALUE;
+        reset_adapt_window(vd);
+    }
 
     if (!ctx->use_hwdec && ctx->vo && lavc_param->dr) {
         avctx->opaque = vd;
@@ -905,6 +953,9 @@ static void reset_avctx(struct mp_filter *vd)
         avcodec_flush_buffers(ctx->avctx);
     ctx->flushing = false;
     ctx->hwdec_request_reinit = false;
+    ctx->adapt.draining = false;
+    ctx->adapt.last_pts = MP_NOPTS_VALUE;
+    reset_adapt_window(vd);
     // Wait for the first keyframe after reset to ensure the decoder state is
     // valid. Seeking should already jump to a keyframe, so this is safe.
     ctx->wait_for_keyframe = ctx->use_hwdec ? HWDEC_WAIT_KEYFRAME_COUNT : 0;
@@ -1202,6 +1253,101 @@ static void prepare_decoding(struct mp_filter *vd)
         reset_avctx(vd);
 }
 
+// Called for each decoded frame with --vd-lavc-threads=adaptive. Decides
+// whether the thread count should be changed; the change itself is deferred to
+// the next keyframe, since libavcodec can't change it on an open decoder.
+static void update_adapt(struct mp_filter *vd, struct mp_image *mpi)
+{
+    vd_ffmpeg_ctx *ctx = vd->priv;
+    struct AVCodecContext *avctx = ctx->avctx;
+
+    double duration = mpi->pts - ctx->adapt.last_pts;
+    if (mpi->pts == MP_NOPTS_VALUE || ctx->adapt.last_pts == MP_NOPTS_VALUE ||
+        duration <= 0 || duration >= 1)
+        duration = mpi->pkt_duration > 0 ? mpi->pkt_duration : 0;
+    ctx->adapt.last_pts = mpi->pts;
+    ctx->adapt.media_time += duration;
+    ctx->adapt.frames += 1;
+
+    if (ctx->adapt.pending || ctx->adapt.frames < ADAPT_MIN_FRAMES ||
+        ctx->adapt.media_time < ADAPT_MIN_TIME)
+        return;
+
+    // Fraction of the playback time the decoder thread spent in libavcodec.
+    double load = MP_TIME_NS_TO_S(ctx->adapt.decode_ns) / ctx->adapt.media_time;
+    int64_t drops = ctx->vo ? vo_get_drop_count(ctx->vo) - ctx->adapt.vo_drops : 0;
+    double queued = ctx->adapt.queued_samples ?
+        ctx->adapt.queued_sum / (double)ctx->adapt.queued_samples : -1;
+    int threads = ctx->adapt.threads;
+    char *reason = ctx->adapt.reason;
+    size_t reason_size = sizeof(ctx->adapt.reason);
+
+    if (threads < ctx->adapt.max_threads) {
+        // Dropped frames are blamed on the decoder only if it's busy at all.
+        if (load > 0.8) {
+            snprintf(reason, reason_size, "decoding takes %d%% of frame time",
+                     (int)(load * 100));
+        } else if (ctx->adapt.framedrops && load > 0.5) {
+            snprintf(reason, reason_size, "decoder dropped %d frames",
+                     ctx->adapt.framedrops);
+        } else if (drops > 0 && load > 0.5) {
+            snprintf(reason, reason_size, "VO dropped %"PRId64" frames", drops);
+        } else if (queued >= 0 && queued < 1 && load > 0.5) {
+            snprintf(reason, reason_size, "decoder queue ran empty");
+        } else {
+            reason[0] = '\0';
+        }
+        if (reason[0])
+            threads = MPMIN(threads * 2, ctx->adapt.max_threads);
+    }
+
+    if (threads == ctx->adapt.threads && threads > 1 && load < 0.25 &&
+        !drops && !ctx->adapt.framedrops && (queued < 0 || queued >= 1))
+    {
+        snprintf(reason, reason_size, "decoding takes only %d%% of frame time",
+                 (int)(load * 100));
+        threads = MPMAX(threads / 2, 1);
+    }
+
+    MP_DBG(vd, "Adaptive threads: %d threads, load %.2f, %"PRId64" VO drops, "
+           "%d decoder drops, queue %.1f.\n", ctx->adapt.threads, load, drops,
+           ctx->adapt.framedrops, queued);
+
+    if (threads != ctx->adapt.threads && avctx) {
+        MP_VERBOSE(vd, "Switching to %d decoding threads at the next keyframe "
+                   "(%s).\n", threads, reason);
+        ctx->adapt.pending = threads;
+    }
+    reset_adapt_window(vd);
+}
+
+// The old avctx was fully drained; recreate it with the new thread count. The
+// keyframe that triggered the switch is still in requeue_packets.
+static void switch_adapt_threads(struct mp_filter *vd)
+{
+    vd_ffmpeg_ctx *ctx = vd->priv;
+
+    struct demux_packet **pkts = ctx->requeue_packets;
+    int num_pkts = ctx->num_requeue_packets;
+    ctx->requeue_packets = NULL;
+    ctx->num_requeue_packets = 0;
+
+    int old = ctx->adapt.threads;
+    ctx->adapt.threads = ctx->adapt.pending;
+    ctx->adapt.pending = 0;
+
+    uninit_avctx(vd);
+    init_avctx(vd);
+
+    ctx->requeue_packets = pkts;
+    ctx->num_requeue_packets = num_pkts;
+
+    if (ctx->avctx) {
+        MP_INFO(vd, "Decoding threads: %d -> %d (%s).\n", old,
+                ctx->adapt.threads, ctx->adapt.reason);
+    }
+}
+
 static void handle_err(struct mp_filter *vd)
 {
     vd_ffmpeg_ctx *ctx = vd->priv;
@@ -1245,9 +1391,26 @@ static int send_packet(struct mp_filter *vd, struct demux_packet *pkt)
     if (avctx->skip_frame == AVDISCARD_ALL)
         return 0;
 
+    if (ctx->adapt.pending && pkt && pkt->keyframe) {
+        // Drain the old decoder, and resend the keyframe to the new one.
+        struct demux_packet *copy = demux_copy_packet(vd->packet_pool, pkt);
+        if (copy) {
+            MP_TARRAY_APPEND(ctx, ctx->requeue_packets,
+                             ctx->num_requeue_packets, copy);
+            avcodec_send_packet(avctx, NULL);
+            ctx->adapt.draining = true;
+            return 0;
+        }
+    }
+
+    if (ctx->framedrop_flags == 1)
+        ctx->adapt.framedrops += 1;
+
     mp_set_av_packet(ctx->avpkt, pkt, &ctx->codec_timebase);
 
+    int64_t start = mp_time_ns();
     int ret = avcodec_send_packet(avctx, pkt ? ctx->avpkt : NULL);
+    ctx->adapt.decode_ns += mp_time_ns() - start;
     if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF)
         return ret;
 
@@ -1287,12 +1450,17 @@ static int decode_frame(struct mp_filter *vd)
     prepare_decoding(vd);
 
     // Re-send old packets (typically after a hwdec fallback during init).
-    if (ctx->num_requeue_packets)
+    if (ctx->num_requeue_packets && !ctx->adapt.draining)
         send_queued_packet(vd);
 
+    int64_t start = mp_time_ns();
     int ret = avcodec_receive_frame(avctx, ctx->pic);
+    ctx->adapt.decode_ns += mp_time_ns() - start;
     if (ret < 0) {
-        if (ret == AVERROR_EOF) {
+        if (ret == AVERROR_EOF && ctx->adapt.draining) {
+            switch_adapt_threads(vd);
+            return AVERROR(EAGAIN); // resend the keyframe
+        } else if (ret == AVERROR_EOF) {
             // If flushing was initialized earlier and has ended now, make it
             // start over in case we get new packets at some point in the future.
             // This must take the delay queue into account, so avctx returns EOF
@@ -1334,6 +1502,9 @@ static int decode_frame(struct mp_filter *vd)
 
     av_frame_unref(ctx->pic);
 
+    if (ctx->adapt.enabled)
+        update_adapt(vd, mpi);
+
     MP_TARRAY_APPEND(ctx, ctx->delay_queue, ctx->num_delay_queue, mpi);
     return ret;
 }
@@ -1430,6 +1601,10 @@ static int control(struct mp_filter *vd, enum dec_ctrl cmd, void *arg)
     case VDCTRL_SET_EXTRA_HW_FRAMES:
         ctx->extra_hw_frames_hint = *(int *)arg;
         return CONTROL_TRUE;
+    case VDCTRL_SET_QUEUED_FRAMES:
+        ctx->adapt.queued_sum += *(int *)arg;
+        ctx->adapt.queued_samples += 1;
+        return CONTROL_TRUE;
     case VDCTRL_CHECK_FORCED_EOF: {
         *(bool *)arg = ctx->force_eof;
         return CONTROL_TRUE;
@@ -23,6 +23,8 @@
 #include "filters/filter_internal.h"
 #include "filters/user_filters.h"
 #include "options/m_option.h"
+#include "options/path.h"
+#include "video/fingerprint_index.h"
 #include "video/img_format.h"
 #include "video/sws_utils.h"
 #include "video/zimg.h"
@@ -35,6 +37,9 @@ struct f_opts {
     int type;
     bool clear;
     bool print;
+    char *index_file;
+    int step;
+    int scene_threshold;
 };
 
 const struct m_opt_choice_alternatives type_names[] = {
@@ -48,16 +53,22 @@ static const struct m_option f_opts_list[] = {
     {"type", OPT_CHOICE_C(type, type_names)},
     {"clear-on-query", OPT_BOOL(clear)},
     {"print", OPT_BOOL(print)},
+    {"index-file", OPT_STRING(index_file), .flags = M_OPT_FILE},
+    {"step", OPT_INT(step), M_RANGE(1, 100000)},
+    {"scene-threshold", OPT_INT(scene_threshold), M_RANGE(0, 255)},
     {0}
 };
 
 static const struct f_opts f_opts_def = {
     .type = 16,
     .clear = true,
+    .step = 1,
+    .scene_threshold = 30,
 };
 
 struct print_entry {
     double pts;
+    int flags;
     char *print;
 };
 
@@ -69,10 +80,13 @@ struct priv {
     struct print_entry entries[PRINT_ENTRY_NUM];
     int num_entries;
     bool fallback_warning;
+    uint8_t *hash, *prev_hash;  // size*size bytes each
+    bool have_prev;
+    int frame_count;            // for opts->step
+    struct mp_fp_index_writer *index;
 };
 
-// (Other code internal to this filter also calls this to reset the frame list.)
-static void f_reset(struct mp_filter *f)
+static void clear_entries(struct mp_filter *f)
 {
     struct priv *p = f->priv;
 
@@ -81,6 +95,16 @@ static void f_reset(struct mp_filter *f)
     p->num_entries = 0;
 }
 
+static void f_reset(struct mp_filter *f)
+{
+    struct priv *p = f->priv;
+
+    clear_entries(f);
+    // No scene cut detection across seeks.
+    p->have_prev = false;
+    p->frame_count = 0;
+}
+
 static void f_process(struct mp_filter *f)
 {
     struct priv *p = f->priv;
@@ -100,6 +124,11 @@ static void f_process(struct mp_filter *f)
 
     struct mp_image *mpi = frame.data;
 
+    if (p->frame_count++ % p->opts->step) {
+        mp_pin_in_write(f->ppins[1], frame);
+        return;
+    }
+
     // Try to achieve minimum conversion, even if it makes the fingerprints less
     // "portable" across source video.
     p->scaled->params.repr = mpi->params.repr;
@@ -123,20 +152,35 @@ static void f_process(struct mp_filter *f)
 
     int size = p->scaled->w;
 
+    for (int y = 0; y < size; y++) {
+        memcpy(&p->hash[y * size],
+               p->scaled->planes[0] + y * p->scaled->stride[0], size);
+    }
+
+    int flags = 0;
+    int threshold = p->opts->scene_threshold;
+    if (p->have_prev && threshold &&
+        mp_fp_distance(p->hash, p->prev_hash, size * size) >= threshold)
+        flags |= MP_FP_SCENE_CUT;
+    MPSWAP(uint8_t *, p->hash, p->prev_hash);
+    p->have_prev = true;
+    uint8_t *hash = p->prev_hash;
+
+    if (p->index)
+        mp_fp_index_writer_add(p->index, mpi->pts, flags, hash);
+
     struct print_entry *e = &p->entries[p->num_entries++];
     e->pts = mpi->pts;
+    e->flags = flags;
     e->print = talloc_array(p, char, size * size * 2 + 1);
 
-    for (int y = 0; y < size; y++) {
-        for (int x = 0; x < size; x++) {
-            char *offs = &e->print[(y * size + x) * 2];
-            uint8_t v = p->scaled->planes[0][y * p->scaled->stride[0] + x];
-            snprintf(offs, 3, "%02x", v);
-        }
-    }
+    for (int n = 0; n < size * size; n++)
+        snprintf(&e->print[n * 2], 3, "%02x", hash[n]);
 
-    if (p->opts->print)
-        MP_INFO(f, "%f: %s\n", e->pts, e->print);
+    if (p->opts->print) {
+        MP_INFO(f, "%f: %s%s\n", e->pts, e->print,
+                (flags & MP_FP_SCENE_CUT) ? " (scene cut)" : "");
+    }
 
     mp_pin_in_write(f->ppins[1], frame);
     return;
@@ -163,12 +207,14 @@ static bool f_command(struct mp_filter *f, struct mp_filter_command *cmd)
                                    mp_tprintf(80, "%f", e->pts));
             }
             mp_tags_set_str(t, mp_tprintf(80, "fp%d.hex", n), e->print);
+            if (e->flags & MP_FP_SCENE_CUT)
+                mp_tags_set_str(t, mp_tprintf(80, "fp%d.scene-cut", n), "yes");
         }
 
         mp_tags_set_str(t, "type", m_opt_choice_str(type_names, p->opts->type));
 
         if (p->opts->clear)
-            f_reset(f);
+            clear_entries(f);
 
         *(struct mp_tags **)cmd->res = t;
         return true;
@@ -178,11 +224,20 @@ static bool f_command(struct mp_filter *f, struct mp_filter_command *cmd)
     }
 }
 
+static void f_destroy(struct mp_filter *f)
+{
+    struct priv *p = f->priv;
+
+    mp_fp_index_writer_close(p->index);
+    p->index = NULL;
+}
+
 static const struct mp_filter_info filter = {
     .name = "fingerprint",
     .process = f_process,
     .command = f_command,
     .reset = f_reset,
+    .destroy = f_destroy,
     .priv_size = sizeof(struct priv),
 };
 
@@ -203,6 +258,17 @@ static struct mp_filter *f_create(struct mp_filter *parent, void *options)
     p->scaled = mp_image_alloc(IMGFMT_Y8, size, size);
     MP_HANDLE_OOM(p->scaled);
     talloc_steal(p, p->scaled);
+    p->hash = talloc_zero_array(p, uint8_t, size * size);
+    p->prev_hash = talloc_zero_array(p, uint8_t, size * size);
+    if (p->opts->index_file && p->opts->index_file[0]) {
+        char *path = mp_get_user_path(NULL, f->global, p->opts->index_file);
+        p->index = mp_fp_index_writer_open(p, f->log, path, size * size);
+        talloc_free(path);
+        if (!p->index) {
+            talloc_free(f);
+            return NULL;
+        }
+    }
     p->sws = mp_sws_alloc(p);
     MP_HANDLE_OOM(p->sws);
     p->zimg = mp_zimg_alloc();
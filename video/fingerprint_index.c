@@ -0,0 +1,207 @@
+/*
+ * This file is part of mpv.
+ *
+ * mpv is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * mpv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <libavutil/intreadwrite.h>
+
+#include "common/common.h"
+#include "common/msg.h"
+#include "fingerprint_index.h"
+#include "osdep/io.h"
+
+#define MAGIC "mpvfpidx"
+#define VERSION 1
+#define HEADER_SIZE 16
+#define ENTRY_HEADER_SIZE 9
+#define MAX_HASH_SIZE 4096
+
+struct mp_fp_index_writer {
+    struct mp_log *log;
+    char *path;
+    FILE *f;
+    int hash_size;
+    uint8_t *buf;
+    bool ok;
+};
+
+static void writer_destroy(void *ptr)
+{
+    struct mp_fp_index_writer *w = ptr;
+    if (w->f)
+        fclose(w->f);
+}
+
+struct mp_fp_index_writer *mp_fp_index_writer_open(void *ta_parent,
+                                                   struct mp_log *log,
+                                                   const char *path,
+                                                   int hash_size)
+{
+    mp_assert(hash_size > 0 && hash_size <= MAX_HASH_SIZE);
+
+    FILE *f = fopen(path, "wb");
+    if (!f) {
+        mp_err(log, "Could not open '%s': %s\n", path, mp_strerror(errno));
+        return NULL;
+    }
+
+    struct mp_fp_index_writer *w = talloc_zero(ta_parent,
+                                               struct mp_fp_index_writer);
+    talloc_set_destructor(w, writer_destroy);
+    w->log = log;
+    w->path = talloc_strdup(w, path);
+    w->f = f;
+    w->hash_size = hash_size;
+    w->buf = talloc_size(w, ENTRY_HEADER_SIZE + hash_size);
+
+    uint8_t header[HEADER_SIZE];
+    memcpy(header, MAGIC, 8);
+    AV_WL32(header + 8, VERSION);
+    AV_WL32(header + 12, hash_size);
+    w->ok = fwrite(header, sizeof(header), 1, f) == 1;
+
+    return w;
+}
+
+bool mp_fp_index_writer_add(struct mp_fp_index_writer *w, double pts,
+                            int flags, const uint8_t *hash)
+{
+    int64_t ipts = INT64_MIN;
+    if (pts != MP_NOPTS_VALUE && isfinite(pts))
+        ipts = llrint(pts * 1e6);
+
+    AV_WL64(w->buf, ipts);
+    w->buf[8] = flags;
+    memcpy(w->buf + ENTRY_HEADER_SIZE, hash, w->hash_size);
+
+    if (w->ok && fwrite(w->buf, ENTRY_HEADER_SIZE + w->hash_size, 1, w->f) != 1) {
+        mp_err(w->log, "Could not write to '%s': %s\n", w->path,
+               mp_strerror(errno));
+        w->ok = false;
+    }
+    return w->ok;
+}
+
+bool mp_fp_index_writer_close(struct mp_fp_index_writer *w)
+{
+    if (!w)
+        return true;
+    bool ok = w->ok && fclose(w->f) == 0;
+    w->f = NULL;
+    if (!ok)
+        mp_err(w->log, "Failed to write '%s'.\n", w->path);
+    talloc_free(w);
+    return ok;
+}
+
+struct mp_fp_index *mp_fp_index_load(void *ta_parent, struct mp_log *log,
+                                     const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        mp_err(log, "Could not open '%s': %s\n", path, mp_strerror(errno));
+        return NULL;
+    }
+
+    struct mp_fp_index *idx = talloc_zero(ta_parent, struct mp_fp_index);
+
+    uint8_t header[HEADER_SIZE];
+    if (fread(header, sizeof(header), 1, f) != 1 ||
+        memcmp(header, MAGIC, 8) != 0)
+    {
+        mp_err(log, "'%s' is not a fingerprint index.\n", path);
+        goto error;
+    }
+    if (AV_RL32(header + 8) != VERSION) {
+        mp_err(log, "'%s' has unsupported version %u.\n", path,
+               (unsigned)AV_RL32(header + 8));
+        goto error;
+    }
+    uint32_t hash_size = AV_RL32(header + 12);
+    if (!hash_size || hash_size > MAX_HASH_SIZE) {
+        mp_err(log, "'%s' has invalid hash size %u.\n", path,
+               (unsigned)hash_size);
+        goto error;
+    }
+    idx->hash_size = hash_size;
+
+    uint8_t *buf = talloc_size(idx, ENTRY_HEADER_SIZE + hash_size);
+    while (fread(buf, ENTRY_HEADER_SIZE + hash_size, 1, f) == 1) {
+        int64_t ipts = AV_RL64(buf);
+        struct mp_fp_entry e = {
+            .pts = ipts == INT64_MIN ? MP_NOPTS_VALUE : ipts / 1e6,
+            .flags = buf[8],
+            .hash = talloc_memdup(idx, buf + ENTRY_HEADER_SIZE, hash_size),
+        };
+        MP_TARRAY_APPEND(idx, idx->entries, idx->num_entries, e);
+    }
+    if (ferror(f)) {
+        mp_err(log, "Could not read '%s'.\n", path);
+        goto error;
+    }
+    talloc_free(buf);
+
+    fclose(f);
+    return idx;
+
+error:
+    fclose(f);
+    talloc_free(idx);
+    return NULL;
+}
+
+int mp_fp_distance(const uint8_t *a, const uint8_t *b, int size)
+{
+    // Simple enough for compilers to vectorize (e.g. to psadbw on x86).
+    unsigned sum = 0;
+    for (int n = 0; n < size; n++)
+        sum += abs(a[n] - b[n]);
+    return (sum + size / 2) / size;
+}
+
+int mp_fp_index_find(struct mp_fp_index *idx, const uint8_t *hash,
+                     int max_distance, void *ta_parent,
+                     struct mp_fp_match **out)
+{
+    struct mp_fp_match *matches = NULL;
+    int num_matches = 0;
+    bool in_run = false;
+
+    for (int n = 0; n < idx->num_entries; n++) {
+        struct mp_fp_entry *e = &idx->entries[n];
+        int dist = mp_fp_distance(e->hash, hash, idx->hash_size);
+        if (dist > max_distance) {
+            in_run = false;
+            continue;
+        }
+        struct mp_fp_match m = {n, e->pts, dist};
+        if (in_run) {
+            struct mp_fp_match *prev = &matches[num_matches - 1];
+            if (dist < prev->distance)
+                *prev = m;
+        } else {
+            MP_TARRAY_APPEND(ta_parent, matches, num_matches, m);
+        }
+        in_run = true;
+    }
+
+    *out = matches;
+    return num_matches;
+}
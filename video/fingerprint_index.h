@@ -0,0 +1,62 @@
+#ifndef MPV_FINGERPRINT_INDEX_H
+#define MPV_FINGERPRINT_INDEX_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct mp_log;
+
+// Binary index of vf_fingerprint hashes. The file starts with a 16 byte
+// header: the magic "mpvfpidx", a 32 bit version and the 32 bit hash size in
+// bytes. It is followed by entries, each consisting of the 64 bit pts in
+// microseconds (INT64_MIN if unknown), a flags byte and the hash. All integers
+// are little endian. A truncated last entry is ignored when loading.
+
+// Entry flags.
+#define MP_FP_SCENE_CUT 1 // first frame after a scene cut
+
+struct mp_fp_entry {
+    double pts;         // MP_NOPTS_VALUE if unknown
+    int flags;          // MP_FP_* bit field
+    uint8_t *hash;      // hash_size bytes
+};
+
+struct mp_fp_index {
+    int hash_size;
+    struct mp_fp_entry *entries;
+    int num_entries;
+};
+
+struct mp_fp_match {
+    int index;          // into mp_fp_index.entries
+    double pts;
+    int distance;
+};
+
+// Create or truncate path and write the header. Returns NULL on error. Freeing
+// the writer closes the file; use mp_fp_index_writer_close() to check for
+// write errors.
+struct mp_fp_index_writer *mp_fp_index_writer_open(void *ta_parent,
+                                                   struct mp_log *log,
+                                                   const char *path,
+                                                   int hash_size);
+bool mp_fp_index_writer_add(struct mp_fp_index_writer *w, double pts,
+                            int flags, const uint8_t *hash);
+// Close the file and free w. Returns success of all writes.
+bool mp_fp_index_writer_close(struct mp_fp_index_writer *w);
+
+// Returns NULL on error.
+struct mp_fp_index *mp_fp_index_load(void *ta_parent, struct mp_log *log,
+                                     const char *path);
+
+// Mean absolute difference of two hashes of the given size (0-255).
+int mp_fp_distance(const uint8_t *a, const uint8_t *b, int size);
+
+// Find all entries within max_distance of hash. Of each run of consecutive
+// matching entries (e.g. a static shot), only the closest one is returned.
+// Returns the number of matches, and sets *out to a talloc'ed array.
+int mp_fp_index_find(struct mp_fp_index *idx, const uint8_t *hash,
+                     int max_distance, void *ta_parent,
+                     struct mp_fp_match **out);
+
+#endif
@@ -0,0 +1,132 @@
+/*
+ * This file is part of mpv.
+ *
+ * mpv is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * mpv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "common/common.h"
+#include "frame_cache.h"
+#include "mp_image.h"
+
+struct entry {
+    struct mp_image *img;
+    int64_t bytes;
+};
+
+struct mp_frame_cache {
+    int64_t max_bytes;
+    int64_t bytes;
+    // Ring buffer of num entries, starting at first.
+    struct entry *entries;
+    int alloc, first, num;
+};
+
+static void frame_cache_destroy(void *p)
+{
+    mp_frame_cache_clear(p);
+}
+
+struct mp_frame_cache *mp_frame_cache_new(void *tparent)
+{
+    struct mp_frame_cache *c = talloc_zero(tparent, struct mp_frame_cache);
+    talloc_set_destructor(c, frame_cache_destroy);
+    return c;
+}
+
+void mp_frame_cache_set_max_bytes(struct mp_frame_cache *c, int64_t max_bytes)
+{
+    c->max_bytes = max_bytes;
+}
+
+static struct entry *get_entry(struct mp_frame_cache *c, int index)
+{
+    mp_assert(index >= 0 && index < c->num);
+    return &c->entries[(c->first + index) % c->alloc];
+}
+
+static void drop_oldest(struct mp_frame_cache *c)
+{
+    struct entry *e = get_entry(c, 0);
+    c->bytes -= e->bytes;
+    talloc_free(e->img);
+    *e = (struct entry){0};
+    c->first = (c->first + 1) % c->alloc;
+    c->num--;
+}
+
+void mp_frame_cache_clear(struct mp_frame_cache *c)
+{
+    while (c->num)
+        drop_oldest(c);
+    c->first = 0;
+}
+
+void mp_frame_cache_add(struct mp_frame_cache *c, struct mp_image *img)
+{
+    if (c->num && !(img->pts > get_entry(c, c->num - 1)->img->pts))
+        mp_frame_cache_clear(c);
+
+    struct mp_image *ref = mp_image_new_ref(img);
+    MP_HANDLE_OOM(ref);
+    struct entry new = {ref, mp_image_approx_byte_size(ref)};
+
+    while (c->num && c->bytes + new.bytes > c->max_bytes)
+        drop_oldest(c);
+
+    if (c->num == c->alloc) {
+        // Unwrap the ring while growing it.
+        int alloc = MPMAX(16, c->alloc * 2);
+        struct entry *entries = talloc_array(c, struct entry, alloc);
+        for (int n = 0; n < c->num; n++)
+            entries[n] = *get_entry(c, n);
+        talloc_free(c->entries);
+        c->entries = entries;
+        c->alloc = alloc;
+        c->first = 0;
+    }
+
+    c->num++;
+    *get_entry(c, c->num - 1) = new;
+    c->bytes += new.bytes;
+}
+
+int mp_frame_cache_num_frames(struct mp_frame_cache *c)
+{
+    return c->num;
+}
+
+int64_t mp_frame_cache_get_bytes(struct mp_frame_cache *c)
+{
+    return c->bytes;
+}
+
+struct mp_image *mp_frame_cache_get(struct mp_frame_cache *c, int index)
+{
+    return get_entry(c, index)->img;
+}
+
+int mp_frame_cache_find(struct mp_frame_cache *c, double pts)
+{
+    // Timestamps are strictly increasing, so use a binary search.
+    int lo = 0, hi = c->num;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (get_entry(c, mid)->img->pts < pts) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo < c->num ? lo : -1;
+}
@@ -0,0 +1,33 @@
+#ifndef MPV_FRAME_CACHE_H
+#define MPV_FRAME_CACHE_H
+
+#include <stdint.h>
+
+struct mp_image;
+
+// A memory-capped history of consecutive decoded frames, oldest first. The
+// caller guarantees that each added frame directly follows the previous one,
+// so a frame's neighbors in the cache are its real neighbors in the stream.
+struct mp_frame_cache;
+
+struct mp_frame_cache *mp_frame_cache_new(void *tparent);
+void mp_frame_cache_set_max_bytes(struct mp_frame_cache *c, int64_t max_bytes);
+
+// Drop all frames.
+void mp_frame_cache_clear(struct mp_frame_cache *c);
+
+// Append a new reference to img. The cache is cleared first if the timestamp
+// does not increase. Oldest frames are dropped to stay within max_bytes, but
+// the new frame is always kept.
+void mp_frame_cache_add(struct mp_frame_cache *c, struct mp_image *img);
+
+int mp_frame_cache_num_frames(struct mp_frame_cache *c);
+int64_t mp_frame_cache_get_bytes(struct mp_frame_cache *c);
+
+// Return the frame at index (0 is the oldest). The cache keeps the reference.
+struct mp_image *mp_frame_cache_get(struct mp_frame_cache *c, int index);
+
+// Return the index of the first frame with a pts >= pts, or -1 if none.
+int mp_frame_cache_find(struct mp_frame_cache *c, double pts);
+
+#endif
@@ -55,6 +55,7 @@ extern const struct vo_driver video_out_gpu_next;
 extern const struct vo_driver video_out_libmpv;
 extern const struct vo_driver video_out_null;
 extern const struct vo_driver video_out_image;
+extern const struct vo_driver video_out_sim;
 extern const struct vo_driver video_out_lavc;
 extern const struct vo_driver video_out_caca;
 extern const struct vo_driver video_out_drm;
@@ -105,6 +106,7 @@ static const struct vo_driver *const video_out_drivers[] =
 
     // should not be auto-selected
     &video_out_image,
+    &video_out_sim,
     &video_out_tct,
 #if HAVE_CACA
     &video_out_caca,
@@ -0,0 +1,202 @@
+/*
+ * This file is part of mpv.
+ *
+ * mpv is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * mpv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Like vo_null, but simulates the timing behavior of a real display, for
+// testing and benchmarking the frame scheduling logic.
+
+#include <math.h>
+#include <stdlib.h>
+
+#include "common/msg.h"
+#include "misc/random.h"
+#include "options/m_option.h"
+#include "osdep/timer.h"
+#include "video/mp_image.h"
+#include "vo.h"
+
+struct priv {
+    // Options
+    double fps;
+    double jitter;          // ms
+    double missed;          // probability
+    double render_time;     // ms
+    double render_stddev;   // ms
+    double speed;
+    int seed;
+
+    mp_rand_state rand;
+    int64_t interval;       // ns
+    int64_t vsync_base;     // time of vsync 0
+    int64_t last_vsync;     // index of the vsync of the last flip
+    int64_t last_display;   // time of the last (jittered) vsync
+    int64_t skipped;        // vsyncs without flip before the last flip
+
+    // Statistics
+    int64_t num_frames, num_repeats, num_skipped, num_missed;
+};
+
+static double gauss(struct priv *p, double mean, double stddev)
+{
+    if (stddev <= 0)
+        return mean;
+    // Box-Muller transform
+    double u1 = MPMAX(mp_rand_next_double(&p->rand), 1e-12);
+    double u2 = mp_rand_next_double(&p->rand);
+    return mean + stddev * sqrt(-2 * log(u1)) * cos(2 * M_PI * u2);
+}
+
+static bool draw_frame(struct vo *vo, struct vo_frame *frame)
+{
+    struct priv *p = vo->priv;
+
+    if (frame->repeat) {
+        p->num_repeats += 1;
+    } else if (frame->current) {
+        p->num_frames += 1;
+    }
+
+    double render_time = gauss(p, p->render_time, p->render_stddev);
+    if (render_time > 0)
+        mp_sleep_ns(MP_TIME_MS_TO_NS(render_time));
+
+    return VO_TRUE;
+}
+
+static void flip_page(struct vo *vo)
+{
+    struct priv *p = vo->priv;
+
+    int64_t now = mp_time_ns();
+    if (!p->vsync_base) {
+        p->vsync_base = now;
+        p->last_vsync = -1;
+    }
+
+    // The frame is shown on the next vsync, at most one flip per vsync. A
+    // missed vsync means it's shown one vsync later.
+    int64_t vsync = (now - p->vsync_base) / p->interval + 1;
+    if (p->missed > 0 && mp_rand_next_double(&p->rand) < p->missed) {
+        vsync += 1;
+        p->num_missed += 1;
+    }
+    vsync = MPMAX(vsync, p->last_vsync + 1);
+    p->skipped = p->last_vsync >= 0 ? vsync - p->last_vsync - 1 : 0;
+    p->num_skipped += p->skipped;
+    p->last_vsync = vsync;
+
+    int64_t jitter = MP_TIME_MS_TO_NS(gauss(p, 0, p->jitter));
+    int64_t display = p->vsync_base + vsync * p->interval + jitter;
+    display = MPMAX(display, p->last_display + 1);
+    p->last_display = display;
+
+    // Block until the frame is displayed, like a swapchain with 1 image.
+    for (;;) {
+        now = mp_time_ns();
+        if (now >= display)
+            break;
+        mp_sleep_ns(display - now);
+    }
+}
+
+static void get_vsync(struct vo *vo, struct vo_vsync_info *info)
+{
+    struct priv *p = vo->priv;
+
+    info->last_queue_display_time = p->last_display;
+    info->vsync_duration = p->interval;
+    info->skipped_vsyncs = p->skipped;
+}
+
+static int query_format(struct vo *vo, int format)
+{
+    return 1;
+}
+
+static int reconfig(struct vo *vo, struct mp_image_params *params)
+{
+    return 0;
+}
+
+static void uninit(struct vo *vo)
+{
+    struct priv *p = vo->priv;
+
+    MP_INFO(vo, "Simulated %"PRId64" vsyncs: %"PRId64" frames, %"PRId64
+            " repeats, %"PRId64" vsyncs without flip, %"PRId64" missed "
+            "vsyncs.\n", p->last_vsync + 1, p->num_frames, p->num_repeats,
+            p->num_skipped, p->num_missed);
+
+    if (p->speed != 1)
+        mp_time_set_speed(1);
+}
+
+static int preinit(struct vo *vo)
+{
+    struct priv *p = vo->priv;
+
+    p->rand = mp_rand_seed(p->seed);
+    p->interval = MPMAX(1e9 / p->fps, 1);
+    p->last_vsync = -1;
+
+    if (p->speed != 1) {
+        MP_WARN(vo, "Running the player clock at %gx speed.\n", p->speed);
+        mp_time_set_speed(p->speed);
+    }
+    return 0;
+}
+
+static int control(struct vo *vo, uint32_t request, void *data)
+{
+    struct priv *p = vo->priv;
+    switch (request) {
+    case VOCTRL_GET_DISPLAY_FPS:
+        *(double *)data = p->fps;
+        return VO_TRUE;
+    }
+    return VO_NOTIMPL;
+}
+
+#define OPT_BASE_STRUCT struct priv
+const struct vo_driver video_out_sim = {
+    .description = "Simulated display for timing tests",
+    .name = "sim",
+    .preinit = preinit,
+    .query_format = query_format,
+    .reconfig = reconfig,
+    .control = control,
+    .draw_frame = draw_frame,
+    .flip_page = flip_page,
+    .get_vsync = get_vsync,
+    .uninit = uninit,
+    .priv_size = sizeof(struct priv),
+    .priv_defaults = &(const struct priv) {
+        .fps = 60,
+        .speed = 1,
+        .seed = 1,
+    },
+    .options = (const struct m_option[]) {
+        {"fps", OPT_DOUBLE(fps), M_RANGE(1, 1000)},
+        {"jitter", OPT_DOUBLE(jitter), M_RANGE(0, 1000)},
+        {"missed-vsyncs", OPT_DOUBLE(missed), M_RANGE(0, 1)},
+        {"render-time", OPT_DOUBLE(render_time), M_RANGE(0, 1000)},
+        {"render-time-stddev", OPT_DOUBLE(render_stddev), M_RANGE(0, 1000)},
+        {"speed", OPT_DOUBLE(speed), M_RANGE(1, 1000)},
+        {"seed", OPT_INT(seed)},
+        {0},
+    },
+    .options_prefix = "vo-sim",
+};